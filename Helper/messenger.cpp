@@ -44,13 +44,16 @@ Usage:
 #include <iomanip>
 #include <string>
 #include <vector>
-#include <thread>
-#include <chrono>
 #include <ctime>
 #include <cstdio>
 
 #pragma comment(lib, "bcrypt.lib")
 
+// Older SDK and MinGW headers predate high-resolution waitable timers (Windows 10 1803)
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
 // Return Codes
 const int SUCCESS = 0;
 const int ERR_USAGE = 1;
@@ -63,6 +66,8 @@ const int ERR_ATTACH_FAILED = 2;
 // Constants, use random uuid at runtime with another thing like server PID
 const int TIMESTAMP_WINDOW_SECONDS = 10;
 const char* DEFAULT_PIPE_NAME = "\\\\.\\pipe\\InjectorAuth";
+const DWORD INPUT_SETTLE_MAX_MS = 50;  // Longest wait for the target to read earlier input
+const LONGLONG INPUT_DRAIN_CHECK_US = 250;  // Interval between checks of the input buffer while it drains
 
 // Auth Payload Structure
 struct AuthPayload {
@@ -386,6 +391,45 @@ void SendRawModeShift(HANDLE hConsoleInput, bool keyDown) {
     WriteConsoleInput(hConsoleInput, &record, 1, &written);
 }
 
+// Input Injection: Wait until the target has read everything queued so far
+// Returns as soon as the input buffer is empty instead of always sleeping, so the next
+// key still arrives in a read of its own; gives up after maxMs like the old fixed sleep.
+// The input handle is signaled while input is pending, the opposite of what is needed, so
+// it can't be waited on for this. The buffer is checked on a high-resolution waitable
+// timer instead: Sleep(1) rounds up to the 15.6 ms system tick, a third of the whole wait.
+void WaitForInputDrained(HANDLE hConsoleInput, DWORD maxMs) {
+    DWORD pending = 0;
+    if (!GetNumberOfConsoleInputEvents(hConsoleInput, &pending) || pending == 0) {
+        return;
+    }
+
+    HANDLE hTimer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    if (!hTimer) {
+        hTimer = CreateWaitableTimerW(NULL, FALSE, NULL);   // Before Windows 10 1803
+    }
+    if (!hTimer) {
+        return;
+    }
+
+    LARGE_INTEGER frequency, start, now;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&start);
+    LONGLONG limit = frequency.QuadPart * maxMs / 1000;
+
+    LARGE_INTEGER due;
+    due.QuadPart = -INPUT_DRAIN_CHECK_US * 10;     // Relative, in 100 ns units
+    do {
+        if (!SetWaitableTimer(hTimer, &due, 0, NULL, NULL, FALSE) ||
+            WaitForSingleObject(hTimer, maxMs) != WAIT_OBJECT_0) {
+            break;
+        }
+        QueryPerformanceCounter(&now);
+    } while (GetNumberOfConsoleInputEvents(hConsoleInput, &pending) && pending > 0 &&
+             now.QuadPart - start.QuadPart < limit);
+
+    CloseHandle(hTimer);
+}
+
 // Input Injection: Send Standard Text
 void SendText(HANDLE hConsoleInput, const std::string& text) {
     std::vector<INPUT_RECORD> buffer;
@@ -524,29 +568,29 @@ int main(int argc, char* const argv[]) { // Added const for linter to shut up
 
     // Execute command
     if (command == "--enter") {
-        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        WaitForInputDrained(hStdIn, INPUT_SETTLE_MAX_MS);
         SendRawModeEnter(hStdIn);
     }
     else if (command == "--tab") {
-        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        WaitForInputDrained(hStdIn, INPUT_SETTLE_MAX_MS);
         SendRawModeTab(hStdIn);
     }
     else if (command == "--escape") {
-        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        WaitForInputDrained(hStdIn, INPUT_SETTLE_MAX_MS);
         SendRawModeEscape(hStdIn);
     }
     else if (command == "--shift-down") {
-        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        WaitForInputDrained(hStdIn, INPUT_SETTLE_MAX_MS);
         SendRawModeShift(hStdIn, true);
     }
     else if (command == "--shift-up") {
-        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        WaitForInputDrained(hStdIn, INPUT_SETTLE_MAX_MS);
         SendRawModeShift(hStdIn, false);
     }
     else {
         // Text injection
         SendText(hStdIn, command);
-        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        WaitForInputDrained(hStdIn, INPUT_SETTLE_MAX_MS);
         SendRawModeEnter(hStdIn);
     }
 
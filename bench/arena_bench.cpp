@@ -0,0 +1,146 @@
+/*
+arena_bench - heap calls, memory and teardown of many screens, SessionArena vs the global heap
+
+    cmake -S . -B build -DHEADLESS_TTY_BENCHMARKS=ON && cmake --build build --config Release
+    build\Release\arena_bench.exe arena [sessions] [lines]
+    build\Release\arena_bench.exe heap [sessions] [lines]
+
+Run the two modes as separate processes so neither inherits the other's heap. Each
+session is a Screen (120x40, 1000 lines of scrollback) fed output in turns, a few lines
+each, the way the read threads of many busy sessions interleave. Reported: global
+operator new calls while filling, process memory (private bytes and working set) before
+and after, and the time to destroy every session. Defaults: 1000 sessions, 5000 lines each.
+ */
+
+#include "headless_tty/screen.hpp"
+
+#include <windows.h>
+#include <psapi.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace headless_tty;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+std::atomic<uint64_t> g_news{ 0 };
+std::atomic<uint64_t> g_deletes{ 0 };
+
+struct Memory {
+    double private_mb = 0;
+    double working_set_mb = 0;
+};
+
+Memory memory_now() {
+    PROCESS_MEMORY_COUNTERS_EX counters = {};
+    counters.cb = sizeof(counters);
+    GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&counters), sizeof(counters));
+    Memory memory;
+    memory.private_mb = counters.PrivateUsage / 1048576.0;
+    memory.working_set_mb = counters.WorkingSetSize / 1048576.0;
+    return memory;
+}
+
+// Lines of shell-like output: prompts, short status lines and long wrapped ones
+std::string make_output(size_t seed) {
+    std::string out;
+    for (size_t i = 0; i < 8; ++i) {
+        size_t length = (seed * 7919 + i * 104729) % 180;
+        out += "\x1b[32mline\x1b[0m ";
+        out.append(length, static_cast<char>('a' + (seed + i) % 26));
+        out += "\r\n";
+    }
+    return out;
+}
+
+} // namespace
+
+void* operator new(size_t size) {
+    ++g_news;
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    std::abort();
+}
+
+void operator delete(void* p) noexcept {
+    if (p) {
+        ++g_deletes;
+        std::free(p);
+    }
+}
+
+void operator delete(void* p, size_t) noexcept {
+    operator delete(p);
+}
+
+int main(int argc, char* argv[]) {
+    bool arena = !(argc > 1 && std::strcmp(argv[1], "heap") == 0);
+    size_t sessions = argc > 2 ? static_cast<size_t>(std::atoi(argv[2])) : 1000;
+    size_t lines = argc > 3 ? static_cast<size_t>(std::atoi(argv[3])) : 5000;
+
+    std::vector<std::string> outputs;
+    for (size_t i = 0; i < 64; ++i) {
+        outputs.push_back(make_output(i));
+    }
+
+    Memory before = memory_now();
+    uint64_t news_before = g_news.load();
+
+    std::vector<std::unique_ptr<Screen>> screens;
+    for (size_t i = 0; i < sessions; ++i) {
+        screens.push_back(std::make_unique<Screen>(TerminalSize{ 120, 40 }, SCREEN_SCROLLBACK_LINES, arena));
+    }
+    Clock::time_point start = Clock::now();
+    for (size_t round = 0; round < lines / 8; ++round) {
+        for (size_t i = 0; i < sessions; ++i) {
+            const std::string& out = outputs[(round + i) % outputs.size()];
+            screens[i]->feed(reinterpret_cast<const uint8_t*>(out.data()), out.size());
+        }
+    }
+    double fill_s = std::chrono::duration<double>(Clock::now() - start).count();
+
+    uint64_t news = g_news.load() - news_before;
+    Memory filled = memory_now();
+    ArenaStats totals;
+    for (const auto& screen : screens) {
+        ArenaStats stats = screen->arena_stats();
+        totals.allocations += stats.allocations;
+        totals.heap_allocations += stats.heap_allocations;
+        totals.reserved_bytes += stats.reserved_bytes;
+        totals.used_bytes += stats.used_bytes;
+    }
+
+    uint64_t deletes_before = g_deletes.load();
+    start = Clock::now();
+    screens.clear();
+    double teardown_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    uint64_t deletes = g_deletes.load() - deletes_before;
+    Memory after = memory_now();
+
+    std::printf("%s: %zu sessions, %zu lines each, filled in %.2f s\n", arena ? "arena" : "heap", sessions, lines, fill_s);
+    std::printf("  operator new while filling  %12llu\n", static_cast<unsigned long long>(news));
+    if (arena) {
+        std::printf("  arena allocations           %12llu (%llu from the heap)\n",
+                    static_cast<unsigned long long>(totals.allocations),
+                    static_cast<unsigned long long>(totals.heap_allocations));
+        std::printf("  arena reserved / in use     %9.1f MB / %.1f MB\n",
+                    totals.reserved_bytes / 1048576.0, totals.used_bytes / 1048576.0);
+    }
+    std::printf("  private bytes               %9.1f MB (+%.1f MB)\n", filled.private_mb, filled.private_mb - before.private_mb);
+    std::printf("  working set                 %9.1f MB (+%.1f MB)\n", filled.working_set_mb,
+                filled.working_set_mb - before.working_set_mb);
+    std::printf("  teardown                    %9.2f ms, %llu operator delete calls\n", teardown_ms,
+                static_cast<unsigned long long>(deletes));
+    std::printf("  private bytes after         %9.1f MB\n", after.private_mb);
+    return 0;
+}
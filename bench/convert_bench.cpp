@@ -0,0 +1,96 @@
+/*
+convert_bench - scaling of the parallel capture converter with thread count
+
+    cmake -S . -B build -DHEADLESS_TTY_BENCHMARKS=ON && cmake --build build --config Release
+    build\Release\convert_bench.exe [capture | megabytes]
+
+Runs every format at 1, 2, 4, ... threads up to the core count and checks that each
+result is identical to the single-threaded one.
+ */
+
+#include "headless_tty/converter.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+
+using namespace headless_tty;
+
+namespace {
+
+// Plain lines, colored lines, CR progress bars and cursor-up blocks, like a build log
+std::string generate(size_t bytes) {
+    std::string out = "\x1b[2J\x1b[H";
+    for (int n = 1; out.size() < bytes; ++n) {
+        if (n % 50 == 0) {
+            for (int pct = 0; pct <= 100; pct += 5) {
+                out += "\r\x1b[K  " + std::to_string(pct) + "% downloading item " + std::to_string(n);
+            }
+            out += "\r\n";
+        } else if (n % 97 == 0) {
+            out += "a\r\nb\r\n";
+            for (int step = 0; step < 10; ++step) {
+                out += "\x1b[2A\rA " + std::to_string(step) + "\x1b[K\r\nB " + std::to_string(step) + "\x1b[K\r\n";
+            }
+        } else if (n % 31 == 0) {
+            out += "\x1b[32mcolored \xE4\xB8\xAD\xE6\x96\x87 line " + std::to_string(n) + "\x1b[0m\r\n";
+        } else {
+            out += "plain output line number " + std::to_string(n) + " with some text to pad it out\r\n";
+        }
+    }
+    return out;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string capture;
+    if (argc > 1 && std::atoi(argv[1]) == 0) {
+        std::ifstream file(argv[1], std::ios::binary);
+        if (!file) {
+            std::fprintf(stderr, "Can't read %s\n", argv[1]);
+            return 1;
+        }
+        capture.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    } else {
+        capture = generate(static_cast<size_t>(argc > 1 ? std::atoi(argv[1]) : 512) * 1024 * 1024);
+    }
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+
+    const char* names[] = { "text", "asciicast", "screens" };
+    for (int format = 0; format < 3; ++format) {
+        std::string reference;
+        double base = 0;
+        for (unsigned threads = 1; threads <= cores; threads = threads < cores && threads * 2 > cores ? cores : threads * 2) {
+            ConvertOptions options;
+            options.format = static_cast<ConvertFormat>(format);
+            options.threads = threads;
+            ConvertStats stats;
+            std::string out;
+            out.reserve(reference.size());
+
+            auto start = std::chrono::steady_clock::now();
+            convert_capture(reinterpret_cast<const uint8_t*>(capture.data()), capture.size(), options,
+                            [&out](const uint8_t* data, size_t length) {
+                                out.append(reinterpret_cast<const char*>(data), length);
+                            }, &stats);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            if (threads == 1) {
+                reference = out;
+                base = seconds;
+            }
+            std::printf("%-10s %2u threads %8.0f MB/s  speedup %5.2f  (%zu segments, %zu redone)%s\n",
+                        names[format], threads, capture.size() / seconds / 1e6, base / seconds,
+                        stats.segments, stats.redone, out == reference ? "" : "  OUTPUT DIFFERS");
+            if (threads == cores) {
+                break;
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,107 @@
+/*
+coro_sessions_bench - many concurrent scripted sessions on a small executor
+
+Each session runs cmd.exe, waits for the prompt, evaluates an expression, checks the
+answer and exits. All of them are driven by the same few executor threads.
+
+    cmake -S . -B build -DHEADLESS_TTY_COROUTINES=ON -DHEADLESS_TTY_BENCHMARKS=ON
+    cmake --build build --config Release
+    build\Release\coro_sessions_bench.exe [sessions] [threads]
+ */
+
+#include "headless_tty/coro.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace headless_tty;
+using namespace std::chrono_literals;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+struct Results {
+    std::mutex mutex;
+    std::condition_variable done;
+    size_t finished = 0;
+    size_t failed = 0;
+    std::vector<double> latencies;      // Seconds from start to exit, per successful session
+};
+
+Task<bool> script(CoSession& session, int n) {
+    std::vector<std::string> prompt = { ">" };
+    if ((co_await session.expect(prompt, 30s)).index != 0) {
+        co_return false;
+    }
+    std::vector<std::string> answer = { std::to_string(n * 7) };
+    co_await session.write("set /a " + std::to_string(n) + "*7\r\n");
+    if ((co_await session.expect(answer, 30s)).index != 0) {
+        co_return false;
+    }
+    co_await session.write("exit\r\n");
+    co_return co_await session.wait_exit(30s) == 0;
+}
+
+Task<void> run_session(Executor& executor, Results& results, int n) {
+    Clock::time_point start = Clock::now();
+    bool ok;
+    {
+        CoSession session(executor);
+        Config config;
+        config.command = L"cmd.exe";
+        config.args = L"/q /k prompt $g";
+        config.size = { 80, 25 };
+        ok = session.start(config) && co_await script(session, n);
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::lock_guard<std::mutex> lock(results.mutex);
+    ++results.finished;
+    if (ok) {
+        results.latencies.push_back(elapsed);
+    } else {
+        ++results.failed;
+    }
+    results.done.notify_one();
+}
+
+double percentile(std::vector<double>& values, double p) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    size_t index = std::min(values.size() - 1, static_cast<size_t>(p * values.size()));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t sessions = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000;
+    unsigned threads = argc > 2 ? static_cast<unsigned>(std::strtoul(argv[2], nullptr, 10)) : 4;
+
+    ThreadPoolExecutor executor(threads);
+    Results results;
+
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < sessions; ++i) {
+        co_spawn(executor, run_session(executor, results, static_cast<int>(i)));
+    }
+    {
+        std::unique_lock<std::mutex> lock(results.mutex);
+        results.done.wait(lock, [&] { return results.finished == sessions; });
+    }
+    double total = std::chrono::duration<double>(Clock::now() - start).count();
+    executor.stop();
+
+    std::printf("%zu sessions on %u executor threads\n", sessions, threads);
+    std::printf("  total      %8.2f s (%.1f sessions/s)\n", total, sessions / total);
+    std::printf("  failed     %8zu\n", results.failed);
+    std::printf("  p50        %8.1f ms\n", percentile(results.latencies, 0.50) * 1000.0);
+    std::printf("  p99        %8.1f ms\n", percentile(results.latencies, 0.99) * 1000.0);
+    return results.failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,104 @@
+/*
+framed_bench - cost of --framed over raw output, and FrameParser throughput
+
+    cmake -S . -B build -DHEADLESS_TTY_BENCHMARKS=ON && cmake --build build --config Release
+    build\Release\framed_bench.exe [megabytes]
+
+A producer thread stands in for the read thread and pushes chunks of a fixed size into an
+OutputBatcher, either raw or through a FrameWriter, with a sink that only counts bytes so
+the figures show the framing itself rather than a pipe. The parser is then run over the
+framed stream in reads of 4 KB (what the stdin forwarder gets) and of the whole buffer.
+ */
+
+#include "headless_tty/framed.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace headless_tty;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+// Keeps everything written, so the parser has a real stream to work on
+struct MemorySink : OutputSink {
+    std::string data;
+    bool write(const OutputSpan* spans, size_t count) override {
+        for (size_t i = 0; i < count; ++i) {
+            data.append(reinterpret_cast<const char*>(spans[i].data), spans[i].length);
+        }
+        return true;
+    }
+};
+
+double produce(bool framed, size_t chunk, size_t total, MemorySink& sink) {
+    std::vector<uint8_t> data(chunk, 'x');
+    OutputBatcher batcher;
+    FrameWriter writer(batcher);
+
+    Clock::time_point start = Clock::now();
+    batcher.start(sink);
+    for (size_t sent = 0; sent < total; sent += chunk) {
+        if (framed) {
+            writer.output(data.data(), chunk);
+        } else {
+            batcher.push(data.data(), chunk);
+        }
+    }
+    batcher.stop();
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+double parse(const std::string& stream, size_t read_size, uint64_t& payload) {
+    FrameParser parser;
+    payload = 0;
+    auto count = [&payload](uint8_t, const uint8_t*, size_t length) { payload += length; };
+
+    Clock::time_point start = Clock::now();
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(stream.data());
+    for (size_t pos = 0; pos < stream.size(); pos += read_size) {
+        size_t n = stream.size() - pos < read_size ? stream.size() - pos : read_size;
+        parser.feed(data + pos, n, count);
+    }
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t megabytes = argc > 1 ? static_cast<size_t>(std::atoi(argv[1])) : 256;
+    size_t total = megabytes * 1024 * 1024;
+    const size_t chunks[] = { 64, 512, 4096, 65536 };
+
+    std::printf("%zu MB per run\n\n", megabytes);
+    std::printf("%-8s %12s %12s %10s\n", "chunk", "raw MB/s", "framed MB/s", "overhead");
+    for (size_t chunk : chunks) {
+        MemorySink raw;
+        MemorySink framed;
+        double raw_s = produce(false, chunk, total, raw);
+        double framed_s = produce(true, chunk, total, framed);
+        std::printf("%-8zu %12.0f %12.0f %9.1f%%\n", chunk, megabytes / raw_s, megabytes / framed_s,
+                    100.0 * (framed.data.size() - raw.data.size()) / raw.data.size());
+    }
+
+    std::printf("\n%-8s %14s %14s\n", "chunk", "parse 4K MB/s", "parse all MB/s");
+    for (size_t chunk : chunks) {
+        MemorySink framed;
+        produce(true, chunk, total, framed);
+        uint64_t payload_small = 0;
+        uint64_t payload_whole = 0;
+        double small_s = parse(framed.data, INPUT_BUFFER_SIZE, payload_small);
+        double whole_s = parse(framed.data, framed.data.size(), payload_whole);
+        if (payload_small != payload_whole) {
+            std::printf("parser mismatch: %llu vs %llu bytes\n",
+                        static_cast<unsigned long long>(payload_small), static_cast<unsigned long long>(payload_whole));
+            return 1;
+        }
+        std::printf("%-8zu %14.0f %14.0f\n", chunk, framed.data.size() / 1048576.0 / small_s,
+                    framed.data.size() / 1048576.0 / whole_s);
+    }
+    return 0;
+}
@@ -0,0 +1,205 @@
+/*
+idle_bench - wakeups of idle sessions and the delay from child exit to exit_event()
+
+    cmake -S . -B build -DHEADLESS_TTY_BENCHMARKS=ON && cmake --build build --config Release
+    build\Release\idle_bench.exe [sessions] [seconds]
+
+Idle: starts the sessions at a cmd.exe prompt, lets them sit, and counts the context
+switches of this process's threads other than the main one (the read threads, the
+writer and thread pool workers) over that period. Every switch is a wakeup, so with
+every thread blocked on a pipe, an event or the thread pool it should stay near zero
+however many sessions there are. CPU time is reported alongside.
+Exit: each session's cmd.exe is terminated, and the time from the process handle being
+signaled until exit_event() is signaled is reported, which is how quickly a caller
+learns that the child is gone.
+Defaults: 20 sessions, 5 seconds.
+ */
+
+#include "headless_tty/pty.hpp"
+
+#include <tlhelp32.h>
+#include <winternl.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <set>
+#include <vector>
+
+using namespace headless_tty;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+// SYSTEM_THREAD_INFORMATION, which winternl.h leaves out; one follows the
+// SYSTEM_PROCESS_INFORMATION of its process for each of NumberOfThreads
+struct ThreadInformation {
+    LARGE_INTEGER kernel_time;
+    LARGE_INTEGER user_time;
+    LARGE_INTEGER create_time;
+    ULONG wait_time;
+    PVOID start_address;
+    HANDLE process_id;
+    HANDLE thread_id;
+    LONG priority;
+    LONG base_priority;
+    ULONG context_switches;
+    ULONG state;
+    ULONG wait_reason;
+};
+
+using QuerySystemInformation = NTSTATUS(NTAPI*)(SYSTEM_INFORMATION_CLASS, PVOID, ULONG, PULONG);
+
+/*
+ Context switches of this process's threads, except the calling one
+ @return false if the system information could not be read
+ */
+bool context_switches(uint64_t& total) {
+    static QuerySystemInformation query = reinterpret_cast<QuerySystemInformation>(
+        GetProcAddress(GetModuleHandleW(L"ntdll.dll"), "NtQuerySystemInformation"));
+    if (!query) {
+        return false;
+    }
+
+    std::vector<uint8_t> buffer(1 << 20);
+    ULONG needed = 0;
+    NTSTATUS status;
+    while ((status = query(SystemProcessInformation, buffer.data(), static_cast<ULONG>(buffer.size()), &needed)) ==
+           static_cast<NTSTATUS>(0xC0000004L)) {      // STATUS_INFO_LENGTH_MISMATCH
+        buffer.resize(std::max<size_t>(buffer.size() * 2, needed + 65536));
+    }
+    if (status < 0) {
+        return false;
+    }
+
+    DWORD self = GetCurrentProcessId();
+    DWORD caller = GetCurrentThreadId();
+    const uint8_t* p = buffer.data();
+    while (true) {
+        auto process = reinterpret_cast<const SYSTEM_PROCESS_INFORMATION*>(p);
+        if (static_cast<DWORD>(reinterpret_cast<ULONG_PTR>(process->UniqueProcessId)) == self) {
+            auto threads = reinterpret_cast<const ThreadInformation*>(process + 1);
+            total = 0;
+            for (ULONG i = 0; i < process->NumberOfThreads; ++i) {
+                if (static_cast<DWORD>(reinterpret_cast<ULONG_PTR>(threads[i].thread_id)) != caller) {
+                    total += threads[i].context_switches;
+                }
+            }
+            return true;
+        }
+        if (process->NextEntryOffset == 0) {
+            return false;
+        }
+        p += process->NextEntryOffset;
+    }
+}
+
+double cpu_seconds() {
+    FILETIME created, exited, kernel, user;
+    GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user);
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return (k.QuadPart + u.QuadPart) / 1e7;
+}
+
+// Process ids of the cmd.exe children of this process
+std::set<DWORD> child_shells() {
+    std::set<DWORD> pids;
+    HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+    if (snapshot == INVALID_HANDLE_VALUE) {
+        return pids;
+    }
+    PROCESSENTRY32W entry = {};
+    entry.dwSize = sizeof(entry);
+    DWORD self = GetCurrentProcessId();
+    for (BOOL more = Process32FirstW(snapshot, &entry); more; more = Process32NextW(snapshot, &entry)) {
+        if (entry.th32ParentProcessID == self && _wcsicmp(entry.szExeFile, L"cmd.exe") == 0) {
+            pids.insert(entry.th32ProcessID);
+        }
+    }
+    CloseHandle(snapshot);
+    return pids;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t count = argc > 1 ? static_cast<size_t>(std::atoi(argv[1])) : 20;
+    DWORD seconds = argc > 2 ? static_cast<DWORD>(std::atoi(argv[2])) : 5;
+
+    Config config;
+    config.command = L"cmd.exe";
+    config.args = L"/d /q /k prompt $g";
+
+    ReadyOptions ready;
+    ready.prompts = { ">" };
+    ready.after_input = false;
+
+    // Each session's child, found as the cmd.exe that appeared when it started
+    std::vector<std::unique_ptr<HeadlessTTY>> sessions;
+    std::vector<HANDLE> children;
+    std::set<DWORD> known = child_shells();
+    for (size_t i = 0; i < count; ++i) {
+        auto tty = std::make_unique<HeadlessTTY>();
+        if (!tty->start(config)) {
+            std::printf("start failed: %s\n", tty->get_last_error().c_str());
+            return 1;
+        }
+        tty->wait_ready(ready, 10000);
+
+        HANDLE child = nullptr;
+        for (DWORD pid : child_shells()) {
+            if (known.insert(pid).second) {
+                child = OpenProcess(SYNCHRONIZE | PROCESS_TERMINATE, FALSE, pid);
+            }
+        }
+        children.push_back(child);
+        sessions.push_back(std::move(tty));
+    }
+
+    uint64_t switchesBefore = 0;
+    uint64_t switchesAfter = 0;
+    bool counted = context_switches(switchesBefore);
+    double cpu = cpu_seconds();
+    Sleep(seconds * 1000);
+    cpu = cpu_seconds() - cpu;
+    counted = counted && context_switches(switchesAfter);
+
+    std::printf("%zu idle sessions for %lu s: %.1f ms CPU\n", count, static_cast<unsigned long>(seconds), cpu * 1000);
+    if (counted) {
+        uint64_t wakeups = switchesAfter - switchesBefore;
+        std::printf("wakeups of session threads: %llu (%.2f per session per second)\n",
+                    static_cast<unsigned long long>(wakeups),
+                    count && seconds ? double(wakeups) / count / seconds : 0.0);
+    } else {
+        std::printf("wakeups of session threads: not available\n");
+    }
+
+    std::vector<double> exits;
+    for (size_t i = 0; i < sessions.size(); ++i) {
+        HANDLE child = children[i];
+        if (child && TerminateProcess(child, 0) && WaitForSingleObject(child, 10000) == WAIT_OBJECT_0) {
+            Clock::time_point gone = Clock::now();
+            if (WaitForSingleObject(sessions[i]->exit_event(), 10000) == WAIT_OBJECT_0) {
+                exits.push_back(std::chrono::duration<double, std::milli>(Clock::now() - gone).count());
+            }
+        }
+        if (child) {
+            CloseHandle(child);
+        }
+        sessions[i]->stop();
+    }
+    if (exits.empty()) {
+        std::printf("no session reported its exit\n");
+        return 1;
+    }
+    std::sort(exits.begin(), exits.end());
+    std::printf("child exit to exit_event(): p50 %.2f ms  max %.2f ms  (%zu of %zu)\n", exits[exits.size() / 2],
+                exits.back(), exits.size(), count);
+    return 0;
+}
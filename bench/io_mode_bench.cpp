@@ -0,0 +1,151 @@
+/*
+io_mode_bench - callbacks per MB, throughput, CPU time and echo latency for each IoMode
+
+    cmake -S . -B build -DHEADLESS_TTY_BENCHMARKS=ON && cmake --build build --config Release
+    build\Release\io_mode_bench.exe [megabytes] [latency samples]
+
+Bulk: cmd.exe types a generated file of build-log lines through the session in each
+mode; reported are output callbacks and pipe reads per MB, MB/s, and the CPU time this
+process spent (the read thread plus the counting callback), which shows whether the
+read thread burns a core while it waits for more output. Latency: write-to-echo
+through an idle cmd.exe prompt with LatencyProbe, as --measure-latency does.
+Defaults: 64 MB and 200 probes.
+ */
+
+#include "headless_tty/latency_probe.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+using namespace headless_tty;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+const char* mode_name(IoMode mode) {
+    switch (mode) {
+        case IoMode::Latency: return "latency";
+        case IoMode::Throughput: return "throughput";
+        default: return "auto";
+    }
+}
+
+double cpu_seconds() {
+    FILETIME created, exited, kernel, user;
+    GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user);
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return (k.QuadPart + u.QuadPart) / 1e7;
+}
+
+bool write_input_file(const std::wstring& path, size_t megabytes) {
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    std::string block;
+    for (int i = 0; block.size() < 1024 * 1024; ++i) {
+        block += "[" + std::to_string(i) + "/4096] Compiling src/module_" + std::to_string(i % 97) + ".cpp\r\n";
+    }
+    block.resize(1024 * 1024);
+    bool ok = true;
+    for (size_t i = 0; i < megabytes && ok; ++i) {
+        DWORD written = 0;
+        ok = WriteFile(file, block.data(), static_cast<DWORD>(block.size()), &written, NULL) && written == block.size();
+    }
+    CloseHandle(file);
+    return ok;
+}
+
+void bulk(IoMode mode, const std::wstring& path) {
+    Config config;
+    config.command = L"cmd.exe";
+    config.args = L"/d /c type \"" + path + L"\"";
+    config.size = { 120, 40 };
+    config.io_mode = mode;
+
+    std::atomic<uint64_t> received{ 0 };
+    HeadlessTTY tty;
+    tty.set_output_callback([&received](const uint8_t*, size_t length) {
+        received.fetch_add(length, std::memory_order_relaxed);
+    });
+
+    double cpu = cpu_seconds();
+    Clock::time_point start = Clock::now();
+    if (!tty.start(config)) {
+        std::printf("%-10s start failed: %s\n", mode_name(mode), tty.get_last_error().c_str());
+        return;
+    }
+    WaitForSingleObject(tty.exit_event(), INFINITE);
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    cpu = cpu_seconds() - cpu;
+    IoStats stats = tty.get_io_stats();
+    tty.stop();
+
+    double mb = stats.bytes / 1048576.0;
+    std::printf("%-10s %8.0f callbacks/MB %8.0f reads/MB %7.1f MB/s   cpu %5.2f s of %5.2f s\n", mode_name(mode),
+                stats.callbacks / mb, stats.reads / mb, mb / seconds, cpu, seconds);
+}
+
+void latency(IoMode mode, uint32_t samples) {
+    Config config;
+    config.command = L"cmd.exe";
+    config.args = L"/d /q /k prompt $g";
+    config.io_mode = mode;
+
+    LatencyOptions options;
+    options.samples = samples;
+    options.prefix = "rem ";
+
+    LatencyProbe probe;
+    HeadlessTTY tty;
+    tty.set_output_callback([&probe](const uint8_t* data, size_t length) {
+        probe.feed(data, length);
+    });
+    if (!tty.start(config)) {
+        std::printf("%-10s start failed: %s\n", mode_name(mode), tty.get_last_error().c_str());
+        return;
+    }
+    LatencyStats stats;
+    if (probe.run(tty, options, NULL, stats)) {
+        std::printf("%-10s echo p50 %7.0f us  p99 %7.0f us  max %7.0f us  lost %zu\n", mode_name(mode),
+                    stats.p50_us, stats.p99_us, stats.max_us, stats.lost);
+    } else {
+        std::printf("%-10s probe failed: %s\n", mode_name(mode), probe.get_last_error().c_str());
+    }
+    tty.stop();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t megabytes = argc > 1 ? static_cast<size_t>(std::atoi(argv[1])) : 64;
+    uint32_t samples = argc > 2 ? static_cast<uint32_t>(std::atoi(argv[2])) : 200;
+
+    wchar_t dir[MAX_PATH];
+    GetTempPathW(MAX_PATH, dir);
+    std::wstring path = std::wstring(dir) + L"io_mode_bench.txt";
+    if (!write_input_file(path, megabytes)) {
+        std::printf("Could not write %zu MB to the temp directory\n", megabytes);
+        return 1;
+    }
+
+    const IoMode modes[] = { IoMode::Latency, IoMode::Throughput, IoMode::Auto };
+    std::printf("Bulk output, %zu MB\n", megabytes);
+    for (IoMode mode : modes) {
+        bulk(mode, path);
+    }
+    DeleteFileW(path.c_str());
+
+    std::printf("\nEcho latency, %u probes\n", samples);
+    for (IoMode mode : modes) {
+        latency(mode, samples);
+    }
+    return 0;
+}
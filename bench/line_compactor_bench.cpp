@@ -0,0 +1,142 @@
+/*
+line_compactor_bench - size reduction and throughput of LineCompactor on progress-bar output
+
+    cmake -S . -B build -DHEADLESS_TTY_BENCHMARKS=ON && cmake --build build --config Release
+    build\Release\line_compactor_bench.exe [capture...]
+
+Without arguments it runs on generated corpora shaped like pip, npm, cargo and curl output.
+Any files given are run as well, e.g. raw logs written by headless-tty --log.
+ */
+
+#include "headless_tty/line_compactor.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+using headless_tty::LineCompactor;
+using headless_tty::OutputCallback;
+
+namespace {
+
+constexpr size_t CORPUS_BYTES = 64 * 1024 * 1024;
+constexpr size_t CHUNK = 16 * 1024;     // Typical PTY read
+
+std::string bar(size_t width, size_t done, size_t total) {
+    size_t filled = width * done / total;
+    return std::string(filled, '#') + std::string(width - filled, ' ');
+}
+
+// tqdm: one line redrawn with CR, a finished line per package
+std::string pip_corpus() {
+    std::string out;
+    for (int package = 0; out.size() < CORPUS_BYTES; ++package) {
+        out += "Collecting package" + std::to_string(package) + "\r\n";
+        for (int step = 0; step <= 1000; ++step) {
+            char line[160];
+            std::snprintf(line, sizeof(line), "\r   %3d%%|%s| %d.%dM/10.0M [00:01<00:02, 3.1MB/s]",
+                          step / 10, bar(40, step, 1000).c_str(), step / 100, step % 100 / 10);
+            out += line;
+        }
+        out += "\r\n";
+    }
+    return out;
+}
+
+// A block of lines redrawn with cursor up and erase line, colored
+std::string npm_corpus() {
+    std::string out;
+    const int rows = 6;
+    for (int round = 0; out.size() < CORPUS_BYTES; ++round) {
+        for (int step = 0; step < 200; ++step) {
+            if (step > 0) {
+                out += "\x1b[" + std::to_string(rows) + "A";
+            }
+            for (int r = 0; r < rows; ++r) {
+                out += "\r\x1b[K\x1b[32m" + std::string(1, "|/-\\"[step % 4]) + "\x1b[0m fetch dep" +
+                       std::to_string(round * rows + r) + " [" + bar(30, step, 199) + "]\r\n";
+            }
+        }
+        out += "added " + std::to_string(rows) + " packages\r\n";
+    }
+    return out;
+}
+
+// One status line under a stream of finished lines, like cargo build
+std::string cargo_corpus() {
+    std::string out;
+    for (int crate = 0; out.size() < CORPUS_BYTES; ++crate) {
+        out += "\r\x1b[K   \x1b[1;32mCompiling\x1b[0m crate" + std::to_string(crate) + " v0.1.0\r\n";
+        for (int step = 0; step < 50; ++step) {
+            out += "\r\x1b[K    \x1b[1;36mBuilding\x1b[0m [" + bar(25, crate % 130, 130) + "] " +
+                   std::to_string(crate % 130) + "/130: crate" + std::to_string(crate + step % 3);
+        }
+    }
+    return out;
+}
+
+// Numeric transfer stats redrawn in place
+std::string curl_corpus() {
+    std::string out;
+    for (int file = 0; out.size() < CORPUS_BYTES; ++file) {
+        out += "  % Total    % Received % Xferd  Average Speed   Time    Time     Time  Current\r\n";
+        for (int step = 0; step <= 400; ++step) {
+            char line[128];
+            std::snprintf(line, sizeof(line), "\r%3d  100M  %3d %4dM    0     0  %4dk      0  0:00:%02d  0:00:%02d --:--:-- %4dk",
+                          step / 4, step / 4, step / 4, 900 + step % 97, step / 10, step / 8, 850 + step % 89);
+            out += line;
+        }
+        out += "\r\n";
+    }
+    return out;
+}
+
+void run(const char* name, const std::string& corpus) {
+    double best = 0;
+    size_t written = 0;
+    for (int round = 0; round < 3; ++round) {
+        LineCompactor compactor;
+        size_t bytes = 0;
+        OutputCallback sink = [&bytes](const uint8_t*, size_t length) { bytes += length; };
+
+        auto start = std::chrono::steady_clock::now();
+        for (size_t offset = 0; offset < corpus.size(); offset += CHUNK) {
+            size_t n = corpus.size() - offset < CHUNK ? corpus.size() - offset : CHUNK;
+            compactor.feed(reinterpret_cast<const uint8_t*>(corpus.data()) + offset, n, sink);
+        }
+        compactor.flush(sink);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        double rate = corpus.size() / seconds / 1e6;
+        if (rate > best) {
+            best = rate;
+        }
+        written = bytes;
+    }
+    std::printf("%-12s %8.1f MB -> %9.1f KB  (%6.0fx smaller)  %6.0f MB/s\n", name, corpus.size() / 1e6,
+                written / 1e3, written ? static_cast<double>(corpus.size()) / written : 0.0, best);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc > 1) {
+        for (int i = 1; i < argc; ++i) {
+            std::ifstream file(argv[i], std::ios::binary);
+            if (!file) {
+                std::fprintf(stderr, "Can't read %s\n", argv[i]);
+                return 1;
+            }
+            run(argv[i], std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()));
+        }
+        return 0;
+    }
+
+    run("pip", pip_corpus());
+    run("npm", npm_corpus());
+    run("cargo", cargo_corpus());
+    run("curl", curl_corpus());
+    return 0;
+}
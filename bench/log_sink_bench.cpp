@@ -0,0 +1,113 @@
+/*
+log_sink_bench - LogSink throughput and write() latency, raw, plain text, compact and compressed
+
+    cmake -S . -B build -DHEADLESS_TTY_BENCHMARKS=ON && cmake --build build --config Release
+    build\Release\log_sink_bench.exe [megabytes] [chunk] [path]
+
+The calling thread stands in for the PTY read thread and hands over chunks of colored
+shell output as fast as it can. write() rate is what the reader sees; end-to-end
+includes close(), so it is bounded by the disk. Output the disk couldn't keep up with
+is dropped rather than blocking the reader, and is reported. Segments rotate every
+64 MB. Defaults: 1024 MB in 4 KB chunks to log_sink_bench.log in the current directory;
+the log and its rotated segments are deleted afterwards.
+ */
+
+#include "headless_tty/log_sink.hpp"
+#include "headless_tty/utf8.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace headless_tty;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+// Colored lines with a progress bar redrawn in place now and then
+std::string make_output(size_t size) {
+    std::string out;
+    for (size_t i = 0; out.size() < size; ++i) {
+        if (i % 16 == 0) {
+            out += "\r\x1b[2K[" + std::string(i % 40, '#') + std::string(40 - i % 40, ' ') + "] " + std::to_string(i) + "%";
+            continue;
+        }
+        out += "\r\n\x1b[32m" + std::to_string(i) + "\x1b[0m compiling src/module_" + std::to_string(i % 97) + ".cpp";
+    }
+    out.resize(size);
+    return out;
+}
+
+void delete_logs(const std::wstring& path) {
+    DeleteFileW(path.c_str());
+    WIN32_FIND_DATAW found;
+    std::wstring pattern = path + L".*";
+    HANDLE find = FindFirstFileW(pattern.c_str(), &found);
+    if (find == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    size_t slash = path.find_last_of(L"\\/");
+    std::wstring dir = slash == std::wstring::npos ? L"" : path.substr(0, slash + 1);
+    do {
+        DeleteFileW((dir + found.cFileName).c_str());
+    } while (FindNextFileW(find, &found));
+    FindClose(find);
+}
+
+void run(const char* name, const std::wstring& path, LogOptions options, const std::string& chunk, size_t total) {
+    delete_logs(path);
+    options.max_segment_bytes = 64ull * 1024 * 1024;
+    LogSink sink;
+    if (!sink.open(path, options)) {
+        std::printf("%-10s open failed: %s\n", name, sink.get_last_error().c_str());
+        return;
+    }
+
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(chunk.data());
+    double slowest_us = 0;
+    Clock::time_point start = Clock::now();
+    for (size_t sent = 0; sent < total; sent += chunk.size()) {
+        Clock::time_point call = Clock::now();
+        sink.write(data, chunk.size());
+        slowest_us = std::max(slowest_us, std::chrono::duration<double, std::micro>(Clock::now() - call).count());
+    }
+    double write_s = std::chrono::duration<double>(Clock::now() - start).count();
+    sink.close();
+    double total_s = std::chrono::duration<double>(Clock::now() - start).count();
+
+    double mb = total / 1048576.0;
+    std::printf("%-10s write() %8.0f MB/s  slowest %7.1f us   end-to-end %7.0f MB/s   dropped %6.1f%%\n", name,
+                mb / write_s, slowest_us, mb / total_s, 100.0 * sink.dropped_bytes() / total);
+    delete_logs(path);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t megabytes = argc > 1 ? static_cast<size_t>(std::atoi(argv[1])) : 1024;
+    size_t chunk_size = argc > 2 ? static_cast<size_t>(std::atoi(argv[2])) : 4096;
+    std::wstring path = argc > 3 ? utf8_to_wstring(argv[3]) : L"log_sink_bench.log";
+
+    std::string chunk = make_output(chunk_size);
+    size_t total = megabytes * 1024 * 1024;
+    std::printf("%zu MB in %zu-byte chunks\n\n", megabytes, chunk_size);
+
+    LogOptions options;
+    options.compress = false;
+    run("raw", path, options, chunk, total);
+
+    options.plain_text = true;
+    run("plain", path, options, chunk, total);
+
+    options.plain_text = false;
+    options.compact_lines = true;
+    run("compact", path, options, chunk, total);
+
+    options.compact_lines = false;
+    options.compress = true;
+    run("compressed", path, options, chunk, total);
+    return 0;
+}
@@ -0,0 +1,164 @@
+/*
+output_sink_bench - WriteFile calls per MB and idle latency, per-chunk writes vs OutputBatcher
+
+    cmake -S . -B build -DHEADLESS_TTY_BENCHMARKS=ON && cmake --build build --config Release
+    build\Release\output_sink_bench.exe [megabytes]
+
+A producer thread stands in for the read thread and hands over chunks of a fixed size,
+either writing each one itself (what main.cpp used to do) or pushing it to an
+OutputBatcher. Destinations are a file and an anonymous pipe drained by another thread.
+The latency test sends one small chunk at a time through the pipe and waits for it to
+come out the other end, so it shows what batching costs an interactive session.
+ */
+
+#include "headless_tty/output_sink.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace headless_tty;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+struct Result {
+    double seconds = 0;
+    uint64_t writes = 0;
+};
+
+Result run(HANDLE handle, bool batched, size_t chunk, size_t total) {
+    std::vector<uint8_t> data(chunk, 'x');
+    Result result;
+    HandleSink sink;
+    sink.attach(handle);
+    OutputBatcher batcher;
+
+    Clock::time_point start = Clock::now();
+    if (batched) {
+        batcher.start(sink);
+        for (size_t sent = 0; sent < total; sent += chunk) {
+            batcher.push(data.data(), chunk);
+        }
+        batcher.stop();
+    } else {
+        OutputSpan span = { data.data(), chunk };
+        for (size_t sent = 0; sent < total; sent += chunk) {
+            sink.write(&span, 1);
+        }
+    }
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    result.writes = sink.get_stats().writes;
+    return result;
+}
+
+// Drains the read end of a pipe until it is closed
+struct PipeDrain {
+    HANDLE read = nullptr;
+    HANDLE write = nullptr;
+    std::thread thread;
+    uint64_t received = 0;
+
+    bool open() {
+        if (!CreatePipe(&read, &write, NULL, 64 * 1024)) {
+            return false;
+        }
+        thread = std::thread([this] {
+            std::vector<uint8_t> buffer(256 * 1024);
+            DWORD got = 0;
+            while (ReadFile(read, buffer.data(), static_cast<DWORD>(buffer.size()), &got, NULL) && got > 0) {
+                received += got;
+            }
+        });
+        return true;
+    }
+
+    void close() {
+        CloseHandle(write);
+        thread.join();
+        CloseHandle(read);
+    }
+};
+
+void report(const char* target, size_t chunk, const Result& direct, const Result& batched, size_t total) {
+    double mb = total / (1024.0 * 1024.0);
+    std::printf("%-5s %6zu B chunks   direct %8.1f writes/MB %7.0f MB/s   batched %8.1f writes/MB %7.0f MB/s\n",
+                target, chunk, direct.writes / mb, mb / direct.seconds, batched.writes / mb, mb / batched.seconds);
+}
+
+// Median microseconds from handing over a 64-byte chunk to reading it from the pipe
+double idle_latency(bool batched, int samples) {
+    HANDLE read, write;
+    if (!CreatePipe(&read, &write, NULL, 64 * 1024)) {
+        return -1;
+    }
+    HandleSink sink;
+    sink.attach(write);
+    OutputBatcher batcher;
+    if (batched) {
+        batcher.start(sink);
+    }
+
+    uint8_t chunk[64] = {};
+    uint8_t buffer[64];
+    std::vector<double> times;
+    for (int i = 0; i < samples; ++i) {
+        Clock::time_point start = Clock::now();
+        if (batched) {
+            batcher.push(chunk, sizeof(chunk));
+        } else {
+            OutputSpan span = { chunk, sizeof(chunk) };
+            sink.write(&span, 1);
+        }
+        DWORD got = 0, total = 0;
+        while (total < sizeof(chunk) && ReadFile(read, buffer, sizeof(buffer) - total, &got, NULL)) {
+            total += got;
+        }
+        times.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+        Sleep(1);
+    }
+    batcher.stop();
+    CloseHandle(write);
+    CloseHandle(read);
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t total = static_cast<size_t>(argc > 1 ? std::atoi(argv[1]) : 256) * 1024 * 1024;
+    const size_t chunks[] = { 256, 4096, 65536 };
+
+    wchar_t dir[MAX_PATH], path[MAX_PATH];
+    GetTempPathW(MAX_PATH, dir);
+    GetTempFileNameW(dir, L"osb", 0, path);
+
+    for (size_t chunk : chunks) {
+        Result results[2];
+        for (int batched = 0; batched < 2; ++batched) {
+            HANDLE file = CreateFileW(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY, NULL);
+            results[batched] = run(file, batched != 0, chunk, total);
+            CloseHandle(file);
+        }
+        report("file", chunk, results[0], results[1], total);
+
+        for (int batched = 0; batched < 2; ++batched) {
+            PipeDrain pipe;
+            if (!pipe.open()) {
+                return 1;
+            }
+            results[batched] = run(pipe.write, batched != 0, chunk, total);
+            pipe.close();
+        }
+        report("pipe", chunk, results[0], results[1], total);
+    }
+    DeleteFileW(path);
+
+    std::printf("idle latency (median of 500, 64 B through a pipe): direct %.1f us, batched %.1f us\n",
+                idle_latency(false, 500), idle_latency(true, 500));
+    return 0;
+}
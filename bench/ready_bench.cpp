@@ -0,0 +1,110 @@
+/*
+ready_bench - end-to-end script time with fixed sleeps versus wait_ready()
+
+Drives cmd.exe through the same short script several ways: the fixed sleeps the
+Python example and messenger used (500 ms for startup, then a delay after every
+command), and wait_ready() on the prompt, on output quiescence and on a stable
+cursor. Reports the wall time of each script and how many commands had not
+finished yet when the next input was sent.
+
+    cmake -S . -B build -DHEADLESS_TTY_BENCHMARKS=ON && cmake --build build --config Release
+    build\Release\ready_bench.exe [commands] [sleep ms]
+ */
+
+#include "headless_tty/pty.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+
+using namespace headless_tty;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+struct Run {
+    double seconds = 0;
+    int early = 0;      // Commands whose answer wasn't there yet when the next one was sent
+    bool ok = true;
+};
+
+// Fixed sleeps when ready is null, otherwise wait_ready() with those options
+Run run_script(int commands, DWORD sleep_ms, const ReadyOptions* ready, bool track_screen) {
+    Run run;
+    HeadlessTTY tty;
+    std::mutex mutex;
+    std::string output;
+    tty.set_output_callback([&](const uint8_t* data, size_t length) {
+        std::lock_guard<std::mutex> lock(mutex);
+        output.append(reinterpret_cast<const char*>(data), length);
+    });
+
+    Config config;
+    config.command = L"cmd.exe";
+    config.args = L"/q /k prompt $g";
+    config.size = { 80, 25 };
+    config.track_screen = track_screen;
+
+    Clock::time_point start = Clock::now();
+    if (!tty.start(config)) {
+        run.ok = false;
+        return run;
+    }
+
+    auto settle = [&](DWORD fixed_ms) {
+        if (!ready) {
+            Sleep(fixed_ms);
+            return true;
+        }
+        ReadyEvent event = tty.wait_ready(*ready, 10000);
+        return event != ReadyEvent::Timeout && event != ReadyEvent::Exited && event != ReadyEvent::Invalid;
+    };
+
+    run.ok = settle(500);
+    for (int i = 1; run.ok && i <= commands; ++i) {
+        std::string answer = std::to_string(i * 7919);
+        run.ok = tty.write("set /a " + std::to_string(i) + "*7919\r\n") && settle(sleep_ms);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (output.find(answer) == std::string::npos) {
+            ++run.early;
+        }
+    }
+    tty.write("exit\r\n");
+    tty.wait(10000);
+    run.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return run;
+}
+
+void report(const char* name, const Run& run, double baseline) {
+    if (!run.ok) {
+        std::printf("%-22s failed\n", name);
+        return;
+    }
+    std::printf("%-22s %7.3f s  saves %6.3f s  (%d commands not finished in time)\n",
+                name, run.seconds, baseline - run.seconds, run.early);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    int commands = argc > 1 ? std::atoi(argv[1]) : 20;
+    DWORD sleep_ms = argc > 2 ? static_cast<DWORD>(std::atoi(argv[2])) : 50;
+
+    Run fixed = run_script(commands, sleep_ms, nullptr, false);
+    report("fixed sleeps", fixed, fixed.seconds);
+
+    ReadyOptions prompt;
+    prompt.prompts = { ">" };
+    report("wait_ready prompt", run_script(commands, sleep_ms, &prompt, false), fixed.seconds);
+
+    ReadyOptions quiet;
+    quiet.quiet_ms = 20;
+    report("wait_ready quiet 20ms", run_script(commands, sleep_ms, &quiet, false), fixed.seconds);
+
+    ReadyOptions cursor;
+    cursor.cursor_stable_ms = 20;
+    report("wait_ready cursor 20ms", run_script(commands, sleep_ms, &cursor, true), fixed.seconds);
+    return 0;
+}
@@ -0,0 +1,67 @@
+/*
+screen_resize_bench - cost of Screen::resize() with a large scrollback, and of the
+deferred history reflow paid on the first scrollback() read afterwards
+
+    cmake -S . -B build -DHEADLESS_TTY_BENCHMARKS=ON && cmake --build build --config Release
+    build\Release\screen_resize_bench.exe [lines]
+ */
+
+#include "headless_tty/screen.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+using headless_tty::Screen;
+using headless_tty::TerminalSize;
+
+namespace {
+
+double elapsed_us(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t lines = static_cast<size_t>(argc > 1 ? std::atoi(argv[1]) : 1000000);
+
+    Screen screen(TerminalSize{ 120, 40 }, lines);
+    std::string chunk;
+    for (int i = 0; i < 1000; ++i) {
+        // Every fourth line is long enough to soft-wrap
+        chunk += (i % 4 == 0) ? std::string(200, 'x') : "drwxr-xr-x  2 user group  4096 Jan  1 12:00 src";
+        chunk += "\r\n";
+    }
+    while (screen.scrollback().size() + screen.size().rows < lines) {
+        screen.feed(reinterpret_cast<const uint8_t*>(chunk.data()), chunk.size());
+    }
+    std::printf("scrollback: %zu lines at 120 columns\n", screen.scrollback().size());
+
+    const TerminalSize sizes[] = { { 80, 40 }, { 100, 30 }, { 132, 50 }, { 120, 40 } };
+    for (const TerminalSize& size : sizes) {
+        auto start = std::chrono::steady_clock::now();
+        screen.resize(size);
+        double resize_us = elapsed_us(start);
+
+        start = std::chrono::steady_clock::now();
+        size_t count = screen.scrollback().size();
+        double reflow_us = elapsed_us(start);
+
+        std::printf("%3ux%-3u resize %8.1f us   first scrollback() %10.0f us  (%zu lines)\n",
+                    size.cols, size.rows, resize_us, reflow_us, count);
+    }
+
+    // A drag: many sizes in a row, history read once at the end
+    auto start = std::chrono::steady_clock::now();
+    for (uint16_t cols = 60; cols <= 160; ++cols) {
+        screen.resize(TerminalSize{ cols, 40 });
+    }
+    double storm_us = elapsed_us(start);
+    start = std::chrono::steady_clock::now();
+    size_t count = screen.scrollback().size();
+    std::printf("101 resizes %8.1f us total, then first scrollback() %.0f us (%zu lines)\n",
+                storm_us, elapsed_us(start), count);
+    return 0;
+}
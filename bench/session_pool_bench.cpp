@@ -0,0 +1,117 @@
+/*
+session_pool_bench - time to first prompt, cold start() vs SessionPool::acquire()
+
+    cmake -S . -B build -DHEADLESS_TTY_BENCHMARKS=ON && cmake --build build --config Release
+    build\Release\session_pool_bench.exe [rounds] [prompt] [command [args...]]
+    build\Release\session_pool_bench.exe 20 ">>>" python.exe -q -i
+
+The cold path is start() followed by wait_ready() for the prompt, what a caller does
+today. The pooled path takes a warm session from a SessionPool and waits for the same
+prompt; the pool refills in the background between rounds, as it would between
+requests. Defaults: 20 rounds of cmd.exe waiting for ">".
+ */
+
+#include "headless_tty/session_pool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace headless_tty;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+double ms_since(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void report(const char* name, std::vector<double> samples) {
+    if (samples.empty()) {
+        std::printf("%-8s no samples\n", name);
+        return;
+    }
+    std::sort(samples.begin(), samples.end());
+    double sum = 0;
+    for (double s : samples) {
+        sum += s;
+    }
+    std::printf("%-8s p50 %8.2f ms  p90 %8.2f ms  max %8.2f ms  mean %8.2f ms\n", name,
+                samples[samples.size() / 2], samples[samples.size() * 9 / 10], samples.back(), sum / samples.size());
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    int rounds = argc > 1 ? std::atoi(argv[1]) : 20;
+    std::string prompt = argc > 2 ? argv[2] : ">";
+
+    Config config;
+    config.command = L"cmd.exe";
+    if (argc > 3) {
+        config.command = utf8_to_wstring(argv[3]);
+        std::string args;
+        for (int i = 4; i < argc; ++i) {
+            if (!args.empty()) args += " ";
+            args += argv[i];
+        }
+        config.args = utf8_to_wstring(args);
+    }
+
+    // A warm session's prompt is already on screen, so don't require output after input
+    ReadyOptions ready;
+    ready.prompts = { prompt };
+    ready.after_input = false;
+
+    std::vector<double> cold;
+    for (int i = 0; i < rounds; ++i) {
+        HeadlessTTY tty;
+        Clock::time_point start = Clock::now();
+        if (!tty.start(config)) {
+            std::printf("start failed: %s\n", tty.get_last_error().c_str());
+            return 1;
+        }
+        if (tty.wait_ready(ready, 10000) == ReadyEvent::Prompt) {
+            cold.push_back(ms_since(start));
+        }
+        tty.stop();
+    }
+
+    PoolOptions options;
+    options.ready = ready;
+    SessionPool pool;
+    pool.start(config, options);
+
+    std::vector<double> pooled;
+    for (int i = 0; i < rounds; ++i) {
+        // Give the pool the time a real caller would leave between sessions
+        for (int wait = 0; wait < 100 && pool.get_stats().warm < options.warm; ++wait) {
+            Sleep(50);
+        }
+
+        Clock::time_point start = Clock::now();
+        std::unique_ptr<HeadlessTTY> tty = pool.acquire(nullptr, 10000);
+        if (!tty) {
+            std::printf("acquire failed: %s\n", pool.get_last_error().c_str());
+            return 1;
+        }
+        if (tty->wait_ready(ready, 10000) == ReadyEvent::Prompt) {
+            pooled.push_back(ms_since(start));
+        }
+        tty->stop();
+    }
+
+    PoolStats stats = pool.get_stats();
+    pool.stop();
+
+    std::printf("%d rounds, prompt \"%s\"\n\n", rounds, prompt.c_str());
+    report("cold", cold);
+    report("pooled", pooled);
+    std::printf("\npool: %llu started, %llu handed out, %llu waited, %llu discarded\n",
+                static_cast<unsigned long long>(stats.started), static_cast<unsigned long long>(stats.handed_out),
+                static_cast<unsigned long long>(stats.waited), static_cast<unsigned long long>(stats.discarded));
+    return 0;
+}
@@ -0,0 +1,56 @@
+/*
+unicode_width_bench - throughput of text_width() on ASCII, mixed-script and CJK text
+
+    cmake -S . -B build -DHEADLESS_TTY_BENCHMARKS=ON && cmake --build build --config Release
+    build\Release\unicode_width_bench.exe [megabytes]
+ */
+
+#include "headless_tty/unicode.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+using headless_tty::text_width;
+
+namespace {
+
+std::string repeat(const std::string& unit, size_t bytes) {
+    std::string out;
+    out.reserve(bytes + unit.size());
+    while (out.size() < bytes) {
+        out += unit;
+    }
+    return out;
+}
+
+void run(const char* name, const std::string& text) {
+    double best = 0;
+    size_t columns = 0;
+    for (int round = 0; round < 5; ++round) {
+        auto start = std::chrono::steady_clock::now();
+        columns = text_width(reinterpret_cast<const uint8_t*>(text.data()), text.size());
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double rate = text.size() / seconds / 1e6;
+        if (rate > best) {
+            best = rate;
+        }
+    }
+    std::printf("%-8s %8.0f MB/s  (%zu bytes, %zu columns)\n", name, best, text.size(), columns);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t bytes = static_cast<size_t>(argc > 1 ? std::atoi(argv[1]) : 64) * 1024 * 1024;
+
+    run("ascii", repeat("drwxr-xr-x  2 user group  4096 Jan  1 12:00 headless-tty/src\r\n", bytes));
+    run("mixed", repeat("build: \xE4\xB8\xAD\xE6\x96\x87\xE6\xB5\x8B\xE8\xAF\x95 ok, caf\xC3\xA9 "
+                        "\xD0\x9F\xD1\x80\xD0\xB8\xD0\xB2\xD0\xB5\xD1\x82 \xF0\x9F\x98\x80 "
+                        "\xF0\x9F\x91\xA8\xE2\x80\x8D\xF0\x9F\x91\xA9\xE2\x80\x8D\xF0\x9F\x91\xA7 "
+                        "\xF0\x9F\x87\xBA\xF0\x9F\x87\xB8 | ls -la /usr/local/bin\r\n", bytes));
+    run("cjk", repeat("\xE4\xB8\xAD\xE6\x96\x87\xE6\xB5\x8B\xE8\xAF\x95\xED\x95\x9C\xEA\xB5\xAD\xEC\x96\xB4"
+                      "\xE3\x81\x93\xE3\x82\x93\xE3\x81\xAB\xE3\x81\xA1\xE3\x81\xAF", bytes));
+    return 0;
+}
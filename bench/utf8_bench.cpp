@@ -0,0 +1,76 @@
+/*
+utf8_bench - throughput of UTF-8 validation, conversion and Utf8Stream re-chunking
+
+    cmake -S . -B build -DHEADLESS_TTY_BENCHMARKS=ON && cmake --build build --config Release
+    build\Release\utf8_bench.exe [megabytes]
+ */
+
+#include "headless_tty/utf8.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace headless_tty;
+
+namespace {
+
+std::string repeat(const std::string& unit, size_t bytes) {
+    std::string out;
+    out.reserve(bytes + unit.size());
+    while (out.size() < bytes) {
+        out += unit;
+    }
+    return out;
+}
+
+template <typename Fn>
+void run(const char* name, size_t bytes, Fn fn) {
+    double best = 1e30;
+    for (int round = 0; round < 5; ++round) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::printf("%-24s %7.2f GB/s\n", name, bytes / best / 1e9);
+}
+
+void bench(const char* label, const std::string& text) {
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(text.data());
+    std::vector<char16_t> utf16(text.size());
+    std::vector<char32_t> utf32(text.size());
+    volatile size_t sink = 0;
+
+    std::printf("%s (%zu bytes)\n", label, text.size());
+    run("  validate", text.size(), [&] { sink = utf8_valid_prefix(data, text.size()); });
+    run("  to utf16", text.size(), [&] { sink = utf8_to_utf16(data, text.size(), utf16.data()); });
+    run("  to utf32", text.size(), [&] { sink = utf8_to_utf32(data, text.size(), utf32.data()); });
+
+    // Re-chunk 8 KB reads, as the read thread delivers them
+    for (Utf8Mode mode : { Utf8Mode::Whole, Utf8Mode::Repair }) {
+        run(mode == Utf8Mode::Whole ? "  stream (whole)" : "  stream (repair)", text.size(), [&] {
+            Utf8Stream stream(mode);
+            size_t total = 0;
+            OutputCallback count = [&total](const uint8_t*, size_t length) { total += length; };
+            for (size_t i = 0; i < text.size(); i += 8192) {
+                stream.feed(data + i, std::min<size_t>(8192, text.size() - i), count);
+            }
+            stream.flush(count);
+            sink = total;
+        });
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t bytes = static_cast<size_t>(argc > 1 ? std::atoi(argv[1]) : 128) * 1024 * 1024;
+
+    bench("ascii", repeat("drwxr-xr-x  2 user group  4096 Jan  1 12:00 headless-tty/src\r\n", bytes));
+    bench("mixed", repeat("build: \xE4\xB8\xAD\xE6\x96\x87 ok, caf\xC3\xA9 \xF0\x9F\x98\x80 "
+                          "\xD0\x9F\xD1\x80\xD0\xB8\xD0\xB2\xD0\xB5\xD1\x82 | ls -la /usr/local/bin\r\n", bytes));
+    return 0;
+}
@@ -9,7 +9,12 @@ if %ERRORLEVEL% NEQ 0 (
 )
 
 echo Building executable...
-clang++ -O3 -Wall -Wextra -std=c++17 -fno-exceptions -I include -o headless-tty.exe src/pty.cpp src/main.cpp resources/app.res -static -luser32 -lshell32 -Wl,/SUBSYSTEM:WINDOWS -Wl,/ENTRY:mainCRTStartup
+clang++ -O3 -Wall -Wextra -std=c++17 -fno-exceptions -I include -o headless-tty.exe src/pty.cpp src/log_sink.cpp src/vt_strip.cpp src/line_editor.cpp src/input_file.cpp src/expect.cpp src/expect_script.cpp src/screen.cpp src/frame_viewer.cpp src/snapshot.cpp src/shared_screen.cpp src/unicode.cpp src/utf8.cpp src/supervisor.cpp src/latency_probe.cpp src/line_compactor.cpp src/converter.cpp src/ready.cpp src/output_sink.cpp src/command_index.cpp src/framed.cpp src/session_pool.cpp src/arena.cpp src/main.cpp resources/app.res -static -luser32 -lshell32 -lcabinet -Wl,/SUBSYSTEM:WINDOWS -Wl,/ENTRY:mainCRTStartup
+
+if %ERRORLEVEL%==0 echo Build successful
+
+echo Building shared library...
+clang++ -O3 -Wall -Wextra -std=c++17 -fno-exceptions -shared -DHEADLESS_TTY_BUILDING_DLL -I include -o headless_tty.dll src/pty.cpp src/log_sink.cpp src/vt_strip.cpp src/line_editor.cpp src/input_file.cpp src/expect.cpp src/expect_script.cpp src/screen.cpp src/frame_viewer.cpp src/snapshot.cpp src/shared_screen.cpp src/unicode.cpp src/utf8.cpp src/supervisor.cpp src/latency_probe.cpp src/line_compactor.cpp src/converter.cpp src/ready.cpp src/output_sink.cpp src/command_index.cpp src/framed.cpp src/session_pool.cpp src/arena.cpp src/c_api.cpp -static -lcabinet
 
 if %ERRORLEVEL%==0 echo Build successful
 
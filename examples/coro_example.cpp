@@ -0,0 +1,70 @@
+/*
+coro_example - drive a cmd.exe session from a coroutine
+
+    cmake -S . -B build -DHEADLESS_TTY_COROUTINES=ON && cmake --build build --config Release
+    build\Release\coro_example.exe
+ */
+
+#include "headless_tty/coro.hpp"
+
+#include <cstdio>
+
+using namespace headless_tty;
+using namespace std::chrono_literals;
+
+namespace {
+
+Task<int> session_main(Executor& executor) {
+    CoSession session(executor);
+    Config config;
+    config.command = L"cmd.exe";
+    config.args = L"/q /k prompt $g";
+    if (!session.start(config)) {
+        std::fprintf(stderr, "start failed: %s\n", session.get_last_error().c_str());
+        co_return -1;
+    }
+
+    std::vector<std::string> prompt = { ">" };
+    if ((co_await session.expect(prompt, 10s)).index != 0) {
+        std::fprintf(stderr, "no prompt\n");
+        co_return -1;
+    }
+
+    co_await session.write("ver\r\n");
+    std::vector<std::string> banner = { "Version" };
+    ExpectResult version = co_await session.expect(banner, 5s);
+    std::printf("matched %d after %zu bytes\n", version.index, version.output.size());
+
+    // Anything still buffered, without waiting for more than a moment
+    ReadResult rest = co_await session.read_some(CORO_READ_SIZE, 200ms);
+    std::fwrite(rest.data.data(), 1, rest.data.size(), stdout);
+
+    co_await sleep_for(executor, 100ms);
+    co_await session.write("exit\r\n");
+    co_return co_await session.wait_exit(5s);
+}
+
+Task<void> run(Executor& executor, std::mutex& mutex, std::condition_variable& done, int& code, bool& finished) {
+    int result = co_await session_main(executor);
+    std::lock_guard<std::mutex> lock(mutex);
+    code = result;
+    finished = true;
+    done.notify_one();
+}
+
+} // namespace
+
+int main() {
+    ThreadPoolExecutor executor(1);
+    std::mutex mutex;
+    std::condition_variable done;
+    int code = 0;
+    bool finished = false;
+
+    co_spawn(executor, run(executor, mutex, done, code, finished));
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&] { return finished; });
+    std::printf("\nexit code %d\n", code);
+    return 0;
+}
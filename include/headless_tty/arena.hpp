@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+#include "types.hpp"
+
+namespace headless_tty {
+
+struct ArenaStats {
+    uint64_t allocations = 0;           // allocate() calls
+    uint64_t heap_allocations = 0;      // Blocks and oversized requests taken from the global heap
+    size_t blocks = 0;
+    size_t reserved_bytes = 0;          // Held in blocks
+    size_t used_bytes = 0;              // Handed out and not yet returned (size-class rounded)
+};
+
+
+// SessionArena - size-classed free lists carved out of large blocks, for one session
+// Requests up to ARENA_MAX_POOLED bytes are rounded up to a size class (16-byte steps up
+// to 128 bytes, then eight classes per doubling, so at most 1/8 is lost to rounding) and
+// served from that class's free list, or cut from the current ARENA_BLOCK_SIZE block. Freed chunks go back on their list for
+// reuse; blocks are only returned when the arena is destroyed, one free per block however
+// many allocations were made from it. Larger requests go straight to the heap. Not
+// thread-safe: it belongs to one session's state and is used under that state's lock.
+
+class SessionArena {
+public:
+    SessionArena() = default;
+    ~SessionArena();
+
+    SessionArena(const SessionArena&) = delete;
+    SessionArena& operator=(const SessionArena&) = delete;
+
+    void* allocate(size_t bytes);
+    void deallocate(void* p, size_t bytes) noexcept;
+    ArenaStats get_stats() const;
+
+private:
+    static constexpr size_t CLASS_COUNT = 64;       // Classes up to ARENA_MAX_POOLED
+
+    struct FreeChunk {
+        FreeChunk* next;
+    };
+    struct Block {
+        Block* next;
+        size_t size;
+    };
+
+    static size_t size_class(size_t bytes);
+    static size_t class_size(size_t index);
+    void* carve(size_t size);
+
+    FreeChunk* m_free[CLASS_COUNT] = {};
+    Block* m_blocks = nullptr;
+    uint8_t* m_cursor = nullptr;        // Unused part of the newest block
+    uint8_t* m_limit = nullptr;
+    ArenaStats m_stats;
+};
+
+static_assert(ARENA_MAX_POOLED == (size_t(1) << 14), "SessionArena::CLASS_COUNT assumes 16 KB as the largest class");
+
+
+// ArenaAllocator - standard allocator over a SessionArena (the global heap when it has none)
+// Containers carry the arena with them when moved or swapped, so memory always goes back to
+// the arena it came from. A copy made outside the owner (select_on_container_copy_construction)
+// goes to the heap, so it can be used on another thread.
+
+template <typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    ArenaAllocator() noexcept = default;
+    explicit ArenaAllocator(SessionArena* arena) noexcept : m_arena(arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) noexcept : m_arena(other.arena()) {}
+
+    T* allocate(size_t n) {
+        size_t bytes = n * sizeof(T);
+        return static_cast<T*>(m_arena ? m_arena->allocate(bytes) : ::operator new(bytes));
+    }
+
+    void deallocate(T* p, size_t n) noexcept {
+        if (m_arena) {
+            m_arena->deallocate(p, n * sizeof(T));
+        } else {
+            ::operator delete(p);
+        }
+    }
+
+    ArenaAllocator select_on_container_copy_construction() const { return ArenaAllocator(); }
+    SessionArena* arena() const noexcept { return m_arena; }
+
+private:
+    SessionArena* m_arena = nullptr;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) noexcept {
+    return a.arena() == b.arena();
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) noexcept {
+    return a.arena() != b.arena();
+}
+
+} // namespace headless_tty
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+
+#include "types.hpp"
+#include "line_compactor.hpp"
+
+namespace headless_tty {
+
+constexpr uint64_t COMMAND_NO_POSITION = UINT64_MAX;   // Mark not seen, or line not known
+
+struct CommandRecord {
+    uint64_t id = 0;                    // 1 for the first command, then consecutive
+    std::string command;                // Command line as shown, prompt removed
+    std::string output;                 // Finished lines as plain text (see LineCompactor), "\r\n" separated
+    bool output_truncated = false;      // Only the last COMMAND_OUTPUT_LIMIT bytes were kept
+    bool finished = false;              // Its end mark or the next prompt has been seen
+    bool has_exit_code = false;
+    int exit_code = 0;
+    std::string cwd;                    // Last OSC 7 directory when the command started
+
+    // Stream offsets just after each mark (bytes since start())
+    uint64_t prompt_offset = COMMAND_NO_POSITION;   // A: prompt drawn
+    uint64_t command_offset = COMMAND_NO_POSITION;  // B: typing starts
+    uint64_t output_offset = COMMAND_NO_POSITION;   // C: command runs
+    uint64_t end_offset = COMMAND_NO_POSITION;      // D: command done
+
+    // Screen::mark_output_row() at the same marks when the screen is tracked;
+    // Screen::output_row_line() gives each one's current line number
+    uint64_t prompt_line = COMMAND_NO_POSITION;
+    uint64_t command_line = COMMAND_NO_POSITION;
+    uint64_t output_line = COMMAND_NO_POSITION;
+    uint64_t end_line = COMMAND_NO_POSITION;
+};
+
+
+// CommandIndex - command boundaries from shell-integration marks in the output
+// Understands FinalTerm/OSC 133 marks (A prompt, B command, C output, D;exit end), the same
+// marks as OSC 633 plus 633;E command lines, and OSC 7 working directories. Output is
+// rendered by a LineCompactor and stored with its command as it arrives, so looking a
+// command up never rescans the stream. Without a C mark (cmd.exe can't emit one) the first
+// line after B is taken as the command and the rest as its output. The last
+// COMMAND_INDEX_SIZE commands are kept. feed() comes from the read thread; lookups may
+// come from any thread.
+
+class CommandIndex {
+public:
+    CommandIndex();
+
+    /*
+     Process output up to and including the next mark
+     Call again with the rest of the chunk until it is used up.
+     @return Bytes consumed
+     */
+    size_t feed(const uint8_t* data, size_t length);
+
+    bool at_mark() const { return m_at_mark; }      // The last feed() ended on a command mark
+    void set_mark_line(uint64_t line);              // Screen row of that mark (Screen::mark_output_row())
+    void close();                                   // Output ended: finish the open command
+    void reset();
+
+    bool command(uint64_t id, CommandRecord& record) const;
+    bool last_command(CommandRecord& record) const;     // Most recent finished command
+
+    // Same lookups without copying the record: reader is called with the index locked,
+    // so it should be quick and must not call back into the index
+    using RecordReader = std::function<void(const CommandRecord&)>;
+    bool read_command(uint64_t id, const RecordReader& reader) const;
+    bool read_last_command(const RecordReader& reader) const;
+    uint64_t last_id() const;                           // 0 if there is none yet
+    std::string cwd() const;
+
+private:
+    enum class Phase : uint8_t { Idle, Prompt, Command, Output };
+    enum class State : uint8_t { Ground, Escape, Osc, OscEscape };
+
+    bool dispatch();                    // Handles the OSC string in m_osc; true if it is a command mark
+    void mark(char kind, const std::string& args);
+    CommandRecord& open_record();
+    void collect(const uint8_t* data, size_t length);
+    void finish(bool has_exit_code, int exit_code);
+    CommandRecord* find(uint64_t id);
+
+    mutable std::mutex m_mutex;
+    std::deque<CommandRecord> m_records;
+    uint64_t m_next_id = 1;
+    bool m_open = false;                // m_records.back() is still being filled
+    Phase m_phase = Phase::Idle;
+    std::string m_prompt_text;          // Last line of the prompt, stripped off the command line
+    std::string m_command_line;         // From OSC 633;E
+    std::string m_cwd;
+    LineCompactor m_compactor;
+    OutputCallback m_collect;
+
+    uint64_t m_offset = 0;
+    bool m_at_mark = false;
+    uint64_t m_mark_id = 0;
+    char m_mark_kind = 0;
+
+    // OSC parser
+    State m_state = State::Ground;
+    std::string m_osc;
+    bool m_osc_overflow = false;
+};
+
+} // namespace headless_tty
@@ -0,0 +1,59 @@
+#pragma once
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <windows.h>
+#include <string>
+
+#include "types.hpp"
+
+namespace headless_tty {
+
+enum class ConvertFormat : uint8_t {
+    Text,         // Final text of each line (LineCompactor)
+    Asciicast,    // asciicast v2, timed by position in the capture
+    Screens       // The visible screen as text every dump_interval bytes, and at the end
+};
+
+struct ConvertOptions {
+    ConvertFormat format = ConvertFormat::Text;
+    TerminalSize size;                  // Screen size of the recorded session
+    unsigned threads = 0;               // 0 = one per core
+    uint64_t dump_interval = 1024 * 1024;   // Screens: capture bytes between dumps
+};
+
+struct ConvertStats {
+    uint64_t input_bytes = 0;
+    uint64_t output_bytes = 0;
+    size_t segments = 0;
+    size_t redone = 0;                  // Segments whose guessed start state was wrong and ran again in order
+    unsigned threads = 0;
+};
+
+
+// Offline conversion of a raw capture (a --log file) on all cores
+// The capture is cut into CONVERT_SEGMENT_BYTES segments just after a newline. Each worker
+// rebuilds the parser state at the start of its segment by replaying the
+// CONVERT_WARMUP_BYTES before it from a fresh state; terminal output forgets its past
+// quickly, so that guess almost always matches. Results are stitched in order, and a
+// segment whose guess differs from the true state left by the one before is converted
+// again from that state, so the output is always the same as a single sequential pass.
+
+/*
+ Convert a capture held in memory
+ @param write Receives the output in order, on the calling thread
+ */
+void convert_capture(const uint8_t* data, size_t length, const ConvertOptions& options,
+                     const OutputCallback& write, ConvertStats* stats = nullptr);
+
+/*
+ Convert a capture file into output (overwritten)
+ The capture is mapped, not read; rotated .xph segments need --unpack-log first.
+ @param error Receives a description on failure (may be null)
+ */
+bool convert_capture_file(const std::wstring& input, const std::wstring& output, const ConvertOptions& options,
+                          ConvertStats* stats = nullptr, std::string* error = nullptr);
+
+} // namespace headless_tty
@@ -0,0 +1,272 @@
+#pragma once
+
+// Opt-in C++20 coroutine layer over HeadlessTTY (CMake: HEADLESS_TTY_COROUTINES=ON,
+// target headless-tty-coro). The rest of the library stays C++17.
+
+#if !defined(__cpp_impl_coroutine) || !__has_include(<coroutine>)
+#error "headless_tty/coro.hpp needs C++20 coroutines (/std:c++20 or -std=c++20)"
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "pty.hpp"
+
+namespace headless_tty {
+
+constexpr size_t CORO_READ_SIZE = 64 * 1024;               // Default read_some() limit
+constexpr size_t CORO_BUFFER_LIMIT = 4 * 1024 * 1024;      // Unread output before the read thread waits
+constexpr std::chrono::milliseconds CORO_NO_TIMEOUT{ -1 };
+
+
+// Executor - where suspended coroutines are resumed
+// Implement post() over your own event loop, or use ThreadPoolExecutor.
+
+class Executor {
+public:
+    virtual ~Executor() = default;
+    virtual void post(std::coroutine_handle<> handle) = 0;
+};
+
+
+// ThreadPoolExecutor - a fixed number of threads resuming coroutines in FIFO order
+
+class ThreadPoolExecutor : public Executor {
+public:
+    explicit ThreadPoolExecutor(unsigned threads = std::thread::hardware_concurrency());
+    ~ThreadPoolExecutor() override;
+
+    ThreadPoolExecutor(const ThreadPoolExecutor&) = delete;
+    ThreadPoolExecutor& operator=(const ThreadPoolExecutor&) = delete;
+
+    void post(std::coroutine_handle<> handle) override;
+    void stop();    // Finishes queued work, then joins the threads
+
+private:
+    void worker();
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<std::coroutine_handle<>> m_queue;
+    bool m_stop = false;
+    std::vector<std::thread> m_threads;
+};
+
+
+// Task<T> - lazily started coroutine; co_await it from another coroutine, or co_spawn() it
+
+template <typename T>
+class Task;
+
+namespace detail {
+
+struct PromiseBase {
+    std::coroutine_handle<> continuation;
+
+    struct FinalAwaiter {
+        bool await_ready() const noexcept { return false; }
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) const noexcept {
+            std::coroutine_handle<> next = handle.promise().continuation;
+            return next ? next : std::noop_coroutine();
+        }
+        void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+    void unhandled_exception() const noexcept { std::abort(); }     // The library builds without exceptions
+};
+
+template <typename T>
+struct Promise : PromiseBase {
+    std::optional<T> value;
+    Task<T> get_return_object() noexcept;
+    void return_value(T v) { value.emplace(std::move(v)); }
+    T take() { return std::move(*value); }
+};
+
+template <>
+struct Promise<void> : PromiseBase {
+    Task<void> get_return_object() noexcept;
+    void return_void() const noexcept {}
+    void take() const noexcept {}
+};
+
+} // namespace detail
+
+template <typename T = void>
+class Task {
+public:
+    using promise_type = detail::Promise<T>;
+
+    explicit Task(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+    Task(Task&& other) noexcept : m_handle(std::exchange(other.m_handle, {})) {}
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (m_handle) m_handle.destroy();
+            m_handle = std::exchange(other.m_handle, {});
+        }
+        return *this;
+    }
+    ~Task() {
+        if (m_handle) m_handle.destroy();
+    }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept {
+        m_handle.promise().continuation = caller;
+        return m_handle;
+    }
+    T await_resume() { return m_handle.promise().take(); }
+
+private:
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+namespace detail {
+
+template <typename T>
+Task<T> Promise<T>::get_return_object() noexcept {
+    return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+}
+
+inline Task<void> Promise<void>::get_return_object() noexcept {
+    return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+
+// Self-destroying wrapper that owns a spawned task
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() noexcept { return Detached{ std::coroutine_handle<promise_type>::from_promise(*this) }; }
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        std::suspend_never final_suspend() const noexcept { return {}; }
+        void return_void() const noexcept {}
+        void unhandled_exception() const noexcept { std::abort(); }
+    };
+    std::coroutine_handle<promise_type> handle;
+};
+
+inline Detached run_detached(Task<void> task) {
+    co_await task;
+}
+
+} // namespace detail
+
+/*
+ Start a task on the executor without waiting for it
+ The task runs until its first suspension on an executor thread and frees itself when done.
+ */
+inline void co_spawn(Executor& executor, Task<void> task) {
+    executor.post(detail::run_detached(std::move(task)).handle);
+}
+
+
+// Results
+
+struct ReadResult {
+    std::string data;               // Up to the requested size; empty on timeout or EOF
+    bool eof = false;               // Output has ended and everything was read
+    bool timed_out = false;
+};
+
+
+// CoSession - a HeadlessTTY driven by coroutines
+// The read thread appends output to a buffer and resumes the coroutine waiting on it
+// through the executor, so nothing blocks an executor thread. read_some() and expect()
+// both consume from that buffer. One operation per session may be pending at a time.
+//
+//     Task<void> run(CoSession& s) {
+//         co_await s.expect({ ">" }, 5s);
+//         co_await s.write("dir\r\n");
+//         ReadResult r = co_await s.read_some();
+//         int code = co_await s.wait_exit();
+//     }
+
+class CoSession {
+    struct State;
+
+public:
+    explicit CoSession(Executor& executor);
+    ~CoSession();       // Stops the child
+
+    CoSession(const CoSession&) = delete;
+    CoSession& operator=(const CoSession&) = delete;
+
+    bool start(const Config& config);
+    void stop();
+    HeadlessTTY& tty();
+    std::string get_last_error() const;
+
+    // Awaiter for the operations below; co_await it once
+    template <typename R>
+    class Op {
+    public:
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> handle);     // false: completed without suspending
+        R await_resume();
+
+    private:
+        friend class CoSession;
+        Op(std::shared_ptr<State> state, int kind) : m_state(std::move(state)), m_kind(kind) {}
+
+        std::shared_ptr<State> m_state;
+        int m_kind;
+        size_t m_max = CORO_READ_SIZE;
+        std::chrono::milliseconds m_timeout = CORO_NO_TIMEOUT;
+        std::vector<std::string> m_patterns;
+        ExpectOptions m_options;
+        std::string m_data;
+    };
+
+    // Next available output (at most max bytes)
+    Op<ReadResult> read_some(size_t max = CORO_READ_SIZE, std::chrono::milliseconds timeout = CORO_NO_TIMEOUT);
+
+    // Wait for any of the patterns; output up to the match is consumed (see HeadlessTTY::expect)
+    Op<ExpectResult> expect(std::vector<std::string> patterns, std::chrono::milliseconds timeout = CORO_NO_TIMEOUT,
+                            const ExpectOptions& options = ExpectOptions());
+
+    // Send input from a thread-pool thread, so a child that isn't reading doesn't block the
+    // executor; the awaiter resumes on the executor once the write is done
+    Op<bool> write(std::string data);
+
+    // Exit code once the child has exited and its output ended, or -1 on timeout. Output read
+    // meanwhile stays buffered for read_some(), up to CORO_BUFFER_LIMIT; beyond that the
+    // oldest is dropped, since holding the read thread back would keep the child from exiting.
+    Op<int> wait_exit(std::chrono::milliseconds timeout = CORO_NO_TIMEOUT);
+
+private:
+    std::shared_ptr<State> m_state;
+};
+
+
+// Resume after a delay (on the executor)
+
+class SleepOp {
+public:
+    SleepOp(Executor& executor, std::chrono::milliseconds delay) : m_executor(executor), m_delay(delay) {}
+    bool await_ready() const noexcept { return m_delay.count() <= 0; }
+    void await_suspend(std::coroutine_handle<> handle);
+    void await_resume() const noexcept {}
+
+private:
+    Executor& m_executor;
+    std::chrono::milliseconds m_delay;
+};
+
+inline SleepOp sleep_for(Executor& executor, std::chrono::milliseconds delay) {
+    return SleepOp(executor, delay);
+}
+
+} // namespace headless_tty
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+#include "types.hpp"
+#include "vt_strip.hpp"
+
+namespace headless_tty {
+
+constexpr int EXPECT_TIMEOUT = -1;
+constexpr int EXPECT_EOF = -2;
+constexpr int EXPECT_ERROR = -3;    // No patterns, an empty pattern, or too many states
+constexpr int EXPECT_CANCELLED = -4;
+
+struct ExpectOptions {
+    bool ignore_escapes = false;    // Match against text with VT escape sequences removed
+};
+
+struct ExpectResult {
+    int index = EXPECT_TIMEOUT;     // Index of the matched pattern, or one of the EXPECT_ codes above
+    std::string output;             // Output consumed up to and including the match (at most EXPECT_WINDOW_SIZE bytes)
+};
+
+
+// PatternMatcher - streaming multi-pattern matcher (Aho-Corasick compiled to a dense DFA)
+// One table lookup per input byte; state carries across feed() calls so matches that
+// straddle PTY read boundaries are found.
+
+class PatternMatcher {
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    bool build(const std::vector<std::string>& patterns);
+    void reset() { m_state = 0; }
+
+    /*
+     Advance the matcher by one byte
+     @return Index of the pattern that ends at this byte (lowest index wins), or -1
+     */
+    int step(uint8_t c) {
+        m_state = m_next[static_cast<size_t>(m_state) * 256 + c];
+        return m_match[m_state];
+    }
+
+    /*
+     Feed a chunk
+     @param matched Receives the matched pattern index
+     @return Offset one past the end of the first match in data, or npos
+     */
+    size_t feed(const uint8_t* data, size_t length, int& matched);
+
+private:
+    std::vector<int32_t> m_next;    // states x 256
+    std::vector<int32_t> m_match;   // per state
+    int32_t m_state = 0;
+};
+
+
+// Expecter - waits for patterns in the live output stream
+// Output is fed from the read thread. Unconsumed output is retained (bounded by EXPECT_WINDOW_SIZE)
+// so text that arrives between two expect() calls is not missed; while an expect() is waiting,
+// new output is matched as it arrives rather than by rescanning. One expect() at a time.
+
+class Expecter {
+public:
+    void feed(const uint8_t* data, size_t length);
+    void close();   // Output ended; waiting and future expect() calls return EXPECT_EOF
+    void cancel();  // Waiting and future expect() calls return EXPECT_CANCELLED until reset()
+    void reset();   // Clear retained output and reopen
+
+    /*
+     Wait until one of the patterns appears in the output
+     @param patterns Literal byte strings
+     @param timeout_ms Milliseconds to wait (0xFFFFFFFF waits forever)
+     @param options Matching options
+     */
+    ExpectResult expect(const std::vector<std::string>& patterns, uint32_t timeout_ms,
+                        const ExpectOptions& options = ExpectOptions());
+
+private:
+    // Runs the armed matcher over data; returns offset past the match or npos. Caller holds m_mutex.
+    size_t scan(const uint8_t* data, size_t length, int& matched);
+    void consume(size_t end, int matched);
+    void trim();
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::string m_pending;
+    bool m_closed = false;
+    bool m_cancelled = false;
+
+    // State of the expect() in progress
+    bool m_armed = false;
+    bool m_ignore_escapes = false;
+    PatternMatcher m_matcher;
+    EscapeStripper m_stripper;
+    ExpectResult m_result;
+    bool m_matched = false;
+};
+
+} // namespace headless_tty
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "pty.hpp"
+
+namespace headless_tty {
+
+
+// ExpectScript - line based automation scripts driven by HeadlessTTY::expect()
+//
+//   # comment
+//   timeout 5000                 default timeout for later expect/rules steps (ms)
+//   escapes ignore|keep          match with or without VT escape sequences
+//   expect "pat1" ["pat2" ...]   wait for any pattern, fail on timeout or exit
+//   send "text\r"                write bytes (escapes: \r \n \t \e \\ \" \xHH)
+//   sendline "text"              write text followed by \r
+//   sleep 250                    pause (ms)
+//   wait-ready [quiet ms] [cursor ms] [prompt "text"]... [paste] [keys] [fullscreen]
+//                                wait until the child is ready for input (see wait_ready)
+//   rule "pattern" ["reply"] [final]
+//   rules [ms]                   answer collected rules until a final rule matches, giving up
+//                                after ms in total (one of the rules must be final)
+//   wait-exit [ms]               wait for the child to exit
+
+class ExpectScript {
+public:
+    bool load(const std::wstring& path);
+    bool parse(const std::string& text);
+
+    /*
+     Run the script against a started session
+     @param cancel Event that aborts the script when signaled (may be null). It is checked
+                   between steps, between rule matches and during sleeps; to end a waiting
+                   expect as well, call tty.cancel_expect() after signaling it.
+     @return true if every step succeeded
+     */
+    bool run(HeadlessTTY& tty, HANDLE cancel = nullptr);
+    bool needs_screen() const;      // A wait-ready step waits on the cursor (Config::track_screen)
+    std::string get_last_error() const { return m_last_error; }
+
+private:
+    enum class Op : uint8_t { Timeout, Escapes, Expect, Send, Sleep, Rule, Rules, WaitExit, WaitReady };
+
+    struct Step {
+        Op op;
+        int line;
+        uint32_t value = 0;
+        bool flag = false;
+        std::vector<std::string> args;
+        ReadyOptions ready;     // WaitReady
+    };
+
+    struct Rule {
+        std::string pattern;
+        std::string reply;
+        bool final = false;
+    };
+
+    bool fail(int line, const std::string& msg);
+
+    std::vector<Step> m_steps;
+    std::string m_last_error;
+};
+
+} // namespace headless_tty
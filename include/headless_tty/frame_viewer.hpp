@@ -0,0 +1,71 @@
+#pragma once
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <functional>
+
+#include "screen.hpp"
+
+namespace headless_tty {
+
+using FrameCallback = std::function<void(const ScreenFrame&)>;
+
+struct FrameViewerStats {
+    uint64_t updates = 0;   // feed() calls
+    uint64_t frames = 0;    // Frames delivered; updates - frames were skipped
+};
+
+
+// FrameViewer - lossy, rate-limited screen delivery for slow consumers
+// feed() runs the output through a Screen on the caller's thread and only marks
+// it dirty. A viewer thread copies the latest screen at most fps times per second
+// and hands it to the callback; whatever changed in between is never delivered
+// on its own. Viewer cost is bounded by fps x screen size, not by output volume.
+
+class FrameViewer {
+public:
+    FrameViewer() = default;
+    ~FrameViewer();
+
+    FrameViewer(const FrameViewer&) = delete;
+    FrameViewer& operator=(const FrameViewer&) = delete;
+
+    /*
+     Start the viewer thread
+     @param size Initial screen size (match the PTY)
+     @param fps Upper bound on frames per second
+     @param callback Receives frames on the viewer thread
+     */
+    void start(TerminalSize size, uint32_t fps, FrameCallback callback);
+    void feed(const uint8_t* data, size_t length);
+    void resize(TerminalSize size);
+    void stop();    // Delivers the final screen if it hasn't been shown yet
+    FrameViewerStats stats() const;
+
+private:
+    void viewer_loop();
+
+    Screen m_screen;
+    ScreenFrame m_frame;                // Only touched by the viewer thread
+    FrameCallback m_callback;
+    std::chrono::steady_clock::duration m_interval{};
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_dirty = false;
+    bool m_stop = false;
+    FrameViewerStats m_stats;
+    std::thread m_thread;
+};
+
+/*
+ Render a frame as VT output that repaints a terminal from the top-left corner
+ @param frame Frame to draw
+ @param out Receives the escape sequences (cleared first)
+ */
+void render_frame(const ScreenFrame& frame, std::string& out);
+
+} // namespace headless_tty
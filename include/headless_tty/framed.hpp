@@ -0,0 +1,105 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <functional>
+
+#include "types.hpp"
+#include "output_sink.hpp"
+
+namespace headless_tty {
+
+// Framed protocol (--framed)
+// Every frame is a 4-byte header followed by its payload. The header is one little-endian
+// uint32: the frame type in the low 8 bits and the payload length in the high 24 bits.
+// Integers in payloads are little endian.
+//
+//   type          stdout (headless-tty -> parent)            stdin (parent -> headless-tty)
+//   0 HELLO       "HTTY", version u8, cols u16, rows u16     -
+//   1 OUTPUT      seq u32, time_ms u32, child output bytes   -
+//   2 EXIT        exit code i32                              -
+//   3 RESIZE      cols u16, rows u16 (after a resize)        cols u16, rows u16
+//   4 METRICS     bytes, reads, callbacks, frames (u64 each) empty: request a METRICS frame
+//   5 ERROR       UTF-8 message                              -
+//   6 STOP        -                                          empty: terminate the child
+//   7 INPUT       -                                          bytes for the child
+//
+// OUTPUT seq counts output frames from 0, so a gap means frames were lost; time_ms is the
+// time since the session started when the chunk was read. Stdin carries frames only; raw
+// bytes there would be read as frame headers, so input for the child goes in INPUT frames.
+// A RESIZE goes out once the size has reached the pseudo console, or an ERROR if it failed.
+// Resizes sent in quick succession are coalesced and answered once, with the final size.
+
+enum FrameType : uint8_t {
+    FRAME_HELLO = 0,
+    FRAME_OUTPUT = 1,
+    FRAME_EXIT = 2,
+    FRAME_RESIZE = 3,
+    FRAME_METRICS = 4,
+    FRAME_ERROR = 5,
+    FRAME_STOP = 6,
+    FRAME_INPUT = 7
+};
+
+constexpr size_t FRAME_OUTPUT_PREFIX = 8;   // seq and time_ms at the start of an OUTPUT payload
+
+inline void put_frame_header(uint8_t* out, uint8_t type, uint32_t length) {
+    uint32_t header = type | (length << 8);
+    out[0] = static_cast<uint8_t>(header);
+    out[1] = static_cast<uint8_t>(header >> 8);
+    out[2] = static_cast<uint8_t>(header >> 16);
+    out[3] = static_cast<uint8_t>(header >> 24);
+}
+
+// Append a whole frame to out
+void append_frame(std::string& out, uint8_t type, const void* payload, size_t length);
+
+
+// FrameWriter - encodes session events as frames into an OutputBatcher
+// Each frame is pushed as one chunk, so frames from different threads never interleave.
+// Output is framed without copying it first: the header and the chunk go to the batcher
+// as two spans of the same push.
+
+class FrameWriter {
+public:
+    explicit FrameWriter(OutputBatcher& batcher);
+
+    void hello(const TerminalSize& size);
+    void output(const uint8_t* data, size_t length);    // From the output callback (one thread)
+    void exited(int code);
+    void resized(const TerminalSize& size);
+    void metrics(const IoStats& stats);
+    void error(const std::string& message);
+
+    uint64_t output_frames() const { return m_seq.load(); }
+
+private:
+    void push(uint8_t type, const void* payload, size_t length);
+
+    OutputBatcher& m_batcher;
+    ULONGLONG m_started;
+    std::atomic<uint32_t> m_seq{ 0 };
+};
+
+
+// FrameParser - splits a byte stream into frames
+// Frames that arrive whole are handed over in place; only one split across feed() calls
+// is copied. The length is taken straight from the header and checked against what is
+// left once per frame, so a stream of small frames costs a few instructions each.
+//
+//     parser.feed(data, n, [&](uint8_t type, const uint8_t* payload, size_t length) { ... });
+
+class FrameParser {
+public:
+    using FrameCallback = std::function<void(uint8_t type, const uint8_t* payload, size_t length)>;
+
+    void feed(const uint8_t* data, size_t length, const FrameCallback& callback);
+    void reset();
+    size_t pending() const { return m_partial.size(); }     // Bytes of an incomplete frame
+
+private:
+    std::vector<uint8_t> m_partial;
+};
+
+} // namespace headless_tty
@@ -0,0 +1,153 @@
+/*
+headless_tty.h - C API of headless_tty.dll
+
+Plain C, opaque handles, no C++ types across the boundary, so the library can be
+embedded from Go (cgo), Rust (bindgen/FFI), C#, etc. instead of running
+headless-tty.exe and talking to it over pipes.
+
+    htty_session* s = htty_create();
+    htty_config config = HTTY_CONFIG_INIT;
+    config.command = "cmd.exe";
+    config.args = "/c dir";
+    if (htty_spawn(s, &config) != HTTY_OK) { puts(htty_last_error(s)); }
+
+    char buf[65536];
+    int64_t n;
+    while ((n = htty_read(s, buf, sizeof(buf), HTTY_INFINITE)) > 0) { fwrite(buf, 1, n, stdout); }
+
+    int exit_code;
+    htty_wait(s, HTTY_INFINITE, &exit_code);
+    htty_destroy(s);
+
+Output is delivered one of two ways, chosen before htty_spawn():
+  - Buffered (default): the read thread copies output into a ring buffer allocated
+    once at spawn; htty_read() copies it out into the caller's buffer. A timeout of 0
+    makes htty_read() non-blocking. When the ring is full the read thread waits,
+    which stalls the child instead of growing memory.
+  - Callback: htty_set_output_callback() hands each read to the callback directly on
+    the read thread; nothing is buffered and htty_read() is not used.
+Neither path allocates after htty_spawn().
+
+Strings are UTF-8. Functions returning int return HTTY_OK or a negative HTTY_E* code.
+ */
+
+#ifndef HEADLESS_TTY_H
+#define HEADLESS_TTY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(HEADLESS_TTY_BUILDING_DLL)
+#define HTTY_API __declspec(dllexport)
+#elif defined(HEADLESS_TTY_STATIC)
+#define HTTY_API
+#else
+#define HTTY_API __declspec(dllimport)
+#endif
+
+#define HTTY_ABI_VERSION 1
+
+#define HTTY_OK            0
+#define HTTY_EOF           0    /* htty_read(): output has ended */
+#define HTTY_ERROR        -1    /* See htty_last_error() */
+#define HTTY_E_TIMEOUT    -2    /* Nothing happened within the timeout (HTTY_NO_WAIT: would block) */
+#define HTTY_E_STATE      -3    /* Call not valid now, e.g. spawn twice or read in callback mode */
+#define HTTY_E_ARGUMENT   -4    /* Invalid argument */
+#define HTTY_E_MEMORY     -5    /* Out of memory */
+
+#define HTTY_NO_WAIT       0u
+#define HTTY_INFINITE      0xFFFFFFFFu
+
+/* htty_config.io_mode */
+#define HTTY_IO_LATENCY    0
+#define HTTY_IO_THROUGHPUT 1
+#define HTTY_IO_AUTO       2
+
+/* htty_config.utf8_mode */
+#define HTTY_UTF8_RAW      0    /* Reads as they arrive; a codepoint may be split between deliveries */
+#define HTTY_UTF8_WHOLE    1    /* Never split a codepoint between deliveries */
+#define HTTY_UTF8_REPAIR   2    /* Whole, and replace ill-formed sequences with U+FFFD */
+
+#define HTTY_DEFAULT_BUFFER_SIZE (4u * 1024u * 1024u)
+
+typedef struct htty_session htty_session;
+
+typedef struct htty_config {
+    uint32_t struct_size;       /* sizeof(htty_config); lets later versions append fields */
+    const char* command;        /* Executable, required */
+    const char* args;           /* Command line arguments, may be NULL */
+    const char* working_dir;    /* May be NULL for the current directory */
+    uint16_t cols;
+    uint16_t rows;
+    uint32_t io_mode;           /* HTTY_IO_* */
+    uint32_t buffer_size;       /* Ring size in bytes for buffered output, 0 for the default */
+    uint32_t utf8_mode;         /* HTTY_UTF8_*, applied before the ring or callback (appended field) */
+    uint32_t reserved;          /* Must be 0. utf8_mode alone fits in the tail padding of the first
+                                   release's struct, so this makes the size tell the two apart */
+} htty_config;
+
+#define HTTY_CONFIG_INIT { sizeof(htty_config), NULL, NULL, NULL, 120, 40, HTTY_IO_AUTO, 0, HTTY_UTF8_RAW, 0 }
+
+typedef struct htty_metrics {
+    uint64_t bytes;             /* Bytes read from the PTY */
+    uint64_t reads;             /* Pipe reads that returned data */
+    uint64_t callbacks;         /* Deliveries to the ring or the output callback */
+    uint64_t buffered;          /* Bytes waiting in the ring */
+    uint64_t buffer_size;       /* Ring capacity (0 in callback mode) */
+    uint64_t stalls;            /* Times the read thread waited for ring space */
+} htty_metrics;
+
+/* Called on the read thread; data is only valid during the call */
+typedef void (*htty_output_fn)(void* user, const uint8_t* data, size_t length);
+/* Called on the read thread once the output has ended */
+typedef void (*htty_exit_fn)(void* user);
+
+HTTY_API uint32_t htty_abi_version(void);
+
+HTTY_API htty_session* htty_create(void);
+/* Stops the child if it is still running. Must not be called from a callback. */
+HTTY_API void htty_destroy(htty_session* session);
+
+/* Both must be set before htty_spawn(); pass NULL to clear */
+HTTY_API int htty_set_output_callback(htty_session* session, htty_output_fn callback, void* user);
+HTTY_API int htty_set_exit_callback(htty_session* session, htty_exit_fn callback, void* user);
+
+HTTY_API int htty_spawn(htty_session* session, const htty_config* config);
+
+/* @return bytes written, or a negative HTTY_E* code */
+HTTY_API int64_t htty_write(htty_session* session, const void* data, size_t length);
+
+/*
+ Copy buffered output into the caller's buffer
+ @param timeout_ms HTTY_NO_WAIT, milliseconds, or HTTY_INFINITE
+ @return bytes copied (> 0), HTTY_EOF once output has ended and the ring is drained,
+         or a negative HTTY_E* code
+ */
+HTTY_API int64_t htty_read(htty_session* session, void* buffer, size_t capacity, uint32_t timeout_ms);
+
+HTTY_API int htty_resize(htty_session* session, uint16_t cols, uint16_t rows);
+
+/*
+ Wait for the child to exit
+ @param exit_code Receives the exit code, may be NULL
+ @return HTTY_OK, HTTY_E_TIMEOUT or HTTY_E_STATE if never spawned
+ */
+HTTY_API int htty_wait(htty_session* session, uint32_t timeout_ms, int* exit_code);
+
+/* Terminate the child; buffered output can still be read afterwards */
+HTTY_API int htty_stop(htty_session* session);
+HTTY_API int htty_is_running(const htty_session* session);
+HTTY_API int htty_get_metrics(const htty_session* session, htty_metrics* metrics);
+
+/* Message for the last HTTY_ERROR on this session; valid until the next call on it */
+HTTY_API const char* htty_last_error(const htty_session* session);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HEADLESS_TTY_H */
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "pty.hpp"
+
+namespace headless_tty {
+
+enum class InputPacing : uint8_t {
+    FullSpeed,      // Write as fast as the PTY accepts it
+    RateLimited,    // Cap throughput at bytes_per_second
+    WaitForQuiet    // Send one line at a time, each after output has been idle for quiet_ms
+};
+
+struct InputFileOptions {
+    InputPacing pacing = InputPacing::FullSpeed;
+    uint64_t bytes_per_second = 0;      // RateLimited
+    uint32_t quiet_ms = 100;            // WaitForQuiet: required output idle time before each line
+    uint32_t quiet_timeout_ms = 10000;  // WaitForQuiet: send the line anyway after this long
+};
+
+/*
+ Stream a file into the session's input
+ The file is memory mapped one INPUT_FILE_WINDOW_SIZE view at a time and written in chunks of
+ up to INPUT_FILE_CHUNK_SIZE. Writes are synchronous, so when the child stops reading the pipe
+ fills and streaming pauses - memory use stays bounded regardless of file size.
+ @param tty Running session to write to
+ @param path File to send
+ @param options Pacing mode
+ @param cancel Event that aborts streaming when signaled (may be null)
+ @param error Receives a description on failure (may be null)
+ @return true if the whole file was written
+ */
+bool stream_input_file(HeadlessTTY& tty, const std::wstring& path, const InputFileOptions& options,
+                       HANDLE cancel = nullptr, std::string* error = nullptr);
+
+} // namespace headless_tty
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "pty.hpp"
+#include "vt_strip.hpp"
+
+#include <condition_variable>
+
+namespace headless_tty {
+
+struct LatencyOptions {
+    uint32_t samples = 500;
+    uint32_t warmup = 10;           // Probes sent first and not counted
+    uint32_t interval_ms = 10;      // Pause after each echo before the next probe
+    uint32_t timeout_ms = 2000;     // A marker not echoed by then counts as lost
+    std::string prefix;             // Sent before each marker ("rem " makes cmd.exe ignore it)
+    std::string suffix = "\r";      // Sent after each marker
+};
+
+struct LatencyStats {
+    size_t samples = 0;
+    size_t lost = 0;
+    double p50_us = 0;
+    double p90_us = 0;
+    double p99_us = 0;
+    double p999_us = 0;
+    double max_us = 0;
+    double mean_us = 0;
+    double stddev_us = 0;
+    double jitter_us = 0;           // Mean difference between consecutive samples
+    std::array<uint32_t, LATENCY_BUCKETS> histogram = {};   // Bucket i: below 250us << i (last: the rest)
+};
+
+/*
+ Percentiles, jitter and histogram of a set of latencies
+ @param samples_us Latencies in microseconds, in the order they were measured
+ */
+LatencyStats summarize_latency(const std::vector<double>& samples_us, size_t lost);
+
+// Multi-line text report headed by title
+std::string format_latency(const std::string& title, const LatencyStats& stats);
+
+
+// LatencyProbe - write-to-echo latency through a running session
+// Each probe writes prefix + "~L<seq>~" + suffix and waits for the marker to come back in
+// the output. Output is matched with escape sequences stripped, and the echo is
+// timestamped in the output callback, so the figure covers write(), the child's echo,
+// conhost and the read thread up to the point a library user would see the bytes.
+//
+//     tty.set_output_callback([&](const uint8_t* d, size_t n) { probe.feed(d, n); });
+//     probe.run(tty, options, cancel, stats);
+
+class LatencyProbe {
+public:
+    LatencyProbe();
+
+    void feed(const uint8_t* data, size_t length);     // From the output callback
+
+    /*
+     Send the probes one at a time and collect the latencies
+     @param cancel Event that aborts the run when signaled (may be null)
+     @return false if cancelled, a write failed or every probe was lost
+     */
+    bool run(HeadlessTTY& tty, const LatencyOptions& options, HANDLE cancel, LatencyStats& stats);
+    std::string get_last_error() const { return m_last_error; }
+
+private:
+    // Send one probe; false on a write failure or cancel, else elapsed is < 0 if lost
+    bool probe(HeadlessTTY& tty, const LatencyOptions& options, HANDLE cancel, double& elapsed_us);
+
+    EscapeStripper m_stripper;      // Read thread only
+    uint8_t m_scan = 0;             // Marker scanner state (read thread only)
+    uint32_t m_scan_value = 0;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    uint32_t m_waiting_for = 0;     // Sequence number of the pending probe (0 = none)
+    LONGLONG m_echo_time = 0;       // QueryPerformanceCounter when it was seen
+    uint32_t m_next_seq = 1;
+    LONGLONG m_frequency = 1;
+    std::string m_last_error;
+};
+
+} // namespace headless_tty
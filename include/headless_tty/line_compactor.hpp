@@ -0,0 +1,96 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+
+#include "types.hpp"
+
+namespace headless_tty {
+
+struct CompactOptions {
+    uint32_t sample_interval_ms = 0;    // Also emit the lines being rewritten at most this often (0 = never)
+    uint16_t rows = TerminalSize().rows;  // Screen height, to follow absolute cursor positioning
+};
+
+
+// LineCompactor - turns output full of in-place rewrites into the lines it finally shows
+// Progress bars redraw a line (pip, curl: CR) or a block of lines (npm, docker: cursor up)
+// thousands of times a second. Only the text a line holds once the output has moved past
+// it is emitted, as plain UTF-8 ending in "\r\n". Understands CR, BS, TAB, LF, cursor
+// movement (CUU/CUD/CNL/CPL/CHA/CUP/HVP) and EL/ED/ECH; every other sequence is dropped.
+// Lines stay open only as far up as the output has actually moved the cursor (and only until
+// COMPACT_MAX_OPEN_LINES lines have passed without such a move), so plain output passes
+// straight through. A move above the open lines can't rewrite what was emitted, so the text
+// written there follows as new lines instead. Memory is bounded by COMPACT_MAX_OPEN_LINES lines of COMPACT_LINE_LIMIT
+// columns. Columns are counted in codepoints.
+
+class LineCompactor {
+public:
+    explicit LineCompactor(const CompactOptions& options = CompactOptions());
+
+    /*
+     Process one chunk of output
+     @param sink Receives the finished lines (and samples) of this chunk in one call, if any
+     */
+    void feed(const uint8_t* data, size_t length, const OutputCallback& sink);
+
+    // End of stream: emits the lines still open
+    void flush(const OutputCallback& sink);
+
+    /*
+     Emit every open line above the cursor now and stop treating them as rewritable
+     For boundaries the output won't redraw across, such as a shell's command marks.
+     */
+    void commit(const OutputCallback& sink);
+
+    // UTF-8 text of the line the cursor is on, trailing blanks removed (not emitted yet)
+    std::string cursor_line_text() const;
+    void reset();
+
+    // Same open lines, cursor and parser state: both will turn the same input into the same output
+    bool same_state(const LineCompactor& other) const;
+
+private:
+    enum class State : uint8_t {
+        Ground,
+        Escape,
+        EscapeIntermediate,
+        Csi,
+        String,         // OSC, DCS, SOS, PM, APC - ignored up to BEL or ST
+        StringEscape
+    };
+
+    void advance(uint8_t c);
+    void put(char32_t ch);
+    void csi_dispatch(uint8_t final);
+    void line_feed();
+    void move_up(size_t count);
+    void move_down(size_t count);
+    void retire();
+    void emit_line(const std::u32string& line);
+    size_t param(size_t index, size_t fallback) const;
+
+    CompactOptions m_options;
+    std::deque<std::u32string> m_lines;     // Open lines, oldest first; never empty
+    size_t m_row = 0;                       // Cursor line in m_lines
+    size_t m_col = 0;
+    size_t m_depth = 0;                     // Deepest recent rewrite: lines kept open above the bottom
+    size_t m_lines_since_up = 0;            // Line feeds since the cursor last moved up
+    uint16_t m_screen_row = 0;              // Cursor row on the child's screen, for CUP
+    bool m_rewritten = false;               // Open text was overwritten since the last sample
+    std::chrono::steady_clock::time_point m_last_sample;
+    std::string m_out;
+
+    // Parser
+    State m_state = State::Ground;
+    size_t m_params[2] = {};
+    size_t m_param_count = 0;
+    bool m_private = false;
+    char32_t m_codepoint = 0;
+    uint8_t m_utf8_remaining = 0;
+};
+
+} // namespace headless_tty
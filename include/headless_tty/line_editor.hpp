@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+namespace headless_tty {
+
+enum class EditKey : uint8_t {
+    Char,       // Insert EditEvent::codepoint at the cursor
+    Enter,
+    Backspace,
+    Delete,
+    Left,
+    Right,
+    Home,
+    End
+};
+
+struct EditEvent {
+    EditKey key = EditKey::Char;
+    char32_t codepoint = 0;
+};
+
+
+// LineEditor - platform independent line editing for the tray console
+// Consumes batches of key events and produces, per batch, one string of echo output
+// (UTF-8 text plus VT cursor movement) and one string of completed lines for the PTY.
+// The line is stored as UTF-8. Cursor keys, Backspace and Delete step over whole grapheme
+// clusters, and cursor movement is counted in columns (text_width), so wide characters and
+// combining marks stay lined up with what the console shows.
+
+class LineEditor {
+public:
+    /*
+     Apply a batch of key events
+     @param events Key events in arrival order
+     @param count Number of events
+     @param echo Appended with bytes to write to the console
+     @param committed Appended with finished lines ("...\r\n") to write to the PTY
+     */
+    void process(const EditEvent* events, size_t count, std::string& echo, std::string& committed);
+
+    const std::string& line() const { return m_line; }
+    size_t cursor() const { return m_cursor; }
+    void clear();
+
+private:
+    void insert(const std::string& text, std::string& echo);
+    void erase(size_t from, size_t to, std::string& echo);
+    size_t prev_boundary(size_t pos) const;
+    size_t next_boundary(size_t pos) const;
+    size_t columns(size_t from, size_t to) const;
+
+    std::string m_line;
+    size_t m_cursor = 0;   // Byte offset into m_line
+};
+
+} // namespace headless_tty
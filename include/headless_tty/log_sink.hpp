@@ -0,0 +1,118 @@
+#pragma once
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <windows.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+#include "types.hpp"
+#include "vt_strip.hpp"
+#include "line_compactor.hpp"
+
+namespace headless_tty {
+
+struct LogOptions {
+    uint64_t max_segment_bytes = 64ull * 1024 * 1024;  // Rotate after this many bytes (0 = never)
+    uint32_t max_segment_seconds = 0;                  // Rotate after this many seconds (0 = never)
+    uint32_t keep_segments = 10;                       // Rotated segments kept on disk (0 = keep all)
+    bool compress = true;                              // Compress rotated segments in the background
+    bool plain_text = false;                           // Strip escape sequences before writing
+    bool compact_lines = false;                        // Write only finished lines (see LineCompactor); implies plain text
+    CompactOptions compact;
+};
+
+
+// LogSink - asynchronous, rotating log file fed from the PTY read path
+// write() only copies into a preallocated page-aligned buffer and never touches the disk,
+// a writer thread flushes full buffers in large writes and rotates segments,
+// and an archive thread compresses rotated segments and enforces retention.
+// If the disk falls behind and every buffer is full, new output is dropped (and counted)
+// rather than stalling the reader.
+
+class LogSink {
+public:
+    LogSink() = default;
+    ~LogSink();
+
+    LogSink(const LogSink&) = delete;
+    LogSink& operator=(const LogSink&) = delete;
+
+    /*
+     Open (append to) the log file and start the background threads
+     @param path Active log file; rotated segments become <path>.<timestamp>-<n>[.xph]
+     @param options Rotation, retention and formatting options
+     @return true if the file could be opened
+     */
+    bool open(const std::wstring& path, const LogOptions& options = LogOptions());
+    void write(const uint8_t* data, size_t length);
+    void close();   // Flushes everything buffered and waits for pending compression
+    bool is_open() const;
+    uint64_t dropped_bytes() const;
+    std::string get_last_error() const;
+
+private:
+    struct Buffer {
+        uint8_t* data = nullptr;
+        size_t used = 0;
+    };
+
+    void writer_loop();
+    void archive_loop();
+    void write_buffer(Buffer* buffer);
+    void write_bytes(const uint8_t* data, size_t length);
+    bool open_segment();
+    void rotate_segment();
+    DWORD rotation_due_ms() const;
+    void set_error(const std::string& msg);
+
+    std::wstring m_path;
+    LogOptions m_options;
+    HANDLE m_hFile = INVALID_HANDLE_VALUE;
+    uint64_t m_segment_bytes = 0;
+    ULONGLONG m_segment_started = 0;
+    uint32_t m_segment_index = 0;
+    EscapeStripper m_stripper;
+    LineCompactor m_compactor;
+
+    // Buffer exchange between write() and the writer thread
+    std::vector<Buffer> m_buffers;
+    std::vector<Buffer*> m_free;
+    std::deque<Buffer*> m_full;
+    Buffer* m_active = nullptr;
+    ULONGLONG m_active_since = 0;
+    bool m_closing = false;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::thread m_writer_thread;
+
+    // Rotated segments waiting for compression / retention
+    std::deque<std::wstring> m_archive_queue;
+    std::deque<std::wstring> m_archived;
+    bool m_archive_closing = false;
+    std::mutex m_archive_mutex;
+    std::condition_variable m_archive_cv;
+    std::thread m_archive_thread;
+
+    std::atomic<bool> m_open{ false };
+    std::atomic<uint64_t> m_dropped{ 0 };
+    mutable std::mutex m_error_mutex;
+    std::string m_last_error;
+};
+
+/*
+ Expand a compressed log segment (.xph) back to plain bytes
+ @param input Compressed segment written by LogSink
+ @param output Destination file (overwritten)
+ @param error Receives a description on failure (may be null)
+ */
+bool decompress_log_segment(const std::wstring& input, const std::wstring& output, std::string* error = nullptr);
+
+} // namespace headless_tty
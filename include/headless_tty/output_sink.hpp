@@ -0,0 +1,128 @@
+#pragma once
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <windows.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+#include "types.hpp"
+
+namespace headless_tty {
+
+struct OutputSpan {
+    const uint8_t* data;
+    size_t length;
+};
+
+struct OutputSinkStats {
+    uint64_t batches = 0;
+    uint64_t spans = 0;
+    uint64_t bytes = 0;
+    uint64_t writes = 0;        // WriteFile calls
+};
+
+
+// OutputSink - destination for batches of output spans (scatter-gather)
+// A batch is written in order as one unit; the spans are only valid during the call.
+
+class OutputSink {
+public:
+    virtual ~OutputSink() = default;
+
+    // @return false if the batch could not be written completely
+    virtual bool write(const OutputSpan* spans, size_t count) = 0;
+};
+
+
+// HandleSink - writes each batch to stdout, a file or a named pipe with one WriteFile
+// Spans that follow each other in memory are written in place; any others are gathered
+// into a staging buffer first. WriteFileGather isn't used: it only takes whole,
+// page-aligned pages on a file opened unbuffered and overlapped, which stdout and pipes
+// never are.
+
+class HandleSink : public OutputSink {
+public:
+    HandleSink() = default;
+    ~HandleSink() override;
+
+    HandleSink(const HandleSink&) = delete;
+    HandleSink& operator=(const HandleSink&) = delete;
+
+    bool open_stdout();                                         // Not closed by close()
+    bool open_file(const std::wstring& path, bool append = true);
+
+    /*
+     Connect to a named pipe as a client
+     @param name Full pipe name (\\.\pipe\...)
+     @param timeout_ms How long to wait for a free pipe instance
+     */
+    bool open_pipe(const std::wstring& name, DWORD timeout_ms = 5000);
+    void attach(HANDLE handle);                                 // Any writable handle; not closed by close()
+    void close();
+    bool is_open() const { return m_handle != INVALID_HANDLE_VALUE; }
+
+    bool write(const OutputSpan* spans, size_t count) override;
+    OutputSinkStats get_stats() const;
+    std::string get_last_error() const { return m_last_error; }
+
+private:
+    bool write_all(const uint8_t* data, size_t length);
+
+    HANDLE m_handle = INVALID_HANDLE_VALUE;
+    bool m_owned = false;
+    std::vector<uint8_t> m_staging;
+    std::atomic<uint64_t> m_batches{ 0 };
+    std::atomic<uint64_t> m_spans{ 0 };
+    std::atomic<uint64_t> m_bytes{ 0 };
+    std::atomic<uint64_t> m_writes{ 0 };
+    std::string m_last_error;
+};
+
+
+// OutputBatcher - feeds an OutputSink from a writer thread, a batch at a time
+// push() copies the chunk and wakes the writer. Nothing waits for more output, so an idle
+// writer writes a chunk as soon as it arrives; chunks that come in while a write is in
+// progress pile up and go out together in the next batch, one span each. Once
+// OUTPUT_BATCH_MAX_BYTES are waiting, push() blocks, stalling the reader rather than
+// growing memory.
+//
+//     sink.open_stdout();
+//     batcher.start(sink);
+//     tty.set_output_callback([&](const uint8_t* d, size_t n) { batcher.push(d, n); });
+
+class OutputBatcher {
+public:
+    OutputBatcher() = default;
+    ~OutputBatcher();
+
+    OutputBatcher(const OutputBatcher&) = delete;
+    OutputBatcher& operator=(const OutputBatcher&) = delete;
+
+    void start(OutputSink& sink);
+    void push(const uint8_t* data, size_t length);
+    void push(const OutputSpan* spans, size_t count);   // Joined into one chunk; never split by another push()
+    void stop();                    // Writes everything pushed so far, then joins the writer
+    bool failed() const { return m_failed.load(); }
+
+private:
+    void writer_loop();
+
+    OutputSink* m_sink = nullptr;
+    std::vector<uint8_t> m_filling;         // Chunks pushed since the last batch, back to back
+    std::vector<size_t> m_filling_ends;     // End offset of each chunk in m_filling
+    bool m_stopping = false;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;           // Writer: work arrived
+    std::condition_variable m_space;        // push(): a batch was taken
+    std::thread m_writer_thread;
+    std::atomic<bool> m_failed{ false };
+};
+
+} // namespace headless_tty
@@ -14,6 +14,11 @@
 #include <memory>
 
 #include "types.hpp"
+#include "command_index.hpp"
+#include "expect.hpp"
+#include "ready.hpp"
+#include "screen.hpp"
+#include "utf8.hpp"
 
 namespace headless_tty {
 
@@ -49,16 +54,42 @@ public:
     bool write(const uint8_t* data, size_t length);
     bool write(const std::string& str);
     void set_output_callback(OutputCallback callback); //callback
+    void set_exit_callback(ExitCallback callback);     // Called on the read thread once output has ended
+    void set_resize_callback(ResizeCallback callback); // Called just before each resize is applied (see resize())
+    void set_resized_callback(ResizedCallback callback);   // Called after each resize is applied or has failed
+    void set_io_mode(IoMode mode);                     // May be changed while reading
+    IoStats get_io_stats() const;
     void start_reading();
     void stop();
     bool is_running() const;
 
+    /*
+     Manual-reset event signaled once the child has exited and all of its output
+     has been delivered. Lets callers block in WaitForMultipleObjects instead of polling is_running().
+     Owned by the ConPTY; valid from initialize() until destruction.
+     */
+    HANDLE exit_event() const { return m_hExitEvent; }
+
+    // GetTickCount64() at the time of the most recent output chunk (0 = none yet)
+    ULONGLONG last_output_tick() const { return m_last_output_tick.load(); }
+
     /*
      Wait for the process to exit @param timeout_ms Timeout in milliseconds (INFINITE for no timeout)
      @return Exit code of the process, or -1 on error
      */
     int wait(DWORD timeout_ms = INFINITE);
-    bool resize(const TerminalSize& size); 
+
+    /*
+     Resize the pseudo console
+     A resize more than PTY_RESIZE_COALESCE_MS after the last one is applied at once. Any
+     that follow sooner only record the size, and a pool timer applies the latest of them
+     when the window ends, so a window being dragged costs ConPTY one redraw per window
+     rather than one per step. The resize callbacks run on whichever thread applies it.
+     Every call ends in one resized callback; calls coalesced together share the one
+     for the size that was applied.
+     @return false if the PTY isn't initialized or an immediate resize failed
+     */
+    bool resize(const TerminalSize& size);
     /*
     Not used in the headless-tty since its
     meant to be headless. 
@@ -76,12 +107,16 @@ public:
 private:
     void cleanup();
     void read_loop();
-    void monitor_loop();
+    void on_process_exit();
+    static VOID CALLBACK process_exit_callback(PVOID context, BOOLEAN timedOut);
+    static VOID CALLBACK resize_timer_callback(PTP_CALLBACK_INSTANCE instance, PVOID context, PTP_TIMER timer);
+    bool apply_resize();
+    bool resize_console(const TerminalSize& size);
     bool create_pipes();
     bool create_pseudo_console(const TerminalSize& size);
     bool initialize_startup_info();
 
-    HPCON m_hPC = nullptr;
+    HPCON m_hPC = nullptr;            // Once running, closed and resized only under m_resize_mutex
     HANDLE m_hPipeIn = nullptr;   // PTY reads from this (our write end)
     HANDLE m_hPipeOut = nullptr;  // PTY writes to this (our read end)
     HANDLE m_hPipePTYIn = nullptr;  // PTY's read end
@@ -89,17 +124,35 @@ private:
     HANDLE m_hProcess = nullptr;
     HANDLE m_hThread = nullptr;
     HANDLE m_hJob = nullptr;
+    HANDLE m_hExitEvent = nullptr;
     PROCESS_INFORMATION m_processInfo = {};
     STARTUPINFOEXW m_startupInfo = {};
     std::unique_ptr<uint8_t[]> m_attributeList;
     std::atomic<bool> m_running{ false };
     std::atomic<bool> m_stop_requested{ false };
+    std::atomic<ULONGLONG> m_last_output_tick{ 0 };
+    std::atomic<IoMode> m_io_mode{ IoMode::Auto };
+    std::atomic<uint64_t> m_stat_bytes{ 0 };
+    std::atomic<uint64_t> m_stat_reads{ 0 };
+    std::atomic<uint64_t> m_stat_callbacks{ 0 };
     std::thread m_read_thread;
-    std::thread m_monitor_thread;
+    HANDLE m_hExitWait = nullptr;     // Thread pool wait on the child process, instead of a thread per session
     mutable std::mutex m_mutex;
 
+    // Resize coalescing
+    std::mutex m_resize_mutex;
+    PTP_TIMER m_resize_timer = nullptr;   // Created on the first resize that has to wait
+    bool m_resize_armed = false;
+    bool m_resize_pending = false;
+    TerminalSize m_size;                  // Last size given to the pseudo console
+    TerminalSize m_pending_size;
+    ULONGLONG m_last_resize_tick = 0;
+
     // Callbacks
     OutputCallback m_output_callback;
+    ExitCallback m_exit_callback;
+    ResizeCallback m_resize_callback;
+    ResizedCallback m_resized_callback;
     mutable std::string m_last_error;
     void set_error(const std::string& msg);
     void set_win_error(const std::string& prefix);
@@ -120,14 +173,87 @@ public:
     bool write(const std::string& input);
     bool write(const uint8_t* data, size_t length);
     void set_output_callback(OutputCallback callback);
+    void set_exit_callback(ExitCallback callback);     // Called on the read thread after the last output
+    bool resize(const TerminalSize& size);             // Coalesced (see ConPTY::resize); resizes the tracked screen too
+    void set_resized_callback(ResizedCallback callback);   // Once a resize is applied or has failed (see ConPTY::resize)
     void stop();
     bool is_running() const;
+    HANDLE exit_event() const;
+    ULONGLONG last_output_tick() const;
+    void set_io_mode(IoMode mode);
+    IoStats get_io_stats() const;
     int wait(DWORD timeout_ms = INFINITE);
     std::string get_last_error() const;
 
+    /*
+     Wait for one of several literal patterns to appear in the output
+     Output that arrived since the previous expect() is searched first, so nothing
+     written between a write() and the following expect() is missed.
+     @param patterns Byte strings to look for; the lowest index wins when several end together
+     @param timeout_ms Timeout in milliseconds (INFINITE for no timeout)
+     @return Matched index and the output consumed, or EXPECT_TIMEOUT / EXPECT_EOF / EXPECT_CANCELLED
+     */
+    ExpectResult expect(const std::vector<std::string>& patterns, DWORD timeout_ms = INFINITE,
+                        const ExpectOptions& options = ExpectOptions());
+    void cancel_expect();   // Any thread; expect() returns EXPECT_CANCELLED until the next start()
+
+    /*
+     Wait until the child is ready for input instead of sleeping a fixed time
+     Nothing is consumed, so it can be mixed freely with expect(). With after_input set
+     (the default) only output that arrived after the last write() counts, so a prompt
+     still on screen from before the write doesn't end the wait early.
+     @param options Conditions; the first that holds ends the wait (see ReadyOptions)
+     @return The condition that held, or ReadyEvent::Timeout / Exited / Invalid
+     */
+    ReadyEvent wait_ready(const ReadyOptions& options, DWORD timeout_ms = INFINITE);
+
+    // Screen tracking (Config::track_screen)
+    void read_screen(const std::function<void(const Screen&)>& reader) const;   // Called with the screen locked
+
+    /*
+     Save the tracked screen to a snapshot file (see snapshot.hpp)
+     @return false if screen tracking is off or the file could not be written
+     */
+    bool save_snapshot(const std::wstring& path, std::string* error = nullptr) const;
+
+    /*
+     Restore the tracked screen from a snapshot
+     Call before start(): the next start() keeps the restored screen (resized to the new
+     config) instead of starting blank, and the new child's output continues on it.
+     */
+    bool load_snapshot(const std::wstring& path, std::string* error = nullptr);
+
+    // Shell-integration command index (Config::index_commands, see CommandIndex)
+    std::string last_command_output() const;                        // Empty if no command has finished
+    bool last_command(CommandRecord& record) const;
+    bool command(uint64_t id, CommandRecord& record) const;         // false once it has aged out
+    bool read_last_command(const CommandIndex::RecordReader& reader) const;    // No copy; called with the index locked
+    bool read_command(uint64_t id, const CommandIndex::RecordReader& reader) const;
+    uint64_t last_command_id() const;
+    std::string shell_cwd() const;                                  // Last OSC 7 directory
+
 private:
+    void on_output(const uint8_t* data, size_t length);
+
     std::unique_ptr<ConPTY> m_pty;
     // Config m_config;  // Unused - kept for potential future use
+
+    // Kept here (not only in ConPTY) so a callback set before start() is not lost
+    OutputCallback m_output_callback;
+    ExitCallback m_exit_callback;
+    ResizedCallback m_resized_callback;
+    mutable std::mutex m_mutex;
+
+    Expecter m_expecter;
+    ReadyWaiter m_ready;
+    CommandIndex m_commands;
+    bool m_index_commands = false;
+    Utf8Stream m_utf8{ Utf8Mode::Raw };     // Config::utf8_mode; only touched on the read thread
+
+    bool m_track_screen = false;
+    bool m_screen_restored = false;
+    Screen m_screen;
+    mutable std::mutex m_screen_mutex;
 };
 
 } // namespace headless_tty
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "types.hpp"
+#include "vt_strip.hpp"
+
+namespace headless_tty {
+
+enum class ReadyEvent : uint8_t {
+    Quiet,          // No output for quiet_ms
+    CursorStable,   // Cursor hasn't moved for cursor_stable_ms
+    Prompt,         // The text before the cursor ends with a prompt
+    Mode,           // One of the requested modes is on
+    Timeout,
+    Exited,         // Output ended first
+    Invalid         // No condition given, or cursor_stable_ms without screen tracking
+};
+
+// Terminal modes an app switches on once it reads keys itself (ReadyOptions::modes)
+enum ReadyMode : uint8_t {
+    READY_BRACKETED_PASTE = 1 << 0,     // DECSET 2004: line editors waiting for input
+    READY_APP_CURSOR_KEYS = 1 << 1,     // DECSET 1: keypad/raw input mode
+    READY_ALT_SCREEN      = 1 << 2      // DECSET 47/1047/1049: full-screen app
+};
+
+// Readiness conditions; whichever holds first ends the wait
+struct ReadyOptions {
+    uint32_t quiet_ms = 0;              // 0 = off
+    uint32_t cursor_stable_ms = 0;      // 0 = off; needs Config::track_screen
+    std::vector<std::string> prompts;   // Matched against text with escapes removed, trailing spaces ignored
+    uint8_t modes = 0;                  // ReadyMode bits
+    bool after_input = true;            // Only count once output has arrived since the last write()
+};
+
+
+// ReadyWaiter - tells when an interactive child is ready for input
+// Fed from the read thread like Expecter, but nothing is consumed: it keeps the time of the
+// last output and cursor move, the tail of the current line and the DEC private modes.
+// wait() sleeps until the earliest moment a timed condition could hold and is woken by
+// output in between, so it returns as soon as the child is ready instead of after a
+// fixed sleep.
+
+class ReadyWaiter {
+public:
+    ReadyWaiter();
+
+    void feed(const uint8_t* data, size_t length);
+    void note_cursor(uint16_t x, uint16_t y);   // After each chunk when the screen is tracked
+    void mark_input();                          // Before each write()
+    void close();                               // Output ended
+    void reset();
+
+    /*
+     Wait until the child is ready
+     @param timeout_ms Milliseconds to wait (0xFFFFFFFF waits forever)
+     @return The condition that held, or Timeout / Exited / Invalid
+     */
+    ReadyEvent wait(const ReadyOptions& options, uint32_t timeout_ms);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // Caller holds m_mutex
+    bool check(const ReadyOptions& options, const std::vector<std::string>& prompts, Clock::time_point now,
+               ReadyEvent& event) const;
+    void scan_mode(uint8_t c);
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    int m_waiting = 0;
+    bool m_closed = false;
+
+    Clock::time_point m_last_output;
+    Clock::time_point m_last_cursor_move;
+    bool m_output_since_input = false;
+    bool m_cursor_known = false;
+    uint16_t m_cursor_x = 0;
+    uint16_t m_cursor_y = 0;
+
+    EscapeStripper m_stripper;
+    std::string m_tail;                 // Current line so far, at most READY_TAIL_BYTES
+
+    // DEC private mode scanner: ESC [ ? Pn ; ... h/l
+    uint8_t m_scan = 0;
+    uint32_t m_param = 0;
+    uint8_t m_pending = 0;             // Modes named by the parameters so far
+    uint8_t m_modes = 0;
+};
+
+} // namespace headless_tty
@@ -0,0 +1,354 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <scoped_allocator>
+#include <unordered_map>
+
+#include "types.hpp"
+#include "arena.hpp"
+#include "unicode.hpp"
+
+namespace headless_tty {
+
+// Cell colors: COLOR_DEFAULT, COLOR_INDEXED | index (0-255) or COLOR_RGB | 0xRRGGBB
+constexpr uint32_t COLOR_DEFAULT = 0;
+constexpr uint32_t COLOR_INDEXED = 0x01000000;
+constexpr uint32_t COLOR_RGB     = 0x02000000;
+
+// Cell attribute bits
+enum CellAttr : uint16_t {
+    ATTR_BOLD      = 1 << 0,
+    ATTR_DIM       = 1 << 1,
+    ATTR_ITALIC    = 1 << 2,
+    ATTR_UNDERLINE = 1 << 3,
+    ATTR_BLINK     = 1 << 4,
+    ATTR_INVERSE   = 1 << 5,
+    ATTR_HIDDEN    = 1 << 6,
+    ATTR_STRIKE    = 1 << 7
+};
+
+struct Cell {
+    char32_t ch = U' ';     // Codepoint, or CELL_CLUSTER | offset for a longer grapheme cluster
+    uint32_t fg = COLOR_DEFAULT;
+    uint32_t bg = COLOR_DEFAULT;
+    uint16_t attrs = 0;
+    uint8_t width = 1;      // 2 = first half of a wide character, 0 = its second half
+    uint8_t reserved = 0;   // Keeps the layout free of padding; snapshots copy cells verbatim
+};
+
+// A cell whose grapheme cluster has more than one codepoint (combining marks, emoji ZWJ
+// sequences, flags) keeps the codepoints in a pool: the Screen's, or ScreenFrame::clusters.
+// ch is then CELL_CLUSTER | offset, and the pool holds the count followed by the codepoints.
+constexpr char32_t CELL_CLUSTER = 0x80000000;
+
+/*
+ Codepoints shown in a cell
+ @param pool Cluster pool the cell belongs to
+ @return ch alone, or the cluster; U+FFFD if the offset doesn't fit the pool
+ */
+std::u32string_view cell_codepoints(const Cell& cell, const std::u32string& pool);
+
+using CellVector = std::vector<Cell, ArenaAllocator<Cell>>;
+
+constexpr uint64_t SCREEN_NO_LINE = UINT64_MAX;    // Row not marked, or its line is gone
+
+// Lines take the allocator of the container they are stored in, so a Screen's rows and
+// scrollback all live in its arena
+struct Line {
+    using allocator_type = ArenaAllocator<Cell>;
+
+    CellVector cells;
+    bool wrapped = false;   // Text continues on the next line (auto-wrap, not a newline)
+
+    Line() = default;
+    explicit Line(const allocator_type& alloc) : cells(alloc) {}
+    Line(const Line& other) = default;
+    Line(Line&& other) noexcept = default;
+    Line(const Line& other, const allocator_type& alloc) : cells(other.cells, alloc), wrapped(other.wrapped) {}
+    Line(Line&& other, const allocator_type& alloc) : cells(std::move(other.cells), alloc), wrapped(other.wrapped) {}
+    Line& operator=(const Line& other) = default;
+    Line& operator=(Line&& other) noexcept = default;
+};
+
+using LineAllocator = std::scoped_allocator_adaptor<ArenaAllocator<Line>>;
+using LineVector = std::vector<Line, LineAllocator>;
+using LineDeque = std::deque<Line, LineAllocator>;
+
+// Terminal modes that consumers care about
+struct ScreenModes {
+    bool cursor_visible = true;
+    bool auto_wrap = true;
+    bool alt_screen = false;
+    bool bracketed_paste = false;
+    bool app_cursor_keys = false;
+};
+
+// Copy of the visible screen, cheap to hand to another thread
+struct ScreenFrame {
+    uint64_t seq = 0;                   // Screen::seq() at the time of the copy
+    TerminalSize size;
+    std::vector<Cell> cells;            // rows * cols, row-major
+    std::u32string clusters;            // Pool for cells holding CELL_CLUSTER, only what they use
+    uint16_t cursor_x = 0;
+    uint16_t cursor_y = 0;
+    ScreenModes modes;
+};
+
+
+namespace detail {
+
+// ScreenData - Screen's members, in a base so that Screen's move operations can run the
+// member-wise move and then detach the moved-from screen from the arena that went with it
+
+struct ScreenData {
+    ScreenData(TerminalSize size, size_t scrollback_lines, bool use_arena);
+
+    enum class State : uint8_t {
+        Ground,
+        Escape,
+        EscapeIntermediate,
+        Csi,
+        Osc,
+        OscEscape,
+        String,         // DCS, SOS, PM, APC - ignored up to ST
+        StringEscape
+    };
+
+    struct Cursor {
+        uint16_t x = 0;
+        uint16_t y = 0;
+        uint32_t fg = COLOR_DEFAULT;
+        uint32_t bg = COLOR_DEFAULT;
+        uint16_t attrs = 0;
+    };
+
+    // Owning reference to the arena. Copy assignment keeps the destination's arena (the
+    // containers copy their elements into it); a move takes the arena with the containers.
+    struct ArenaRef {
+        std::shared_ptr<SessionArena> arena;
+
+        ArenaRef() = default;
+        explicit ArenaRef(std::shared_ptr<SessionArena> a) : arena(std::move(a)) {}
+        ArenaRef(const ArenaRef&) = delete;
+        ArenaRef(ArenaRef&&) noexcept = default;
+        ArenaRef& operator=(const ArenaRef&) { return *this; }
+        ArenaRef& operator=(ArenaRef&&) noexcept = default;
+    };
+
+    LineAllocator line_allocator() const { return LineAllocator(ArenaAllocator<Line>(m_arena.arena.get())); }
+
+    // First member, so it exists before the containers that allocate from it
+    ArenaRef m_arena;
+
+    TerminalSize m_size;
+    size_t m_scrollback_limit;
+    LineVector m_lines;
+    LineVector m_saved_lines;           // Main screen while the alternate screen is active
+
+    // Scrollback is re-wrapped lazily: m_layout records the width each stretch of it was
+    // laid out at (oldest first) until reflow_scrollback() brings it all to m_size.cols
+    struct LayoutRun {
+        uint16_t cols;
+        size_t lines;
+    };
+    mutable LineDeque m_scrollback;
+    mutable std::vector<LayoutRun> m_layout;
+    mutable uint64_t m_scrollback_base = 0;
+    uint64_t m_rows_scrolled = 0;       // Rows pushed into scrollback since reset(), never re-wrapped
+
+    // Marked output rows and the current number of their line, renumbered by every re-wrap
+    struct RowMark {
+        uint64_t row;
+        uint64_t line;
+    };
+    mutable std::deque<RowMark> m_row_marks;
+
+    uint16_t m_cursor_x = 0;
+    uint16_t m_cursor_y = 0;
+    bool m_wrap_pending = false;
+    uint32_t m_fg = COLOR_DEFAULT;
+    uint32_t m_bg = COLOR_DEFAULT;
+    uint16_t m_attrs = 0;
+    Cursor m_saved_cursor;
+    uint16_t m_scroll_top = 0;
+    uint16_t m_scroll_bottom = 0;
+    ScreenModes m_modes;
+    std::string m_title;
+    uint64_t m_seq = 0;
+
+    // Parser
+    State m_state = State::Ground;
+    std::vector<int> m_params;
+    bool m_param_started = false;
+    uint8_t m_private = 0;          // '?', '>', '<' or '=' after CSI
+    uint8_t m_intermediate = 0;
+    std::string m_osc;
+
+    // UTF-8 decoder
+    char32_t m_codepoint = 0;
+    uint8_t m_utf8_remaining = 0;
+
+    // Grapheme clustering of printed text; any control or escape sequence ends the cluster
+    GraphemeSegmenter m_segmenter;
+    bool m_cluster_open = false;
+    std::u32string m_cluster;               // Codepoints of the open cluster
+    uint16_t m_cluster_x = 0;               // Its cell
+    uint16_t m_cluster_y = 0;
+    bool m_cluster_fresh = false;           // Its pool entry is the last one and used by no other cell
+    bool m_cluster_pictograph = false;      // Starts with a one-column pictograph VS16 hasn't widened yet
+
+    // Clusters of more than one codepoint, each stored once; see CELL_CLUSTER
+    std::u32string m_clusters;
+    std::unordered_map<std::u32string, uint32_t> m_cluster_index;
+    uint64_t m_cluster_retry_row = 0;       // Pool was full of live clusters; don't reclaim before this row
+
+    // The arena again, as the last member: a move assignment replaces m_arena first, and
+    // this keeps the old arena alive until the containers in between have given their
+    // memory back to it. Destruction runs the other way, so the arena goes last either way.
+    ArenaRef m_arena_keep;
+};
+
+} // namespace detail
+
+
+// Screen - VT parser and cell grid fed with raw PTY output
+// Understands the subset of xterm that ConPTY emits: cursor movement, erase,
+// insert/delete, scroll regions, SGR (16/256/true color), alternate screen
+// and the DEC private modes listed in ScreenModes. Unknown sequences are
+// consumed and ignored. Not thread-safe; callers serialize feed() and reads.
+// Rows and scrollback are allocated from the screen's own SessionArena, so a busy
+// session doesn't scatter thousands of lines over the global heap and destroying it
+// returns a few blocks instead of every line.
+
+class Screen : private detail::ScreenData {
+public:
+    /*
+     @param use_arena false allocates lines from the global heap (for comparison)
+     */
+    explicit Screen(TerminalSize size = TerminalSize(), size_t scrollback_lines = SCREEN_SCROLLBACK_LINES,
+                    bool use_arena = true);
+
+    Screen(const Screen& other);                    // The copy gets an arena of its own
+    Screen& operator=(const Screen&) = default;     // Copied into this screen's arena
+
+    // Moves take the other screen's arena. The moved-from screen is left empty, on the heap,
+    // and can only be assigned to or destroyed.
+    Screen(Screen&& other) noexcept;
+    Screen& operator=(Screen&& other) noexcept;
+
+    void feed(const uint8_t* data, size_t length);
+
+    /*
+     Change the grid size
+     On the main screen a column change re-wraps soft-wrapped lines to the new width. Only the
+     visible lines are re-wrapped here; scrollback is re-wrapped the next time it is read, so
+     the cost doesn't grow with the history.
+     */
+    void resize(TerminalSize size);
+    void reset();
+    void set_scrollback_limit(size_t lines);    // Drops the oldest lines if over the new limit
+
+    TerminalSize size() const { return m_size; }
+    const Cell& cell(uint16_t x, uint16_t y) const { return m_lines[y].cells[x]; }
+    const Line& line(uint16_t y) const { return m_lines[y]; }
+    const LineDeque& scrollback() const;            // Oldest first, trailing blanks trimmed
+
+    // Lines are numbered from the first one ever scrolled into history, so a number keeps
+    // pointing at the same line as history grows; scrollback()[n - scrollback_base()] is
+    // line n. A width change re-wraps history and renumbers it.
+    uint64_t scrollback_base() const;               // Lines dropped over the scrollback limit
+    uint64_t cursor_line() const;                   // Number of the cursor's line
+
+    // The cursor's row counted as output was written: rows scrolled into history plus
+    // cursor_y(). Never renumbered, so it is cheap to read after a width change (where
+    // cursor_line() re-wraps history first); until the first width change it equals cursor_line().
+    uint64_t cursor_output_row() const { return m_rows_scrolled + m_cursor_y; }
+
+    // A marked row's line is followed through the re-wraps of a width change, so
+    // output_row_line() turns the row into the line's current number without re-wrapping
+    // anything at mark time. The last SCREEN_ROW_MARKS marks are kept; reset() and
+    // load_state() drop them.
+    uint64_t mark_output_row();                         // Marks the cursor's line; returns cursor_output_row()
+    uint64_t output_row_line(uint64_t row) const;       // Current number of a marked row's line, or SCREEN_NO_LINE
+    uint16_t cursor_x() const { return m_cursor_x; }
+    uint16_t cursor_y() const { return m_cursor_y; }
+    const ScreenModes& modes() const { return m_modes; }
+    const std::string& title() const { return m_title; }
+
+    // Codepoints of a cell from this screen's grid or scrollback
+    std::u32string_view codepoints(const Cell& cell) const { return cell_codepoints(cell, m_clusters); }
+
+    // Changes with every feed(), resize() and reset()
+    uint64_t seq() const { return m_seq; }
+
+    /*
+     Copy the visible screen into frame, reusing its storage
+     @param frame Destination; cells is only reallocated when the size changed
+     */
+    void snapshot(ScreenFrame& frame) const;
+
+    // Visible text of one row as UTF-8, trailing blanks removed
+    std::string line_text(uint16_t y) const;
+
+    /*
+     Size of the serialized state (grid, scrollback, alternate screen, modes, cursor, title)
+     @return Bytes save_state() will write
+     */
+    size_t state_size() const;
+    void save_state(uint8_t* out) const;
+
+    /*
+     Replace this screen with a state written by save_state()
+     @param data Serialized state, e.g. a mapped snapshot file
+     @param length Number of bytes available
+     Scrollback beyond this screen's limit is dropped, oldest first.
+     @return false (screen unchanged) if the data is truncated, inconsistent or another format version
+     */
+    bool load_state(const uint8_t* data, size_t length);
+
+    /*
+     Compare everything that decides what the grid shows and how further output is drawn:
+     cells, cursor, attributes, modes, scroll region and parser state
+     Scrollback and title are not compared.
+     @return true if feeding both screens the same bytes gives the same grids
+     */
+    bool same_live_state(const Screen& other) const;
+
+    ArenaStats arena_stats() const;     // Zeros without an arena
+
+private:
+    void advance(uint8_t c);
+    void put_char(char32_t ch);
+    void place_char(char32_t ch, int width);
+    void extend_cluster(char32_t cp);
+    char32_t intern_cluster(const std::u32string& cluster);
+    void reclaim_clusters();
+    void execute(uint8_t c);
+    void esc_dispatch(uint8_t final);
+    void csi_dispatch(uint8_t final);
+    void osc_dispatch();
+    void set_mode(int mode, bool enable);
+    void select_graphic_rendition();
+
+    void line_feed();
+    void scroll_up(uint16_t top, uint16_t bottom, uint16_t count, bool to_scrollback);
+    void scroll_down(uint16_t top, uint16_t bottom, uint16_t count);
+    void erase_cells(Line& line, uint16_t from, uint16_t to);
+    void set_alt_screen(bool enable);
+    void push_scrollback(const Line& line);
+    void pop_scrollback();
+    void reflow_lines(TerminalSize size);
+    void reflow_scrollback() const;
+    void clear_line(Line& line) const;
+    Line blank_line() const;
+    void detach_arena();
+    int param(size_t index, int fallback) const;
+};
+
+} // namespace headless_tty
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "pty.hpp"
+
+#include <condition_variable>
+#include <deque>
+
+namespace headless_tty {
+
+struct PoolOptions {
+    size_t warm = POOL_WARM_SESSIONS;           // Sessions kept started and ready
+    std::string entry;                          // Written to a session as it is handed out (may be empty)
+    ReadyOptions ready;                         // When a new session counts as warm (default: quiet POOL_QUIET_MS)
+    uint32_t warm_timeout_ms = POOL_WARM_TIMEOUT_MS;
+
+    PoolOptions() { ready.quiet_ms = POOL_QUIET_MS; }
+};
+
+struct PoolStats {
+    uint64_t started = 0;           // Sessions spawned by the pool
+    uint64_t handed_out = 0;
+    uint64_t waited = 0;            // acquire() calls that found no warm session
+    uint64_t discarded = 0;         // Never got ready, or exited while waiting
+    size_t warm = 0;                // Ready right now
+};
+
+
+// SessionPool - sessions started ahead of time, so handing one out skips the child's startup
+// A filler thread keeps options.warm sessions of the same Config started and waited on with
+// wait_ready(), so the interpreter or runtime is already loaded when acquire() hands one
+// out. acquire() then only writes options.entry, which runs the actual entry point, and a
+// replacement starts warming in the background.
+//
+// Windows has no fork(), so each session is still a full CreateProcess; the pool moves that
+// cost off the path of the caller instead of sharing one loaded image. The template
+// command preloads what it can and waits for the entry line:
+//
+//     config.command = L"python.exe";
+//     config.args = L"-u -q -i -c \"import numpy, mylib\"";     // Heavy imports up front
+//     options.entry = "exec(open('main.py').read())\r";
+//
+//     config.command = L"node.exe";
+//     config.args = L"-i -r ./preload.js";
+//     options.entry = "require('./server.js')\r";
+//
+// Output from before the hand-out (a banner, the REPL prompt) isn't passed on; the entry
+// line itself is echoed like any other input.
+
+class SessionPool {
+public:
+    SessionPool() = default;
+    ~SessionPool();
+
+    SessionPool(const SessionPool&) = delete;
+    SessionPool& operator=(const SessionPool&) = delete;
+
+    /*
+     Start warming sessions in the background
+     @return false if the pool is already running
+     */
+    bool start(const Config& config, const PoolOptions& options);
+
+    /*
+     Hand out a warm session, or wait for one
+     @param output Set as the session's output callback before the entry is written
+     @param timeout_ms How long to wait when no session is warm
+     @return null on timeout, after stop(), or when the last start failed (see get_last_error)
+     */
+    std::unique_ptr<HeadlessTTY> acquire(OutputCallback output = nullptr, DWORD timeout_ms = INFINITE);
+
+    void stop();        // Stops the warm sessions; sessions already handed out are not affected
+    PoolStats get_stats() const;
+    std::string get_last_error() const;
+
+private:
+    void filler_loop();
+
+    Config m_config;
+    PoolOptions m_options;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_refill;       // Filler: a session was taken, or stopping
+    std::condition_variable m_available;    // acquire(): a session is warm, a start failed, or stopping
+    std::deque<std::unique_ptr<HeadlessTTY>> m_ready;
+    HeadlessTTY* m_warming = nullptr;       // Being waited on by the filler; stop() ends the wait
+    bool m_stopping = false;
+    bool m_start_failed = false;
+    PoolStats m_stats;
+    std::string m_last_error;
+    std::thread m_filler;
+};
+
+} // namespace headless_tty
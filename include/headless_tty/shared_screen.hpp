@@ -0,0 +1,120 @@
+#pragma once
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <windows.h>
+#include <atomic>
+#include <string>
+
+#include "screen.hpp"
+
+namespace headless_tty {
+
+constexpr uint32_t SHARED_SCREEN_VERSION = 2;
+constexpr uint32_t SHARED_SCREEN_DEFAULT_FPS = 60;  // Publish rate when no frame rate is given
+
+// Mode bits in SharedScreenHeader::flags
+constexpr uint32_t SHARED_CURSOR_VISIBLE  = 1 << 0;
+constexpr uint32_t SHARED_AUTO_WRAP       = 1 << 1;
+constexpr uint32_t SHARED_ALT_SCREEN      = 1 << 2;
+constexpr uint32_t SHARED_BRACKETED_PASTE = 1 << 3;
+constexpr uint32_t SHARED_APP_CURSOR_KEYS = 1 << 4;
+
+// Start of the shared region; rows * cols Cells (row-major, stride cols) follow at header_size,
+// and the cluster pool for cells holding CELL_CLUSTER after max_rows * max_cols Cells.
+// Seqlock: sequence is odd while the writer is updating. A reader copies what it needs and
+// accepts the copy only if sequence was even and unchanged before and after.
+struct SharedScreenHeader {
+    char magic[8];                      // "HTTYSHM1"
+    uint32_t version;                   // SHARED_SCREEN_VERSION
+    uint32_t header_size;               // Offset of the cells
+    uint32_t cell_size;                 // sizeof(Cell)
+    uint16_t max_cols;                  // Capacity of the region
+    uint16_t max_rows;
+    std::atomic<uint32_t> sequence;
+    uint32_t flags;                     // SHARED_* mode bits
+    uint16_t cols;
+    uint16_t rows;
+    uint16_t cursor_x;
+    uint16_t cursor_y;
+    uint64_t frame;                     // Screen::seq() of the published state
+    uint32_t writer_pid;
+    uint32_t exited;                    // Non-zero once the session has ended
+    uint32_t cluster_capacity;          // Codepoints the pool can hold (max_rows * max_cols)
+    uint32_t cluster_length;            // Codepoints of the published pool
+};
+
+static_assert(sizeof(SharedScreenHeader) == 64, "shared screen header layout is fixed");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "sequence must be lock free across processes");
+
+
+// SharedScreenWriter - publishes screen frames into a named file mapping
+// Meant to be driven by a FrameViewer so publishing cost follows the frame rate.
+
+class SharedScreenWriter {
+public:
+    SharedScreenWriter() = default;
+    ~SharedScreenWriter();
+
+    SharedScreenWriter(const SharedScreenWriter&) = delete;
+    SharedScreenWriter& operator=(const SharedScreenWriter&) = delete;
+
+    /*
+     Create the named mapping
+     @param name Mapping name, e.g. L"Local\\my-session"
+     @param max_size Largest screen the region can hold; bigger frames are clipped
+     @return true if the mapping was created
+     */
+    bool create(const std::wstring& name, TerminalSize max_size);
+    void publish(const ScreenFrame& frame);
+    void mark_exited();
+    void close();
+    std::string get_last_error() const { return m_last_error; }
+
+private:
+    HANDLE m_hMapping = nullptr;
+    SharedScreenHeader* m_header = nullptr;
+    Cell* m_cells = nullptr;
+    char32_t* m_clusters = nullptr;
+    std::string m_last_error;
+};
+
+
+// SharedScreenReader - consistent snapshots of a published screen, no syscalls per read
+
+class SharedScreenReader {
+public:
+    SharedScreenReader() = default;
+    ~SharedScreenReader();
+
+    SharedScreenReader(const SharedScreenReader&) = delete;
+    SharedScreenReader& operator=(const SharedScreenReader&) = delete;
+
+    bool open(const std::wstring& name);
+    void close();
+    bool is_open() const { return m_header != nullptr; }
+
+    /*
+     Copy the current screen
+     @param frame Destination; storage is reused between calls
+     @param max_retries Attempts before giving up while the writer is mid-update
+     @return true if frame holds a consistent screen
+     */
+    bool read(ScreenFrame& frame, uint32_t max_retries = 1000) const;
+
+    // Frame counter of the published state; compare with ScreenFrame::seq to skip unchanged reads
+    uint64_t frame_seq() const;
+    bool writer_exited() const;
+    std::string get_last_error() const { return m_last_error; }
+
+private:
+    HANDLE m_hMapping = nullptr;
+    const SharedScreenHeader* m_header = nullptr;
+    const Cell* m_cells = nullptr;
+    const char32_t* m_clusters = nullptr;
+    std::string m_last_error;
+};
+
+} // namespace headless_tty
@@ -0,0 +1,35 @@
+#pragma once
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <windows.h>
+#include <string>
+
+#include "screen.hpp"
+
+namespace headless_tty {
+
+/*
+ Write a screen snapshot (grid, scrollback, modes, cursor, title) to a file
+ The state is serialized straight into a mapping of a temporary file, which then replaces
+ path, so a crash mid-write never leaves a truncated snapshot behind.
+ @param screen Screen to save
+ @param path Destination file
+ @param error Receives a description on failure (may be null)
+ @return true if the snapshot was written
+ */
+bool save_snapshot(const Screen& screen, const std::wstring& path, std::string* error = nullptr);
+
+/*
+ Restore a screen from a snapshot file
+ The file is mapped read-only and each line is copied out of the view, no output is replayed.
+ @param screen Replaced on success, unchanged on failure
+ @param path Snapshot written by save_snapshot()
+ @param error Receives a description on failure (may be null)
+ @return true if the snapshot was valid and loaded
+ */
+bool load_snapshot(Screen& screen, const std::wstring& path, std::string* error = nullptr);
+
+} // namespace headless_tty
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "pty.hpp"
+#include "log_sink.hpp"
+
+#include <memory>
+
+namespace headless_tty {
+
+enum class RestartPolicy : uint8_t {
+    Never,
+    Always,       // Restart after every exit
+    OnFailure,    // Restart after a non-zero exit code (or a failed start)
+    Backoff       // Restart after every exit, doubling the delay up to max_restart_delay_ms
+};
+
+struct SupervisorEntry {
+    std::string name;
+    Config config;
+    std::wstring log_path;          // Separate log sink; empty = multiplexed output
+    std::string prefix;             // Prefix of each multiplexed line (default "[name] ")
+    bool plain = false;             // Strip escape sequences from this entry's output
+    RestartPolicy restart = RestartPolicy::Never;
+    uint32_t restart_delay_ms = SUPERVISOR_RESTART_DELAY_MS;
+    uint32_t max_restart_delay_ms = SUPERVISOR_MAX_RESTART_DELAY_MS;
+    uint32_t max_failed_starts = SUPERVISOR_MAX_FAILED_STARTS;     // 0 = keep trying
+};
+
+
+// Manifest - one [name] section per child
+//
+//   # comment
+//   [server]
+//   command = node server.js       command line (required)
+//   cwd = C:\srv
+//   size = 120x40
+//   io-mode = latency|throughput|auto
+//   log = C:\logs\server.log       own rotating log instead of the multiplexed output
+//   prefix = srv>                  multiplexed line prefix (default "[server] ", empty for none)
+//   plain = yes|no                 strip escape sequences
+//   restart = never|always|on-failure|backoff
+//   restart-delay = 1000           ms before a restart (first delay for backoff)
+//   max-restart-delay = 60000      backoff ceiling; a run this long resets the delay
+//   max-failed-starts = 10         failed starts in a row before giving up (0 = never)
+//
+// A start that fails is retried no sooner than SUPERVISOR_FAILED_START_DELAY_MS, doubled
+// for each failure in a row up to max-restart-delay, whatever restart-delay says.
+
+/*
+ Parse a manifest
+ @param defaults Values for keys an entry doesn't set
+ @param error Receives "line N: ..." on failure (may be null)
+ */
+bool parse_manifest(const std::string& text, const SupervisorEntry& defaults,
+                    std::vector<SupervisorEntry>& entries, std::string* error = nullptr);
+bool load_manifest(const std::wstring& path, const SupervisorEntry& defaults,
+                   std::vector<SupervisorEntry>& entries, std::string* error = nullptr);
+
+
+// Supervisor - hosts many sessions from one event loop
+// Exits and restart timers are handled by whichever thread calls dispatch(); read threads
+// only deliver output and signal wake_event(). Multiplexed output is passed on a whole
+// line at a time so lines of different entries never interleave; a line longer than
+// SUPERVISOR_LINE_LIMIT is split. A partial line is held until its newline arrives or
+// the child exits.
+//
+//     supervisor.start(entries, LogOptions(), output);
+//     while (!supervisor.finished()) {
+//         WaitForSingleObject(supervisor.wake_event(), supervisor.dispatch());
+//     }
+
+class Supervisor {
+public:
+    Supervisor();
+    ~Supervisor();
+
+    Supervisor(const Supervisor&) = delete;
+    Supervisor& operator=(const Supervisor&) = delete;
+
+    /*
+     Open the entries' log sinks and start every child
+     A child that fails to start is handled by its restart policy like one that exited.
+     @param log_options Rotation options for entries with their own log
+     @param output Receives the multiplexed output and supervisor messages (any thread, serialized)
+     @return false if an entry's log could not be opened
+     */
+    bool start(const std::vector<SupervisorEntry>& entries, const LogOptions& log_options, OutputCallback output);
+
+    /*
+     Reap exited children and start those whose restart delay has passed
+     @return Milliseconds until the next restart is due, INFINITE if none
+     */
+    DWORD dispatch();
+
+    HANDLE wake_event() const { return m_hWake; }    // Signaled when a child's output has ended
+    bool finished() const;                          // Nothing running and no restart pending
+    void stop();                                    // Stops every child; no more restarts
+    int exit_code() const;                          // 0 if every entry's last exit code was 0
+    std::string get_last_error() const { return m_last_error; }
+
+private:
+    struct Session;
+
+    void launch(Session& session, ULONGLONG now);
+    void finish(Session& session, int code, ULONGLONG now, ULONGLONG uptime);
+    void on_output(Session& session, const uint8_t* data, size_t length);
+    void flush_line(Session& session);
+    void emit(const std::string& text);
+    void message(const Session& session, const std::string& text);
+
+    std::vector<std::unique_ptr<Session>> m_sessions;
+    OutputCallback m_output;
+    std::mutex m_output_mutex;
+
+    HANDLE m_hWake = nullptr;
+    std::mutex m_mutex;
+    std::vector<size_t> m_exited;       // Sessions whose output ended, for dispatch()
+    bool m_stopping = false;
+    std::string m_last_error;
+};
+
+} // namespace headless_tty
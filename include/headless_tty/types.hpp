@@ -9,8 +9,68 @@
 namespace headless_tty {
 
 // Buffer sizes
-constexpr size_t PTY_BUFFER_SIZE = 8192;
+constexpr size_t PTY_BUFFER_SIZE = 8192;            // Initial read buffer
+constexpr size_t PTY_MAX_BUFFER_SIZE = 256 * 1024;  // Read buffer ceiling in throughput mode
+constexpr uint32_t PTY_COALESCE_WINDOW_US = 500;    // Throughput mode: wait this long for more output before delivering (timer granularity)
+constexpr size_t PTY_AUTO_THROUGHPUT_BYTES = 4096;  // Auto mode: average read size that switches to throughput
+constexpr uint32_t PTY_RESIZE_COALESCE_MS = 30;     // Resizes closer together than this collapse into one
 constexpr size_t INPUT_BUFFER_SIZE = 4096;
+constexpr size_t OUTPUT_BATCH_MAX_BYTES = 4 * 1024 * 1024;   // Output an OutputBatcher holds before push() waits
+constexpr size_t FRAME_HEADER_SIZE = 4;             // --framed: type (8 bits) and payload length (24 bits), little endian
+constexpr size_t FRAME_MAX_PAYLOAD = 0xFFFFFF;      // Longer output is split over several frames
+constexpr uint8_t FRAME_PROTOCOL_VERSION = 1;
+constexpr size_t LOG_BUFFER_SIZE = 1024 * 1024;   // Per-buffer size of the log sink (page aligned)
+constexpr size_t LOG_BUFFER_COUNT = 8;           // Buffers in flight before log output is dropped
+constexpr size_t INPUT_FILE_CHUNK_SIZE = 64 * 1024;            // Largest single write of --input-file data
+constexpr size_t INPUT_FILE_WINDOW_SIZE = 64 * 1024 * 1024;    // Mapped view size (multiple of 64 KB granularity)
+constexpr size_t EXPECT_WINDOW_SIZE = 64 * 1024;   // Unconsumed output retained for the next expect()
+constexpr size_t READY_TAIL_BYTES = 256;           // Text before the cursor kept for wait_ready() prompt matching
+constexpr size_t SCREEN_SCROLLBACK_LINES = 1000;    // Lines kept above the visible screen
+constexpr size_t SCREEN_OSC_MAX = 4096;            // Longest OSC string kept (title, cwd, ...)
+constexpr size_t SCREEN_CLUSTER_MAX = 32;           // Codepoints kept of one grapheme cluster
+constexpr size_t SCREEN_CLUSTER_POOL = 64 * 1024;   // Codepoints of clusters a Screen keeps before reclaiming
+constexpr size_t SCREEN_ROW_MARKS = 4096;           // Rows marked with Screen::mark_output_row() that are followed
+constexpr size_t ARENA_BLOCK_SIZE = 64 * 1024;      // Blocks a SessionArena takes from the heap
+constexpr size_t ARENA_MAX_POOLED = 16 * 1024;      // Largest request served from a SessionArena block
+constexpr size_t COMMAND_INDEX_SIZE = 1000;         // Commands kept by the shell-integration index
+constexpr size_t COMMAND_OUTPUT_LIMIT = 1024 * 1024;   // Output kept per indexed command (the end of it)
+constexpr size_t SUPERVISOR_LINE_LIMIT = 4096;                // Longest multiplexed line before it is split
+constexpr uint32_t SUPERVISOR_RESTART_DELAY_MS = 1000;        // Default delay before restarting a child
+constexpr uint32_t SUPERVISOR_MAX_RESTART_DELAY_MS = 60000;   // Default backoff ceiling
+constexpr uint32_t SUPERVISOR_FAILED_START_DELAY_MS = 250;    // Least delay after a failed start, doubled per failure
+constexpr uint32_t SUPERVISOR_MAX_FAILED_STARTS = 10;         // Default failed starts in a row before giving up
+constexpr size_t POOL_WARM_SESSIONS = 2;                    // Sessions a SessionPool keeps ready by default
+constexpr uint32_t POOL_WARM_TIMEOUT_MS = 30000;            // A pooled session not ready by then is discarded
+constexpr uint32_t POOL_QUIET_MS = 100;                     // Default readiness: output quiet this long
+constexpr uint32_t POOL_RETRY_DELAY_MS = 1000;              // Pause after a pooled session fails to start
+constexpr size_t LATENCY_BUCKETS = 11;             // Histogram buckets of --measure-latency (250us doubling)
+constexpr size_t COMPACT_MAX_OPEN_LINES = 256;      // Lines a cursor-up can still rewrite before they are emitted
+constexpr size_t COMPACT_LINE_LIMIT = 16384;        // Columns kept per line; text beyond is dropped
+constexpr size_t CONVERT_SEGMENT_BYTES = 8 * 1024 * 1024;   // Capture bytes per parallel segment of --convert
+constexpr size_t CONVERT_WARMUP_BYTES = 256 * 1024;        // Bytes replayed before a segment to rebuild parser state
+constexpr size_t CONVERT_CAST_EVENT_BYTES = 4096;          // Largest asciicast output event
+constexpr uint32_t CONVERT_CAST_BYTES_PER_SECOND = 65536;  // Synthetic asciicast clock (captures carry no timing)
+
+// Output delivery strategy of the read thread
+enum class IoMode : uint8_t {
+    Latency,      // Deliver every read immediately, never coalesce
+    Throughput,   // Grow the buffer with burst size and coalesce reads within PTY_COALESCE_WINDOW_US
+    Auto          // Switch between the two based on recent read sizes
+};
+
+// How output callbacks treat UTF-8 split across reads
+enum class Utf8Mode : uint8_t {
+    Raw,          // Deliver reads as they arrive; a codepoint may be split between callbacks
+    Whole,        // Hold back a trailing partial codepoint until the rest arrives
+    Repair        // Whole, and replace ill-formed sequences with U+FFFD
+};
+
+// Read path counters
+struct IoStats {
+    uint64_t bytes = 0;       // Bytes read from the PTY
+    uint64_t reads = 0;       // ReadFile calls that returned data
+    uint64_t callbacks = 0;   // Output callback invocations
+};
 
 // Terminal dimensions
 struct TerminalSize {
@@ -24,9 +84,23 @@ struct Config {
     std::wstring command = L"notepad.exe";
     std::wstring args = L"";
     std::wstring working_dir = L"";
+    IoMode io_mode = IoMode::Auto;
+    Utf8Mode utf8_mode = Utf8Mode::Raw;                 // Applies to the output callback only
+    bool track_screen = false;                          // Keep a Screen model of the output (needed for snapshots)
+    size_t scrollback_lines = SCREEN_SCROLLBACK_LINES;  // Scrollback of the tracked screen
+    bool index_commands = false;                        // Index OSC 133 command marks (see CommandIndex)
 };
 
 // Callback for PTY output
 using OutputCallback = std::function<void(const uint8_t*, size_t)>;
 
+// Callback when the PTY output stream has ended (child exited and output drained)
+using ExitCallback = std::function<void()>;
+
+// Callback with the size a PTY is about to be resized to
+using ResizeCallback = std::function<void(const TerminalSize&)>;
+
+// Callback once a resize has reached the pseudo console (applied) or failed
+using ResizedCallback = std::function<void(const TerminalSize& size, bool applied)>;
+
 }
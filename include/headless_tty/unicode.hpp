@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace headless_tty {
+
+// Grapheme_Cluster_Break property (UAX #29); order matches python/gen_unicode_tables.py
+enum class GraphemeBreak : uint8_t {
+    Other,
+    CR,
+    LF,
+    Control,
+    Extend,
+    ZWJ,
+    RegionalIndicator,
+    Prepend,
+    SpacingMark,
+    L,
+    V,
+    T,
+    LV,
+    LVT
+};
+
+constexpr char32_t VARIATION_SELECTOR_16 = 0xFE0F;  // Emoji presentation for the preceding pictograph
+
+// Columns a codepoint occupies in the grid: 0 for combining marks and format
+// characters, 2 for East Asian Wide/Fullwidth (which includes emoji), 1 otherwise
+int char_width(char32_t cp);
+GraphemeBreak grapheme_break(char32_t cp);
+bool is_extended_pictographic(char32_t cp);
+
+
+// GraphemeSegmenter - finds extended grapheme cluster boundaries in a codepoint stream
+// Handles Hangul syllables, combining marks, regional indicator pairs and emoji ZWJ sequences.
+
+class GraphemeSegmenter {
+public:
+    /*
+     Advance by one codepoint
+     @param cp Next codepoint
+     @return true if cp starts a new cluster (always true for the first one)
+     */
+    bool next(char32_t cp);
+    void reset();
+
+private:
+    friend size_t text_width(const uint8_t* data, size_t length);
+    bool advance(uint8_t props);    // Packed table entry of the next codepoint
+
+    GraphemeBreak m_prev = GraphemeBreak::Other;
+    bool m_started = false;
+    bool m_ri_odd = false;          // Odd number of regional indicators end at m_prev
+    uint8_t m_emoji = 0;            // 1: in ExtPict Extend*, 2: ... followed by ZWJ
+};
+
+/*
+ Length of the printable ASCII (0x20-0x7E) prefix, checked 32 bytes at a time
+ @return Number of leading bytes that are each a single-column cluster on their own
+ */
+size_t ascii_span(const uint8_t* data, size_t length);
+
+/*
+ Columns UTF-8 text takes up on one line
+ A cluster counts as wide as its first codepoint, plus one column when VS16 asks for
+ emoji presentation of a narrow pictograph. Invalid bytes count as U+FFFD.
+ */
+size_t text_width(const uint8_t* data, size_t length);
+
+} // namespace headless_tty
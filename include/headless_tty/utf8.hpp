@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "types.hpp"
+
+namespace headless_tty {
+
+/*
+ Length of the longest well-formed UTF-8 prefix (Unicode Table 3-7: no overlongs,
+ surrogates or codepoints above U+10FFFF). ASCII is skipped 16 bytes at a time.
+ @return length if the whole input is valid
+ */
+size_t utf8_valid_prefix(const uint8_t* data, size_t length);
+
+/*
+ Bytes at the end that start a codepoint whose remaining bytes haven't arrived yet
+ @return 0-3
+ */
+size_t utf8_incomplete_tail(const uint8_t* data, size_t length);
+
+/*
+ Convert in a single pass, without a sizing pass first
+ Each ill-formed subsequence becomes one U+FFFD. A UTF-8 input never needs more
+ code units than it has bytes, so out must have room for length units.
+ @return Code units written
+ */
+size_t utf8_to_utf16(const uint8_t* data, size_t length, char16_t* out);
+size_t utf8_to_utf32(const uint8_t* data, size_t length, char32_t* out);
+
+// UTF-8 to the platform wide string (UTF-16 on Windows)
+std::wstring utf8_to_wstring(const char* data, size_t length);
+inline std::wstring utf8_to_wstring(const std::string& text) {
+    return utf8_to_wstring(text.data(), text.size());
+}
+
+
+// Utf8Stream - re-chunks a byte stream so no codepoint is split between deliveries
+// A codepoint cut off at the end of one read is held back (at most 3 bytes) and
+// delivered with the start of the next. Complete runs are passed through without
+// copying; in Utf8Mode::Repair ill-formed sequences are replaced with U+FFFD.
+
+class Utf8Stream {
+public:
+    explicit Utf8Stream(Utf8Mode mode = Utf8Mode::Whole) : m_mode(mode) {}
+
+    void set_mode(Utf8Mode mode) { m_mode = mode; }
+    Utf8Mode mode() const { return m_mode; }
+
+    /*
+     Pass one read through
+     @param sink Receives zero or more pieces, each made of whole codepoints
+     */
+    void feed(const uint8_t* data, size_t length, const OutputCallback& sink);
+
+    // End of stream: delivers a held-back partial codepoint (as U+FFFD in Repair mode)
+    void flush(const OutputCallback& sink);
+    void reset() { m_pending_length = 0; }
+
+private:
+    void emit(const uint8_t* data, size_t length, const OutputCallback& sink) const;
+
+    Utf8Mode m_mode;
+    uint8_t m_pending[4] = {};
+    uint8_t m_pending_length = 0;
+};
+
+} // namespace headless_tty
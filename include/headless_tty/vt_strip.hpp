@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace headless_tty {
+
+
+// EscapeStripper - streaming removal of VT/ANSI escape sequences
+// Keeps printable text plus \t, \r and \n. State carries across calls so a
+// sequence split between two PTY reads is still removed completely.
+
+class EscapeStripper {
+public:
+    /*
+     Filter a chunk of PTY output
+     @param in Input bytes
+     @param length Number of input bytes
+     @param out Destination, must hold at least length bytes (may equal in)
+     @return Number of bytes written to out
+     */
+    size_t filter(const uint8_t* in, size_t length, uint8_t* out);
+    void reset() { m_state = State::Ground; }
+
+    // Advance by one byte; true if the byte is text that should be kept
+    inline bool accept(uint8_t c);
+
+private:
+    enum class State : uint8_t {
+        Ground,
+        Escape,
+        EscapeIntermediate,
+        Csi,
+        String,      // OSC, DCS, SOS, PM, APC - terminated by BEL or ST
+        StringEscape
+    };
+
+    State m_state = State::Ground;
+};
+
+inline bool EscapeStripper::accept(uint8_t c) {
+    switch (m_state) {
+        case State::Ground:
+            if (c == 0x1B) {
+                m_state = State::Escape;
+                return false;
+            }
+            return (c >= 0x20 && c != 0x7F) || c == '\n' || c == '\r' || c == '\t';
+
+        case State::Escape:
+            if (c == '[') {
+                m_state = State::Csi;
+            } else if (c == ']' || c == 'P' || c == 'X' || c == '^' || c == '_') {
+                m_state = State::String;
+            } else if (c >= 0x20 && c <= 0x2F) {
+                m_state = State::EscapeIntermediate;
+            } else if (c != 0x1B) {
+                m_state = State::Ground;
+            }
+            return false;
+
+        case State::EscapeIntermediate:
+            if (c < 0x20 || c > 0x2F) {
+                m_state = State::Ground;
+            }
+            return false;
+
+        case State::Csi:
+            if (c == 0x1B) {
+                m_state = State::Escape;
+            } else if (c >= 0x40 && c <= 0x7E) {
+                m_state = State::Ground;
+            }
+            return false;
+
+        case State::String:
+            if (c == 0x07) {
+                m_state = State::Ground;
+            } else if (c == 0x1B) {
+                m_state = State::StringEscape;
+            }
+            return false;
+
+        case State::StringEscape:
+            // ESC \ is ST; any other ESC aborts the string and starts a new sequence
+            if (c == '\\') {
+                m_state = State::Ground;
+                return false;
+            }
+            m_state = State::Escape;
+            return accept(c);
+    }
+    return false;
+}
+
+} // namespace headless_tty
@@ -0,0 +1,97 @@
+"""
+Compare output throughput of the headless_tty extension with a subprocess pipeline.
+
+    cmake -S . -B build -DHEADLESS_TTY_PYTHON=ON && cmake --build build --config Release
+    set PYTHONPATH=build\Release
+    python python/bench_output.py                      # default: cmd /c type of a generated file
+    python python/bench_output.py --size 256 --runs 5  # 256 MB, best of 5
+
+Both sides run the same command and just count bytes. The subprocess side is the
+usual approach of spawning headless-tty.exe and reading its stdout, which copies
+every byte through an extra process and pipe. The extension side reads the
+ConPTY output in-process as memoryviews over pooled buffers.
+"""
+
+import argparse
+import asyncio
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+import headless_tty
+
+
+def make_file(megabytes):
+    line = b"".join(b"%d " % i for i in range(30)) + b"\r\n"
+    handle, path = tempfile.mkstemp(suffix=".txt")
+    with os.fdopen(handle, "wb") as f:
+        total = 0
+        block = line * (65536 // len(line))
+        while total < megabytes * 1024 * 1024:
+            f.write(block)
+            total += len(block)
+    return path
+
+
+def run_extension(path, io_mode):
+    start = time.perf_counter()
+    session = headless_tty.Session("cmd.exe", '/c type "%s"' % path, io_mode=io_mode)
+    total = 0
+    for chunk in session:
+        total += len(chunk)
+    session.wait()
+    return total, time.perf_counter() - start, session.stats()
+
+
+async def run_extension_async(path):
+    start = time.perf_counter()
+    session = headless_tty.Session("cmd.exe", '/c type "%s"' % path, io_mode="throughput")
+    total = 0
+    async for chunk in session:
+        total += len(chunk)
+    session.wait()
+    return total, time.perf_counter() - start, session.stats()
+
+
+def run_subprocess(path, exe):
+    start = time.perf_counter()
+    proc = subprocess.Popen([exe, "--", "cmd.exe", "/c", "type", path], stdout=subprocess.PIPE)
+    total = 0
+    while True:
+        data = proc.stdout.read1(65536)
+        if not data:
+            break
+        total += len(data)
+    proc.wait()
+    return total, time.perf_counter() - start, None
+
+
+def report(name, results):
+    total, elapsed, stats = min(results, key=lambda r: r[1])
+    line = "%-22s %8.1f MB/s  (%d bytes in %.3fs" % (name, total / elapsed / 1e6, total, elapsed)
+    if stats:
+        line += ", %d reads, %d callbacks" % (stats["reads"], stats["callbacks"])
+    print(line + ")")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--size", type=int, default=64, help="megabytes of output (default 64)")
+    parser.add_argument("--runs", type=int, default=3, help="runs per variant, best is reported")
+    parser.add_argument("--exe", default="headless-tty.exe", help="headless-tty executable for the subprocess run")
+    args = parser.parse_args()
+
+    path = make_file(args.size)
+    try:
+        report("extension (latency)", [run_extension(path, "latency") for _ in range(args.runs)])
+        report("extension (throughput)", [run_extension(path, "throughput") for _ in range(args.runs)])
+        report("extension (asyncio)", [asyncio.run(run_extension_async(path)) for _ in range(args.runs)])
+        report("subprocess", [run_subprocess(path, args.exe) for _ in range(args.runs)])
+    finally:
+        os.remove(path)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,103 @@
+"""Minimal client for headless-tty --framed (protocol in include/headless_tty/framed.hpp).
+
+    python framed_client.py [headless-tty.exe] [command...]
+
+Runs the command under headless-tty --framed, prints each event, sends "exit" and
+asks for metrics along the way. Import FramedSession to use it from your own code.
+"""
+
+import struct
+import subprocess
+import sys
+import threading
+
+HELLO, OUTPUT, EXIT, RESIZE, METRICS, ERROR, STOP, INPUT = range(8)
+
+
+class FramedSession:
+    def __init__(self, exe, command, cols=120, rows=40):
+        args = [exe, "--framed", "--width", str(cols), "--height", str(rows), "--"] + command
+        self.process = subprocess.Popen(args, stdin=subprocess.PIPE, stdout=subprocess.PIPE, bufsize=0)
+        self._lock = threading.Lock()
+
+    def events(self):
+        """Yields (type, payload) tuples until the EXIT frame or the end of stdout."""
+        stream = self.process.stdout
+        while True:
+            header = self._read_exact(stream, 4)
+            if header is None:
+                return
+            (word,) = struct.unpack("<I", header)
+            kind, length = word & 0xFF, word >> 8
+            payload = self._read_exact(stream, length) if length else b""
+            if payload is None:
+                return
+            yield kind, payload
+            if kind == EXIT:
+                return
+
+    def write(self, data):
+        if isinstance(data, str):
+            data = data.encode("utf-8")
+        self._send(INPUT, data)
+
+    def resize(self, cols, rows):
+        self._send(RESIZE, struct.pack("<HH", cols, rows))
+
+    def request_metrics(self):
+        self._send(METRICS, b"")
+
+    def stop(self):
+        self._send(STOP, b"")
+
+    def _send(self, kind, payload):
+        with self._lock:
+            self.process.stdin.write(struct.pack("<I", kind | (len(payload) << 8)) + payload)
+            self.process.stdin.flush()
+
+    @staticmethod
+    def _read_exact(stream, size):
+        data = b""
+        while len(data) < size:
+            chunk = stream.read(size - len(data))
+            if not chunk:
+                return None
+            data += chunk
+        return data
+
+
+def describe(kind, payload):
+    if kind == HELLO:
+        magic, version, cols, rows = struct.unpack("<4sBHH", payload)
+        return f"HELLO {magic.decode()} v{version} {cols}x{rows}"
+    if kind == OUTPUT:
+        seq, time_ms = struct.unpack_from("<II", payload)
+        return f"OUTPUT #{seq} at {time_ms} ms: {payload[8:]!r}"
+    if kind == EXIT:
+        return f"EXIT {struct.unpack('<i', payload)[0]}"
+    if kind == RESIZE:
+        return "RESIZE %dx%d" % struct.unpack("<HH", payload)
+    if kind == METRICS:
+        return "METRICS bytes=%d reads=%d callbacks=%d frames=%d" % struct.unpack("<QQQQ", payload)
+    if kind == ERROR:
+        return f"ERROR {payload.decode('utf-8', 'replace')}"
+    return f"type {kind}: {payload!r}"
+
+
+def main():
+    exe = sys.argv[1] if len(sys.argv) > 1 else "headless-tty.exe"
+    command = sys.argv[2:] or ["cmd.exe"]
+    session = FramedSession(exe, command)
+    sent = False
+    for kind, payload in session.events():
+        print(describe(kind, payload))
+        if kind == OUTPUT and not sent and payload.rstrip().endswith(b">"):
+            session.resize(100, 30)
+            session.request_metrics()
+            session.write("exit\r")
+            sent = True
+    session.process.wait()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,260 @@
+"""
+Generate src/unicode_tables.inc: column width and grapheme cluster break tables.
+
+    python python/gen_unicode_tables.py --ucd path/to/ucd -o src/unicode_tables.inc
+    python python/gen_unicode_tables.py -o src/unicode_tables.inc      # from Python's unicodedata
+
+With --ucd the tables come from the Unicode Character Database files
+(EastAsianWidth.txt, DerivedGeneralCategory.txt, auxiliary/GraphemeBreakProperty.txt,
+emoji/emoji-data.txt; the directory layout of Public/<version>/ucd or all files in
+one directory both work). Without it, general category and East Asian Width come
+from unicodedata and the grapheme break and Extended_Pictographic properties are
+derived from the UAX #29 definitions, which matches the published files for
+assigned characters.
+
+Every codepoint gets one byte:
+    bits 0-1  column width (0, 1 or 2)
+    bits 2-5  GraphemeBreak value (order of the enum in include/headless_tty/unicode.hpp)
+    bit  6    Extended_Pictographic
+The 0x110000 bytes are split into 256-entry blocks; identical blocks are stored once
+and UNICODE_STAGE1[cp >> 8] selects the block.
+"""
+
+import argparse
+import os
+import re
+import sys
+import unicodedata
+
+MAX_CP = 0x110000
+BLOCK = 256
+
+GCB = ["Other", "CR", "LF", "Control", "Extend", "ZWJ", "Regional_Indicator", "Prepend",
+       "SpacingMark", "L", "V", "T", "LV", "LVT"]
+GCB_INDEX = {name: i for i, name in enumerate(GCB)}
+
+# Unassigned codepoints in these ranges default to W (EastAsianWidth.txt header)
+WIDE_DEFAULT = [(0x3400, 0x4DBF), (0x4E00, 0x9FFF), (0xF900, 0xFAFF), (0x20000, 0x2FFFD), (0x30000, 0x3FFFD)]
+
+# Extended_Pictographic (emoji-data.txt), used when no UCD directory is given
+EXT_PICT = [
+    (0x00A9, 0x00A9), (0x00AE, 0x00AE), (0x203C, 0x203C), (0x2049, 0x2049), (0x2122, 0x2122),
+    (0x2139, 0x2139), (0x2194, 0x2199), (0x21A9, 0x21AA), (0x231A, 0x231B), (0x2328, 0x2328),
+    (0x2388, 0x2388), (0x23CF, 0x23CF), (0x23E9, 0x23F3), (0x23F8, 0x23FA), (0x24C2, 0x24C2),
+    (0x25AA, 0x25AB), (0x25B6, 0x25B6), (0x25C0, 0x25C0), (0x25FB, 0x25FE), (0x2600, 0x2605),
+    (0x2607, 0x2612), (0x2614, 0x2685), (0x2690, 0x2705), (0x2708, 0x2712), (0x2714, 0x2714),
+    (0x2716, 0x2716), (0x271D, 0x271D), (0x2721, 0x2721), (0x2728, 0x2728), (0x2733, 0x2734),
+    (0x2744, 0x2744), (0x2747, 0x2747), (0x274C, 0x274C), (0x274E, 0x274E), (0x2753, 0x2755),
+    (0x2757, 0x2757), (0x2763, 0x2767), (0x2795, 0x2797), (0x27A1, 0x27A1), (0x27B0, 0x27B0),
+    (0x27BF, 0x27BF), (0x2934, 0x2935), (0x2B05, 0x2B07), (0x2B1B, 0x2B1C), (0x2B50, 0x2B50),
+    (0x2B55, 0x2B55), (0x3030, 0x3030), (0x303D, 0x303D), (0x3297, 0x3297), (0x3299, 0x3299),
+    (0x1F000, 0x1F0FF), (0x1F10D, 0x1F10F), (0x1F12F, 0x1F12F), (0x1F16C, 0x1F171),
+    (0x1F17E, 0x1F17F), (0x1F18E, 0x1F18E), (0x1F191, 0x1F19A), (0x1F1AD, 0x1F1E5),
+    (0x1F201, 0x1F20F), (0x1F21A, 0x1F21A), (0x1F22F, 0x1F22F), (0x1F232, 0x1F23A),
+    (0x1F23C, 0x1F23F), (0x1F249, 0x1F3FA), (0x1F400, 0x1F53D), (0x1F546, 0x1F64F),
+    (0x1F680, 0x1F6FF), (0x1F774, 0x1F77F), (0x1F7D5, 0x1F7FF), (0x1F80C, 0x1F80F),
+    (0x1F848, 0x1F84F), (0x1F85A, 0x1F85F), (0x1F888, 0x1F88F), (0x1F8AE, 0x1F8FF),
+    (0x1F90C, 0x1F93A), (0x1F93C, 0x1F945), (0x1F947, 0x1FAFF), (0x1FC00, 0x1FFFD),
+]
+
+# Other_Grapheme_Extend (PropList.txt) that unicodedata can't tell from the category
+OTHER_GRAPHEME_EXTEND = [
+    (0x09BE, 0x09BE), (0x09D7, 0x09D7), (0x0B3E, 0x0B3E), (0x0B57, 0x0B57), (0x0BBE, 0x0BBE),
+    (0x0BD7, 0x0BD7), (0x0CC2, 0x0CC2), (0x0CD5, 0x0CD6), (0x0D3E, 0x0D3E), (0x0D57, 0x0D57),
+    (0x0DCF, 0x0DCF), (0x0DDF, 0x0DDF), (0x1B35, 0x1B35), (0x200C, 0x200C), (0x302E, 0x302F),
+    (0xFF9E, 0xFF9F), (0x1133E, 0x1133E), (0x11357, 0x11357), (0x114B0, 0x114B0),
+    (0x114BD, 0x114BD), (0x115AF, 0x115AF), (0x11930, 0x11930), (0x1D165, 0x1D165),
+    (0x1D16E, 0x1D172), (0xE0020, 0xE007F),
+]
+EMOJI_MODIFIER = [(0x1F3FB, 0x1F3FF)]
+
+# Prepend = Indic_Syllabic_Category Consonant_Preceding_Repha/Prefixed + Prepended_Concatenation_Mark
+PREPEND = [
+    (0x0600, 0x0605), (0x06DD, 0x06DD), (0x070F, 0x070F), (0x0890, 0x0891), (0x08E2, 0x08E2),
+    (0x0D4E, 0x0D4E), (0x110BD, 0x110BD), (0x110CD, 0x110CD), (0x111C2, 0x111C3),
+    (0x1193F, 0x1193F), (0x11941, 0x11941), (0x11A3A, 0x11A3A), (0x11A84, 0x11A89),
+    (0x11D46, 0x11D46),
+]
+
+# Mc characters that are not SpacingMark, and non-Mc ones that are
+NOT_SPACING_MARK = [
+    (0x102B, 0x102C), (0x1038, 0x1038), (0x1062, 0x1064), (0x1067, 0x106D), (0x1083, 0x1083),
+    (0x1087, 0x108C), (0x108F, 0x108F), (0x109A, 0x109C), (0x1A61, 0x1A61), (0x1A63, 0x1A64),
+    (0xAA7B, 0xAA7B), (0xAA7D, 0xAA7D), (0x11720, 0x11721),
+]
+EXTRA_SPACING_MARK = [(0x0E33, 0x0E33), (0x0EB3, 0x0EB3)]
+
+
+def in_ranges(cp, ranges):
+    return any(lo <= cp <= hi for lo, hi in ranges)
+
+
+def parse_ucd(path):
+    """(lo, hi, value) for every data line of a UCD property file."""
+    pattern = re.compile(r"^([0-9A-F]+)(?:\.\.([0-9A-F]+))?\s*;\s*([A-Za-z_]+)")
+    with open(path, encoding="utf-8") as f:
+        for line in f:
+            m = pattern.match(line)
+            if m:
+                lo = int(m.group(1), 16)
+                hi = int(m.group(2), 16) if m.group(2) else lo
+                yield lo, hi, m.group(3)
+
+
+def find_ucd_file(root, name):
+    for sub in ("", "auxiliary", "emoji", "extracted"):
+        path = os.path.join(root, sub, name)
+        if os.path.exists(path):
+            return path
+    sys.exit("%s not found under %s" % (name, root))
+
+
+def properties_from_ucd(root):
+    category = ["Cn"] * MAX_CP
+    for lo, hi, value in parse_ucd(find_ucd_file(root, "DerivedGeneralCategory.txt")):
+        category[lo:hi + 1] = [value] * (hi - lo + 1)
+
+    eaw = ["N"] * MAX_CP
+    for lo, hi in WIDE_DEFAULT:
+        eaw[lo:hi + 1] = ["W"] * (hi - lo + 1)
+    for lo, hi, value in parse_ucd(find_ucd_file(root, "EastAsianWidth.txt")):
+        eaw[lo:hi + 1] = [value] * (hi - lo + 1)
+
+    gcb = [GCB_INDEX["Other"]] * MAX_CP
+    for lo, hi, value in parse_ucd(find_ucd_file(root, "GraphemeBreakProperty.txt")):
+        gcb[lo:hi + 1] = [GCB_INDEX[value]] * (hi - lo + 1)
+
+    pict = [False] * MAX_CP
+    for lo, hi, value in parse_ucd(find_ucd_file(root, "emoji-data.txt")):
+        if value == "Extended_Pictographic":
+            pict[lo:hi + 1] = [True] * (hi - lo + 1)
+
+    return category, eaw, gcb, pict
+
+
+def derived_gcb(cp, cat):
+    if cp == 0x0D:
+        return "CR"
+    if cp == 0x0A:
+        return "LF"
+    if cp == 0x200D:
+        return "ZWJ"
+    if 0x1F1E6 <= cp <= 0x1F1FF:
+        return "Regional_Indicator"
+    if in_ranges(cp, PREPEND):
+        return "Prepend"
+    if cat in ("Mn", "Me") or in_ranges(cp, OTHER_GRAPHEME_EXTEND) or in_ranges(cp, EMOJI_MODIFIER):
+        return "Extend"
+    if cat in ("Zl", "Zp", "Cc", "Cf"):
+        return "Control"
+    if (cat == "Mc" and not in_ranges(cp, NOT_SPACING_MARK)) or in_ranges(cp, EXTRA_SPACING_MARK):
+        return "SpacingMark"
+    if 0x1100 <= cp <= 0x115F or 0xA960 <= cp <= 0xA97C:
+        return "L"
+    if 0x1160 <= cp <= 0x11A7 or 0xD7B0 <= cp <= 0xD7C6:
+        return "V"
+    if 0x11A8 <= cp <= 0x11FF or 0xD7CB <= cp <= 0xD7FB:
+        return "T"
+    if 0xAC00 <= cp <= 0xD7A3:
+        return "LV" if (cp - 0xAC00) % 28 == 0 else "LVT"
+    return "Other"
+
+
+def properties_from_unicodedata():
+    category = [None] * MAX_CP
+    eaw = [None] * MAX_CP
+    gcb = [0] * MAX_CP
+    pict = [False] * MAX_CP
+    for cp in range(MAX_CP):
+        ch = chr(cp)
+        cat = unicodedata.category(ch)
+        width = unicodedata.east_asian_width(ch)
+        if cat == "Cn" and in_ranges(cp, WIDE_DEFAULT):
+            width = "W"
+        category[cp] = cat
+        eaw[cp] = width
+        gcb[cp] = GCB_INDEX[derived_gcb(cp, cat)]
+    for lo, hi in EXT_PICT:
+        for cp in range(lo, hi + 1):
+            pict[cp] = True
+    return category, eaw, gcb, pict
+
+
+def column_width(cp, cat, eaw, gcb):
+    if cp == 0x00AD:
+        return 1        # Soft hyphen is Cf but terminals show it
+    if cat in ("Mn", "Me", "Cf", "Cc", "Zl", "Zp") or gcb in (GCB_INDEX["V"], GCB_INDEX["T"]):
+        return 0        # Combining marks, format characters, Hangul medial and final jamo
+    if 0x1F3FB <= cp <= 0x1F3FF:
+        return 0        # Emoji skin tone modifiers combine with the preceding emoji
+    if eaw in ("W", "F"):
+        return 2
+    if 0x1F1E6 <= cp <= 0x1F1FF:
+        return 2        # Regional indicators: a flag pair occupies the width of its first half
+    return 1
+
+
+def build(category, eaw, gcb, pict):
+    data = bytearray(MAX_CP)
+    for cp in range(MAX_CP):
+        width = column_width(cp, category[cp], eaw[cp], gcb[cp])
+        data[cp] = width | (gcb[cp] << 2) | (0x40 if pict[cp] else 0)
+
+    blocks = {}
+    stage1 = []
+    stage2 = []
+    for start in range(0, MAX_CP, BLOCK):
+        block = bytes(data[start:start + BLOCK])
+        if block not in blocks:
+            blocks[block] = len(stage2)
+            stage2.append(block)
+        stage1.append(blocks[block])
+    return stage1, stage2
+
+
+def write_inc(path, stage1, stage2, source):
+    index_type = "uint8_t" if len(stage2) <= 256 else "uint16_t"
+    out = []
+    out.append("// Generated by python/gen_unicode_tables.py from %s - do not edit" % source)
+    out.append("// %d blocks of %d entries, %d bytes" % (len(stage2), BLOCK,
+                                                       len(stage1) * (1 if index_type == "uint8_t" else 2)
+                                                       + len(stage2) * BLOCK))
+    out.append("")
+    out.append("constexpr size_t UNICODE_BLOCK_SHIFT = 8;")
+    out.append("")
+    out.append("const %s UNICODE_STAGE1[%d] = {" % (index_type, len(stage1)))
+    for i in range(0, len(stage1), 16):
+        out.append("    " + ", ".join("%d" % v for v in stage1[i:i + 16]) + ",")
+    out.append("};")
+    out.append("")
+    out.append("const uint8_t UNICODE_STAGE2[%d][%d] = {" % (len(stage2), BLOCK))
+    for block in stage2:
+        out.append("    {")
+        for i in range(0, BLOCK, 32):
+            out.append("        " + ",".join("0x%02x" % v for v in block[i:i + 32]) + ",")
+        out.append("    },")
+    out.append("};")
+    with open(path, "w", newline="\r\n") as f:
+        f.write("\n".join(out) + "\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--ucd", help="directory with the Unicode Character Database files")
+    parser.add_argument("-o", "--output", default=os.path.join(os.path.dirname(__file__), "..", "src", "unicode_tables.inc"))
+    args = parser.parse_args()
+
+    if args.ucd:
+        props = properties_from_ucd(args.ucd)
+        source = "the UCD files in %s" % os.path.basename(os.path.abspath(args.ucd))
+    else:
+        props = properties_from_unicodedata()
+        source = "unicodedata %s" % unicodedata.unidata_version
+
+    stage1, stage2 = build(*props)
+    write_inc(args.output, stage1, stage2, source)
+    print("%s: %d unique blocks" % (args.output, len(stage2)))
+
+
+if __name__ == "__main__":
+    sys.exit(main())
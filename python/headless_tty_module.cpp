@@ -0,0 +1,553 @@
+/*
+headless_tty - CPython extension wrapping HeadlessTTY in-process
+
+    import headless_tty
+
+    session = headless_tty.Session("cmd.exe", "/c dir", cols=120, rows=40)
+    for chunk in session:               # memoryview over a library-owned buffer, no copy
+        sys.stdout.buffer.write(chunk)
+    print(session.wait())
+
+    async for chunk in session:         # asyncio: each read runs on the loop's default executor
+        ...
+
+Output is gathered by the read thread into pooled 64 KB blocks. read() hands the
+oldest block to Python as a memoryview; the block goes back to the pool when the
+last reference to the view is dropped. Blocking calls release the GIL.
+
+That gathering is the one copy output takes on its way to Python: ConPTY reuses its read
+buffer as soon as the output callback returns, so the bytes have to move somewhere the
+callback doesn't own. Copying them into a block also merges small reads, so Python pays
+per block rather than per pipe read.
+
+Timeouts are seconds as int or float, or None to wait without a limit.
+
+Build with cmake -DHEADLESS_TTY_PYTHON=ON.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "headless_tty/pty.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+#include <condition_variable>
+
+namespace {
+
+constexpr size_t PY_BLOCK_SIZE = 64 * 1024;             // Output is gathered into blocks of this size
+constexpr size_t PY_QUEUE_LIMIT = 16 * 1024 * 1024;     // Reading pauses once Python is this far behind
+constexpr size_t PY_FREE_BLOCKS = 64;                   // Blocks kept for reuse
+
+struct OutputBlock {
+    uint8_t data[PY_BLOCK_SIZE];
+    size_t length = 0;
+};
+
+// Blocks travel: free list -> ready queue (filled by the read thread) -> Python -> free list
+class OutputQueue {
+public:
+    ~OutputQueue() {
+        for (OutputBlock* block : m_ready) delete block;
+        for (OutputBlock* block : m_free) delete block;
+    }
+
+    // Read thread; blocks while Python is PY_QUEUE_LIMIT behind, which stalls the child
+    void push(const uint8_t* data, size_t length) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [this] { return m_queued < PY_QUEUE_LIMIT || m_closed; });
+        if (m_closed) {
+            return;
+        }
+
+        while (length > 0) {
+            if (m_ready.empty() || m_ready.back()->length == PY_BLOCK_SIZE) {
+                m_ready.push_back(take_block());
+            }
+            OutputBlock* tail = m_ready.back();
+            size_t n = std::min(length, PY_BLOCK_SIZE - tail->length);
+            std::memcpy(tail->data + tail->length, data, n);
+            tail->length += n;
+            data += n;
+            length -= n;
+            m_queued += n;
+        }
+        m_cv.notify_all();
+    }
+
+    /*
+     Oldest block of output
+     @param timeout_ms Milliseconds to wait (INFINITE for no limit)
+     @param eof Set when the output has ended and nothing is left
+     @return Block now owned by the caller (give it back with release()), or null
+     */
+    OutputBlock* pop(DWORD timeout_ms, bool& eof) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto ready = [this] { return !m_ready.empty() || m_closed; };
+        if (timeout_ms == INFINITE) {
+            m_cv.wait(lock, ready);
+        } else {
+            m_cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), ready);
+        }
+
+        eof = false;
+        if (m_ready.empty()) {
+            eof = m_closed;
+            return nullptr;
+        }
+
+        OutputBlock* block = m_ready.front();
+        m_ready.pop_front();
+        m_queued -= block->length;
+        m_cv.notify_all();
+        return block;
+    }
+
+    void release(OutputBlock* block) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_free.size() < PY_FREE_BLOCKS) {
+            m_free.push_back(block);
+        } else {
+            delete block;
+        }
+    }
+
+    // No more output: wakes readers and a read thread stuck in push()
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_closed = true;
+        }
+        m_cv.notify_all();
+    }
+
+private:
+    OutputBlock* take_block() {
+        OutputBlock* block;
+        if (m_free.empty()) {
+            block = new OutputBlock;
+        } else {
+            block = m_free.back();
+            m_free.pop_back();
+        }
+        block->length = 0;
+        return block;
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<OutputBlock*> m_ready;
+    std::vector<OutputBlock*> m_free;
+    size_t m_queued = 0;
+    bool m_closed = false;
+};
+
+// Seconds to milliseconds; sets an exception (check PyErr_Occurred) for anything else
+DWORD timeout_from_object(PyObject* timeout) {
+    if (timeout == nullptr || timeout == Py_None) {
+        return INFINITE;
+    }
+    double seconds = PyFloat_AsDouble(timeout);
+    if (seconds == -1.0 && PyErr_Occurred()) {
+        return 0;
+    }
+    // INFINITE itself would mean no limit, so the largest real timeout is one below it
+    if (!(seconds >= 0) || seconds * 1000.0 >= static_cast<double>(INFINITE)) {
+        PyErr_SetString(PyExc_ValueError, "timeout must be None or between 0 and 4294967 seconds");
+        return 0;
+    }
+    return static_cast<DWORD>(seconds * 1000.0);
+}
+
+
+// Chunk - exports one OutputBlock through the buffer protocol
+
+struct ChunkObject {
+    PyObject_HEAD
+    std::shared_ptr<OutputQueue> queue;
+    OutputBlock* block;
+};
+
+int Chunk_getbuffer(PyObject* self, Py_buffer* view, int flags) {
+    ChunkObject* chunk = reinterpret_cast<ChunkObject*>(self);
+    return PyBuffer_FillInfo(view, self, chunk->block->data, static_cast<Py_ssize_t>(chunk->block->length), 1, flags);
+}
+
+void Chunk_dealloc(PyObject* self) {
+    ChunkObject* chunk = reinterpret_cast<ChunkObject*>(self);
+    chunk->queue->release(chunk->block);
+    chunk->queue.~shared_ptr<OutputQueue>();
+    Py_TYPE(self)->tp_free(self);
+}
+
+PyBufferProcs Chunk_as_buffer = { Chunk_getbuffer, nullptr };
+
+PyTypeObject ChunkType = { PyVarObject_HEAD_INIT(nullptr, 0) };
+
+// memoryview over a block; the view keeps the chunk (and so the block) alive
+PyObject* make_chunk_view(const std::shared_ptr<OutputQueue>& queue, OutputBlock* block) {
+    ChunkObject* chunk = PyObject_New(ChunkObject, &ChunkType);
+    if (!chunk) {
+        queue->release(block);
+        return nullptr;
+    }
+    new (&chunk->queue) std::shared_ptr<OutputQueue>(queue);
+    chunk->block = block;
+
+    PyObject* view = PyMemoryView_FromObject(reinterpret_cast<PyObject*>(chunk));
+    Py_DECREF(chunk);
+    return view;
+}
+
+
+// Session - one HeadlessTTY
+
+struct SessionObject {
+    PyObject_HEAD
+    headless_tty::HeadlessTTY* tty;
+    std::shared_ptr<OutputQueue> queue;
+};
+
+PyObject* Session_new(PyTypeObject* type, PyObject*, PyObject*) {
+    SessionObject* self = reinterpret_cast<SessionObject*>(type->tp_alloc(type, 0));
+    if (self) {
+        self->tty = nullptr;
+        new (&self->queue) std::shared_ptr<OutputQueue>();
+    }
+    return reinterpret_cast<PyObject*>(self);
+}
+
+bool to_wstring(PyObject* text, std::wstring& out) {
+    if (!text) {
+        return true;
+    }
+    Py_ssize_t length = 0;
+    wchar_t* chars = PyUnicode_AsWideCharString(text, &length);
+    if (!chars) {
+        return false;
+    }
+    out.assign(chars, static_cast<size_t>(length));
+    PyMem_Free(chars);
+    return true;
+}
+
+int Session_init(SessionObject* self, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = { "command", "args", "cols", "rows", "cwd", "io_mode", "utf8", nullptr };
+    PyObject* command = nullptr;
+    PyObject* arguments = nullptr;
+    PyObject* cwd = nullptr;
+    unsigned short cols = 120;
+    unsigned short rows = 40;
+    const char* ioMode = "auto";
+    const char* utf8Mode = "raw";
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "U|UHHUss", const_cast<char**>(keywords),
+                                     &command, &arguments, &cols, &rows, &cwd, &ioMode, &utf8Mode)) {
+        return -1;
+    }
+    if (self->tty) {
+        PyErr_SetString(PyExc_RuntimeError, "Session already started");
+        return -1;
+    }
+
+    headless_tty::Config config;
+    config.size = { cols, rows };
+    if (!to_wstring(command, config.command) || !to_wstring(arguments, config.args) ||
+        !to_wstring(cwd, config.working_dir)) {
+        return -1;
+    }
+
+    if (std::strcmp(ioMode, "latency") == 0) {
+        config.io_mode = headless_tty::IoMode::Latency;
+    } else if (std::strcmp(ioMode, "throughput") == 0) {
+        config.io_mode = headless_tty::IoMode::Throughput;
+    } else if (std::strcmp(ioMode, "auto") != 0) {
+        PyErr_SetString(PyExc_ValueError, "io_mode must be 'latency', 'throughput' or 'auto'");
+        return -1;
+    }
+
+    if (std::strcmp(utf8Mode, "whole") == 0) {
+        config.utf8_mode = headless_tty::Utf8Mode::Whole;
+    } else if (std::strcmp(utf8Mode, "repair") == 0) {
+        config.utf8_mode = headless_tty::Utf8Mode::Repair;
+    } else if (std::strcmp(utf8Mode, "raw") != 0) {
+        PyErr_SetString(PyExc_ValueError, "utf8 must be 'raw', 'whole' or 'repair'");
+        return -1;
+    }
+
+    self->queue = std::make_shared<OutputQueue>();
+    self->tty = new headless_tty::HeadlessTTY();
+
+    std::shared_ptr<OutputQueue> queue = self->queue;
+    self->tty->set_output_callback([queue](const uint8_t* data, size_t length) {
+        queue->push(data, length);
+    });
+    self->tty->set_exit_callback([queue]() {
+        queue->close();
+    });
+
+    bool started;
+    Py_BEGIN_ALLOW_THREADS
+    started = self->tty->start(config);
+    Py_END_ALLOW_THREADS
+
+    if (!started) {
+        PyErr_SetString(PyExc_OSError, self->tty->get_last_error().c_str());
+        // Back to unstarted, so other methods raise "not started" and __init__ can be retried
+        delete self->tty;
+        self->tty = nullptr;
+        self->queue.reset();
+        return -1;
+    }
+    return 0;
+}
+
+void Session_dealloc(SessionObject* self) {
+    if (self->tty) {
+        Py_BEGIN_ALLOW_THREADS
+        self->queue->close();
+        self->tty->stop();
+        delete self->tty;
+        Py_END_ALLOW_THREADS
+    }
+    self->queue.~shared_ptr<OutputQueue>();
+    Py_TYPE(self)->tp_free(reinterpret_cast<PyObject*>(self));
+}
+
+bool check_started(SessionObject* self) {
+    if (!self->tty) {
+        PyErr_SetString(PyExc_RuntimeError, "Session not started");
+        return false;
+    }
+    return true;
+}
+
+// Shared by read(), __next__ and the asyncio path; returns null with no exception set at EOF
+PyObject* read_chunk(SessionObject* self, DWORD timeout_ms) {
+    if (!check_started(self)) {
+        return nullptr;
+    }
+
+    OutputBlock* block;
+    bool eof;
+    std::shared_ptr<OutputQueue> queue = self->queue;
+    Py_BEGIN_ALLOW_THREADS
+    block = queue->pop(timeout_ms, eof);
+    Py_END_ALLOW_THREADS
+
+    if (block) {
+        return make_chunk_view(queue, block);
+    }
+    if (!eof) {
+        PyErr_SetString(PyExc_TimeoutError, "no output within the timeout");
+    }
+    return nullptr;
+}
+
+PyObject* Session_read(SessionObject* self, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = { "timeout", nullptr };
+    PyObject* timeout = nullptr;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|O", const_cast<char**>(keywords), &timeout)) {
+        return nullptr;
+    }
+
+    DWORD timeoutMs = timeout_from_object(timeout);
+    if (PyErr_Occurred()) {
+        return nullptr;
+    }
+
+    PyObject* chunk = read_chunk(self, timeoutMs);
+    if (!chunk && !PyErr_Occurred()) {
+        Py_RETURN_NONE;
+    }
+    return chunk;
+}
+
+PyObject* Session_write(SessionObject* self, PyObject* args) {
+    PyObject* object;
+    if (!check_started(self) || !PyArg_ParseTuple(args, "O", &object)) {
+        return nullptr;
+    }
+
+    // str goes out as UTF-8; anything else must support the buffer protocol
+    Py_buffer data;
+    if (PyUnicode_Check(object)) {
+        Py_ssize_t length = 0;
+        const char* text = PyUnicode_AsUTF8AndSize(object, &length);
+        if (!text || PyBuffer_FillInfo(&data, object, const_cast<char*>(text), length, 1, PyBUF_SIMPLE) < 0) {
+            return nullptr;
+        }
+    } else if (PyObject_GetBuffer(object, &data, PyBUF_SIMPLE) < 0) {
+        return nullptr;
+    }
+
+    bool ok;
+    Py_BEGIN_ALLOW_THREADS
+    ok = self->tty->write(static_cast<const uint8_t*>(data.buf), static_cast<size_t>(data.len));
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&data);
+
+    if (!ok) {
+        return PyErr_Format(PyExc_OSError, "write failed: %s", self->tty->get_last_error().c_str());
+    }
+    Py_RETURN_NONE;
+}
+
+PyObject* Session_wait(SessionObject* self, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = { "timeout", nullptr };
+    PyObject* timeout = nullptr;
+    if (!check_started(self) ||
+        !PyArg_ParseTupleAndKeywords(args, kwargs, "|O", const_cast<char**>(keywords), &timeout)) {
+        return nullptr;
+    }
+
+    DWORD timeoutMs = timeout_from_object(timeout);
+    if (PyErr_Occurred()) {
+        return nullptr;
+    }
+
+    int exitCode;
+    Py_BEGIN_ALLOW_THREADS
+    exitCode = self->tty->wait(timeoutMs);
+    Py_END_ALLOW_THREADS
+
+    if (exitCode < 0) {
+        Py_RETURN_NONE;     // Still running
+    }
+    return PyLong_FromLong(exitCode);
+}
+
+PyObject* Session_stop(SessionObject* self, PyObject*) {
+    if (self->tty) {
+        Py_BEGIN_ALLOW_THREADS
+        self->queue->close();
+        self->tty->stop();
+        Py_END_ALLOW_THREADS
+    }
+    Py_RETURN_NONE;
+}
+
+PyObject* Session_stats(SessionObject* self, PyObject*) {
+    if (!check_started(self)) {
+        return nullptr;
+    }
+    headless_tty::IoStats stats = self->tty->get_io_stats();
+    return Py_BuildValue("{s:K,s:K,s:K}", "bytes", stats.bytes, "reads", stats.reads, "callbacks", stats.callbacks);
+}
+
+PyObject* Session_running(SessionObject* self, void*) {
+    return PyBool_FromLong(self->tty && self->tty->is_running());
+}
+
+PyObject* Session_iternext(SessionObject* self) {
+    return read_chunk(self, INFINITE);     // Null without an exception ends the iteration
+}
+
+// Runs on an executor thread for __anext__; StopAsyncIteration ends `async for`
+PyObject* Session_read_async_item(SessionObject* self, PyObject*) {
+    PyObject* chunk = read_chunk(self, INFINITE);
+    if (!chunk && !PyErr_Occurred()) {
+        PyErr_SetNone(PyExc_StopAsyncIteration);
+    }
+    return chunk;
+}
+
+PyObject* Session_aiter(PyObject* self) {
+    Py_INCREF(self);
+    return self;
+}
+
+PyObject* Session_anext(PyObject* self) {
+    PyObject* asyncio = PyImport_ImportModule("asyncio");
+    if (!asyncio) {
+        return nullptr;
+    }
+    PyObject* loop = PyObject_CallMethod(asyncio, "get_running_loop", nullptr);
+    Py_DECREF(asyncio);
+    if (!loop) {
+        return nullptr;
+    }
+
+    PyObject* reader = PyObject_GetAttrString(self, "_read_async_item");
+    PyObject* future = reader ? PyObject_CallMethod(loop, "run_in_executor", "OO", Py_None, reader) : nullptr;
+    Py_XDECREF(reader);
+    Py_DECREF(loop);
+    return future;
+}
+
+PyMethodDef Session_methods[] = {
+    { "read", reinterpret_cast<PyCFunction>(Session_read), METH_VARARGS | METH_KEYWORDS,
+      "read(timeout=None) -> memoryview | None\nNext block of output (None at end of output). Raises TimeoutError." },
+    { "write", reinterpret_cast<PyCFunction>(Session_write), METH_VARARGS,
+      "write(data)\nSend bytes (or str, encoded as UTF-8) to the child." },
+    { "wait", reinterpret_cast<PyCFunction>(Session_wait), METH_VARARGS | METH_KEYWORDS,
+      "wait(timeout=None) -> int | None\nExit code, or None if still running after timeout seconds." },
+    { "stop", reinterpret_cast<PyCFunction>(Session_stop), METH_NOARGS,
+      "stop()\nTerminate the child and end the output." },
+    { "stats", reinterpret_cast<PyCFunction>(Session_stats), METH_NOARGS,
+      "stats() -> dict\nBytes, pipe reads and callbacks on the read path." },
+    { "_read_async_item", reinterpret_cast<PyCFunction>(Session_read_async_item), METH_NOARGS, nullptr },
+    { nullptr, nullptr, 0, nullptr }
+};
+
+PyGetSetDef Session_getset[] = {
+    { "running", reinterpret_cast<getter>(Session_running), nullptr, "True while the child is running", nullptr },
+    { nullptr, nullptr, nullptr, nullptr, nullptr }
+};
+
+PyAsyncMethods Session_as_async = { nullptr, Session_aiter, Session_anext };
+
+PyTypeObject SessionType = { PyVarObject_HEAD_INIT(nullptr, 0) };
+
+PyModuleDef module_def = {
+    PyModuleDef_HEAD_INIT, "headless_tty", "Headless ConPTY sessions with zero-copy output.", -1,
+    nullptr, nullptr, nullptr, nullptr, nullptr
+};
+
+} // namespace
+
+PyMODINIT_FUNC PyInit_headless_tty() {
+    ChunkType.tp_name = "headless_tty.Chunk";
+    ChunkType.tp_basicsize = sizeof(ChunkObject);
+    ChunkType.tp_flags = Py_TPFLAGS_DEFAULT;
+    ChunkType.tp_dealloc = Chunk_dealloc;
+    ChunkType.tp_as_buffer = &Chunk_as_buffer;
+    ChunkType.tp_doc = "Block of session output (use through memoryview)";
+
+    SessionType.tp_name = "headless_tty.Session";
+    SessionType.tp_basicsize = sizeof(SessionObject);
+    SessionType.tp_flags = Py_TPFLAGS_DEFAULT;
+    SessionType.tp_new = Session_new;
+    SessionType.tp_init = reinterpret_cast<initproc>(Session_init);
+    SessionType.tp_dealloc = reinterpret_cast<destructor>(Session_dealloc);
+    SessionType.tp_methods = Session_methods;
+    SessionType.tp_getset = Session_getset;
+    SessionType.tp_iter = PyObject_SelfIter;
+    SessionType.tp_iternext = reinterpret_cast<iternextfunc>(Session_iternext);
+    SessionType.tp_as_async = &Session_as_async;
+    SessionType.tp_doc = "Session(command, args='', cols=120, rows=40, cwd='', io_mode='auto', utf8='raw')";
+
+    if (PyType_Ready(&ChunkType) < 0 || PyType_Ready(&SessionType) < 0) {
+        return nullptr;
+    }
+
+    PyObject* module = PyModule_Create(&module_def);
+    if (!module) {
+        return nullptr;
+    }
+
+    Py_INCREF(&SessionType);
+    if (PyModule_AddObject(module, "Session", reinterpret_cast<PyObject*>(&SessionType)) < 0) {
+        Py_DECREF(&SessionType);
+        Py_DECREF(module);
+        return nullptr;
+    }
+    return module;
+}
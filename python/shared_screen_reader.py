@@ -0,0 +1,149 @@
+"""
+Read a headless-tty screen published with --shared-screen.
+
+    headless-tty --shared-screen Local\\my-session -- cmd
+    python shared_screen_reader.py Local\\my-session            # print the screen once
+    python shared_screen_reader.py Local\\my-session --watch    # reprint whenever it changes
+    python shared_screen_reader.py Local\\my-session --bench 5  # snapshot cost while the writer updates
+
+The layout matches SharedScreenHeader in include/headless_tty/shared_screen.hpp.
+Reads never make a system call: the mapping is read in place and a snapshot is
+accepted only if the writer's sequence number was even and unchanged around it.
+"""
+
+import argparse
+import mmap
+import struct
+import sys
+import time
+
+HEADER = struct.Struct("<8sIIIHHIIHHHHQIIII")
+SEQUENCE = struct.Struct("<I")
+SEQUENCE_OFFSET = 24
+CELL = struct.Struct("<IIIHBB")
+MAGIC = b"HTTYSHM1"
+VERSION = 2
+CELL_CLUSTER = 0x80000000   # ch is an offset into the cluster pool: a count, then the codepoints
+
+CURSOR_VISIBLE = 1 << 0
+ALT_SCREEN = 1 << 2
+
+
+class Snapshot:
+    def __init__(self, frame, cols, rows, cursor, flags, exited, cells, clusters):
+        self.frame = frame          # Screen sequence number, changes with every update
+        self.cols = cols
+        self.rows = rows
+        self.cursor = cursor        # (x, y)
+        self.flags = flags
+        self.exited = exited
+        self.cells = cells          # bytes, rows * cols cells of CELL.size
+        self.clusters = clusters    # bytes, the cluster pool as little-endian uint32
+
+    def text(self, ch):
+        """The codepoints of one cell as a string."""
+        if not ch & CELL_CLUSTER:
+            return chr(ch)
+        offset = (ch & ~CELL_CLUSTER) * 4
+        if offset + 4 > len(self.clusters):
+            return "\ufffd"
+        count = struct.unpack_from("<I", self.clusters, offset)[0]
+        if offset + 4 + count * 4 > len(self.clusters):
+            return "\ufffd"
+        return "".join(map(chr, struct.unpack_from("<%dI" % count, self.clusters, offset + 4)))
+
+    def lines(self):
+        """Screen text, one string per row with trailing blanks removed."""
+        out = []
+        stride = self.cols * CELL.size
+        for y in range(self.rows):
+            row = self.cells[y * stride:(y + 1) * stride]
+            chars = [self.text(ch) for ch, _fg, _bg, _attrs, width, _ in CELL.iter_unpack(row) if width != 0]
+            out.append("".join(chars).rstrip(" "))
+        return out
+
+
+class SharedScreen:
+    def __init__(self, name):
+        probe = mmap.mmap(-1, HEADER.size, tagname=name, access=mmap.ACCESS_READ)
+        try:
+            magic, version, header_size, cell_size, max_cols, max_rows = HEADER.unpack_from(probe)[:6]
+        finally:
+            probe.close()
+        if magic != MAGIC or version != VERSION or cell_size != CELL.size:
+            raise ValueError("%s is not a compatible headless-tty shared screen" % name)
+
+        self.header_size = header_size
+        self.clusters_offset = header_size + max_cols * max_rows * cell_size
+        self.cluster_capacity = max_cols * max_rows
+        self.map = mmap.mmap(-1, self.clusters_offset + self.cluster_capacity * 4,
+                             tagname=name, access=mmap.ACCESS_READ)
+
+    def close(self):
+        self.map.close()
+
+    def snapshot(self, retries=1000):
+        """Consistent copy of the current screen, or None if the writer stayed busy."""
+        m = self.map
+        for _ in range(retries):
+            before = SEQUENCE.unpack_from(m, SEQUENCE_OFFSET)[0]
+            if before & 1:
+                continue
+            fields = HEADER.unpack_from(m)
+            flags, cols, rows, cx, cy, frame, _pid, exited, _capacity, cluster_length = fields[7:17]
+            cells = m[self.header_size:self.header_size + cols * rows * CELL.size]
+            length = min(cluster_length, self.cluster_capacity)
+            clusters = m[self.clusters_offset:self.clusters_offset + length * 4]
+            if SEQUENCE.unpack_from(m, SEQUENCE_OFFSET)[0] == before:
+                return Snapshot(frame, cols, rows, (cx, cy), flags, bool(exited), cells, clusters)
+        return None
+
+
+def bench(screen, seconds):
+    reads = failures = changes = 0
+    last = None
+    start = time.perf_counter()
+    deadline = start + seconds
+    while time.perf_counter() < deadline:
+        snap = screen.snapshot()
+        reads += 1
+        if snap is None:
+            failures += 1
+        elif snap.frame != last:
+            changes += 1
+            last = snap.frame
+    elapsed = time.perf_counter() - start
+    print("%d snapshots in %.2fs: %.1f us each, %d distinct frames, %d gave up"
+          % (reads, elapsed, elapsed / reads * 1e6, changes, failures))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("name", help="mapping name given to --shared-screen")
+    parser.add_argument("--watch", action="store_true", help="reprint the screen whenever it changes")
+    parser.add_argument("--bench", type=float, metavar="SECONDS", help="measure snapshot cost")
+    args = parser.parse_args()
+
+    screen = SharedScreen(args.name)
+    try:
+        if args.bench:
+            bench(screen, args.bench)
+            return
+
+        last = None
+        while True:
+            snap = screen.snapshot()
+            if snap is not None and snap.frame != last:
+                last = snap.frame
+                print("\n".join(snap.lines()))
+                print("-- frame %d, cursor %d,%d%s" % (snap.frame, snap.cursor[0], snap.cursor[1],
+                                                       ", exited" if snap.exited else ""))
+            if not args.watch or (snap is not None and snap.exited):
+                break
+            time.sleep(0.05)
+    finally:
+        screen.close()
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,25 @@
+# Shell-integration marks for headless-tty's command index (Config::index_commands)
+# Source from ~/.bashrc:  . /path/to/headless-tty.bash
+#
+#   OSC 133;A  prompt starts        OSC 133;C  command starts running
+#   OSC 133;B  prompt ends          OSC 133;D;<exit>  command finished
+#   OSC 7      working directory
+
+if [[ -n "$__htty_installed" ]]; then
+    return
+fi
+__htty_installed=1
+
+__htty_prompt_command() {
+    local status=$?
+    # Every prompt after the first ends a command (an empty one is dropped by the index)
+    if [[ -n "$__htty_prompted" ]]; then
+        printf '\e]133;D;%s\e\\' "$status"
+    fi
+    __htty_prompted=1
+    printf '\e]7;file://%s%s\e\\' "$HOSTNAME" "$PWD"
+}
+
+PROMPT_COMMAND="__htty_prompt_command${PROMPT_COMMAND:+; $PROMPT_COMMAND}"
+PS1="\[\e]133;A\e\\\\\]${PS1}\[\e]133;B\e\\\\\]"
+PS0="\e]133;C\e\\\\${PS0}"
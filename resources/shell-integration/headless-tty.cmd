@@ -0,0 +1,11 @@
+@echo off
+rem Shell-integration marks for headless-tty's command index (Config::index_commands)
+rem Run once in the session, or set it as the AutoRun command:
+rem   reg add "HKCU\Software\Microsoft\Command Processor" /v AutoRun /d "C:\path\to\headless-tty.cmd"
+rem
+rem cmd.exe has no hook before a command runs and doesn't expose exit codes to the prompt,
+rem so only A (prompt start), B (prompt end) and D (previous command done) are sent. The
+rem index then takes the first line after B as the command and the rest as its output.
+rem OSC 7 isn't sent either: the prompt can't percent-encode the path.
+
+prompt $e]133;D$e\$e]133;A$e\$P$G$e]133;B$e\
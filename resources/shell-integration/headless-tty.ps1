@@ -0,0 +1,48 @@
+# Shell-integration marks for headless-tty's command index (Config::index_commands)
+# Dot-source from $PROFILE:  . C:\path\to\headless-tty.ps1
+#
+#   OSC 133;A / B   prompt start / end      OSC 633;E   command line as typed
+#   OSC 133;C       command starts running  OSC 7       working directory
+#   OSC 133;D;<n>   command finished with exit code n
+
+if ($Global:__HttyInstalled) { return }
+$Global:__HttyInstalled = $true
+$Global:__HttyOriginalPrompt = $function:prompt
+$Global:__HttyPrompted = $false
+
+function Global:prompt {
+    $success = $?
+    $code = $LASTEXITCODE
+    $esc = [char]27
+    $st = "$esc\"
+
+    $marks = ""
+    if ($Global:__HttyPrompted) {
+        $exit = if ($success) { 0 } elseif ($code) { $code } else { 1 }
+        $marks += "$esc]133;D;$exit$st"
+    }
+    $Global:__HttyPrompted = $true
+
+    $location = $executionContext.SessionState.Path.CurrentLocation
+    if ($location.Provider.Name -eq "FileSystem") {
+        $path = $location.ProviderPath -replace "\\", "/"
+        $marks += "$esc]7;file://$env:COMPUTERNAME/$([uri]::EscapeUriString($path))$st"
+    }
+
+    $text = & $Global:__HttyOriginalPrompt
+    $global:LASTEXITCODE = $code
+    "$marks$esc]133;A$st$text$esc]133;B$st"
+}
+
+# PSReadLine draws the command line itself, so mark the start of execution from its Enter handler
+if (Get-Module PSReadLine) {
+    Set-PSReadLineKeyHandler -Chord Enter -ScriptBlock {
+        $line = $null
+        $cursor = $null
+        [Microsoft.PowerShell.PSConsoleReadLine]::GetBufferState([ref]$line, [ref]$cursor)
+        [Microsoft.PowerShell.PSConsoleReadLine]::AcceptLine()
+        $esc = [char]27
+        $escaped = $line -replace "\\", "\x5c" -replace ";", "\x3b" -replace "`n", "\x0a" -replace "`r", ""
+        [Console]::Write("$esc]633;E;$escaped$esc\$esc]133;C$esc\")
+    }
+}
@@ -0,0 +1,105 @@
+#include "headless_tty/arena.hpp"
+
+#include <algorithm>
+
+namespace headless_tty {
+
+namespace {
+
+constexpr size_t CHUNK_ALIGN = 16;
+
+// Index of the highest set bit (value > 0)
+size_t top_bit(size_t value) {
+    size_t bit = 0;
+    while (value >>= 1) {
+        ++bit;
+    }
+    return bit;
+}
+
+} // namespace
+
+SessionArena::~SessionArena() {
+    Block* block = m_blocks;
+    while (block) {
+        Block* next = block->next;
+        ::operator delete(block);
+        block = next;
+    }
+}
+
+size_t SessionArena::size_class(size_t bytes) {
+    if (bytes <= 128) {
+        return bytes == 0 ? 0 : (bytes - 1) >> 4;
+    }
+    size_t m = bytes - 1;
+    size_t bit = top_bit(m);
+    return 8 + (bit - 7) * 8 + ((m >> (bit - 3)) & 7);
+}
+
+size_t SessionArena::class_size(size_t index) {
+    if (index < 8) {
+        return (index + 1) * 16;
+    }
+    size_t bit = 7 + (index - 8) / 8;
+    return (size_t(1) << bit) + ((index - 8) % 8 + 1) * (size_t(1) << (bit - 3));
+}
+
+void* SessionArena::carve(size_t size) {
+    if (static_cast<size_t>(m_limit - m_cursor) < size) {
+        // The rest of the old block, smaller than this chunk, stays unused
+        size_t capacity = std::max(ARENA_BLOCK_SIZE, size + sizeof(Block));
+        Block* block = static_cast<Block*>(::operator new(capacity));
+        block->next = m_blocks;
+        block->size = capacity;
+        m_blocks = block;
+        m_cursor = reinterpret_cast<uint8_t*>(block) + ((sizeof(Block) + CHUNK_ALIGN - 1) & ~(CHUNK_ALIGN - 1));
+        m_limit = reinterpret_cast<uint8_t*>(block) + capacity;
+        ++m_stats.blocks;
+        ++m_stats.heap_allocations;
+        m_stats.reserved_bytes += capacity;
+    }
+    void* p = m_cursor;
+    m_cursor += size;
+    return p;
+}
+
+void* SessionArena::allocate(size_t bytes) {
+    ++m_stats.allocations;
+    if (bytes > ARENA_MAX_POOLED) {
+        ++m_stats.heap_allocations;
+        return ::operator new(bytes);
+    }
+
+    size_t index = size_class(bytes);
+    size_t size = class_size(index);
+    m_stats.used_bytes += size;
+    FreeChunk* chunk = m_free[index];
+    if (chunk) {
+        m_free[index] = chunk->next;
+        return chunk;
+    }
+    return carve(size);
+}
+
+void SessionArena::deallocate(void* p, size_t bytes) noexcept {
+    if (!p) {
+        return;
+    }
+    if (bytes > ARENA_MAX_POOLED) {
+        ::operator delete(p);
+        return;
+    }
+
+    size_t index = size_class(bytes);
+    m_stats.used_bytes -= class_size(index);
+    FreeChunk* chunk = static_cast<FreeChunk*>(p);
+    chunk->next = m_free[index];
+    m_free[index] = chunk;
+}
+
+ArenaStats SessionArena::get_stats() const {
+    return m_stats;
+}
+
+} // namespace headless_tty
@@ -0,0 +1,331 @@
+#include "headless_tty/headless_tty.h"
+#include "headless_tty/pty.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <exception>
+
+using headless_tty::HeadlessTTY;
+
+struct htty_session {
+    HeadlessTTY tty;
+    bool spawned = false;
+
+    htty_output_fn output_fn = nullptr;
+    void* output_user = nullptr;
+    htty_exit_fn exit_fn = nullptr;
+    void* exit_user = nullptr;
+
+    // Output ring (buffered mode); allocated once in htty_spawn()
+    std::unique_ptr<uint8_t[]> ring;
+    size_t capacity = 0;
+    size_t head = 0;            // Next byte to read
+    size_t count = 0;           // Bytes buffered
+    uint64_t stalls = 0;
+    bool ended = false;         // No more output will arrive
+    bool stopping = false;      // htty_stop(): drop instead of waiting for space
+    mutable std::mutex mutex;
+    std::condition_variable cv;
+
+    mutable std::string last_error;     // Also set when a const call fails
+};
+
+namespace {
+
+int fail(htty_session* session, const std::string& message) {
+    session->last_error = message;
+    return HTTY_ERROR;
+}
+
+// Runs the body of an exported function. Exceptions must not unwind into a C caller:
+// out of memory becomes HTTY_E_MEMORY, anything else HTTY_ERROR.
+template <typename Body>
+auto guarded(const htty_session* session, Body body) noexcept -> decltype(body()) {
+    try {
+        return body();
+    } catch (const std::bad_alloc&) {
+        return HTTY_E_MEMORY;
+    } catch (const std::exception& e) {
+        try {
+            if (session) session->last_error = e.what();
+        } catch (...) {
+        }
+        return HTTY_ERROR;
+    } catch (...) {
+        if (session) session->last_error = "Unknown error";
+        return HTTY_ERROR;
+    }
+}
+
+bool utf8_to_wide(const char* text, std::wstring& out) {
+    if (!text) {
+        out.clear();
+        return true;
+    }
+    size_t length = std::strlen(text);
+    if (headless_tty::utf8_valid_prefix(reinterpret_cast<const uint8_t*>(text), length) != length) {
+        return false;
+    }
+    out = headless_tty::utf8_to_wstring(text, length);
+    return true;
+}
+
+// Read thread: copy into the ring, waiting for the reader when it is full
+void ring_push(htty_session* session, const uint8_t* data, size_t length) {
+    std::unique_lock<std::mutex> lock(session->mutex);
+    while (length > 0) {
+        if (session->count == session->capacity) {
+            ++session->stalls;
+            session->cv.wait(lock, [session] { return session->count < session->capacity || session->stopping; });
+            if (session->stopping) {
+                return;
+            }
+        }
+
+        size_t tail = (session->head + session->count) % session->capacity;
+        size_t n = std::min(length, std::min(session->capacity - session->count, session->capacity - tail));
+        std::memcpy(session->ring.get() + tail, data, n);
+        session->count += n;
+        data += n;
+        length -= n;
+        session->cv.notify_all();
+    }
+}
+
+void ring_end(htty_session* session) {
+    {
+        std::lock_guard<std::mutex> lock(session->mutex);
+        session->ended = true;
+    }
+    session->cv.notify_all();
+}
+
+} // namespace
+
+extern "C" {
+
+uint32_t htty_abi_version(void) {
+    return HTTY_ABI_VERSION;
+}
+
+htty_session* htty_create(void) {
+    try {
+        return new htty_session();
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void htty_destroy(htty_session* session) {
+    if (!session) {
+        return;
+    }
+    htty_stop(session);
+    delete session;
+}
+
+int htty_set_output_callback(htty_session* session, htty_output_fn callback, void* user) {
+    return guarded(session, [&]() -> int {
+        if (!session) return HTTY_E_ARGUMENT;
+        if (session->spawned) return HTTY_E_STATE;
+        session->output_fn = callback;
+        session->output_user = user;
+        return HTTY_OK;
+    });
+}
+
+int htty_set_exit_callback(htty_session* session, htty_exit_fn callback, void* user) {
+    return guarded(session, [&]() -> int {
+        if (!session) return HTTY_E_ARGUMENT;
+        if (session->spawned) return HTTY_E_STATE;
+        session->exit_fn = callback;
+        session->exit_user = user;
+        return HTTY_OK;
+    });
+}
+
+int htty_spawn(htty_session* session, const htty_config* config) {
+    return guarded(session, [&]() -> int {
+        if (!session || !config || !config->command || config->struct_size < offsetof(htty_config, utf8_mode)) {
+            return HTTY_E_ARGUMENT;
+        }
+        if (session->spawned) {
+            return HTTY_E_STATE;
+        }
+
+        headless_tty::Config cfg;
+        if (!utf8_to_wide(config->command, cfg.command) || !utf8_to_wide(config->args, cfg.args) ||
+            !utf8_to_wide(config->working_dir, cfg.working_dir)) {
+            return fail(session, "Invalid UTF-8 in config");
+        }
+        if (config->cols == 0 || config->rows == 0 || config->io_mode > HTTY_IO_AUTO) {
+            return HTTY_E_ARGUMENT;
+        }
+        cfg.size = { config->cols, config->rows };
+        cfg.io_mode = static_cast<headless_tty::IoMode>(config->io_mode);
+        // Fields appended after the first release are read only if the caller's struct has them.
+        // The first release's sizeof already covers utf8_mode's offset on 64-bit, so go by reserved.
+        if (config->struct_size >= offsetof(htty_config, reserved) + sizeof(config->reserved)) {
+            if (config->utf8_mode > HTTY_UTF8_REPAIR || config->reserved != 0) {
+                return HTTY_E_ARGUMENT;
+            }
+            cfg.utf8_mode = static_cast<headless_tty::Utf8Mode>(config->utf8_mode);
+        }
+
+        // The lambdas capture one pointer, so the std::function copies made per read stay in
+        // the small-object buffer and the hot path never allocates
+        if (session->output_fn) {
+            session->tty.set_output_callback([session](const uint8_t* data, size_t length) {
+                session->output_fn(session->output_user, data, length);
+            });
+        } else {
+            session->capacity = config->buffer_size ? config->buffer_size : HTTY_DEFAULT_BUFFER_SIZE;
+            session->ring.reset(new (std::nothrow) uint8_t[session->capacity]);
+            if (!session->ring) {
+                return fail(session, "Failed to allocate output buffer");
+            }
+            session->tty.set_output_callback([session](const uint8_t* data, size_t length) {
+                ring_push(session, data, length);
+            });
+        }
+        session->tty.set_exit_callback([session]() {
+            ring_end(session);
+            if (session->exit_fn) {
+                session->exit_fn(session->exit_user);
+            }
+        });
+
+        if (!session->tty.start(cfg)) {
+            return fail(session, session->tty.get_last_error());
+        }
+        session->spawned = true;
+        return HTTY_OK;
+    });
+}
+
+int64_t htty_write(htty_session* session, const void* data, size_t length) {
+    return guarded(session, [&]() -> int64_t {
+        if (!session || (!data && length > 0)) return HTTY_E_ARGUMENT;
+        if (!session->spawned) return HTTY_E_STATE;
+
+        if (!session->tty.write(static_cast<const uint8_t*>(data), length)) {
+            return fail(session, session->tty.get_last_error());
+        }
+        return static_cast<int64_t>(length);
+    });
+}
+
+int64_t htty_read(htty_session* session, void* buffer, size_t capacity, uint32_t timeout_ms) {
+    return guarded(session, [&]() -> int64_t {
+        if (!session || !buffer || capacity == 0) return HTTY_E_ARGUMENT;
+        if (!session->spawned || !session->ring) return HTTY_E_STATE;
+
+        std::unique_lock<std::mutex> lock(session->mutex);
+        auto readable = [session] { return session->count > 0 || session->ended; };
+        if (timeout_ms == HTTY_INFINITE) {
+            session->cv.wait(lock, readable);
+        } else if (!session->cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), readable)) {
+            return HTTY_E_TIMEOUT;
+        }
+
+        if (session->count == 0) {
+            return HTTY_EOF;
+        }
+
+        // At most two copies: up to the end of the ring, then from its start
+        uint8_t* out = static_cast<uint8_t*>(buffer);
+        size_t total = std::min(capacity, session->count);
+        size_t first = std::min(total, session->capacity - session->head);
+        std::memcpy(out, session->ring.get() + session->head, first);
+        std::memcpy(out + first, session->ring.get(), total - first);
+        session->head = (session->head + total) % session->capacity;
+        session->count -= total;
+        lock.unlock();
+
+        session->cv.notify_all();
+        return static_cast<int64_t>(total);
+    });
+}
+
+int htty_resize(htty_session* session, uint16_t cols, uint16_t rows) {
+    return guarded(session, [&]() -> int {
+        if (!session || cols == 0 || rows == 0) return HTTY_E_ARGUMENT;
+        if (!session->spawned) return HTTY_E_STATE;
+
+        if (!session->tty.resize({ cols, rows })) {
+            return fail(session, session->tty.get_last_error());
+        }
+        return HTTY_OK;
+    });
+}
+
+int htty_wait(htty_session* session, uint32_t timeout_ms, int* exit_code) {
+    return guarded(session, [&]() -> int {
+        if (!session) return HTTY_E_ARGUMENT;
+        if (!session->spawned) return HTTY_E_STATE;
+
+        int code = session->tty.wait(timeout_ms);
+        // -1 is both "timed out" and a possible exit code; the exit event tells them apart
+        if (code == -1 && WaitForSingleObject(session->tty.exit_event(), 0) != WAIT_OBJECT_0) {
+            return HTTY_E_TIMEOUT;
+        }
+        if (exit_code) {
+            *exit_code = code;
+        }
+        return HTTY_OK;
+    });
+}
+
+int htty_stop(htty_session* session) {
+    return guarded(session, [&]() -> int {
+        if (!session) return HTTY_E_ARGUMENT;
+        if (!session->spawned) return HTTY_OK;
+
+        // Unblock a read thread waiting for ring space, or stop() could never join it
+        {
+            std::lock_guard<std::mutex> lock(session->mutex);
+            session->stopping = true;
+        }
+        session->cv.notify_all();
+
+        session->tty.stop();
+        ring_end(session);
+        return HTTY_OK;
+    });
+}
+
+int htty_is_running(const htty_session* session) {
+    try {
+        return session && session->tty.is_running() ? 1 : 0;
+    } catch (...) {
+        return 0;
+    }
+}
+
+int htty_get_metrics(const htty_session* session, htty_metrics* metrics) {
+    return guarded(session, [&]() -> int {
+        if (!session || !metrics) return HTTY_E_ARGUMENT;
+
+        headless_tty::IoStats stats = session->tty.get_io_stats();
+        metrics->bytes = stats.bytes;
+        metrics->reads = stats.reads;
+        metrics->callbacks = stats.callbacks;
+
+        std::lock_guard<std::mutex> lock(session->mutex);
+        metrics->buffered = session->count;
+        metrics->buffer_size = session->capacity;
+        metrics->stalls = session->stalls;
+        return HTTY_OK;
+    });
+}
+
+const char* htty_last_error(const htty_session* session) {
+    return session ? session->last_error.c_str() : "";
+}
+
+} // extern "C"
@@ -0,0 +1,407 @@
+#include "headless_tty/command_index.hpp"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace headless_tty {
+
+namespace {
+
+std::string trim(const std::string& text) {
+    size_t start = text.find_first_not_of(' ');
+    if (start == std::string::npos) {
+        return std::string();
+    }
+    return text.substr(start, text.find_last_not_of(' ') - start + 1);
+}
+
+void strip_line_end(std::string& text) {
+    while (!text.empty() && (text.back() == '\n' || text.back() == '\r')) {
+        text.pop_back();
+    }
+}
+
+int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// %XX escapes of an OSC 7 URL
+std::string percent_decode(const std::string& text) {
+    std::string out;
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '%' && i + 2 < text.size() && hex_digit(text[i + 1]) >= 0 && hex_digit(text[i + 2]) >= 0) {
+            out += static_cast<char>(hex_digit(text[i + 1]) * 16 + hex_digit(text[i + 2]));
+            i += 2;
+        } else {
+            out += text[i];
+        }
+    }
+    return out;
+}
+
+// \\ and \xXX escapes of an OSC 633;E command line
+std::string unescape_command(const std::string& text) {
+    std::string out;
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '\\' && i + 1 < text.size() && text[i + 1] == '\\') {
+            out += '\\';
+            ++i;
+        } else if (text[i] == '\\' && i + 3 < text.size() && text[i + 1] == 'x' &&
+                   hex_digit(text[i + 2]) >= 0 && hex_digit(text[i + 3]) >= 0) {
+            out += static_cast<char>(hex_digit(text[i + 2]) * 16 + hex_digit(text[i + 3]));
+            i += 3;
+        } else {
+            out += text[i];
+        }
+    }
+    return out;
+}
+
+// file://host/path -> path; "/C:/dir" -> "C:/dir"
+std::string url_path(const std::string& url) {
+    const char prefix[] = "file://";
+    if (url.compare(0, sizeof(prefix) - 1, prefix) != 0) {
+        return url;
+    }
+    size_t slash = url.find('/', sizeof(prefix) - 1);
+    if (slash == std::string::npos) {
+        return std::string();
+    }
+    std::string path = percent_decode(url.substr(slash));
+    if (path.size() >= 3 && path[0] == '/' && path[2] == ':') {
+        path.erase(0, 1);
+    }
+    return path;
+}
+
+} // namespace
+
+CommandIndex::CommandIndex() {
+    m_collect = [this](const uint8_t* data, size_t length) {
+        collect(data, length);
+    };
+}
+
+void CommandIndex::reset() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_records.clear();
+    m_next_id = 1;
+    m_open = false;
+    m_phase = Phase::Idle;
+    m_prompt_text.clear();
+    m_command_line.clear();
+    m_cwd.clear();
+    m_compactor.reset();
+    m_offset = 0;
+    m_at_mark = false;
+    m_state = State::Ground;
+}
+
+size_t CommandIndex::feed(const uint8_t* data, size_t length) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_at_mark = false;
+
+    size_t i = 0;
+    bool marked = false;
+    while (i < length && !marked) {
+        uint8_t c = data[i++];
+        switch (m_state) {
+            case State::Ground:
+                if (c == 0x1B) {
+                    m_state = State::Escape;
+                } else {
+                    const void* esc = memchr(data + i, 0x1B, length - i);
+                    i = esc ? static_cast<size_t>(static_cast<const uint8_t*>(esc) - data) : length;
+                }
+                break;
+
+            case State::Escape:
+                if (c == ']') {
+                    m_state = State::Osc;
+                    m_osc.clear();
+                    m_osc_overflow = false;
+                } else if (c != 0x1B) {
+                    m_state = State::Ground;
+                }
+                break;
+
+            case State::Osc:
+                if (c == 0x07) {
+                    m_state = State::Ground;
+                    marked = dispatch();
+                } else if (c == 0x1B) {
+                    m_state = State::OscEscape;
+                } else if (m_osc.size() < SCREEN_OSC_MAX) {
+                    m_osc += static_cast<char>(c);
+                } else {
+                    m_osc_overflow = true;
+                }
+                break;
+
+            case State::OscEscape:
+                if (c == '\\') {
+                    m_state = State::Ground;
+                    marked = dispatch();
+                } else if (c == ']') {
+                    m_state = State::Osc;       // Unterminated string followed by a new one
+                    m_osc.clear();
+                    m_osc_overflow = false;
+                } else {
+                    m_state = State::Ground;
+                }
+                break;
+        }
+    }
+
+    // The compactor sees everything up to the mark before the mark takes effect
+    m_compactor.feed(data, i, m_collect);
+    m_offset += i;
+    if (marked) {
+        // "133;D;0": the kind, then its arguments after another ';'
+        size_t sep = m_osc.find(';');
+        char kind = m_osc[sep + 1];
+        mark(kind, sep + 3 < m_osc.size() ? m_osc.substr(sep + 3) : std::string());
+    }
+    return i;
+}
+
+bool CommandIndex::dispatch() {
+    if (m_osc_overflow) {
+        return false;
+    }
+    size_t sep = m_osc.find(';');
+    std::string code = m_osc.substr(0, sep);
+    if (sep == std::string::npos) {
+        return false;
+    }
+    if (code == "7") {
+        m_cwd = url_path(m_osc.substr(sep + 1));
+        return false;
+    }
+    if (code != "133" && code != "633") {
+        return false;
+    }
+    char kind = sep + 1 < m_osc.size() ? m_osc[sep + 1] : 0;
+    if (kind == 'E' && code == "633") {
+        // 633;E;<command line>[;nonce]
+        std::string line = sep + 3 < m_osc.size() ? m_osc.substr(sep + 3) : std::string();
+        m_command_line = unescape_command(line.substr(0, line.find(';')));
+        return false;
+    }
+    return kind >= 'A' && kind <= 'D';
+}
+
+void CommandIndex::collect(const uint8_t* data, size_t length) {
+    if (!m_open) {
+        return;
+    }
+    CommandRecord& record = m_records.back();
+    if (m_phase == Phase::Command) {
+        record.command.append(reinterpret_cast<const char*>(data), length);
+    } else if (m_phase == Phase::Output) {
+        record.output.append(reinterpret_cast<const char*>(data), length);
+        if (record.output.size() > 2 * COMMAND_OUTPUT_LIMIT) {
+            record.output.erase(0, record.output.size() - COMMAND_OUTPUT_LIMIT);    // Amortized
+            record.output_truncated = true;
+        }
+    }
+}
+
+CommandRecord& CommandIndex::open_record() {
+    if (!m_open) {
+        CommandRecord record;
+        record.id = m_next_id++;
+        record.cwd = m_cwd;
+        m_records.push_back(std::move(record));
+        m_open = true;
+        m_command_line.clear();
+        if (m_records.size() > COMMAND_INDEX_SIZE) {
+            m_records.pop_front();
+        }
+    }
+    return m_records.back();
+}
+
+void CommandIndex::mark(char kind, const std::string& args) {
+    // Lines above the cursor are final once a mark arrives; they belong to the phase ending here
+    if (kind == 'A' || kind == 'B' || kind == 'C' || m_phase == Phase::Output || m_phase == Phase::Command) {
+        m_compactor.commit(m_collect);
+    }
+
+    switch (kind) {
+        case 'A':
+            if (m_open && m_phase != Phase::Prompt && m_phase != Phase::Idle) {
+                finish(false, 0);
+            }
+            open_record().prompt_offset = m_offset;
+            m_phase = Phase::Prompt;
+            break;
+
+        case 'B': {
+            CommandRecord& record = open_record();
+            record.command_offset = m_offset;
+            record.command.clear();
+            m_prompt_text = trim(m_compactor.cursor_line_text());
+            m_phase = Phase::Command;
+            break;
+        }
+
+        case 'C': {
+            CommandRecord& record = open_record();
+            if (m_phase == Phase::Command) {
+                // The command line is finished once the command runs; take it with the prompt removed
+                record.command += m_compactor.cursor_line_text();
+                std::string line = record.command;
+                if (line.compare(0, m_prompt_text.size(), m_prompt_text) == 0) {
+                    line.erase(0, m_prompt_text.size());
+                }
+                strip_line_end(line);
+                record.command = trim(line);
+            }
+            if (!m_command_line.empty()) {
+                record.command = m_command_line;
+            }
+            record.cwd = m_cwd;
+            record.output_offset = m_offset;
+            m_phase = Phase::Output;
+            break;
+        }
+
+        case 'D': {
+            if (!m_open || (m_phase != Phase::Output && m_phase != Phase::Command)) {
+                return;     // Shells send D before every prompt, commands or not
+            }
+            if (m_phase == Phase::Output) {
+                m_records.back().output += m_compactor.cursor_line_text();     // Output that didn't end its last line
+            }
+            uint64_t id = m_records.back().id;
+            char* end = nullptr;
+            long code = args.empty() ? 0 : strtol(args.c_str(), &end, 10);
+            finish(!args.empty() && end != args.c_str(), static_cast<int>(code));
+            if (m_records.empty() || m_records.back().id != id) {
+                return;     // Dropped as an empty command
+            }
+            break;
+        }
+
+        default:
+            return;
+    }
+
+    m_at_mark = true;
+    m_mark_id = m_records.back().id;
+    m_mark_kind = kind;
+}
+
+void CommandIndex::finish(bool has_exit_code, int exit_code) {
+    CommandRecord& record = m_records.back();
+    if (m_phase == Phase::Command) {
+        // No C mark: the first line is the command, the rest its output
+        std::string text = record.command;
+        size_t eol = text.find("\r\n");
+        std::string line = text.substr(0, eol);
+        if (line.compare(0, m_prompt_text.size(), m_prompt_text) == 0) {
+            line.erase(0, m_prompt_text.size());
+        }
+        record.command = m_command_line.empty() ? trim(line) : m_command_line;
+        record.output = eol == std::string::npos ? std::string() : text.substr(eol + 2);
+        record.cwd = m_cwd;
+        if (record.command.empty() && record.output.empty()) {
+            // Enter on an empty prompt
+            m_records.pop_back();
+            --m_next_id;
+            m_open = false;
+            m_phase = Phase::Idle;
+            return;
+        }
+    }
+    if (record.output.size() > COMMAND_OUTPUT_LIMIT) {
+        record.output.erase(0, record.output.size() - COMMAND_OUTPUT_LIMIT);
+        record.output_truncated = true;
+    }
+    record.end_offset = m_offset;
+    record.has_exit_code = has_exit_code;
+    record.exit_code = exit_code;
+    record.finished = true;
+    m_open = false;
+    m_phase = Phase::Idle;
+}
+
+void CommandIndex::set_mark_line(uint64_t line) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    CommandRecord* record = find(m_mark_id);
+    if (!record) {
+        return;
+    }
+    switch (m_mark_kind) {
+        case 'A': record->prompt_line = line; break;
+        case 'B': record->command_line = line; break;
+        case 'C': record->output_line = line; break;
+        case 'D': record->end_line = line; break;
+    }
+}
+
+void CommandIndex::close() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_compactor.flush(m_collect);
+    if (m_open && (m_phase == Phase::Output || m_phase == Phase::Command)) {
+        finish(false, 0);
+    } else if (m_open) {
+        // Only a prompt: nothing ran
+        m_records.pop_back();
+        --m_next_id;
+        m_open = false;
+    }
+    m_phase = Phase::Idle;
+}
+
+CommandRecord* CommandIndex::find(uint64_t id) {
+    if (m_records.empty() || id < m_records.front().id || id > m_records.back().id) {
+        return nullptr;
+    }
+    return &m_records[static_cast<size_t>(id - m_records.front().id)];
+}
+
+bool CommandIndex::command(uint64_t id, CommandRecord& record) const {
+    return read_command(id, [&record](const CommandRecord& found) { record = found; });
+}
+
+bool CommandIndex::last_command(CommandRecord& record) const {
+    return read_last_command([&record](const CommandRecord& found) { record = found; });
+}
+
+bool CommandIndex::read_command(uint64_t id, const RecordReader& reader) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_records.empty() || id < m_records.front().id || id > m_records.back().id) {
+        return false;
+    }
+    reader(m_records[static_cast<size_t>(id - m_records.front().id)]);
+    return true;
+}
+
+bool CommandIndex::read_last_command(const RecordReader& reader) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // Only the newest record can still be open
+    for (auto it = m_records.rbegin(); it != m_records.rend() && it - m_records.rbegin() < 2; ++it) {
+        if (it->finished) {
+            reader(*it);
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t CommandIndex::last_id() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_records.empty() ? 0 : m_records.back().id;
+}
+
+std::string CommandIndex::cwd() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_cwd;
+}
+
+} // namespace headless_tty
@@ -0,0 +1,347 @@
+#include "headless_tty/converter.hpp"
+#include "headless_tty/line_compactor.hpp"
+#include "headless_tty/screen.hpp"
+#include "headless_tty/utf8.hpp"
+#include "win_error.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <cstdio>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace headless_tty {
+
+namespace {
+
+// Stages: copyable converters fed consecutive pieces of the capture
+
+class TextStage {
+public:
+    explicit TextStage(const ConvertOptions& options) {
+        CompactOptions compact;
+        compact.rows = options.size.rows;
+        m_compactor = LineCompactor(compact);
+    }
+
+    void feed(const uint8_t* data, size_t length, uint64_t offset, std::string& out) {
+        (void)offset;
+        m_compactor.feed(data, length, [&out](const uint8_t* text, size_t n) {
+            out.append(reinterpret_cast<const char*>(text), n);
+        });
+    }
+
+    void finish(std::string& out) {
+        m_compactor.flush([&out](const uint8_t* text, size_t n) {
+            out.append(reinterpret_cast<const char*>(text), n);
+        });
+    }
+
+    bool same_state(const TextStage& other) const { return m_compactor.same_state(other.m_compactor); }
+
+private:
+    LineCompactor m_compactor;
+};
+
+class CastStage {
+public:
+    explicit CastStage(const ConvertOptions&) {}
+
+    // Events never split a codepoint; segments start on one, so no state carries over
+    void feed(const uint8_t* data, size_t length, uint64_t offset, std::string& out) {
+        size_t pos = 0;
+        while (pos < length) {
+            size_t n = std::min(length - pos, CONVERT_CAST_EVENT_BYTES);
+            if (pos + n < length) {
+                size_t cut = n;
+                while (cut > 0 && (data[pos + cut] & 0xC0) == 0x80) {
+                    --cut;
+                }
+                n = cut > 0 ? cut : n;
+            }
+            char time[32];
+            std::snprintf(time, sizeof(time), "[%.6f, \"o\", \"",
+                          static_cast<double>(offset + pos) / CONVERT_CAST_BYTES_PER_SECOND);
+            out += time;
+            append_json(data + pos, n, out);
+            out += "\"]\n";
+            pos += n;
+        }
+    }
+
+    void finish(std::string&) {}
+    bool same_state(const CastStage&) const { return true; }
+
+private:
+    static void append_json(const uint8_t* data, size_t length, std::string& out) {
+        static const char hex[] = "0123456789abcdef";
+        size_t pos = 0;
+        while (pos < length) {
+            size_t valid = utf8_valid_prefix(data + pos, length - pos);
+            for (size_t i = pos; i < pos + valid; ++i) {
+                uint8_t c = data[i];
+                if (c == '"' || c == '\\') {
+                    out += '\\';
+                    out += static_cast<char>(c);
+                } else if (c < 0x20 || c == 0x7F) {
+                    out += "\\u00";
+                    out += hex[c >> 4];
+                    out += hex[c & 0xF];
+                } else {
+                    out += static_cast<char>(c);
+                }
+            }
+            pos += valid;
+            if (pos < length) {
+                out += "\\ufffd";   // Ill-formed byte
+                ++pos;
+            }
+        }
+    }
+};
+
+class ScreenStage {
+public:
+    explicit ScreenStage(const ConvertOptions& options)
+        : m_screen(options.size, 0), m_interval(std::max<uint64_t>(options.dump_interval, 1)) {}
+
+    void feed(const uint8_t* data, size_t length, uint64_t offset, std::string& out) {
+        size_t pos = 0;
+        while (pos < length) {
+            uint64_t next = m_interval - (offset + pos) % m_interval;
+            size_t n = static_cast<size_t>(std::min<uint64_t>(next, length - pos));
+            m_screen.feed(data + pos, n);
+            pos += n;
+            if ((offset + pos) % m_interval == 0) {
+                dump(offset + pos, out);
+            }
+        }
+        m_offset = offset + length;
+    }
+
+    void finish(std::string& out) {
+        if (m_offset % m_interval != 0) {
+            dump(m_offset, out);
+        }
+    }
+
+    bool same_state(const ScreenStage& other) const { return m_screen.same_live_state(other.m_screen); }
+
+private:
+    void dump(uint64_t offset, std::string& out) const {
+        out += "--- offset " + std::to_string(offset) + " ---\r\n";
+        for (uint16_t y = 0; y < m_screen.size().rows; ++y) {
+            out += m_screen.line_text(y);
+            out += "\r\n";
+        }
+    }
+
+    Screen m_screen;
+    uint64_t m_interval;
+    uint64_t m_offset = 0;
+};
+
+// Segment starts: just after a newline near every CONVERT_SEGMENT_BYTES, else on a codepoint
+std::vector<size_t> split_points(const uint8_t* data, size_t length) {
+    std::vector<size_t> cuts(1, 0);
+    size_t nominal = CONVERT_SEGMENT_BYTES;
+    while (nominal < length) {
+        size_t limit = std::min(length, nominal + CONVERT_WARMUP_BYTES);
+        const void* nl = std::memchr(data + nominal, '\n', limit - nominal);
+        size_t cut;
+        if (nl) {
+            cut = static_cast<const uint8_t*>(nl) - data + 1;
+        } else {
+            cut = nominal;
+            while (cut > cuts.back() + 1 && (data[cut] & 0xC0) == 0x80) {
+                --cut;
+            }
+        }
+        if (cut >= length) {
+            break;
+        }
+        cuts.push_back(cut);
+        nominal = cut + CONVERT_SEGMENT_BYTES;
+    }
+    cuts.push_back(length);
+    return cuts;
+}
+
+template <typename Stage>
+void convert_segments(const uint8_t* data, size_t length, const ConvertOptions& options,
+                      const OutputCallback& write, ConvertStats& stats) {
+    std::vector<size_t> cuts = split_points(data, length);
+    size_t segments = cuts.size() - 1;
+    unsigned threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::min<size_t>(threads, std::max<size_t>(segments, 1)));
+    stats.segments = segments;
+    stats.threads = threads;
+
+    auto emit = [&write, &stats](const std::string& out) {
+        if (!out.empty()) {
+            write(reinterpret_cast<const uint8_t*>(out.data()), out.size());
+            stats.output_bytes += out.size();
+        }
+    };
+
+    struct Slot {
+        std::optional<Stage> start;     // Guessed state at the segment start
+        std::optional<Stage> end;
+        std::string out;
+    };
+
+    // Batches bound the output held in memory; the first segment of a batch starts from
+    // the exact state the previous batch ended in
+    const Stage fresh(options);
+    Stage carried(options);
+    size_t batch = static_cast<size_t>(threads) * 2;
+    std::vector<Slot> slots;
+
+    for (size_t first = 0; first < segments; first += batch) {
+        size_t count = std::min(batch, segments - first);
+        slots.clear();
+        slots.resize(count);
+
+        std::atomic<size_t> next{ 0 };
+        auto worker = [&]() {
+            std::string scratch;
+            for (size_t k = next++; k < count; k = next++) {
+                size_t i = first + k;
+                Stage stage = k == 0 ? carried : fresh;
+                if (k > 0) {
+                    size_t from = cuts[i] - std::min(cuts[i] - cuts[i - 1], CONVERT_WARMUP_BYTES);
+                    stage.feed(data + from, cuts[i] - from, from, scratch);
+                    scratch.clear();
+                }
+                slots[k].start.emplace(stage);
+                stage.feed(data + cuts[i], cuts[i + 1] - cuts[i], cuts[i], slots[k].out);
+                slots[k].end.emplace(std::move(stage));
+            }
+        };
+        std::vector<std::thread> pool;
+        for (unsigned t = 1; t < std::min<size_t>(threads, count); ++t) {
+            pool.emplace_back(worker);
+        }
+        worker();
+        for (std::thread& thread : pool) {
+            thread.join();
+        }
+
+        for (size_t k = 0; k < count; ++k) {
+            if (k > 0 && !slots[k - 1].end->same_state(*slots[k].start)) {
+                size_t i = first + k;
+                Stage stage = *slots[k - 1].end;
+                slots[k].out.clear();
+                stage.feed(data + cuts[i], cuts[i + 1] - cuts[i], cuts[i], slots[k].out);
+                slots[k].end.emplace(std::move(stage));
+                ++stats.redone;
+            }
+            emit(slots[k].out);
+            slots[k].out = std::string();
+        }
+        carried = *slots[count - 1].end;
+    }
+
+    std::string out;
+    carried.finish(out);
+    emit(out);
+}
+
+bool write_all(HANDLE hFile, const void* data, size_t length) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    while (length > 0) {
+        DWORD chunk = length > 0x40000000 ? 0x40000000 : static_cast<DWORD>(length);
+        DWORD written = 0;
+        if (!WriteFile(hFile, p, chunk, &written, NULL) || written == 0) {
+            return false;
+        }
+        p += written;
+        length -= written;
+    }
+    return true;
+}
+
+bool fail(std::string* error, const std::string& msg) {
+    if (error) *error = msg;
+    return false;
+}
+
+} // namespace
+
+void convert_capture(const uint8_t* data, size_t length, const ConvertOptions& options,
+                     const OutputCallback& write, ConvertStats* stats) {
+    ConvertStats local;
+    local.input_bytes = length;
+
+    switch (options.format) {
+        case ConvertFormat::Text:
+            convert_segments<TextStage>(data, length, options, write, local);
+            break;
+
+        case ConvertFormat::Asciicast: {
+            std::string header = "{\"version\": 2, \"width\": " + std::to_string(options.size.cols) +
+                                 ", \"height\": " + std::to_string(options.size.rows) + "}\n";
+            write(reinterpret_cast<const uint8_t*>(header.data()), header.size());
+            local.output_bytes += header.size();
+            convert_segments<CastStage>(data, length, options, write, local);
+            break;
+        }
+
+        case ConvertFormat::Screens:
+            convert_segments<ScreenStage>(data, length, options, write, local);
+            break;
+    }
+
+    if (stats) {
+        *stats = local;
+    }
+}
+
+bool convert_capture_file(const std::wstring& input, const std::wstring& output, const ConvertOptions& options,
+                          ConvertStats* stats, std::string* error) {
+    HANDLE hIn = CreateFileW(input.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                             OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (hIn == INVALID_HANDLE_VALUE) {
+        return fail(error, format_win_error("Failed to open capture"));
+    }
+
+    LARGE_INTEGER size = {};
+    GetFileSizeEx(hIn, &size);
+    const uint8_t* view = nullptr;
+    if (size.QuadPart > 0) {
+        HANDLE hMapping = CreateFileMappingW(hIn, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (hMapping) {
+            view = static_cast<const uint8_t*>(MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0));
+            CloseHandle(hMapping);
+        }
+        if (!view) {
+            std::string msg = format_win_error("Failed to map capture");
+            CloseHandle(hIn);
+            return fail(error, msg);
+        }
+    }
+    CloseHandle(hIn);
+
+    HANDLE hOut = CreateFileW(output.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (hOut == INVALID_HANDLE_VALUE) {
+        std::string msg = format_win_error("Failed to create output");
+        if (view) UnmapViewOfFile(view);
+        return fail(error, msg);
+    }
+
+    bool ok = true;
+    convert_capture(view, static_cast<size_t>(size.QuadPart), options, [&](const uint8_t* data, size_t length) {
+        if (ok && !write_all(hOut, data, length)) {
+            ok = fail(error, format_win_error("Failed to write output"));
+        }
+    }, stats);
+
+    CloseHandle(hOut);
+    if (view) UnmapViewOfFile(view);
+    return ok;
+}
+
+} // namespace headless_tty
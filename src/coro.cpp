@@ -0,0 +1,490 @@
+#include "headless_tty/coro.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <type_traits>
+
+namespace headless_tty {
+
+namespace {
+
+enum OpKind : int {
+    OP_NONE,
+    OP_READ,
+    OP_EXPECT,
+    OP_WRITE,
+    OP_EXIT
+};
+
+// One thread for every timeout and sleep in the process; callbacks only post to executors
+class TimerThread {
+public:
+    static TimerThread& instance() {
+        static TimerThread timers;
+        return timers;
+    }
+
+    void schedule(std::chrono::steady_clock::time_point when, std::function<void()> callback) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_timers.emplace(when, std::move(callback));
+        }
+        m_cv.notify_one();
+    }
+
+    ~TimerThread() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_cv.notify_one();
+        m_thread.join();
+    }
+
+private:
+    TimerThread() : m_thread([this] { run(); }) {}
+
+    void run() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_stop) {
+            if (m_timers.empty()) {
+                m_cv.wait(lock);
+                continue;
+            }
+            auto first = m_timers.begin();
+            if (first->first > std::chrono::steady_clock::now()) {
+                m_cv.wait_until(lock, first->first);
+                continue;
+            }
+            std::function<void()> callback = std::move(first->second);
+            m_timers.erase(first);
+            lock.unlock();
+            callback();
+            lock.lock();
+        }
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::multimap<std::chrono::steady_clock::time_point, std::function<void()>> m_timers;
+    bool m_stop = false;
+    std::thread m_thread;
+};
+
+} // namespace
+
+
+// ThreadPoolExecutor
+
+ThreadPoolExecutor::ThreadPoolExecutor(unsigned threads) {
+    if (threads == 0) {
+        threads = 1;
+    }
+    for (unsigned i = 0; i < threads; ++i) {
+        m_threads.emplace_back([this] { worker(); });
+    }
+}
+
+ThreadPoolExecutor::~ThreadPoolExecutor() {
+    stop();
+}
+
+void ThreadPoolExecutor::post(std::coroutine_handle<> handle) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back(handle);
+    }
+    m_cv.notify_one();
+}
+
+void ThreadPoolExecutor::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    for (std::thread& thread : m_threads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+}
+
+void ThreadPoolExecutor::worker() {
+    while (true) {
+        std::coroutine_handle<> handle;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+            if (m_queue.empty()) {
+                return;
+            }
+            handle = m_queue.front();
+            m_queue.pop_front();
+        }
+        handle.resume();
+    }
+}
+
+
+// CoSession
+
+struct CoSession::State {
+    explicit State(Executor& e) : executor(e) {}
+
+    Executor& executor;
+    HeadlessTTY tty;
+
+    std::mutex mutex;
+    std::condition_variable space;      // Read thread waits here while the buffer is full
+    std::string buffer;
+    size_t head = 0;                    // Unread output starts here
+    bool ended = false;
+    bool stopping = false;
+
+    // The pending operation; generation tells a stale timeout from the current one
+    int kind = OP_NONE;
+    std::coroutine_handle<> waiter;
+    uint64_t generation = 0;
+    size_t max = 0;
+    PatternMatcher matcher;
+    EscapeStripper stripper;
+    bool ignore_escapes = false;
+    size_t scanned = 0;                 // Bytes after head already run through the matcher
+
+    // Results for the awaiter
+    ReadResult read_result;
+    ExpectResult expect_result;
+    bool timed_out = false;
+    bool write_ok = false;
+
+    // A write() in flight on the thread pool; holds the session until it has resumed the awaiter
+    struct WriteJob {
+        std::shared_ptr<State> state;
+        std::string data;
+    };
+
+    static void CALLBACK run_write(PTP_CALLBACK_INSTANCE, void* context) {
+        std::unique_ptr<WriteJob> job(static_cast<WriteJob*>(context));
+        State& state = *job->state;
+        bool ok = state.tty.write(reinterpret_cast<const uint8_t*>(job->data.data()), job->data.size());
+        std::coroutine_handle<> resume;
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.write_ok = ok;
+            resume = state.finish();
+        }
+        state.executor.post(resume);
+    }
+
+    size_t available() const { return buffer.size() - head; }
+
+    void consume(size_t count) {
+        head += count;
+        if (head == buffer.size()) {
+            buffer.clear();
+            head = 0;
+        } else if (head > buffer.size() / 2 && head > CORO_READ_SIZE) {
+            buffer.erase(0, head);      // Amortized compaction
+            head = 0;
+        }
+        space.notify_one();
+    }
+
+    size_t scan(int& matched) {
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(buffer.data()) + head;
+        for (size_t i = scanned; i < available(); ++i) {
+            if (ignore_escapes && !stripper.accept(data[i])) {
+                continue;
+            }
+            int m = matcher.step(data[i]);
+            if (m >= 0) {
+                matched = m;
+                return i + 1;
+            }
+        }
+        scanned = available();
+        return PatternMatcher::npos;
+    }
+
+    // Caller holds mutex. true if the pending operation can complete now.
+    bool try_complete() {
+        switch (kind) {
+            case OP_READ:
+                if (available() > 0) {
+                    size_t n = std::min(max, available());
+                    read_result.data.assign(buffer, head, n);
+                    consume(n);
+                    return true;
+                }
+                read_result.eof = ended;
+                return ended;
+
+            case OP_EXPECT: {
+                int matched = -1;
+                size_t end = scan(matched);
+                if (end != PatternMatcher::npos) {
+                    size_t start = end > EXPECT_WINDOW_SIZE ? end - EXPECT_WINDOW_SIZE : 0;
+                    expect_result.index = matched;
+                    expect_result.output.assign(buffer, head + start, end - start);
+                    consume(end);
+                    scanned = 0;
+                    return true;
+                }
+                // Keep only the window that could still end up in the result
+                if (scanned > 2 * EXPECT_WINDOW_SIZE) {
+                    size_t drop = scanned - EXPECT_WINDOW_SIZE;
+                    consume(drop);
+                    scanned -= drop;
+                }
+                if (ended) {
+                    expect_result.index = EXPECT_EOF;
+                    return true;
+                }
+                return false;
+            }
+
+            case OP_EXIT:
+                return ended;
+
+            default:
+                return false;
+        }
+    }
+
+    // Caller holds mutex; returns the coroutine to resume
+    std::coroutine_handle<> finish() {
+        std::coroutine_handle<> handle = waiter;
+        waiter = nullptr;
+        kind = OP_NONE;
+        ++generation;
+        return handle;
+    }
+
+    void on_output(const uint8_t* data, size_t length) {
+        std::coroutine_handle<> handle;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            // An expect trims as it scans and a wait_exit must see the output end, so only
+            // plain reads (or no operation at all) hold the read thread back
+            space.wait(lock, [this] {
+                return available() < CORO_BUFFER_LIMIT || kind == OP_EXPECT || kind == OP_EXIT || stopping;
+            });
+            if (stopping) {
+                return;
+            }
+            buffer.append(reinterpret_cast<const char*>(data), length);
+            if (waiter && try_complete()) {
+                handle = finish();
+            }
+            // Those two don't hold the read thread back, so bound the buffer by dropping the
+            // oldest output instead (an expect has scanned it already and trims as it goes)
+            if ((kind == OP_EXPECT || kind == OP_EXIT) && available() > CORO_BUFFER_LIMIT) {
+                size_t drop = available() - CORO_BUFFER_LIMIT;
+                consume(drop);
+                scanned -= std::min(scanned, drop);
+            }
+        }
+        if (handle) {
+            executor.post(handle);
+        }
+    }
+
+    void on_exit() {
+        std::coroutine_handle<> handle;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ended = true;
+            if (waiter && try_complete()) {
+                handle = finish();
+            }
+        }
+        if (handle) {
+            executor.post(handle);
+        }
+    }
+};
+
+CoSession::CoSession(Executor& executor) : m_state(std::make_shared<State>(executor)) {
+}
+
+CoSession::~CoSession() {
+    stop();
+}
+
+bool CoSession::start(const Config& config) {
+    State* state = m_state.get();
+    state->tty.set_output_callback([state](const uint8_t* data, size_t length) {
+        state->on_output(data, length);
+    });
+    state->tty.set_exit_callback([state]() {
+        state->on_exit();
+    });
+    return state->tty.start(config);
+}
+
+void CoSession::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+        m_state->stopping = true;
+    }
+    m_state->space.notify_all();
+    m_state->tty.stop();
+}
+
+HeadlessTTY& CoSession::tty() {
+    return m_state->tty;
+}
+
+std::string CoSession::get_last_error() const {
+    return m_state->tty.get_last_error();
+}
+
+CoSession::Op<ReadResult> CoSession::read_some(size_t max, std::chrono::milliseconds timeout) {
+    Op<ReadResult> op(m_state, OP_READ);
+    op.m_max = max > 0 ? max : 1;
+    op.m_timeout = timeout;
+    return op;
+}
+
+CoSession::Op<ExpectResult> CoSession::expect(std::vector<std::string> patterns, std::chrono::milliseconds timeout,
+                                              const ExpectOptions& options) {
+    Op<ExpectResult> op(m_state, OP_EXPECT);
+    op.m_patterns = std::move(patterns);
+    op.m_timeout = timeout;
+    op.m_options = options;
+    return op;
+}
+
+CoSession::Op<bool> CoSession::write(std::string data) {
+    Op<bool> op(m_state, OP_WRITE);
+    op.m_data = std::move(data);
+    return op;
+}
+
+CoSession::Op<int> CoSession::wait_exit(std::chrono::milliseconds timeout) {
+    Op<int> op(m_state, OP_EXIT);
+    op.m_timeout = timeout;
+    return op;
+}
+
+template <typename R>
+bool CoSession::Op<R>::await_suspend(std::coroutine_handle<> handle) {
+    // Once the waiter is published another thread may resume the coroutine and destroy this
+    // Op, so everything needed after that point is copied out first
+    std::shared_ptr<State> keep = m_state;
+    const std::chrono::milliseconds timeout = m_timeout;
+    State& state = *keep;
+
+    if (m_kind == OP_WRITE) {
+        // WriteFile blocks while the child isn't reading; that belongs on a pool thread
+        auto job = std::make_unique<State::WriteJob>(State::WriteJob{ keep, std::move(m_data) });
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.kind = OP_WRITE;
+        state.write_ok = false;
+        if (!TrySubmitThreadpoolCallback(State::run_write, job.get(), NULL)) {
+            return false;
+        }
+        job.release();
+        state.waiter = handle;     // run_write needs the lock to resume, so this comes first
+        return true;
+    }
+
+    // Compile outside the lock so the read thread isn't held up
+    PatternMatcher matcher;
+    if (m_kind == OP_EXPECT && !matcher.build(m_patterns)) {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.expect_result = ExpectResult();
+        state.expect_result.index = EXPECT_ERROR;
+        return false;
+    }
+
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.kind = m_kind;
+        state.max = m_max;
+        state.read_result = ReadResult();
+        state.expect_result = ExpectResult();
+        state.timed_out = false;
+        if (m_kind == OP_EXPECT) {
+            state.matcher = std::move(matcher);
+            state.stripper.reset();
+            state.ignore_escapes = m_options.ignore_escapes;
+            state.scanned = 0;
+        }
+
+        if (state.try_complete()) {
+            state.finish();
+            return false;
+        }
+        state.waiter = handle;
+        generation = state.generation;
+    }
+    state.space.notify_one();   // A waiting expect or wait_exit lifts the read thread's backpressure
+
+    if (timeout.count() >= 0) {
+        std::weak_ptr<State> weak = keep;
+        TimerThread::instance().schedule(std::chrono::steady_clock::now() + timeout, [weak, generation]() {
+            std::shared_ptr<State> state = weak.lock();
+            if (!state) {
+                return;
+            }
+            std::coroutine_handle<> resume;
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (state->waiter && state->generation == generation) {
+                    state->timed_out = true;
+                    state->read_result.timed_out = true;
+                    state->expect_result.index = EXPECT_TIMEOUT;
+                    resume = state->finish();
+                }
+            }
+            if (resume) {
+                state->executor.post(resume);
+            }
+        });
+    }
+    return true;
+}
+
+template <typename R>
+R CoSession::Op<R>::await_resume() {
+    State& state = *m_state;
+    if constexpr (std::is_same_v<R, bool>) {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        return state.write_ok;
+    } else if constexpr (std::is_same_v<R, int>) {
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            if (state.timed_out) {
+                return -1;
+            }
+        }
+        // Output only ends once the console is closed after the child exits, so this doesn't block
+        return state.tty.wait(INFINITE);
+    } else {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if constexpr (std::is_same_v<R, ReadResult>) {
+            return std::move(state.read_result);
+        } else {
+            return std::move(state.expect_result);
+        }
+    }
+}
+
+template class CoSession::Op<ReadResult>;
+template class CoSession::Op<ExpectResult>;
+template class CoSession::Op<bool>;
+template class CoSession::Op<int>;
+
+
+void SleepOp::await_suspend(std::coroutine_handle<> handle) {
+    Executor* executor = &m_executor;
+    TimerThread::instance().schedule(std::chrono::steady_clock::now() + m_delay, [executor, handle]() {
+        executor->post(handle);
+    });
+}
+
+} // namespace headless_tty
@@ -0,0 +1,233 @@
+#include "headless_tty/expect.hpp"
+#include <chrono>
+#include <deque>
+
+namespace headless_tty {
+
+namespace {
+
+// 16K states x 256 x 4 bytes = 16 MB of transition table at most
+constexpr size_t MAX_MATCHER_STATES = 16384;
+
+} // namespace
+
+bool PatternMatcher::build(const std::vector<std::string>& patterns) {
+    m_next.assign(256, -1);
+    m_match.assign(1, -1);
+    m_state = 0;
+
+    if (patterns.empty()) {
+        return false;
+    }
+
+    // Trie
+    for (size_t idx = 0; idx < patterns.size(); ++idx) {
+        const std::string& pattern = patterns[idx];
+        if (pattern.empty()) {
+            return false;
+        }
+
+        int32_t s = 0;
+        for (char ch : pattern) {
+            size_t slot = static_cast<size_t>(s) * 256 + static_cast<uint8_t>(ch);
+            int32_t t = m_next[slot];
+            if (t < 0) {
+                if (m_match.size() >= MAX_MATCHER_STATES) {
+                    return false;
+                }
+                t = static_cast<int32_t>(m_match.size());
+                m_match.push_back(-1);
+                m_next.resize(m_next.size() + 256, -1);
+                m_next[slot] = t;
+            }
+            s = t;
+        }
+        if (m_match[s] < 0) {
+            m_match[s] = static_cast<int32_t>(idx);
+        }
+    }
+
+    // Failure links, folded into a complete transition table (BFS order guarantees
+    // a state's failure target is finished before the state itself)
+    std::vector<int32_t> fail(m_match.size(), 0);
+    std::deque<int32_t> queue;
+
+    for (int c = 0; c < 256; ++c) {
+        int32_t t = m_next[c];
+        if (t < 0) {
+            m_next[c] = 0;
+        } else {
+            fail[t] = 0;
+            queue.push_back(t);
+        }
+    }
+
+    while (!queue.empty()) {
+        int32_t s = queue.front();
+        queue.pop_front();
+
+        int32_t inherited = m_match[fail[s]];
+        if (inherited >= 0 && (m_match[s] < 0 || inherited < m_match[s])) {
+            m_match[s] = inherited;
+        }
+
+        size_t row = static_cast<size_t>(s) * 256;
+        size_t failRow = static_cast<size_t>(fail[s]) * 256;
+        for (int c = 0; c < 256; ++c) {
+            int32_t t = m_next[row + c];
+            if (t < 0) {
+                m_next[row + c] = m_next[failRow + c];
+            } else {
+                fail[t] = m_next[failRow + c];
+                queue.push_back(t);
+            }
+        }
+    }
+
+    return true;
+}
+
+size_t PatternMatcher::feed(const uint8_t* data, size_t length, int& matched) {
+    for (size_t i = 0; i < length; ++i) {
+        int m = step(data[i]);
+        if (m >= 0) {
+            matched = m;
+            return i + 1;
+        }
+    }
+    return npos;
+}
+
+size_t Expecter::scan(const uint8_t* data, size_t length, int& matched) {
+    if (!m_ignore_escapes) {
+        return m_matcher.feed(data, length, matched);
+    }
+
+    for (size_t i = 0; i < length; ++i) {
+        if (!m_stripper.accept(data[i])) {
+            continue;
+        }
+        int m = m_matcher.step(data[i]);
+        if (m >= 0) {
+            matched = m;
+            return i + 1;
+        }
+    }
+    return PatternMatcher::npos;
+}
+
+void Expecter::consume(size_t end, int matched) {
+    size_t start = end > EXPECT_WINDOW_SIZE ? end - EXPECT_WINDOW_SIZE : 0;
+    m_result.index = matched;
+    m_result.output.assign(m_pending, start, end - start);
+    m_pending.erase(0, end);
+    m_matched = true;
+}
+
+void Expecter::trim() {
+    // Amortized: drop the oldest bytes only once the buffer is twice the window
+    if (m_pending.size() > 2 * EXPECT_WINDOW_SIZE) {
+        m_pending.erase(0, m_pending.size() - EXPECT_WINDOW_SIZE);
+    }
+}
+
+void Expecter::feed(const uint8_t* data, size_t length) {
+    bool notify = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        size_t base = m_pending.size();
+        m_pending.append(reinterpret_cast<const char*>(data), length);
+
+        if (m_armed && !m_matched) {
+            int matched = -1;
+            size_t end = scan(data, length, matched);
+            if (end != PatternMatcher::npos) {
+                consume(base + end, matched);
+                notify = true;
+            }
+        }
+
+        trim();
+    }
+
+    if (notify) {
+        m_cv.notify_all();
+    }
+}
+
+void Expecter::close() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+    }
+    m_cv.notify_all();
+}
+
+void Expecter::cancel() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_cancelled = true;
+    }
+    m_cv.notify_all();
+}
+
+void Expecter::reset() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pending.clear();
+    m_closed = false;
+    m_cancelled = false;
+    m_matched = false;
+}
+
+ExpectResult Expecter::expect(const std::vector<std::string>& patterns, uint32_t timeout_ms,
+                              const ExpectOptions& options) {
+    ExpectResult result;
+
+    // Compile outside the lock so the read thread isn't held up
+    PatternMatcher matcher;
+    if (!matcher.build(patterns)) {
+        result.index = EXPECT_ERROR;
+        return result;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_cancelled) {
+        result.index = EXPECT_CANCELLED;
+        return result;
+    }
+    m_matcher = std::move(matcher);
+    m_stripper.reset();
+    m_ignore_escapes = options.ignore_escapes;
+    m_matched = false;
+
+    // Output retained since the previous expect() first
+    int matched = -1;
+    size_t end = scan(reinterpret_cast<const uint8_t*>(m_pending.data()), m_pending.size(), matched);
+    if (end != PatternMatcher::npos) {
+        consume(end, matched);
+    } else if (!m_closed) {
+        m_armed = true;
+        auto done = [this] { return m_matched || m_closed || m_cancelled; };
+        if (timeout_ms == 0xFFFFFFFF) {
+            m_cv.wait(lock, done);
+        } else {
+            m_cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), done);
+        }
+        m_armed = false;
+    }
+
+    if (m_matched) {
+        m_matched = false;
+        return std::move(m_result);
+    }
+
+    if (m_cancelled) {
+        result.index = EXPECT_CANCELLED;
+    } else {
+        result.index = m_closed ? EXPECT_EOF : EXPECT_TIMEOUT;
+    }
+    return result;
+}
+
+} // namespace headless_tty
@@ -0,0 +1,381 @@
+#include "headless_tty/expect_script.hpp"
+#include "session_sleep.hpp"
+#include "win_error.hpp"
+#include <algorithm>
+#include <sstream>
+
+namespace headless_tty {
+
+namespace {
+
+constexpr uint32_t DEFAULT_SCRIPT_TIMEOUT_MS = 10000;
+constexpr uint32_t DEFAULT_READY_QUIET_MS = 100;        // Plain "wait-ready"
+
+int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Split a script line into words; quoted words support C-style escapes
+bool tokenize(const std::string& line, std::vector<std::string>& tokens, std::string& error) {
+    size_t i = 0;
+    while (i < line.size()) {
+        char c = line[i];
+        if (c == ' ' || c == '\t' || c == '\r') {
+            ++i;
+            continue;
+        }
+        if (c == '#') {
+            break;
+        }
+
+        std::string token;
+        if (c != '"') {
+            while (i < line.size() && line[i] != ' ' && line[i] != '\t' && line[i] != '\r') {
+                token += line[i++];
+            }
+            tokens.push_back(token);
+            continue;
+        }
+
+        ++i;
+        bool closed = false;
+        while (i < line.size()) {
+            c = line[i++];
+            if (c == '"') {
+                closed = true;
+                break;
+            }
+            if (c != '\\' || i >= line.size()) {
+                token += c;
+                continue;
+            }
+
+            char e = line[i++];
+            switch (e) {
+                case 'r': token += '\r'; break;
+                case 'n': token += '\n'; break;
+                case 't': token += '\t'; break;
+                case 'e': token += '\x1b'; break;
+                case '\\': token += '\\'; break;
+                case '"': token += '"'; break;
+                case 'x': {
+                    int hi = i < line.size() ? hex_value(line[i]) : -1;
+                    int lo = i + 1 < line.size() ? hex_value(line[i + 1]) : -1;
+                    if (hi < 0 || lo < 0) {
+                        error = "bad \\x escape";
+                        return false;
+                    }
+                    token += static_cast<char>(hi * 16 + lo);
+                    i += 2;
+                    break;
+                }
+                default:
+                    token += '\\';
+                    token += e;
+                    break;
+            }
+        }
+        if (!closed) {
+            error = "unterminated string";
+            return false;
+        }
+        tokens.push_back(token);
+    }
+    return true;
+}
+
+bool parse_number(const std::string& text, uint32_t& value) {
+    if (text.empty()) return false;
+    uint64_t v = 0;
+    for (char c : text) {
+        if (c < '0' || c > '9') return false;
+        v = v * 10 + static_cast<uint64_t>(c - '0');
+        if (v > 0xFFFFFFFFull) return false;
+    }
+    value = static_cast<uint32_t>(v);
+    return true;
+}
+
+} // namespace
+
+bool ExpectScript::fail(int line, const std::string& msg) {
+    std::stringstream ss;
+    ss << "line " << line << ": " << msg;
+    m_last_error = ss.str();
+    return false;
+}
+
+bool ExpectScript::load(const std::wstring& path) {
+    HANDLE hFile = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                               OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        m_last_error = format_win_error("Failed to open expect script");
+        return false;
+    }
+
+    std::string text;
+    char buffer[4096];
+    DWORD bytesRead = 0;
+    while (ReadFile(hFile, buffer, sizeof(buffer), &bytesRead, NULL) && bytesRead > 0) {
+        text.append(buffer, bytesRead);
+    }
+    CloseHandle(hFile);
+
+    return parse(text);
+}
+
+bool ExpectScript::parse(const std::string& text) {
+    m_steps.clear();
+
+    std::istringstream in(text);
+    std::string line;
+    int lineNo = 0;
+    bool final_rule = false;    // Since the last rules step
+
+    while (std::getline(in, line)) {
+        ++lineNo;
+
+        std::vector<std::string> tokens;
+        std::string error;
+        if (!tokenize(line, tokens, error)) {
+            return fail(lineNo, error);
+        }
+        if (tokens.empty()) {
+            continue;
+        }
+
+        const std::string& cmd = tokens[0];
+        Step step;
+        step.line = lineNo;
+        step.args.assign(tokens.begin() + 1, tokens.end());
+
+        if (cmd == "timeout" || cmd == "sleep") {
+            step.op = cmd == "timeout" ? Op::Timeout : Op::Sleep;
+            if (step.args.size() != 1 || !parse_number(step.args[0], step.value)) {
+                return fail(lineNo, cmd + " expects a number of milliseconds");
+            }
+        } else if (cmd == "escapes") {
+            step.op = Op::Escapes;
+            if (step.args.size() != 1 || (step.args[0] != "ignore" && step.args[0] != "keep")) {
+                return fail(lineNo, "escapes expects 'ignore' or 'keep'");
+            }
+            step.flag = step.args[0] == "ignore";
+        } else if (cmd == "expect") {
+            step.op = Op::Expect;
+            if (step.args.empty()) {
+                return fail(lineNo, "expect needs at least one pattern");
+            }
+        } else if (cmd == "send" || cmd == "sendline") {
+            step.op = Op::Send;
+            if (step.args.size() != 1) {
+                return fail(lineNo, cmd + " expects one string");
+            }
+            if (cmd == "sendline") {
+                step.args[0] += '\r';
+            }
+        } else if (cmd == "rule") {
+            step.op = Op::Rule;
+            if (!step.args.empty() && step.args.back() == "final") {
+                step.flag = true;
+                step.args.pop_back();
+            }
+            if (step.args.empty() || step.args.size() > 2) {
+                return fail(lineNo, "rule expects a pattern, an optional reply and optional 'final'");
+            }
+            final_rule = final_rule || step.flag;
+        } else if (cmd == "rules") {
+            step.op = Op::Rules;
+            step.value = INFINITE;
+            if (step.args.size() > 1 || (step.args.size() == 1 && !parse_number(step.args[0], step.value))) {
+                return fail(lineNo, "rules expects an optional number of milliseconds");
+            }
+            if (!final_rule) {
+                return fail(lineNo, "rules needs a final rule to finish");
+            }
+            final_rule = false;
+        } else if (cmd == "wait-ready") {
+            step.op = Op::WaitReady;
+            for (size_t i = 0; i < step.args.size(); ++i) {
+                const std::string& word = step.args[i];
+                bool has_value = i + 1 < step.args.size();
+                if (word == "quiet" || word == "cursor") {
+                    uint32_t& ms = word == "quiet" ? step.ready.quiet_ms : step.ready.cursor_stable_ms;
+                    if (!has_value || !parse_number(step.args[++i], ms) || ms == 0) {
+                        return fail(lineNo, word + " expects a number of milliseconds");
+                    }
+                } else if (word == "prompt") {
+                    if (!has_value) {
+                        return fail(lineNo, "prompt expects a string");
+                    }
+                    step.ready.prompts.push_back(step.args[++i]);
+                } else if (word == "paste") {
+                    step.ready.modes |= READY_BRACKETED_PASTE;
+                } else if (word == "keys") {
+                    step.ready.modes |= READY_APP_CURSOR_KEYS;
+                } else if (word == "fullscreen") {
+                    step.ready.modes |= READY_ALT_SCREEN;
+                } else {
+                    return fail(lineNo, "unknown wait-ready condition '" + word + "'");
+                }
+            }
+            if (step.args.empty()) {
+                step.ready.quiet_ms = DEFAULT_READY_QUIET_MS;
+            }
+        } else if (cmd == "wait-exit") {
+            step.op = Op::WaitExit;
+            step.value = INFINITE;
+            if (step.args.size() > 1 || (step.args.size() == 1 && !parse_number(step.args[0], step.value))) {
+                return fail(lineNo, "wait-exit expects an optional number of milliseconds");
+            }
+        } else {
+            return fail(lineNo, "unknown command '" + cmd + "'");
+        }
+
+        m_steps.push_back(std::move(step));
+    }
+
+    return true;
+}
+
+bool ExpectScript::needs_screen() const {
+    for (const Step& step : m_steps) {
+        if (step.op == Op::WaitReady && step.ready.cursor_stable_ms > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ExpectScript::run(HeadlessTTY& tty, HANDLE cancel) {
+    uint32_t timeout = DEFAULT_SCRIPT_TIMEOUT_MS;
+    ExpectOptions options;
+    std::vector<Rule> rules;
+
+    auto expect_failed = [this](const Step& step, const ExpectResult& result) {
+        if (result.index == EXPECT_EOF) {
+            return fail(step.line, "child exited before a pattern matched");
+        }
+        if (result.index == EXPECT_ERROR) {
+            return fail(step.line, "invalid patterns");
+        }
+        if (result.index == EXPECT_CANCELLED) {
+            return fail(step.line, "cancelled");
+        }
+        return fail(step.line, "timed out waiting for a pattern");
+    };
+
+    for (const Step& step : m_steps) {
+        if (cancel && WaitForSingleObject(cancel, 0) == WAIT_OBJECT_0) {
+            return fail(step.line, "cancelled");
+        }
+
+        switch (step.op) {
+            case Op::Timeout:
+                timeout = step.value;
+                break;
+
+            case Op::Escapes:
+                options.ignore_escapes = step.flag;
+                break;
+
+            case Op::Expect: {
+                ExpectResult result = tty.expect(step.args, timeout, options);
+                if (result.index < 0) {
+                    return expect_failed(step, result);
+                }
+                break;
+            }
+
+            case Op::Send:
+                if (!tty.write(step.args[0])) {
+                    return fail(step.line, "write failed: " + tty.get_last_error());
+                }
+                break;
+
+            case Op::Sleep:
+                if (!session_sleep(tty, cancel, step.value)) {
+                    return fail(step.line, "session ended during sleep");
+                }
+                break;
+
+            case Op::Rule: {
+                Rule rule;
+                rule.pattern = step.args[0];
+                rule.reply = step.args.size() > 1 ? step.args[1] : std::string();
+                rule.final = step.flag;
+                rules.push_back(std::move(rule));
+                break;
+            }
+
+            case Op::Rules: {
+                std::vector<std::string> patterns;
+                for (const Rule& rule : rules) {
+                    patterns.push_back(rule.pattern);
+                }
+
+                ULONGLONG start = GetTickCount64();
+                while (true) {
+                    uint32_t wait = timeout;
+                    if (step.value != INFINITE) {
+                        ULONGLONG elapsed = GetTickCount64() - start;
+                        if (elapsed >= step.value) {
+                            return fail(step.line, "no final rule matched in time");
+                        }
+                        wait = static_cast<uint32_t>(std::min<ULONGLONG>(wait, step.value - elapsed));
+                    }
+
+                    ExpectResult result = tty.expect(patterns, wait, options);
+                    if (result.index == EXPECT_TIMEOUT && wait < timeout) {
+                        return fail(step.line, "no final rule matched in time");
+                    }
+                    if (result.index < 0) {
+                        return expect_failed(step, result);
+                    }
+
+                    const Rule& rule = rules[static_cast<size_t>(result.index)];
+                    if (!rule.reply.empty() && !tty.write(rule.reply)) {
+                        return fail(step.line, "write failed: " + tty.get_last_error());
+                    }
+                    if (rule.final) {
+                        break;
+                    }
+                    if (cancel && WaitForSingleObject(cancel, 0) == WAIT_OBJECT_0) {
+                        return fail(step.line, "cancelled");
+                    }
+                }
+                rules.clear();
+                break;
+            }
+
+            case Op::WaitReady: {
+                ReadyEvent event = tty.wait_ready(step.ready, timeout);
+                if (event == ReadyEvent::Timeout) {
+                    return fail(step.line, "timed out waiting for the child to become ready");
+                }
+                if (event == ReadyEvent::Exited) {
+                    return fail(step.line, "child exited before it became ready");
+                }
+                if (event == ReadyEvent::Invalid) {
+                    return fail(step.line, "cursor needs screen tracking");
+                }
+                break;
+            }
+
+            case Op::WaitExit: {
+                HANDLE handles[2] = { tty.exit_event(), cancel };
+                DWORD result = WaitForMultipleObjects(cancel ? 2 : 1, handles, FALSE, step.value);
+                if (result != WAIT_OBJECT_0) {
+                    return fail(step.line, result == WAIT_TIMEOUT ? "child did not exit in time" : "cancelled");
+                }
+                break;
+            }
+        }
+    }
+
+    return true;
+}
+
+} // namespace headless_tty
@@ -0,0 +1,198 @@
+#include "headless_tty/frame_viewer.hpp"
+#include "utf8_encode.hpp"
+
+namespace headless_tty {
+
+namespace {
+
+void append_number(std::string& out, uint32_t value) {
+    char digits[10];
+    int n = 0;
+    do {
+        digits[n++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    while (n > 0) {
+        out += digits[--n];
+    }
+}
+
+void append_color(std::string& out, uint32_t color, bool background) {
+    uint32_t value = color & 0xFFFFFF;
+    if (color & COLOR_RGB) {
+        out += background ? ";48;2;" : ";38;2;";
+        append_number(out, value >> 16);
+        out += ';';
+        append_number(out, (value >> 8) & 0xFF);
+        out += ';';
+        append_number(out, value & 0xFF);
+    } else if (color & COLOR_INDEXED) {
+        out += ';';
+        if (value < 8) {
+            append_number(out, (background ? 40 : 30) + value);
+        } else if (value < 16) {
+            append_number(out, (background ? 100 : 90) + value - 8);
+        } else {
+            out += background ? "48;5;" : "38;5;";
+            append_number(out, value);
+        }
+    }
+}
+
+void append_sgr(std::string& out, const Cell& cell) {
+    static const struct { uint16_t attr; const char* code; } attrs[] = {
+        { ATTR_BOLD, ";1" }, { ATTR_DIM, ";2" }, { ATTR_ITALIC, ";3" }, { ATTR_UNDERLINE, ";4" },
+        { ATTR_BLINK, ";5" }, { ATTR_INVERSE, ";7" }, { ATTR_HIDDEN, ";8" }, { ATTR_STRIKE, ";9" }
+    };
+
+    out += "\x1b[0";
+    for (const auto& a : attrs) {
+        if (cell.attrs & a.attr) {
+            out += a.code;
+        }
+    }
+    append_color(out, cell.fg, false);
+    append_color(out, cell.bg, true);
+    out += 'm';
+}
+
+bool same_style(const Cell& a, const Cell& b) {
+    return a.fg == b.fg && a.bg == b.bg && a.attrs == b.attrs;
+}
+
+} // namespace
+
+FrameViewer::~FrameViewer() {
+    stop();
+}
+
+void FrameViewer::start(TerminalSize size, uint32_t fps, FrameCallback callback) {
+    stop();
+
+    m_screen = Screen(size);
+    m_callback = std::move(callback);
+    m_interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::microseconds(1000000 / (fps > 0 ? fps : 1)));
+    m_dirty = false;
+    m_stop = false;
+    m_stats = FrameViewerStats();
+    m_thread = std::thread(&FrameViewer::viewer_loop, this);
+}
+
+void FrameViewer::feed(const uint8_t* data, size_t length) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_screen.feed(data, length);
+        ++m_stats.updates;
+        if (m_dirty) {
+            return;     // Viewer already has a wakeup pending
+        }
+        m_dirty = true;
+    }
+    m_cv.notify_one();
+}
+
+void FrameViewer::resize(TerminalSize size) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_screen.resize(size);
+        m_dirty = true;
+    }
+    m_cv.notify_one();
+}
+
+void FrameViewer::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_one();
+
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+FrameViewerStats FrameViewer::stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void FrameViewer::viewer_loop() {
+    auto next = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_cv.wait(lock, [this] { return m_dirty || m_stop; });
+        if (!m_dirty) {
+            break;
+        }
+
+        // Let output pile up until the frame interval has passed
+        m_cv.wait_until(lock, next, [this] { return m_stop; });
+
+        m_screen.snapshot(m_frame);
+        m_dirty = false;
+        ++m_stats.frames;
+
+        lock.unlock();
+        m_callback(m_frame);
+        next = std::chrono::steady_clock::now() + m_interval;
+        lock.lock();
+    }
+}
+
+void render_frame(const ScreenFrame& frame, std::string& out) {
+    out.clear();
+    out += "\x1b[?25l";
+
+    const Cell* pen = nullptr;
+    for (uint16_t y = 0; y < frame.size.rows; ++y) {
+        const Cell* row = frame.cells.data() + static_cast<size_t>(y) * frame.size.cols;
+
+        // Trailing default blanks are cleared with EL instead of being drawn
+        size_t end = frame.size.cols;
+        while (end > 0 && row[end - 1].ch == U' ' && row[end - 1].bg == COLOR_DEFAULT &&
+               !(row[end - 1].attrs & (ATTR_INVERSE | ATTR_UNDERLINE | ATTR_STRIKE))) {
+            --end;
+        }
+
+        out += "\x1b[";
+        append_number(out, y + 1u);
+        out += ";1H";
+
+        for (size_t x = 0; x < end; ++x) {
+            const Cell& cell = row[x];
+            if (cell.width == 0) {
+                continue;
+            }
+            if (!pen || !same_style(*pen, cell)) {
+                append_sgr(out, cell);
+                pen = &cell;
+            }
+            for (char32_t cp : cell_codepoints(cell, frame.clusters)) {
+                append_utf8(out, cp);
+            }
+        }
+
+        if (end < frame.size.cols) {
+            if (!pen || pen->fg != COLOR_DEFAULT || pen->bg != COLOR_DEFAULT || pen->attrs != 0) {
+                out += "\x1b[0m";
+                static const Cell plain;
+                pen = &plain;
+            }
+            out += "\x1b[K";
+        }
+    }
+
+    out += "\x1b[0m\x1b[";
+    append_number(out, frame.cursor_y + 1u);
+    out += ';';
+    append_number(out, frame.cursor_x + 1u);
+    out += 'H';
+    if (frame.modes.cursor_visible) {
+        out += "\x1b[?25h";
+    }
+}
+
+} // namespace headless_tty
@@ -0,0 +1,154 @@
+#include "headless_tty/framed.hpp"
+
+#include <algorithm>
+
+namespace headless_tty {
+
+namespace {
+
+void put_u16(uint8_t* out, uint16_t value) {
+    out[0] = static_cast<uint8_t>(value);
+    out[1] = static_cast<uint8_t>(value >> 8);
+}
+
+void put_u32(uint8_t* out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+void put_u64(uint8_t* out, uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+uint32_t get_u32(const uint8_t* in) {
+    return in[0] | (in[1] << 8) | (in[2] << 16) | (static_cast<uint32_t>(in[3]) << 24);
+}
+
+} // namespace
+
+void append_frame(std::string& out, uint8_t type, const void* payload, size_t length) {
+    uint8_t header[FRAME_HEADER_SIZE];
+    put_frame_header(header, type, static_cast<uint32_t>(length));
+    out.append(reinterpret_cast<const char*>(header), FRAME_HEADER_SIZE);
+    out.append(static_cast<const char*>(payload), length);
+}
+
+
+// FrameWriter
+
+FrameWriter::FrameWriter(OutputBatcher& batcher)
+    : m_batcher(batcher), m_started(GetTickCount64()) {
+}
+
+void FrameWriter::push(uint8_t type, const void* payload, size_t length) {
+    uint8_t header[FRAME_HEADER_SIZE];
+    put_frame_header(header, type, static_cast<uint32_t>(length));
+    OutputSpan spans[2] = {
+        { header, FRAME_HEADER_SIZE },
+        { static_cast<const uint8_t*>(payload), length }
+    };
+    m_batcher.push(spans, 2);
+}
+
+void FrameWriter::hello(const TerminalSize& size) {
+    uint8_t payload[9] = { 'H', 'T', 'T', 'Y', FRAME_PROTOCOL_VERSION };
+    put_u16(payload + 5, size.cols);
+    put_u16(payload + 7, size.rows);
+    push(FRAME_HELLO, payload, sizeof(payload));
+}
+
+void FrameWriter::output(const uint8_t* data, size_t length) {
+    uint32_t time_ms = static_cast<uint32_t>(GetTickCount64() - m_started);
+    const size_t max_chunk = FRAME_MAX_PAYLOAD - FRAME_OUTPUT_PREFIX;
+
+    do {
+        size_t n = std::min(length, max_chunk);
+        uint8_t prefix[FRAME_HEADER_SIZE + FRAME_OUTPUT_PREFIX];
+        put_frame_header(prefix, FRAME_OUTPUT, static_cast<uint32_t>(FRAME_OUTPUT_PREFIX + n));
+        put_u32(prefix + FRAME_HEADER_SIZE, m_seq.fetch_add(1));
+        put_u32(prefix + FRAME_HEADER_SIZE + 4, time_ms);
+        OutputSpan spans[2] = {
+            { prefix, sizeof(prefix) },
+            { data, n }
+        };
+        m_batcher.push(spans, 2);
+        data += n;
+        length -= n;
+    } while (length > 0);
+}
+
+void FrameWriter::exited(int code) {
+    uint8_t payload[4];
+    put_u32(payload, static_cast<uint32_t>(code));
+    push(FRAME_EXIT, payload, sizeof(payload));
+}
+
+void FrameWriter::resized(const TerminalSize& size) {
+    uint8_t payload[4];
+    put_u16(payload, size.cols);
+    put_u16(payload + 2, size.rows);
+    push(FRAME_RESIZE, payload, sizeof(payload));
+}
+
+void FrameWriter::metrics(const IoStats& stats) {
+    uint8_t payload[32];
+    put_u64(payload, stats.bytes);
+    put_u64(payload + 8, stats.reads);
+    put_u64(payload + 16, stats.callbacks);
+    put_u64(payload + 24, m_seq.load());
+    push(FRAME_METRICS, payload, sizeof(payload));
+}
+
+void FrameWriter::error(const std::string& message) {
+    push(FRAME_ERROR, message.data(), std::min(message.size(), FRAME_MAX_PAYLOAD));
+}
+
+
+// FrameParser
+
+void FrameParser::feed(const uint8_t* data, size_t length, const FrameCallback& callback) {
+    const uint8_t* end = data + length;
+
+    // Complete the frame left over from the last call first
+    if (!m_partial.empty()) {
+        if (m_partial.size() < FRAME_HEADER_SIZE) {
+            size_t n = std::min(FRAME_HEADER_SIZE - m_partial.size(), length);
+            m_partial.insert(m_partial.end(), data, data + n);
+            data += n;
+            if (m_partial.size() < FRAME_HEADER_SIZE) {
+                return;
+            }
+        }
+        size_t total = FRAME_HEADER_SIZE + (get_u32(m_partial.data()) >> 8);
+        size_t n = std::min(total - m_partial.size(), static_cast<size_t>(end - data));
+        m_partial.insert(m_partial.end(), data, data + n);
+        data += n;
+        if (m_partial.size() < total) {
+            return;
+        }
+        callback(m_partial[0], m_partial.data() + FRAME_HEADER_SIZE, total - FRAME_HEADER_SIZE);
+        m_partial.clear();
+    }
+
+    // Whole frames straight from the buffer
+    while (static_cast<size_t>(end - data) >= FRAME_HEADER_SIZE) {
+        uint32_t header = get_u32(data);
+        size_t payload = header >> 8;
+        if (static_cast<size_t>(end - data) - FRAME_HEADER_SIZE < payload) {
+            break;
+        }
+        callback(static_cast<uint8_t>(header), data + FRAME_HEADER_SIZE, payload);
+        data += FRAME_HEADER_SIZE + payload;
+    }
+
+    m_partial.assign(data, end);
+}
+
+void FrameParser::reset() {
+    m_partial.clear();
+}
+
+} // namespace headless_tty
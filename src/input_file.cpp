@@ -0,0 +1,170 @@
+#include "headless_tty/input_file.hpp"
+#include "session_sleep.hpp"
+#include "win_error.hpp"
+#include <cstring>
+
+namespace headless_tty {
+
+namespace {
+
+struct StreamState {
+    ULONGLONG started = 0;
+    uint64_t sent = 0;
+    bool at_line_start = true;
+    ULONGLONG last_line_tick = 0;
+};
+
+bool cancelled(HANDLE cancel) {
+    return cancel && WaitForSingleObject(cancel, 0) == WAIT_OBJECT_0;
+}
+
+// Wait until neither output nor our own last line is more recent than quiet_ms
+bool wait_for_quiet(HeadlessTTY& tty, const InputFileOptions& options, const StreamState& state, HANDLE cancel) {
+    ULONGLONG start = GetTickCount64();
+
+    while (true) {
+        ULONGLONG now = GetTickCount64();
+        ULONGLONG lastActivity = tty.last_output_tick();
+        if (state.last_line_tick > lastActivity) {
+            lastActivity = state.last_line_tick;
+        }
+
+        ULONGLONG idle = now - lastActivity;
+        if (idle >= options.quiet_ms || now - start >= options.quiet_timeout_ms) {
+            return true;
+        }
+        if (!session_sleep(tty, cancel, static_cast<DWORD>(options.quiet_ms - idle))) {
+            return false;
+        }
+    }
+}
+
+bool write_paced(HeadlessTTY& tty, const uint8_t* data, size_t length, const InputFileOptions& options,
+                 StreamState& state, HANDLE cancel) {
+    size_t chunkSize = INPUT_FILE_CHUNK_SIZE;
+    if (options.pacing == InputPacing::RateLimited && options.bytes_per_second > 0) {
+        // About 20 writes per second keeps the rate smooth without tiny writes
+        uint64_t slice = options.bytes_per_second / 20;
+        if (slice == 0) slice = 1;
+        if (slice < chunkSize) chunkSize = static_cast<size_t>(slice);
+    }
+
+    while (length > 0) {
+        if (cancelled(cancel) || !tty.is_running()) {
+            return false;
+        }
+
+        size_t n = length < chunkSize ? length : chunkSize;
+        // Synchronous write: blocks while the PTY input pipe is full, which is our flow control
+        if (!tty.write(data, n)) {
+            return false;
+        }
+        data += n;
+        length -= n;
+        state.sent += n;
+
+        if (options.pacing == InputPacing::RateLimited && options.bytes_per_second > 0) {
+            ULONGLONG due = state.started + state.sent * 1000 / options.bytes_per_second;
+            ULONGLONG now = GetTickCount64();
+            if (due > now && !session_sleep(tty, cancel, static_cast<DWORD>(due - now))) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool send_view(HeadlessTTY& tty, const uint8_t* view, size_t length, const InputFileOptions& options,
+               StreamState& state, HANDLE cancel) {
+    if (options.pacing != InputPacing::WaitForQuiet) {
+        return write_paced(tty, view, length, options, state, cancel);
+    }
+
+    // One line at a time; a line may continue into the next view
+    while (length > 0) {
+        const uint8_t* newline = static_cast<const uint8_t*>(memchr(view, '\n', length));
+        size_t lineLength = newline ? static_cast<size_t>(newline - view) + 1 : length;
+
+        if (state.at_line_start && !wait_for_quiet(tty, options, state, cancel)) {
+            return false;
+        }
+        if (!write_paced(tty, view, lineLength, options, state, cancel)) {
+            return false;
+        }
+
+        state.at_line_start = newline != nullptr;
+        state.last_line_tick = GetTickCount64();
+        view += lineLength;
+        length -= lineLength;
+    }
+
+    return true;
+}
+
+} // namespace
+
+bool stream_input_file(HeadlessTTY& tty, const std::wstring& path, const InputFileOptions& options,
+                       HANDLE cancel, std::string* error) {
+    HANDLE hFile = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                               OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        if (error) *error = format_win_error("Failed to open input file");
+        return false;
+    }
+
+    LARGE_INTEGER size = {};
+    if (!GetFileSizeEx(hFile, &size)) {
+        if (error) *error = format_win_error("Failed to get input file size");
+        CloseHandle(hFile);
+        return false;
+    }
+
+    // Empty files can't be mapped and have nothing to send
+    if (size.QuadPart == 0) {
+        CloseHandle(hFile);
+        return true;
+    }
+
+    HANDLE hMapping = CreateFileMappingW(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!hMapping) {
+        if (error) *error = format_win_error("Failed to map input file");
+        CloseHandle(hFile);
+        return false;
+    }
+
+    StreamState state;
+    state.started = GetTickCount64();
+
+    bool ok = true;
+    uint64_t total = static_cast<uint64_t>(size.QuadPart);
+    for (uint64_t offset = 0; ok && offset < total; offset += INPUT_FILE_WINDOW_SIZE) {
+        size_t viewSize = static_cast<size_t>(
+            total - offset < INPUT_FILE_WINDOW_SIZE ? total - offset : INPUT_FILE_WINDOW_SIZE);
+
+        // Only one window is mapped at a time, so address space and working set stay bounded
+        const uint8_t* view = static_cast<const uint8_t*>(MapViewOfFile(
+            hMapping, FILE_MAP_READ, static_cast<DWORD>(offset >> 32),
+            static_cast<DWORD>(offset & 0xFFFFFFFF), viewSize));
+        if (!view) {
+            if (error) *error = format_win_error("Failed to map input file view");
+            ok = false;
+            break;
+        }
+
+        ok = send_view(tty, view, viewSize, options, state, cancel);
+        UnmapViewOfFile(view);
+
+        if (!ok && error) {
+            *error = cancelled(cancel) || !tty.is_running()
+                ? "Input streaming stopped before the end of the file"
+                : "Write to PTY failed: " + tty.get_last_error();
+        }
+    }
+
+    CloseHandle(hMapping);
+    CloseHandle(hFile);
+    return ok;
+}
+
+} // namespace headless_tty
@@ -0,0 +1,222 @@
+#include "headless_tty/latency_probe.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+namespace headless_tty {
+
+namespace {
+
+constexpr double LATENCY_FIRST_BUCKET_US = 250.0;
+
+enum ScanState : uint8_t {
+    SCAN_IDLE,
+    SCAN_TILDE,         // Saw '~'
+    SCAN_DIGITS         // Saw "~L", collecting the sequence number
+};
+
+double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    size_t index = static_cast<size_t>(std::ceil(p * sorted.size()));
+    return sorted[std::min(sorted.size() - 1, index > 0 ? index - 1 : 0)];
+}
+
+std::string format_us(double us) {
+    char text[32];
+    if (us >= 1000.0) {
+        std::snprintf(text, sizeof(text), "%.2f ms", us / 1000.0);
+    } else {
+        std::snprintf(text, sizeof(text), "%.0f us", us);
+    }
+    return text;
+}
+
+} // namespace
+
+LatencyStats summarize_latency(const std::vector<double>& samples_us, size_t lost) {
+    LatencyStats stats;
+    stats.samples = samples_us.size();
+    stats.lost = lost;
+    if (samples_us.empty()) {
+        return stats;
+    }
+
+    std::vector<double> sorted = samples_us;
+    std::sort(sorted.begin(), sorted.end());
+    stats.p50_us = percentile(sorted, 0.50);
+    stats.p90_us = percentile(sorted, 0.90);
+    stats.p99_us = percentile(sorted, 0.99);
+    stats.p999_us = percentile(sorted, 0.999);
+    stats.max_us = sorted.back();
+
+    double sum = 0.0;
+    for (double v : samples_us) {
+        sum += v;
+    }
+    stats.mean_us = sum / samples_us.size();
+
+    double squares = 0.0;
+    double deltas = 0.0;
+    for (size_t i = 0; i < samples_us.size(); ++i) {
+        double d = samples_us[i] - stats.mean_us;
+        squares += d * d;
+        if (i > 0) {
+            deltas += std::fabs(samples_us[i] - samples_us[i - 1]);
+        }
+    }
+    stats.stddev_us = std::sqrt(squares / samples_us.size());
+    stats.jitter_us = samples_us.size() > 1 ? deltas / (samples_us.size() - 1) : 0.0;
+
+    for (double v : samples_us) {
+        size_t bucket = 0;
+        double bound = LATENCY_FIRST_BUCKET_US;
+        while (bucket + 1 < LATENCY_BUCKETS && v >= bound) {
+            ++bucket;
+            bound *= 2.0;
+        }
+        ++stats.histogram[bucket];
+    }
+    return stats;
+}
+
+std::string format_latency(const std::string& title, const LatencyStats& stats) {
+    std::string out = title + "\n";
+    char line[128];
+    std::snprintf(line, sizeof(line), "  samples %zu, lost %zu\n", stats.samples, stats.lost);
+    out += line;
+    if (stats.samples == 0) {
+        return out;
+    }
+
+    const std::pair<const char*, double> rows[] = {
+        { "p50", stats.p50_us }, { "p90", stats.p90_us }, { "p99", stats.p99_us }, { "p99.9", stats.p999_us },
+        { "max", stats.max_us }, { "mean", stats.mean_us }, { "stddev", stats.stddev_us }, { "jitter", stats.jitter_us },
+    };
+    for (const auto& row : rows) {
+        std::snprintf(line, sizeof(line), "  %-7s %12s\n", row.first, format_us(row.second).c_str());
+        out += line;
+    }
+
+    uint32_t peak = *std::max_element(stats.histogram.begin(), stats.histogram.end());
+    double bound = LATENCY_FIRST_BUCKET_US;
+    for (size_t i = 0; i < LATENCY_BUCKETS; ++i) {
+        std::string label = i + 1 < LATENCY_BUCKETS ? "< " + format_us(bound) : ">= " + format_us(bound / 2.0);
+        size_t bar = peak > 0 ? static_cast<size_t>(40.0 * stats.histogram[i] / peak + 0.5) : 0;
+        std::snprintf(line, sizeof(line), "  %12s %6u %s\n", label.c_str(), stats.histogram[i], std::string(bar, '#').c_str());
+        out += line;
+        bound *= 2.0;
+    }
+    return out;
+}
+
+LatencyProbe::LatencyProbe() {
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    m_frequency = frequency.QuadPart;
+}
+
+void LatencyProbe::feed(const uint8_t* data, size_t length) {
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+
+    for (size_t i = 0; i < length; ++i) {
+        uint8_t c = data[i];
+        if (!m_stripper.accept(c)) {
+            continue;
+        }
+
+        if (m_scan == SCAN_DIGITS && c >= '0' && c <= '9' && m_scan_value < 100000000) {
+            m_scan_value = m_scan_value * 10 + (c - '0');
+            continue;
+        }
+        if (m_scan == SCAN_DIGITS && c == '~' && m_scan_value > 0) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_scan_value == m_waiting_for) {
+                m_echo_time = now.QuadPart;
+                m_waiting_for = 0;
+                m_cv.notify_one();
+            }
+        }
+        if (m_scan == SCAN_TILDE && c == 'L') {
+            m_scan = SCAN_DIGITS;
+            m_scan_value = 0;
+            continue;
+        }
+        m_scan = c == '~' ? SCAN_TILDE : SCAN_IDLE;
+    }
+}
+
+bool LatencyProbe::probe(HeadlessTTY& tty, const LatencyOptions& options, HANDLE cancel, double& elapsed_us) {
+    uint32_t seq = m_next_seq++;
+    std::string text = options.prefix + "~L" + std::to_string(seq) + "~" + options.suffix;
+
+    LARGE_INTEGER start;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_waiting_for = seq;
+        QueryPerformanceCounter(&start);
+    }
+    if (!tty.write(text)) {
+        m_last_error = "write failed: " + tty.get_last_error();
+        return false;
+    }
+
+    // Wait in short slices so the cancel event is noticed
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(options.timeout_ms);
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_waiting_for == seq) {
+        if (cancel && WaitForSingleObject(cancel, 0) == WAIT_OBJECT_0) {
+            m_waiting_for = 0;
+            m_last_error = "cancelled";
+            return false;
+        }
+        if (std::chrono::steady_clock::now() >= deadline) {
+            m_waiting_for = 0;
+            elapsed_us = -1.0;
+            return true;
+        }
+        m_cv.wait_for(lock, std::chrono::milliseconds(50));
+    }
+    elapsed_us = (m_echo_time - start.QuadPart) * 1e6 / m_frequency;
+    return true;
+}
+
+bool LatencyProbe::run(HeadlessTTY& tty, const LatencyOptions& options, HANDLE cancel, LatencyStats& stats) {
+    std::vector<double> samples;
+    samples.reserve(options.samples);
+    size_t lost = 0;
+
+    for (uint32_t i = 0; i < options.warmup + options.samples; ++i) {
+        double elapsed = 0.0;
+        if (!probe(tty, options, cancel, elapsed)) {
+            return false;
+        }
+        if (i >= options.warmup) {
+            if (elapsed < 0.0) {
+                ++lost;
+            } else {
+                samples.push_back(elapsed);
+            }
+        }
+        if (cancel && WaitForSingleObject(cancel, options.interval_ms) == WAIT_OBJECT_0) {
+            m_last_error = "cancelled";
+            return false;
+        }
+        if (!cancel && options.interval_ms > 0) {
+            Sleep(options.interval_ms);
+        }
+    }
+
+    stats = summarize_latency(samples, lost);
+    if (samples.empty()) {
+        m_last_error = "no marker was echoed back";
+        return false;
+    }
+    return true;
+}
+
+} // namespace headless_tty
@@ -0,0 +1,413 @@
+#include "headless_tty/line_compactor.hpp"
+#include "utf8_encode.hpp"
+
+#include <algorithm>
+
+namespace headless_tty {
+
+namespace {
+
+constexpr char32_t REPLACEMENT_CHAR = 0xFFFD;
+constexpr size_t MAX_PARAM = 1000000;
+
+} // namespace
+
+LineCompactor::LineCompactor(const CompactOptions& options) : m_options(options) {
+    if (m_options.rows == 0) {
+        m_options.rows = 1;
+    }
+    reset();
+}
+
+void LineCompactor::reset() {
+    m_lines.assign(1, std::u32string());
+    m_row = 0;
+    m_col = 0;
+    m_depth = 0;
+    m_lines_since_up = 0;
+    m_screen_row = 0;
+    m_rewritten = false;
+    m_last_sample = std::chrono::steady_clock::now();
+    m_out.clear();
+    m_state = State::Ground;
+    m_utf8_remaining = 0;
+}
+
+void LineCompactor::feed(const uint8_t* data, size_t length, const OutputCallback& sink) {
+    for (size_t i = 0; i < length; ++i) {
+        advance(data[i]);
+    }
+
+    if (m_options.sample_interval_ms > 0 && m_rewritten) {
+        auto now = std::chrono::steady_clock::now();
+        if (now - m_last_sample >= std::chrono::milliseconds(m_options.sample_interval_ms)) {
+            for (const std::u32string& line : m_lines) {
+                if (!line.empty()) {
+                    emit_line(line);
+                }
+            }
+            m_last_sample = now;
+            m_rewritten = false;
+        }
+    }
+
+    if (!m_out.empty() && sink) {
+        sink(reinterpret_cast<const uint8_t*>(m_out.data()), m_out.size());
+    }
+    m_out.clear();
+}
+
+void LineCompactor::flush(const OutputCallback& sink) {
+    // A last line with nothing on it is just where the cursor was left
+    while (m_lines.size() > 1 && m_lines.back().empty()) {
+        m_lines.pop_back();
+    }
+    for (const std::u32string& line : m_lines) {
+        if (!line.empty() || m_lines.size() > 1) {
+            emit_line(line);
+        }
+    }
+    if (!m_out.empty() && sink) {
+        sink(reinterpret_cast<const uint8_t*>(m_out.data()), m_out.size());
+    }
+    reset();
+}
+
+void LineCompactor::commit(const OutputCallback& sink) {
+    while (m_row > 0) {
+        emit_line(m_lines.front());
+        m_lines.pop_front();
+        --m_row;
+    }
+    m_depth = 0;
+    m_lines_since_up = 0;
+    if (!m_out.empty() && sink) {
+        sink(reinterpret_cast<const uint8_t*>(m_out.data()), m_out.size());
+    }
+    m_out.clear();
+}
+
+std::string LineCompactor::cursor_line_text() const {
+    const std::u32string& line = m_lines[m_row];
+    size_t end = line.size();
+    while (end > 0 && line[end - 1] == U' ') {
+        --end;
+    }
+    std::string text;
+    for (size_t i = 0; i < end; ++i) {
+        append_utf8(text, line[i]);
+    }
+    return text;
+}
+
+void LineCompactor::emit_line(const std::u32string& line) {
+    size_t end = line.size();
+    while (end > 0 && line[end - 1] == U' ') {
+        --end;
+    }
+    for (size_t i = 0; i < end; ++i) {
+        append_utf8(m_out, line[i]);
+    }
+    m_out += "\r\n";
+}
+
+// Lines more than m_depth above the bottom can no longer be reached by the rewrites seen so far
+void LineCompactor::retire() {
+    while (m_row > 0 && (m_lines.size() - 1 > m_depth || m_lines.size() > COMPACT_MAX_OPEN_LINES)) {
+        emit_line(m_lines.front());
+        m_lines.pop_front();
+        --m_row;
+    }
+}
+
+void LineCompactor::put(char32_t ch) {
+    if (m_col >= COMPACT_LINE_LIMIT) {
+        return;
+    }
+    std::u32string& line = m_lines[m_row];
+    if (m_col < line.size()) {
+        if (line[m_col] != ch) {
+            line[m_col] = ch;
+            m_rewritten = true;
+        }
+    } else {
+        if (m_col > line.size()) {
+            line.resize(m_col, U' ');
+        }
+        line.push_back(ch);
+    }
+    ++m_col;
+}
+
+bool LineCompactor::same_state(const LineCompactor& other) const {
+    return m_lines == other.m_lines && m_row == other.m_row && m_col == other.m_col &&
+           m_depth == other.m_depth && (m_depth == 0 || m_lines_since_up == other.m_lines_since_up) &&
+           m_screen_row == other.m_screen_row && m_options.rows == other.m_options.rows &&
+           m_state == other.m_state &&
+           (m_state != State::Csi || (m_param_count == other.m_param_count && m_params[0] == other.m_params[0] &&
+                                      m_params[1] == other.m_params[1] && m_private == other.m_private)) &&
+           m_utf8_remaining == other.m_utf8_remaining &&
+           (m_utf8_remaining == 0 || m_codepoint == other.m_codepoint);
+}
+
+void LineCompactor::line_feed() {
+    if (m_screen_row + 1 < m_options.rows) {
+        ++m_screen_row;
+    }
+    // The block that was being redrawn is done
+    if (m_depth > 0 && ++m_lines_since_up >= COMPACT_MAX_OPEN_LINES) {
+        m_depth = 0;
+        m_lines_since_up = 0;
+    }
+    ++m_row;
+    if (m_row == m_lines.size()) {
+        m_lines.emplace_back();
+    }
+    retire();
+}
+
+void LineCompactor::move_up(size_t count) {
+    m_lines_since_up = 0;
+    count = std::min<size_t>(count, m_screen_row);
+    m_screen_row = static_cast<uint16_t>(m_screen_row - count);
+    // Keep this many lines open from now on, even if some of them were emitted already
+    m_depth = std::max(m_depth, std::min(m_lines.size() - 1 - m_row + count, COMPACT_MAX_OPEN_LINES - 1));
+    if (count <= m_row) {
+        m_row -= count;
+        return;
+    }
+
+    // The target line was emitted already and can't be rewritten. Finish the open lines as
+    // they are and carry on from a new one, instead of writing over the line the cursor is on.
+    while (m_lines.size() > m_row && m_lines.back().empty()) {
+        m_lines.pop_back();
+    }
+    for (const std::u32string& line : m_lines) {
+        emit_line(line);
+    }
+    m_lines.assign(1, std::u32string());
+    m_row = 0;
+}
+
+void LineCompactor::move_down(size_t count) {
+    size_t room = m_options.rows - 1u - m_screen_row;
+    count = std::min(count, room);      // The cursor stops at the bottom row; nothing scrolls
+    m_screen_row = static_cast<uint16_t>(m_screen_row + count);
+    m_row += count;
+    while (m_row >= m_lines.size()) {
+        m_lines.emplace_back();
+    }
+    retire();
+}
+
+size_t LineCompactor::param(size_t index, size_t fallback) const {
+    if (index >= m_param_count || m_params[index] == 0) {
+        return fallback;
+    }
+    return m_params[index];
+}
+
+void LineCompactor::advance(uint8_t c) {
+    switch (m_state) {
+        case State::Ground:
+            if (m_utf8_remaining > 0) {
+                if ((c & 0xC0) == 0x80) {
+                    m_codepoint = (m_codepoint << 6) | (c & 0x3F);
+                    if (--m_utf8_remaining == 0) {
+                        put(m_codepoint);
+                    }
+                    return;
+                }
+                // Truncated sequence; the current byte starts something new
+                m_utf8_remaining = 0;
+                put(REPLACEMENT_CHAR);
+            }
+
+            if (c >= 0x20 && c < 0x7F) {
+                put(c);
+            } else if (c == '\n' || c == '\v' || c == '\f') {
+                line_feed();
+            } else if (c == '\r') {
+                m_col = 0;
+            } else if (c == '\b') {
+                m_col -= m_col > 0 ? 1 : 0;
+            } else if (c == '\t') {
+                m_col = std::min((m_col / 8 + 1) * 8, COMPACT_LINE_LIMIT);
+            } else if (c == 0x1B) {
+                m_state = State::Escape;
+            } else if ((c & 0xE0) == 0xC0) {
+                m_codepoint = c & 0x1F;
+                m_utf8_remaining = 1;
+            } else if ((c & 0xF0) == 0xE0) {
+                m_codepoint = c & 0x0F;
+                m_utf8_remaining = 2;
+            } else if ((c & 0xF8) == 0xF0) {
+                m_codepoint = c & 0x07;
+                m_utf8_remaining = 3;
+            } else if (c >= 0x80) {
+                put(REPLACEMENT_CHAR);
+            }
+            return;
+
+        case State::Escape:
+            if (c == '[') {
+                m_params[0] = m_params[1] = 0;
+                m_param_count = 0;
+                m_private = false;
+                m_state = State::Csi;
+            } else if (c == ']' || c == 'P' || c == 'X' || c == '^' || c == '_') {
+                m_state = State::String;
+            } else if (c >= 0x20 && c <= 0x2F) {
+                m_state = State::EscapeIntermediate;
+            } else if (c != 0x1B) {
+                m_state = State::Ground;
+                if (c == 'D') {             // IND
+                    line_feed();
+                } else if (c == 'E') {      // NEL
+                    m_col = 0;
+                    line_feed();
+                } else if (c == 'M') {      // RI
+                    move_up(1);
+                }
+            }
+            return;
+
+        case State::EscapeIntermediate:
+            if (c < 0x20 || c > 0x2F) {
+                m_state = State::Ground;
+            }
+            return;
+
+        case State::Csi:
+            if (c >= '0' && c <= '9') {
+                if (m_param_count == 0) {
+                    m_param_count = 1;
+                }
+                if (m_param_count <= 2) {
+                    size_t& value = m_params[m_param_count - 1];
+                    value = std::min(value * 10 + (c - '0'), MAX_PARAM);
+                }
+            } else if (c == ';' || c == ':') {
+                if (m_param_count == 0) {
+                    m_param_count = 1;
+                }
+                ++m_param_count;
+            } else if (c >= 0x3C && c <= 0x3F) {
+                m_private = true;           // DEC private modes etc. don't move anything
+            } else if (c == 0x1B) {
+                m_state = State::Escape;
+            } else if (c >= 0x40 && c <= 0x7E) {
+                m_state = State::Ground;
+                if (!m_private) {
+                    csi_dispatch(c);
+                }
+            }
+            return;
+
+        case State::String:
+            if (c == 0x07) {
+                m_state = State::Ground;
+            } else if (c == 0x1B) {
+                m_state = State::StringEscape;
+            }
+            return;
+
+        case State::StringEscape:
+            // ESC \ is ST; any other ESC aborts the string and starts a new sequence
+            if (c == '\\') {
+                m_state = State::Ground;
+                return;
+            }
+            m_state = State::Escape;
+            advance(c);
+            return;
+    }
+}
+
+void LineCompactor::csi_dispatch(uint8_t final) {
+    std::u32string& line = m_lines[m_row];
+
+    switch (final) {
+        case 'A':   // CUU
+            move_up(param(0, 1));
+            break;
+        case 'B':   // CUD
+        case 'e':   // VPR
+            move_down(param(0, 1));
+            break;
+        case 'C':   // CUF
+        case 'a':   // HPR
+            m_col = std::min(m_col + param(0, 1), COMPACT_LINE_LIMIT);
+            break;
+        case 'D':   // CUB
+            m_col -= std::min(param(0, 1), m_col);
+            break;
+        case 'E':   // CNL
+            move_down(param(0, 1));
+            m_col = 0;
+            break;
+        case 'F':   // CPL
+            move_up(param(0, 1));
+            m_col = 0;
+            break;
+        case 'G':   // CHA
+        case '`':   // HPA
+            m_col = std::min(param(0, 1) - 1, COMPACT_LINE_LIMIT);
+            break;
+        case 'H':   // CUP
+        case 'f': { // HVP
+            size_t row = std::min<size_t>(param(0, 1) - 1, m_options.rows - 1u);
+            if (row < m_screen_row) {
+                move_up(m_screen_row - row);
+            } else if (row > m_screen_row) {
+                move_down(row - m_screen_row);
+            }
+            m_col = std::min(param(1, 1) - 1, COMPACT_LINE_LIMIT);
+            break;
+        }
+        case 'K': { // EL
+            size_t mode = m_param_count > 0 ? m_params[0] : 0;
+            std::u32string& current = m_lines[m_row];
+            if (mode == 0) {
+                if (m_col < current.size()) {
+                    current.resize(m_col);
+                    m_rewritten = true;
+                }
+            } else if (mode == 1) {
+                std::fill(current.begin(), current.begin() + std::min(m_col + 1, current.size()), U' ');
+                m_rewritten = true;
+            } else if (mode == 2) {
+                current.clear();
+                m_rewritten = true;
+            }
+            break;
+        }
+        case 'J': { // ED
+            size_t mode = m_param_count > 0 ? m_params[0] : 0;
+            size_t first = mode == 0 ? m_row + 1 : 0;
+            size_t last = mode == 1 ? m_row : m_lines.size();
+            for (size_t i = first; i < last; ++i) {
+                m_lines[i].clear();
+            }
+            if (mode == 0 && m_col < line.size()) {
+                line.resize(m_col);
+            } else if (mode == 1) {
+                std::fill(line.begin(), line.begin() + std::min(m_col + 1, line.size()), U' ');
+            }
+            m_rewritten = true;
+            break;
+        }
+        case 'X': { // ECH
+            size_t end = std::min(m_col + param(0, 1), line.size());
+            if (m_col < end) {
+                std::fill(line.begin() + m_col, line.begin() + end, U' ');
+                m_rewritten = true;
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+} // namespace headless_tty
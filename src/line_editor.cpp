@@ -0,0 +1,170 @@
+#include "headless_tty/line_editor.hpp"
+#include "headless_tty/unicode.hpp"
+#include "utf8_encode.hpp"
+
+namespace headless_tty {
+
+namespace {
+
+// Decode the codepoint at i and step past it. The line only holds what append_utf8()
+// wrote, so it is well-formed and the lead byte gives the length.
+char32_t next_codepoint(const std::string& text, size_t& i) {
+    uint8_t lead = static_cast<uint8_t>(text[i++]);
+    if (lead < 0x80) {
+        return lead;
+    }
+    int extra = lead >= 0xF0 ? 3 : lead >= 0xE0 ? 2 : 1;
+    char32_t cp = lead & (0x3F >> extra);
+    while (extra-- > 0 && i < text.size()) {
+        cp = (cp << 6) | (static_cast<uint8_t>(text[i++]) & 0x3F);
+    }
+    return cp;
+}
+
+// CSI n C / CSI n D
+void move_cursor(std::string& echo, size_t cols, char direction) {
+    if (cols == 0) return;
+    echo += "\x1b[";
+    echo += std::to_string(cols);
+    echo += direction;
+}
+
+} // namespace
+
+void LineEditor::clear() {
+    m_line.clear();
+    m_cursor = 0;
+}
+
+// Cluster boundaries need the context before them, so scan from the start of the line;
+// an edited line is a few hundred bytes at most
+size_t LineEditor::prev_boundary(size_t pos) const {
+    GraphemeSegmenter segmenter;
+    size_t boundary = 0;
+    size_t i = 0;
+    while (i < pos) {
+        size_t start = i;
+        if (segmenter.next(next_codepoint(m_line, i))) {
+            boundary = start;
+        }
+    }
+    return boundary;
+}
+
+size_t LineEditor::next_boundary(size_t pos) const {
+    if (pos >= m_line.size()) return m_line.size();
+    GraphemeSegmenter segmenter;
+    size_t i = pos;
+    segmenter.next(next_codepoint(m_line, i));
+    while (i < m_line.size()) {
+        size_t start = i;
+        if (segmenter.next(next_codepoint(m_line, i))) {
+            return start;
+        }
+    }
+    return m_line.size();
+}
+
+size_t LineEditor::columns(size_t from, size_t to) const {
+    return text_width(reinterpret_cast<const uint8_t*>(m_line.data()) + from, to - from);
+}
+
+void LineEditor::insert(const std::string& text, std::string& echo) {
+    m_line.insert(m_cursor, text);
+    m_cursor += text.size();
+
+    // Redraw the tail once per run of inserted characters, not once per character
+    echo += text;
+    if (m_cursor < m_line.size()) {
+        echo.append(m_line, m_cursor, std::string::npos);
+        move_cursor(echo, columns(m_cursor, m_line.size()), 'D');
+    }
+}
+
+void LineEditor::erase(size_t from, size_t to, std::string& echo) {
+    size_t erasedCols = columns(from, to);
+    move_cursor(echo, columns(from, m_cursor), 'D');
+
+    m_line.erase(from, to - from);
+    m_cursor = from;
+
+    size_t tailCols = columns(m_cursor, m_line.size());
+    echo.append(m_line, m_cursor, std::string::npos);
+    echo.append(erasedCols, ' ');
+    move_cursor(echo, tailCols + erasedCols, 'D');
+}
+
+void LineEditor::process(const EditEvent* events, size_t count, std::string& echo, std::string& committed) {
+    std::string run;
+
+    for (size_t i = 0; i < count; ++i) {
+        const EditEvent& ev = events[i];
+
+        if (ev.key == EditKey::Char) {
+            append_utf8(run, ev.codepoint);
+            continue;
+        }
+
+        if (!run.empty()) {
+            insert(run, echo);
+            run.clear();
+        }
+
+        switch (ev.key) {
+            case EditKey::Enter:
+                move_cursor(echo, columns(m_cursor, m_line.size()), 'C');
+                echo += "\r\n";
+                committed += m_line;
+                committed += "\r\n";
+                clear();
+                break;
+
+            case EditKey::Backspace:
+                if (m_cursor > 0) {
+                    erase(prev_boundary(m_cursor), m_cursor, echo);
+                }
+                break;
+
+            case EditKey::Delete:
+                if (m_cursor < m_line.size()) {
+                    erase(m_cursor, next_boundary(m_cursor), echo);
+                }
+                break;
+
+            case EditKey::Left:
+                if (m_cursor > 0) {
+                    size_t to = m_cursor;
+                    m_cursor = prev_boundary(m_cursor);
+                    move_cursor(echo, columns(m_cursor, to), 'D');
+                }
+                break;
+
+            case EditKey::Right:
+                if (m_cursor < m_line.size()) {
+                    size_t from = m_cursor;
+                    m_cursor = next_boundary(m_cursor);
+                    move_cursor(echo, columns(from, m_cursor), 'C');
+                }
+                break;
+
+            case EditKey::Home:
+                move_cursor(echo, columns(0, m_cursor), 'D');
+                m_cursor = 0;
+                break;
+
+            case EditKey::End:
+                move_cursor(echo, columns(m_cursor, m_line.size()), 'C');
+                m_cursor = m_line.size();
+                break;
+
+            case EditKey::Char:
+                break;
+        }
+    }
+
+    if (!run.empty()) {
+        insert(run, echo);
+    }
+}
+
+} // namespace headless_tty
@@ -0,0 +1,509 @@
+#include "headless_tty/log_sink.hpp"
+#include "win_error.hpp"
+#include <compressapi.h>
+#include <chrono>
+#include <cstring>
+#include <cwchar>
+
+namespace headless_tty {
+
+namespace {
+
+// Partially filled buffers are flushed after this long so the log trails output by at most this much
+constexpr DWORD LOG_FLUSH_INTERVAL_MS = 250;
+
+// Compressed segment layout: magic, then blocks of [uint32 raw size][uint32 packed size][packed bytes].
+// packed size == raw size means the block is stored uncompressed.
+constexpr char XPH_MAGIC[8] = { 'H', 'T', 'T', 'Y', 'X', 'P', 'H', '1' };
+constexpr wchar_t XPH_EXTENSION[] = L".xph";
+
+bool write_all(HANDLE hFile, const void* data, size_t length) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    while (length > 0) {
+        DWORD chunk = length > 0x40000000 ? 0x40000000 : static_cast<DWORD>(length);
+        DWORD written = 0;
+        if (!WriteFile(hFile, p, chunk, &written, NULL) || written == 0) {
+            return false;
+        }
+        p += written;
+        length -= written;
+    }
+    return true;
+}
+
+bool read_exact(HANDLE hFile, void* data, DWORD length) {
+    uint8_t* p = static_cast<uint8_t*>(data);
+    while (length > 0) {
+        DWORD got = 0;
+        if (!ReadFile(hFile, p, length, &got, NULL) || got == 0) {
+            return false;
+        }
+        p += got;
+        length -= got;
+    }
+    return true;
+}
+
+bool compress_segment(const std::wstring& input, const std::wstring& output) {
+    HANDLE hIn = CreateFileW(input.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                             OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (hIn == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    HANDLE hOut = CreateFileW(output.c_str(), GENERIC_WRITE, 0, NULL,
+                              CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (hOut == INVALID_HANDLE_VALUE) {
+        CloseHandle(hIn);
+        return false;
+    }
+
+    COMPRESSOR_HANDLE compressor = NULL;
+    bool ok = CreateCompressor(COMPRESS_ALGORITHM_XPRESS_HUFF, NULL, &compressor) &&
+              write_all(hOut, XPH_MAGIC, sizeof(XPH_MAGIC));
+
+    std::vector<uint8_t> raw(LOG_BUFFER_SIZE);
+    std::vector<uint8_t> packed(LOG_BUFFER_SIZE + LOG_BUFFER_SIZE / 2);
+
+    while (ok) {
+        DWORD rawSize = 0;
+        if (!ReadFile(hIn, raw.data(), static_cast<DWORD>(raw.size()), &rawSize, NULL)) {
+            ok = false;
+            break;
+        }
+        if (rawSize == 0) {
+            break;
+        }
+
+        SIZE_T packedSize = 0;
+        const uint8_t* payload = packed.data();
+        if (!Compress(compressor, raw.data(), rawSize, packed.data(), packed.size(), &packedSize) ||
+            packedSize >= rawSize) {
+            // Incompressible block - store it as is
+            payload = raw.data();
+            packedSize = rawSize;
+        }
+
+        uint32_t header[2] = { rawSize, static_cast<uint32_t>(packedSize) };
+        ok = write_all(hOut, header, sizeof(header)) && write_all(hOut, payload, packedSize);
+    }
+
+    if (compressor) {
+        CloseCompressor(compressor);
+    }
+    CloseHandle(hOut);
+    CloseHandle(hIn);
+
+    if (!ok) {
+        DeleteFileW(output.c_str());
+    }
+    return ok;
+}
+
+std::wstring timestamp_suffix() {
+    SYSTEMTIME st;
+    GetLocalTime(&st);
+    wchar_t buf[32];
+    swprintf(buf, 32, L"%04u%02u%02u-%02u%02u%02u",
+             st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond);
+    return buf;
+}
+
+} // namespace
+
+LogSink::~LogSink() {
+    close();
+}
+
+void LogSink::set_error(const std::string& msg) {
+    std::lock_guard<std::mutex> lock(m_error_mutex);
+    m_last_error = msg;
+}
+
+std::string LogSink::get_last_error() const {
+    std::lock_guard<std::mutex> lock(m_error_mutex);
+    return m_last_error;
+}
+
+bool LogSink::is_open() const {
+    return m_open.load();
+}
+
+uint64_t LogSink::dropped_bytes() const {
+    return m_dropped.load();
+}
+
+bool LogSink::open(const std::wstring& path, const LogOptions& options) {
+    if (m_open.load()) {
+        set_error("Log sink already open");
+        return false;
+    }
+
+    m_path = path;
+    m_options = options;
+    m_stripper.reset();
+    m_compactor = LineCompactor(options.compact);
+
+    if (!open_segment()) {
+        return false;
+    }
+
+    // Page-aligned buffers so every flush is a large, aligned write
+    m_buffers.resize(LOG_BUFFER_COUNT);
+    m_free.clear();
+    m_full.clear();
+    for (Buffer& buffer : m_buffers) {
+        buffer.data = static_cast<uint8_t*>(
+            VirtualAlloc(NULL, LOG_BUFFER_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+        buffer.used = 0;
+        if (!buffer.data) {
+            set_error(format_win_error("VirtualAlloc failed for log buffer"));
+            close();
+            return false;
+        }
+        m_free.push_back(&buffer);
+    }
+    m_active = nullptr;
+    m_closing = false;
+    m_archive_closing = false;
+
+    m_open.store(true);
+    m_writer_thread = std::thread(&LogSink::writer_loop, this);
+    m_archive_thread = std::thread(&LogSink::archive_loop, this);
+    return true;
+}
+
+bool LogSink::open_segment() {
+    m_hFile = CreateFileW(m_path.c_str(), FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_DELETE,
+                          NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (m_hFile == INVALID_HANDLE_VALUE) {
+        set_error(format_win_error("Failed to open log file"));
+        return false;
+    }
+
+    LARGE_INTEGER size = {};
+    GetFileSizeEx(m_hFile, &size);
+    m_segment_bytes = static_cast<uint64_t>(size.QuadPart);
+    m_segment_started = GetTickCount64();
+    return true;
+}
+
+void LogSink::write(const uint8_t* data, size_t length) {
+    if (!m_open.load()) return;
+
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_closing) {
+            return;  // close() is tearing the buffers down
+        }
+
+        while (length > 0) {
+            if (!m_active) {
+                if (m_free.empty()) {
+                    // Disk can't keep up - drop instead of blocking the PTY reader
+                    m_dropped.fetch_add(length);
+                    break;
+                }
+                m_active = m_free.back();
+                m_free.pop_back();
+                m_active_since = GetTickCount64();
+                wake = true;  // Writer arms its flush timer for the new buffer
+            }
+
+            size_t space = LOG_BUFFER_SIZE - m_active->used;
+            size_t n = length < space ? length : space;
+            memcpy(m_active->data + m_active->used, data, n);
+            m_active->used += n;
+            data += n;
+            length -= n;
+
+            if (m_active->used == LOG_BUFFER_SIZE) {
+                m_full.push_back(m_active);
+                m_active = nullptr;
+                wake = true;
+            }
+        }
+    }
+
+    if (wake) {
+        m_cv.notify_one();
+    }
+}
+
+void LogSink::writer_loop() {
+    std::vector<Buffer*> batch;
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true) {
+        bool flushPartial = m_closing;
+
+        if (m_full.empty() && !m_closing) {
+            DWORD rotateIn = rotation_due_ms();
+            if (!m_active || m_active->used == 0) {
+                // Nothing buffered: a segment past its age limit is rotated here, so a quiet
+                // session's log still turns over on time
+                if (rotateIn == 0) {
+                    lock.unlock();
+                    rotate_segment();
+                    lock.lock();
+                } else if (rotateIn == INFINITE) {
+                    m_cv.wait(lock);
+                } else {
+                    m_cv.wait_for(lock, std::chrono::milliseconds(rotateIn));
+                }
+                continue;
+            }
+
+            // Let a partial buffer collect more output until the flush interval elapses;
+            // writing it rotates the segment if it is due
+            ULONGLONG age = GetTickCount64() - m_active_since;
+            if (age < LOG_FLUSH_INTERVAL_MS) {
+                m_cv.wait_for(lock, std::chrono::milliseconds(LOG_FLUSH_INTERVAL_MS - age));
+                continue;
+            }
+            flushPartial = true;
+        }
+
+        batch.assign(m_full.begin(), m_full.end());
+        m_full.clear();
+        if (flushPartial && m_active && m_active->used > 0) {
+            batch.push_back(m_active);
+            m_active = nullptr;
+        }
+
+        if (batch.empty()) {
+            if (m_closing) break;
+            continue;
+        }
+
+        lock.unlock();
+        for (Buffer* buffer : batch) {
+            write_buffer(buffer);
+        }
+        lock.lock();
+
+        for (Buffer* buffer : batch) {
+            buffer->used = 0;
+            m_free.push_back(buffer);
+        }
+    }
+}
+
+// Milliseconds until the active segment reaches max_segment_seconds; INFINITE without a
+// time limit or while the segment is empty (rotating it would only archive nothing)
+DWORD LogSink::rotation_due_ms() const {
+    if (m_options.max_segment_seconds == 0 || m_segment_bytes == 0 || m_hFile == INVALID_HANDLE_VALUE) {
+        return INFINITE;
+    }
+    ULONGLONG limit = m_options.max_segment_seconds * 1000ull;
+    ULONGLONG age = GetTickCount64() - m_segment_started;
+    return age >= limit ? 0 : static_cast<DWORD>(limit - age);
+}
+
+void LogSink::write_buffer(Buffer* buffer) {
+    if (m_options.compact_lines) {
+        m_compactor.feed(buffer->data, buffer->used, [this](const uint8_t* data, size_t length) {
+            write_bytes(data, length);
+        });
+        return;
+    }
+
+    size_t length = buffer->used;
+    if (m_options.plain_text) {
+        length = m_stripper.filter(buffer->data, length, buffer->data);
+    }
+    write_bytes(buffer->data, length);
+}
+
+void LogSink::write_bytes(const uint8_t* data, size_t length) {
+    if (length == 0 || m_hFile == INVALID_HANDLE_VALUE) {
+        return;
+    }
+
+    if (!write_all(m_hFile, data, length)) {
+        set_error(format_win_error("Failed to write log file"));
+        return;
+    }
+    m_segment_bytes += length;
+
+    bool sizeLimit = m_options.max_segment_bytes > 0 &&
+                     m_segment_bytes >= m_options.max_segment_bytes;
+    bool timeLimit = m_options.max_segment_seconds > 0 &&
+                     GetTickCount64() - m_segment_started >= m_options.max_segment_seconds * 1000ull;
+    if (sizeLimit || timeLimit) {
+        rotate_segment();
+    }
+}
+
+void LogSink::rotate_segment() {
+    CloseHandle(m_hFile);
+    m_hFile = INVALID_HANDLE_VALUE;
+
+    std::wstring rotated = m_path + L"." + timestamp_suffix() + L"-" + std::to_wstring(++m_segment_index);
+    if (!MoveFileExW(m_path.c_str(), rotated.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+        set_error(format_win_error("Failed to rotate log file"));
+    } else {
+        {
+            std::lock_guard<std::mutex> lock(m_archive_mutex);
+            m_archive_queue.push_back(rotated);
+        }
+        m_archive_cv.notify_one();
+    }
+
+    open_segment();
+}
+
+void LogSink::archive_loop() {
+    std::unique_lock<std::mutex> lock(m_archive_mutex);
+
+    while (true) {
+        m_archive_cv.wait(lock, [this] { return !m_archive_queue.empty() || m_archive_closing; });
+        if (m_archive_queue.empty()) {
+            break;
+        }
+
+        std::wstring segment = std::move(m_archive_queue.front());
+        m_archive_queue.pop_front();
+        lock.unlock();
+
+        std::wstring kept = segment;
+        if (m_options.compress) {
+            std::wstring packed = segment + XPH_EXTENSION;
+            if (compress_segment(segment, packed)) {
+                DeleteFileW(segment.c_str());
+                kept = packed;
+            } else {
+                set_error(format_win_error("Failed to compress log segment"));
+            }
+        }
+
+        // Retention only covers segments rotated by this sink instance
+        m_archived.push_back(kept);
+        while (m_options.keep_segments > 0 && m_archived.size() > m_options.keep_segments) {
+            DeleteFileW(m_archived.front().c_str());
+            m_archived.pop_front();
+        }
+
+        lock.lock();
+    }
+}
+
+void LogSink::close() {
+    // Taking the lock waits out a write() already copying into a buffer; any later one
+    // sees m_closing and returns before touching the buffers freed below
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closing = true;
+    }
+
+    if (m_writer_thread.joinable()) {
+        m_cv.notify_one();
+        m_writer_thread.join();
+
+        // Lines still open for rewriting when the output ended
+        if (m_options.compact_lines) {
+            m_compactor.flush([this](const uint8_t* data, size_t length) {
+                write_bytes(data, length);
+            });
+        }
+    }
+
+    if (m_archive_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_archive_mutex);
+            m_archive_closing = true;
+        }
+        m_archive_cv.notify_one();
+        m_archive_thread.join();
+    }
+
+    if (m_hFile != INVALID_HANDLE_VALUE) {
+        CloseHandle(m_hFile);
+        m_hFile = INVALID_HANDLE_VALUE;
+    }
+
+    for (Buffer& buffer : m_buffers) {
+        if (buffer.data) {
+            VirtualFree(buffer.data, 0, MEM_RELEASE);
+        }
+    }
+    m_buffers.clear();
+    m_free.clear();
+    m_full.clear();
+    m_active = nullptr;
+    m_open.store(false);
+}
+
+bool decompress_log_segment(const std::wstring& input, const std::wstring& output, std::string* error) {
+    auto fail = [error](const std::string& msg) {
+        if (error) *error = format_win_error(msg);
+        return false;
+    };
+
+    HANDLE hIn = CreateFileW(input.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                             OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (hIn == INVALID_HANDLE_VALUE) {
+        return fail("Failed to open compressed segment");
+    }
+
+    char magic[sizeof(XPH_MAGIC)] = {};
+    if (!read_exact(hIn, magic, sizeof(magic)) || memcmp(magic, XPH_MAGIC, sizeof(magic)) != 0) {
+        CloseHandle(hIn);
+        if (error) *error = "Not a headless-tty compressed log segment";
+        return false;
+    }
+
+    HANDLE hOut = CreateFileW(output.c_str(), GENERIC_WRITE, 0, NULL,
+                              CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (hOut == INVALID_HANDLE_VALUE) {
+        CloseHandle(hIn);
+        return fail("Failed to create output file");
+    }
+
+    DECOMPRESSOR_HANDLE decompressor = NULL;
+    bool ok = CreateDecompressor(COMPRESS_ALGORITHM_XPRESS_HUFF, NULL, &decompressor) != FALSE;
+    std::vector<uint8_t> packed;
+    std::vector<uint8_t> raw;
+
+    while (ok) {
+        uint32_t header[2];
+        DWORD got = 0;
+        if (!ReadFile(hIn, header, sizeof(header), &got, NULL) || got == 0) {
+            break;  // Clean end of file
+        }
+        if (got != sizeof(header) || header[0] > LOG_BUFFER_SIZE || header[1] > header[0]) {
+            ok = false;
+            break;
+        }
+
+        packed.resize(header[1]);
+        if (!read_exact(hIn, packed.data(), header[1])) {
+            ok = false;
+            break;
+        }
+
+        if (header[1] == header[0]) {
+            ok = write_all(hOut, packed.data(), packed.size());
+        } else {
+            raw.resize(header[0]);
+            SIZE_T rawSize = 0;
+            ok = Decompress(decompressor, packed.data(), packed.size(), raw.data(), raw.size(), &rawSize) &&
+                 rawSize == header[0] && write_all(hOut, raw.data(), rawSize);
+        }
+    }
+
+    if (decompressor) {
+        CloseDecompressor(decompressor);
+    }
+    CloseHandle(hOut);
+    CloseHandle(hIn);
+
+    if (!ok) {
+        DeleteFileW(output.c_str());
+        if (error) *error = "Corrupt compressed log segment";
+    }
+    return ok;
+}
+
+} // namespace headless_tty
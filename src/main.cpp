@@ -9,11 +9,25 @@ Usage: headless-tty [options] [command] [args...]
  */
 
 #include "headless_tty/pty.hpp"
+#include "headless_tty/log_sink.hpp"
+#include "headless_tty/line_editor.hpp"
+#include "headless_tty/input_file.hpp"
+#include "headless_tty/expect_script.hpp"
+#include "headless_tty/output_sink.hpp"
+#include "headless_tty/framed.hpp"
+#include "headless_tty/frame_viewer.hpp"
+#include "headless_tty/snapshot.hpp"
+#include "headless_tty/shared_screen.hpp"
+#include "headless_tty/utf8.hpp"
+#include "headless_tty/supervisor.hpp"
+#include "headless_tty/latency_probe.hpp"
+#include "headless_tty/converter.hpp"
 
 #include <iostream>
 #include <string>
 #include <vector>
 #include <thread>
+#include <future>
 #include <atomic>
 #include <csignal>
 #include <io.h>
@@ -27,6 +41,9 @@ Usage: headless-tty [options] [command] [args...]
 #define ID_TRAY_SHOW_CONSOLE 1001
 
 static std::atomic<bool> g_shutdown_requested{ false };
+// Manual-reset event mirroring g_shutdown_requested so threads can block on it instead of polling
+static HANDLE g_hShutdownEvent = nullptr;
+static std::atomic<bool> g_script_failed{ false };
 
 // Tray mode globals
 static HWND g_tray_hwnd = nullptr;
@@ -34,10 +51,19 @@ static NOTIFYICONDATAW g_nid = {};
 static std::atomic<bool> g_console_visible{ false };
 static HANDLE g_hConsoleOut = INVALID_HANDLE_VALUE;
 static HANDLE g_hConsoleIn = INVALID_HANDLE_VALUE;
+// Auto-reset event pulsed whenever the tray console is shown or hidden
+static HANDLE g_hConsoleChangedEvent = nullptr;
+
+void request_shutdown() {
+    g_shutdown_requested.store(true);
+    if (g_hShutdownEvent) {
+        SetEvent(g_hShutdownEvent);
+    }
+}
 
 void signal_handler(int signum) {
     (void)signum;
-    g_shutdown_requested.store(true);
+    request_shutdown();
 }
 
 
@@ -46,6 +72,33 @@ void print_usage(const char* program_name) {
     std::cerr << "Usage: " << program_name << " [options] [command] [args...]\n\n";
     std::cerr << "Options:\n";
     std::cerr << "  --sys-tray         Run with system tray icon (right-click for menu)\n";
+    std::cerr << "  --log <path>       Also write output to a rotating log file\n";
+    std::cerr << "  --log-max-size <MB>      Rotate the log after this many MB (default 64, 0 = never)\n";
+    std::cerr << "  --log-max-age <seconds>  Rotate the log after this many seconds (default 0 = never)\n";
+    std::cerr << "  --log-keep <n>     Rotated log segments to keep (default 10, 0 = all)\n";
+    std::cerr << "  --log-plain        Strip escape sequences from the log\n";
+    std::cerr << "  --log-no-compress  Keep rotated log segments uncompressed\n";
+    std::cerr << "  --log-compact      Log only finished lines, not each progress-bar redraw (plain text)\n";
+    std::cerr << "  --log-compact-sample <ms>  With --log-compact, also log a line being redrawn at most every <ms>\n";
+    std::cerr << "  --unpack-log <file.xph>  Decompress a rotated log segment and exit\n";
+    std::cerr << "  --convert <capture>      Convert a raw --log capture on all cores and exit\n";
+    std::cerr << "  --to <format>      --convert output: text, asciicast or screens (default text)\n";
+    std::cerr << "  --output <path>    --convert destination (default <capture>.txt / .cast / .screens)\n";
+    std::cerr << "  --threads <n>      --convert worker threads (default one per core)\n";
+    std::cerr << "  --dump-every <KB>  --to screens: capture KB between screen dumps (default 1024)\n";
+    std::cerr << "  --input-file <path>      Send a file to the child instead of stdin\n";
+    std::cerr << "  --input-rate <bytes/s>   Limit --input-file throughput\n";
+    std::cerr << "  --input-wait-quiet <ms>  Send --input-file line by line, each after output is idle this long\n";
+    std::cerr << "  --expect-script <path>   Drive the child with an expect/send script (exit code 1 if it fails)\n";
+    std::cerr << "  --snapshot <path>  Restore the screen saved in <path> (if any) and save it there on exit\n";
+    std::cerr << "  --shared-screen <name>   Publish the screen in shared memory <name> for other processes\n";
+    std::cerr << "  --frame-rate <fps> Show the child's screen at most <fps> times per second instead of raw output\n";
+    std::cerr << "  --io-mode <mode>   Output delivery: latency, throughput or auto (default auto)\n";
+    std::cerr << "  --framed           Binary frames on stdin/stdout: output with sequence numbers and times, exit,\n";
+    std::cerr << "                     resize and metrics events out; input, resize, metrics and stop commands in\n";
+    std::cerr << "  --manifest <path>  Host every command listed in <path>, with restart policies\n";
+    std::cerr << "  --measure-latency <n>    Report write-to-echo latency over n probes (idle and under load) and exit\n";
+    std::cerr << "  --latency-gate <ms>      With --measure-latency: exit code 1 if the idle p99 exceeds this\n";
     std::cerr << "  --help, -h         Show this help message\n";
     std::cerr << "\n";
     std::cerr << "If no command is specified, notepad.exe opens.\n";
@@ -54,18 +107,13 @@ void print_usage(const char* program_name) {
     std::cerr << "  " << program_name << " app_name\n";
     std::cerr << "  " << program_name << " cmd /c dir\n";
     std::cerr << "  " << program_name << " --sys-tray -- python -u main.py\n";
+    std::cerr << "  " << program_name << " --log C:\\logs\\server.log --log-plain -- node server.js\n";
+    std::cerr << "  " << program_name << " --sys-tray --manifest C:\\tools\\background.ini\n";
 }
 
 // Convert narrow string to wide string
 std::wstring to_wstring(const std::string& str) {
-    if (str.empty()) return L"";
-
-    int size_needed = MultiByteToWideChar(CP_UTF8, 0, str.c_str(),
-                                          static_cast<int>(str.length()), NULL, 0);
-    std::wstring result(size_needed, 0);
-    MultiByteToWideChar(CP_UTF8, 0, str.c_str(), static_cast<int>(str.length()),
-                        &result[0], size_needed);
-    return result;
+    return headless_tty::utf8_to_wstring(str);
 }
 
 
@@ -78,6 +126,33 @@ struct Args {
     bool error = false;
     bool sys_tray = false;
     std::string error_msg;
+
+    // Log sink
+    std::wstring log_path;
+    headless_tty::LogOptions log_options;
+    std::wstring unpack_log;
+
+    // Offline conversion
+    std::wstring convert_input;
+    std::wstring convert_output;
+    headless_tty::ConvertOptions convert_options;
+
+    // Scripted input
+    std::wstring input_file;
+    headless_tty::InputFileOptions input_options;
+    std::wstring expect_script;
+
+    headless_tty::IoMode io_mode = headless_tty::IoMode::Auto;
+    uint32_t frame_rate = 0;    // 0 = pass output through unchanged
+    bool framed = false;        // Frame protocol on stdin/stdout (see framed.hpp)
+    std::wstring snapshot_path;
+    std::wstring shared_screen;
+    std::wstring manifest;
+
+    // Latency probe
+    bool has_command = false;
+    uint32_t latency_samples = 0;   // 0 = normal run
+    double latency_gate_ms = 0;
 };
 
 Args parse_args(int argc, char* argv[]) {
@@ -110,6 +185,209 @@ Args parse_args(int argc, char* argv[]) {
         else if (arg == "--sys-tray") {
             args.sys_tray = true;
         }
+        else if (arg == "--framed") {
+            args.framed = true;
+        }
+        else if (arg == "--log") {
+            if (i + 1 >= argc) {
+                args.error = true;
+                args.error_msg = "--log requires a path";
+                return args;
+            }
+            args.log_path = to_wstring(argv[++i]);
+        }
+        else if (arg == "--log-max-size") {
+            if (i + 1 >= argc) {
+                args.error = true;
+                args.error_msg = "--log-max-size requires a value";
+                return args;
+            }
+            args.log_options.max_segment_bytes = std::stoull(argv[++i]) * 1024 * 1024;
+        }
+        else if (arg == "--log-max-age") {
+            if (i + 1 >= argc) {
+                args.error = true;
+                args.error_msg = "--log-max-age requires a value";
+                return args;
+            }
+            args.log_options.max_segment_seconds = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--log-keep") {
+            if (i + 1 >= argc) {
+                args.error = true;
+                args.error_msg = "--log-keep requires a value";
+                return args;
+            }
+            args.log_options.keep_segments = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--log-plain") {
+            args.log_options.plain_text = true;
+        }
+        else if (arg == "--log-no-compress") {
+            args.log_options.compress = false;
+        }
+        else if (arg == "--log-compact") {
+            args.log_options.compact_lines = true;
+        }
+        else if (arg == "--log-compact-sample") {
+            if (i + 1 >= argc) {
+                args.error = true;
+                args.error_msg = "--log-compact-sample requires a value";
+                return args;
+            }
+            args.log_options.compact_lines = true;
+            args.log_options.compact.sample_interval_ms = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--input-file") {
+            if (i + 1 >= argc) {
+                args.error = true;
+                args.error_msg = "--input-file requires a path";
+                return args;
+            }
+            args.input_file = to_wstring(argv[++i]);
+        }
+        else if (arg == "--input-rate") {
+            if (i + 1 >= argc) {
+                args.error = true;
+                args.error_msg = "--input-rate requires a value";
+                return args;
+            }
+            args.input_options.pacing = headless_tty::InputPacing::RateLimited;
+            args.input_options.bytes_per_second = std::stoull(argv[++i]);
+        }
+        else if (arg == "--input-wait-quiet") {
+            if (i + 1 >= argc) {
+                args.error = true;
+                args.error_msg = "--input-wait-quiet requires a value";
+                return args;
+            }
+            args.input_options.pacing = headless_tty::InputPacing::WaitForQuiet;
+            args.input_options.quiet_ms = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--expect-script") {
+            if (i + 1 >= argc) {
+                args.error = true;
+                args.error_msg = "--expect-script requires a path";
+                return args;
+            }
+            args.expect_script = to_wstring(argv[++i]);
+        }
+        else if (arg == "--snapshot") {
+            if (i + 1 >= argc) {
+                args.error = true;
+                args.error_msg = "--snapshot requires a path";
+                return args;
+            }
+            args.snapshot_path = to_wstring(argv[++i]);
+        }
+        else if (arg == "--shared-screen") {
+            if (i + 1 >= argc) {
+                args.error = true;
+                args.error_msg = "--shared-screen requires a name";
+                return args;
+            }
+            args.shared_screen = to_wstring(argv[++i]);
+        }
+        else if (arg == "--frame-rate") {
+            if (i + 1 >= argc) {
+                args.error = true;
+                args.error_msg = "--frame-rate requires a value";
+                return args;
+            }
+            args.frame_rate = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--io-mode") {
+            std::string mode = i + 1 < argc ? argv[++i] : "";
+            if (mode == "latency") {
+                args.io_mode = headless_tty::IoMode::Latency;
+            } else if (mode == "throughput") {
+                args.io_mode = headless_tty::IoMode::Throughput;
+            } else if (mode == "auto") {
+                args.io_mode = headless_tty::IoMode::Auto;
+            } else {
+                args.error = true;
+                args.error_msg = "--io-mode must be latency, throughput or auto";
+                return args;
+            }
+        }
+        else if (arg == "--manifest") {
+            if (i + 1 >= argc) {
+                args.error = true;
+                args.error_msg = "--manifest requires a path";
+                return args;
+            }
+            args.manifest = to_wstring(argv[++i]);
+        }
+        else if (arg == "--measure-latency") {
+            if (i + 1 >= argc) {
+                args.error = true;
+                args.error_msg = "--measure-latency requires a number of probes";
+                return args;
+            }
+            args.latency_samples = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--latency-gate") {
+            if (i + 1 >= argc) {
+                args.error = true;
+                args.error_msg = "--latency-gate requires a value";
+                return args;
+            }
+            args.latency_gate_ms = std::stod(argv[++i]);
+        }
+        else if (arg == "--unpack-log") {
+            if (i + 1 >= argc) {
+                args.error = true;
+                args.error_msg = "--unpack-log requires a path";
+                return args;
+            }
+            args.unpack_log = to_wstring(argv[++i]);
+        }
+        else if (arg == "--convert") {
+            if (i + 1 >= argc) {
+                args.error = true;
+                args.error_msg = "--convert requires a path";
+                return args;
+            }
+            args.convert_input = to_wstring(argv[++i]);
+        }
+        else if (arg == "--to") {
+            std::string format = i + 1 < argc ? argv[++i] : "";
+            if (format == "text") {
+                args.convert_options.format = headless_tty::ConvertFormat::Text;
+            } else if (format == "asciicast") {
+                args.convert_options.format = headless_tty::ConvertFormat::Asciicast;
+            } else if (format == "screens") {
+                args.convert_options.format = headless_tty::ConvertFormat::Screens;
+            } else {
+                args.error = true;
+                args.error_msg = "--to must be text, asciicast or screens";
+                return args;
+            }
+        }
+        else if (arg == "--output") {
+            if (i + 1 >= argc) {
+                args.error = true;
+                args.error_msg = "--output requires a path";
+                return args;
+            }
+            args.convert_output = to_wstring(argv[++i]);
+        }
+        else if (arg == "--threads") {
+            if (i + 1 >= argc) {
+                args.error = true;
+                args.error_msg = "--threads requires a value";
+                return args;
+            }
+            args.convert_options.threads = static_cast<unsigned>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--dump-every") {
+            if (i + 1 >= argc) {
+                args.error = true;
+                args.error_msg = "--dump-every requires a value";
+                return args;
+            }
+            args.convert_options.dump_interval = std::stoull(argv[++i]) * 1024;
+        }
         else if (arg == "--") {
             // Everything after "--" is the command and its arguments, important for other processes to pass its own arguments
             for (int j = i + 1; j < argc; ++j) {
@@ -127,8 +405,44 @@ Args parse_args(int argc, char* argv[]) {
         }
     }
 
-    
+    // A manifest brings its own commands; per-session features need a single child
+    if (!args.manifest.empty() && (!positional.empty() || !args.input_file.empty() || !args.expect_script.empty() ||
+                                   !args.snapshot_path.empty() || !args.shared_screen.empty() || args.frame_rate > 0)) {
+        args.error = true;
+        args.error_msg = "--manifest can't be combined with a command, --input-file, --expect-script, --snapshot, --shared-screen or --frame-rate";
+        return args;
+    }
+
+    // Frames replace the raw stdin/stdout streams of a single session
+    if (args.framed && (args.sys_tray || !args.manifest.empty() || !args.input_file.empty() ||
+                        args.frame_rate > 0 || args.latency_samples > 0)) {
+        args.error = true;
+        args.error_msg = "--framed can't be combined with --sys-tray, --manifest, --input-file, --frame-rate or --measure-latency";
+        return args;
+    }
+
+    // Tray mode only logs and publishes the session; nothing runs a script or repaints a console there
+    if (args.sys_tray && !args.expect_script.empty()) {
+        args.error = true;
+        args.error_msg = "--sys-tray can't be combined with --expect-script";
+        return args;
+    }
+
+    // Without a console --frame-rate only sets the --shared-screen publish rate
+    if (args.sys_tray && args.frame_rate > 0 && args.shared_screen.empty()) {
+        args.error = true;
+        args.error_msg = "--sys-tray can't be combined with --frame-rate unless --shared-screen is given";
+        return args;
+    }
+
+    if (args.latency_samples > 0 && !args.manifest.empty()) {
+        args.error = true;
+        args.error_msg = "--measure-latency can't be combined with --manifest";
+        return args;
+    }
+
     if (!positional.empty()) {
+        args.has_command = true;
         args.command = to_wstring(positional[0]);
 
         
@@ -145,46 +459,214 @@ Args parse_args(int argc, char* argv[]) {
         args.args = to_wstring(argsStr);
     }
 
+    args.log_options.compact.rows = args.height;    // Follows the child's cursor positioning
+    args.convert_options.size = { args.width, args.height };
     return args;
 }
 
 
+// IoThread - a std::thread that can be woken out of blocking I/O with CancelSynchronousIo
+// std::thread::native_handle() is a HANDLE only under the MS STL (a pthread_t under
+// libstdc++/MinGW), so the thread duplicates its own handle before it runs, and start()
+// waits for it.
+
+class IoThread {
+public:
+    IoThread() = default;
+    ~IoThread() {
+        cancel_and_join();
+    }
+
+    IoThread(const IoThread&) = delete;
+    IoThread& operator=(const IoThread&) = delete;
+
+    template <typename F, typename... Args>
+    void start(F&& f, Args&&... args) {
+        std::promise<HANDLE> handle;
+        std::future<HANDLE> ready = handle.get_future();
+        m_thread = std::thread([&handle](auto fn, auto... fnArgs) {
+            HANDLE self = nullptr;
+            DuplicateHandle(GetCurrentProcess(), GetCurrentThread(), GetCurrentProcess(), &self,
+                            0, FALSE, DUPLICATE_SAME_ACCESS);
+            handle.set_value(self);     // handle is gone once start() returns
+            fn(fnArgs...);
+        }, std::forward<F>(f), std::forward<Args>(args)...);
+        m_handle = ready.get();
+    }
+
+    // Cancel a blocking ReadFile/WriteFile/ReadConsole the thread is in, then wait for it
+    void cancel_and_join() {
+        if (!m_thread.joinable()) {
+            return;
+        }
+        if (m_handle) {
+            CancelSynchronousIo(m_handle);
+        }
+        m_thread.join();
+        if (m_handle) {
+            CloseHandle(m_handle);
+            m_handle = nullptr;
+        }
+    }
+
+private:
+    std::thread m_thread;
+    HANDLE m_handle = nullptr;
+};
+
+
+// Blocks in the read itself; main() cancels it with CancelSynchronousIo on shutdown
 void stdin_forwarder(headless_tty::HeadlessTTY& tty) {
     // Set stdin to binary mode to handle raw bytes
     _setmode(_fileno(stdin), _O_BINARY);
 
     char buffer[headless_tty::INPUT_BUFFER_SIZE];
+    HANDLE hStdin = GetStdHandle(STD_INPUT_HANDLE);
+    DWORD mode = 0;
+    bool isConsole = GetConsoleMode(hStdin, &mode) != FALSE;
+    HANDLE waitHandles[3] = { hStdin, g_hShutdownEvent, tty.exit_event() };
 
     while (!g_shutdown_requested.load() && tty.is_running()) {
-        HANDLE hStdin = GetStdHandle(STD_INPUT_HANDLE);
-        DWORD available = 0;
+        DWORD bytesRead = 0;
 
+        if (isConsole) {
+            // Console input handle is signaled while input events are queued
+            if (WaitForMultipleObjects(3, waitHandles, FALSE, INFINITE) != WAIT_OBJECT_0) {
+                break;
+            }
+            if (!ReadConsoleA(hStdin, buffer, sizeof(buffer) - 1, &bytesRead, NULL)) {
+                break;
+            }
+        } else {
+            // Pipe or file - a blocking read returns as soon as any data arrives
+            if (!ReadFile(hStdin, buffer, sizeof(buffer), &bytesRead, NULL) || bytesRead == 0) {
+                break;
+            }
+        }
 
-        INPUT_RECORD inputRecords[128];
-        DWORD eventsRead = 0;
+        if (bytesRead > 0) {
+            tty.write(reinterpret_cast<uint8_t*>(buffer), bytesRead);
+        }
+    }
+}
+
+
+// --framed: commands from the parent; output frames are written by the output callback
+void framed_stdin_forwarder(headless_tty::HeadlessTTY& tty, headless_tty::FrameWriter& frames) {
+    _setmode(_fileno(stdin), _O_BINARY);
 
-        if (GetConsoleMode(hStdin, &available)) {
-            if (PeekConsoleInput(hStdin, inputRecords, 128, &eventsRead) && eventsRead > 0) {
-                DWORD charsRead = 0;
-                if (ReadConsoleA(hStdin, buffer, sizeof(buffer) - 1, &charsRead, NULL)) {
-                    if (charsRead > 0) {
-                        tty.write(reinterpret_cast<uint8_t*>(buffer), charsRead);
-                    }
+    char buffer[headless_tty::INPUT_BUFFER_SIZE];
+    HANDLE hStdin = GetStdHandle(STD_INPUT_HANDLE);
+    headless_tty::FrameParser parser;
+    auto dispatch = [&tty, &frames](uint8_t type, const uint8_t* payload, size_t length) {
+        switch (type) {
+            case headless_tty::FRAME_INPUT:
+                tty.write(payload, length);
+                break;
+
+            case headless_tty::FRAME_RESIZE: {
+                if (length < 4) {
+                    frames.error("RESIZE needs cols and rows");
+                    break;
                 }
-            } else {
-                Sleep(10);
-            }
-        } else {
-            // Pipe mode - use ReadFile
-            if (PeekNamedPipe(hStdin, NULL, 0, NULL, &available, NULL) && available > 0) {
-                DWORD bytesRead = 0;
-                if (ReadFile(hStdin, buffer, sizeof(buffer), &bytesRead, NULL) && bytesRead > 0) {
-                    tty.write(reinterpret_cast<uint8_t*>(buffer), bytesRead);
+                headless_tty::TerminalSize size;
+                size.cols = static_cast<uint16_t>(payload[0] | (payload[1] << 8));
+                size.rows = static_cast<uint16_t>(payload[2] | (payload[3] << 8));
+                if (size.cols == 0 || size.rows == 0) {
+                    frames.error("RESIZE needs a non-zero size");
+                    break;
                 }
-            } else {
-                Sleep(10);
+                tty.resize(size);   // Acknowledged by the resized callback once it is applied
+                break;
             }
+
+            case headless_tty::FRAME_METRICS:
+                frames.metrics(tty.get_io_stats());
+                break;
+
+            case headless_tty::FRAME_STOP:
+                request_shutdown();
+                break;
+
+            default:
+                frames.error("Unknown frame type " + std::to_string(type));
+                break;
+        }
+    };
+
+    while (!g_shutdown_requested.load() && tty.is_running()) {
+        DWORD bytesRead = 0;
+        if (!ReadFile(hStdin, buffer, sizeof(buffer), &bytesRead, NULL) || bytesRead == 0) {
+            break;
         }
+        parser.feed(reinterpret_cast<uint8_t*>(buffer), bytesRead, dispatch);
+    }
+}
+
+
+// Streams --input-file into the PTY; cancelled by the shutdown event
+void input_file_forwarder(headless_tty::HeadlessTTY& tty, const Args& args) {
+    std::string error;
+    if (!headless_tty::stream_input_file(tty, args.input_file, args.input_options, g_hShutdownEvent, &error) &&
+        !g_shutdown_requested.load()) {
+        std::cerr << "Input file: " << error << std::endl;
+    }
+}
+
+
+// --snapshot: load the screen saved by the previous run, if there is one, and optionally repaint it
+void restore_snapshot(headless_tty::HeadlessTTY& tty, const std::wstring& path, HANDLE hOut) {
+    if (GetFileAttributesW(path.c_str()) == INVALID_FILE_ATTRIBUTES) {
+        return;
+    }
+
+    std::string error;
+    if (!tty.load_snapshot(path, &error)) {
+        if (hOut != INVALID_HANDLE_VALUE) {
+            std::cerr << "Snapshot not restored: " << error << std::endl;
+        }
+        return;
+    }
+
+    if (hOut != INVALID_HANDLE_VALUE) {
+        tty.read_screen([hOut](const headless_tty::Screen& screen) {
+            headless_tty::ScreenFrame frame;
+            std::string rendered;
+            screen.snapshot(frame);
+            headless_tty::render_frame(frame, rendered);
+            DWORD bytesWritten;
+            WriteFile(hOut, rendered.data(), static_cast<DWORD>(rendered.size()), &bytesWritten, NULL);
+        });
+    }
+}
+
+void save_snapshot(headless_tty::HeadlessTTY& tty, const std::wstring& path, bool has_console) {
+    std::string error;
+    if (!tty.save_snapshot(path, &error) && has_console) {
+        std::cerr << "Snapshot not saved: " << error << std::endl;
+    }
+}
+
+// --shared-screen: publish frames from a FrameViewer into the named mapping
+bool start_shared_screen(const Args& args, const headless_tty::Config& config,
+                         headless_tty::SharedScreenWriter& shared, headless_tty::FrameViewer& publisher) {
+    if (!shared.create(args.shared_screen, config.size)) {
+        return false;
+    }
+
+    uint32_t fps = args.frame_rate > 0 ? args.frame_rate : headless_tty::SHARED_SCREEN_DEFAULT_FPS;
+    publisher.start(config.size, fps, [&shared](const headless_tty::ScreenFrame& frame) {
+        shared.publish(frame);
+    });
+    return true;
+}
+
+// Runs --expect-script; a failing script ends the session
+void script_runner(headless_tty::HeadlessTTY& tty, headless_tty::ExpectScript& script) {
+    if (!script.run(tty, g_hShutdownEvent) && !g_shutdown_requested.load()) {
+        std::cerr << "Expect script failed: " << script.get_last_error() << std::endl;
+        g_script_failed.store(true);
+        request_shutdown();
     }
 }
 
@@ -194,7 +676,7 @@ void stdin_forwarder(headless_tty::HeadlessTTY& tty) {
 // Console control handler - called when user closes console window
 BOOL WINAPI ConsoleCtrlHandler(DWORD ctrlType) {
     if (ctrlType == CTRL_CLOSE_EVENT || ctrlType == CTRL_C_EVENT || ctrlType == CTRL_BREAK_EVENT) {
-        g_shutdown_requested.store(true);
+        request_shutdown();
         if (g_tray_hwnd) {
             PostMessage(g_tray_hwnd, WM_CLOSE, 0, 0);
         }
@@ -213,6 +695,9 @@ void show_console() {
     g_hConsoleOut = GetStdHandle(STD_OUTPUT_HANDLE);
     g_hConsoleIn = GetStdHandle(STD_INPUT_HANDLE);
 
+    // ConPTY output and the line editor echo are both UTF-8
+    SetConsoleOutputCP(CP_UTF8);
+
     if (g_hConsoleOut != INVALID_HANDLE_VALUE) {
         // Enable VT processing for proper terminal rendering
         DWORD outMode = 0;
@@ -228,6 +713,7 @@ void show_console() {
 
     SetConsoleTitleW(L"headless-tty");
     g_console_visible.store(true);
+    SetEvent(g_hConsoleChangedEvent);
 
     // Register handler so closing console window exits app
     SetConsoleCtrlHandler(ConsoleCtrlHandler, TRUE);
@@ -260,6 +746,7 @@ void hide_console() {
     if (!g_console_visible.load()) return;
 
     g_console_visible.store(false);
+    SetEvent(g_hConsoleChangedEvent);
     SetConsoleCtrlHandler(ConsoleCtrlHandler, FALSE);
 
     // Invalidate handles (don't close - they're from GetStdHandle)
@@ -344,9 +831,65 @@ void remove_tray() {
     }
 }
 
+// Translate a batch of console input records into line editor events
+// Surrogate pairs may straddle batches, so the pending high surrogate is carried by the caller.
+void translate_input_records(const INPUT_RECORD* records, DWORD count,
+                             std::vector<headless_tty::EditEvent>& events, wchar_t& pendingHigh) {
+    using headless_tty::EditKey;
+
+    for (DWORD i = 0; i < count; ++i) {
+        if (records[i].EventType != KEY_EVENT || !records[i].Event.KeyEvent.bKeyDown) {
+            continue;
+        }
+
+        const KEY_EVENT_RECORD& key = records[i].Event.KeyEvent;
+        headless_tty::EditEvent ev;
+
+        switch (key.wVirtualKeyCode) {
+            case VK_RETURN: ev.key = EditKey::Enter; break;
+            case VK_BACK:   ev.key = EditKey::Backspace; break;
+            case VK_DELETE: ev.key = EditKey::Delete; break;
+            case VK_LEFT:   ev.key = EditKey::Left; break;
+            case VK_RIGHT:  ev.key = EditKey::Right; break;
+            case VK_HOME:   ev.key = EditKey::Home; break;
+            case VK_END:    ev.key = EditKey::End; break;
+            default: {
+                wchar_t ch = key.uChar.UnicodeChar;
+                if (ch >= 0xD800 && ch <= 0xDBFF) {
+                    pendingHigh = ch;
+                    continue;
+                }
+                if (ch >= 0xDC00 && ch <= 0xDFFF) {
+                    if (!pendingHigh) continue;
+                    ev.codepoint = 0x10000 + ((static_cast<char32_t>(pendingHigh) - 0xD800) << 10) + (ch - 0xDC00);
+                    pendingHigh = 0;
+                } else if (ch >= 32 && ch != 127) {
+                    ev.codepoint = ch;
+                } else {
+                    continue;
+                }
+                ev.key = EditKey::Char;
+                break;
+            }
+        }
+
+        WORD repeat = key.wRepeatCount ? key.wRepeatCount : 1;
+        events.insert(events.end(), repeat, ev);
+    }
+}
+
 // Console input forwarder for tray mode using raw input events
+// Reads input records in bulk so a paste is handled in a few batches, with one echo write
+// and one PTY write per batch.
 void tray_console_input_forwarder(headless_tty::HeadlessTTY& tty) {
-    std::string lineBuffer;
+    constexpr DWORD RECORD_BATCH = 512;
+
+    std::vector<INPUT_RECORD> records(RECORD_BATCH);
+    std::vector<headless_tty::EditEvent> events;
+    headless_tty::LineEditor editor;
+    std::string echo;
+    std::string committed;
+    wchar_t pendingHigh = 0;
 
     while (true) {
         if (g_shutdown_requested.load() || !tty.is_running()) {
@@ -355,71 +898,45 @@ void tray_console_input_forwarder(headless_tty::HeadlessTTY& tty) {
 
         HANDLE hIn = g_hConsoleIn;
         HANDLE hOut = g_hConsoleOut;
-        if (!g_console_visible.load() || hIn == INVALID_HANDLE_VALUE) {
-            Sleep(50);
-            continue;
-        }
-
-        DWORD waitResult = WaitForSingleObject(hIn, 50);
+        bool visible = g_console_visible.load() && hIn != INVALID_HANDLE_VALUE;
 
-        if (g_shutdown_requested.load() || !tty.is_running()) {
-            break;
-        }
+        // Sleep until input arrives, the console is shown/hidden, or the session ends
+        HANDLE waitHandles[4] = { g_hShutdownEvent, tty.exit_event(), g_hConsoleChangedEvent, hIn };
+        DWORD waitResult = WaitForMultipleObjects(visible ? 4 : 3, waitHandles, FALSE, INFINITE);
 
-        if (waitResult != WAIT_OBJECT_0 || !g_console_visible.load()) {
+        if (waitResult != WAIT_OBJECT_0 + 3 || !g_console_visible.load()) {
             continue;
         }
 
-        // Read input events
-        INPUT_RECORD record;
-        DWORD eventsRead = 0;
-        if (!ReadConsoleInputA(hIn, &record, 1, &eventsRead) || eventsRead == 0) {
+        // Returns everything already queued (up to one batch) without waiting for more
+        DWORD recordsRead = 0;
+        if (!ReadConsoleInputW(hIn, records.data(), RECORD_BATCH, &recordsRead) || recordsRead == 0) {
             continue;
         }
 
-        // Only process key down events
-        if (record.EventType != KEY_EVENT || !record.Event.KeyEvent.bKeyDown) {
-            continue;
-        }
+        events.clear();
+        translate_input_records(records.data(), recordsRead, events, pendingHigh);
 
-        char ch = record.Event.KeyEvent.uChar.AsciiChar;
-        WORD vk = record.Event.KeyEvent.wVirtualKeyCode;
+        echo.clear();
+        committed.clear();
+        editor.process(events.data(), events.size(), echo, committed);
 
-        if (vk == VK_RETURN) {
-            // Echo newline and send line to PTY
-            if (hOut != INVALID_HANDLE_VALUE) {
-                DWORD written;
-                WriteConsoleA(hOut, "\r\n", 2, &written, NULL);
-            }
-            lineBuffer += "\r\n";
-            if (tty.is_running()) {
-                tty.write(reinterpret_cast<const uint8_t*>(lineBuffer.c_str()), lineBuffer.size());
-            }
-            lineBuffer.clear();
-        } else if (vk == VK_BACK) {
-            // Handle backspace
-            if (!lineBuffer.empty()) {
-                lineBuffer.pop_back();
-                if (hOut != INVALID_HANDLE_VALUE) {
-                    DWORD written;
-                    WriteConsoleA(hOut, "\b \b", 3, &written, NULL);
-                }
-            }
-        } else if (ch >= 32 && ch < 127) {
-            // Printable ASCII - echo and buffer
-            lineBuffer += ch;
-            if (hOut != INVALID_HANDLE_VALUE) {
-                DWORD written;
-                WriteConsoleA(hOut, &ch, 1, &written, NULL);
-            }
+        if (!echo.empty() && hOut != INVALID_HANDLE_VALUE) {
+            DWORD written;
+            WriteFile(hOut, echo.data(), static_cast<DWORD>(echo.size()), &written, NULL);
+        }
+        if (!committed.empty() && tty.is_running()) {
+            tty.write(reinterpret_cast<const uint8_t*>(committed.data()), committed.size());
         }
     }
 }
 
 // Run in system tray mode
-int run_tray_mode(const Args& args) {
+int run_tray_mode(const Args& args, headless_tty::LogSink& log) {
     HINSTANCE hInstance = GetModuleHandle(NULL);
 
+    g_hConsoleChangedEvent = CreateEventW(NULL, FALSE, FALSE, NULL);
+
     if (!setup_tray(hInstance)) {
         return 1;
     }
@@ -432,55 +949,82 @@ int run_tray_mode(const Args& args) {
     config.size.rows = args.height;
     config.command = args.command;
     config.args = args.args;
+    config.io_mode = args.io_mode;
+    config.track_screen = !args.snapshot_path.empty();
 
-    if (!tty.start(config)) {
+    if (config.track_screen) {
+        restore_snapshot(tty, args.snapshot_path, INVALID_HANDLE_VALUE);
+    }
+
+    headless_tty::SharedScreenWriter shared;
+    headless_tty::FrameViewer publisher;
+    bool publishing = !args.shared_screen.empty();
+    if (publishing && !start_shared_screen(args, config, shared, publisher)) {
         remove_tray();
         return 1;
     }
 
-    // Set output callback AFTER start() - m_pty must exist first
-    tty.set_output_callback([](const uint8_t* data, size_t length) {
+    // Installed before start() so the child's first output isn't lost
+    tty.set_output_callback([&log, &publisher, publishing](const uint8_t* data, size_t length) {
+        log.write(data, length);
+        if (publishing) {
+            publisher.feed(data, length);
+        }
         if (g_console_visible.load() && g_hConsoleOut != INVALID_HANDLE_VALUE) {
             DWORD written;
             WriteFile(g_hConsoleOut, data, static_cast<DWORD>(length), &written, NULL);
         }
     });
 
+    if (!tty.start(config)) {
+        remove_tray();
+        return 1;
+    }
+
     // Start console input forwarder thread
     std::thread input_thread(tray_console_input_forwarder, std::ref(tty));
+    IoThread file_thread;
+    if (!args.input_file.empty()) {
+        file_thread.start(input_file_forwarder, std::ref(tty), std::cref(args));
+    }
 
-    // Message loop with periodic check for process exit
+    // Message loop - a single wait on child exit, shutdown and the message queue
     MSG msg;
+    HANDLE waitHandles[2] = { tty.exit_event(), g_hShutdownEvent };
     while (!g_shutdown_requested.load()) {
-        // Wait for messages or timeout (100ms) to check process status
-        DWORD result = MsgWaitForMultipleObjects(0, NULL, FALSE, 100, QS_ALLINPUT);
+        DWORD result = MsgWaitForMultipleObjects(2, waitHandles, FALSE, INFINITE, QS_ALLINPUT);
 
-        if (result == WAIT_OBJECT_0) {
+        if (result == WAIT_OBJECT_0 + 2) {
             // Process all pending messages
             while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
                 if (msg.message == WM_QUIT) {
-                    g_shutdown_requested.store(true);
+                    request_shutdown();
                     break;
                 }
                 TranslateMessage(&msg);
                 DispatchMessage(&msg);
             }
-        }
-
-        // Check if child process exited
-        if (!tty.is_running()) {
-            g_shutdown_requested.store(true);
+        } else {
+            // Child exited (output drained) or shutdown requested
+            request_shutdown();
         }
     }
 
     // Cleanup
-    g_shutdown_requested.store(true);
+    request_shutdown();
     tty.stop();
+    publisher.stop();
+    shared.mark_exited();
+    if (config.track_screen) {
+        save_snapshot(tty, args.snapshot_path, false);
+    }
 
-    // Input thread will exit on next loop iteration (100ms max)
+    // Input thread is woken by the shutdown event
     if (input_thread.joinable()) {
         input_thread.join();
     }
+    // May be blocked in a PTY write that will never drain
+    file_thread.cancel_and_join();
 
     if (g_console_visible.load()) {
         hide_console();
@@ -492,6 +1036,192 @@ int run_tray_mode(const Args& args) {
     return exitCode >= 0 ? exitCode : 0;
 }
 
+// --manifest: host every entry in this process, with or without the tray icon
+int run_manifest(const Args& args, headless_tty::LogSink& log, bool has_console) {
+    headless_tty::SupervisorEntry defaults;
+    defaults.config.size.cols = args.width;
+    defaults.config.size.rows = args.height;
+    defaults.config.io_mode = args.io_mode;
+    defaults.plain = args.log_options.plain_text;
+
+    std::vector<headless_tty::SupervisorEntry> entries;
+    std::string error;
+    if (!headless_tty::load_manifest(args.manifest, defaults, entries, &error)) {
+        if (has_console) {
+            std::cerr << "Manifest: " << error << std::endl;
+        }
+        return 1;
+    }
+
+    bool tray = args.sys_tray;
+    if (tray) {
+        g_hConsoleChangedEvent = CreateEventW(NULL, FALSE, FALSE, NULL);
+        if (!setup_tray(GetModuleHandle(NULL))) {
+            return 1;
+        }
+    } else {
+        signal(SIGINT, signal_handler);
+        signal(SIGTERM, signal_handler);
+        if (has_console) {
+            _setmode(_fileno(stdout), _O_BINARY);
+            _setmode(_fileno(stderr), _O_BINARY);
+        }
+    }
+
+    // Stdout is written in batches by a writer thread, so lines from many children that
+    // pile up during one write go out in the next single WriteFile
+    headless_tty::HandleSink stdoutSink;
+    headless_tty::OutputBatcher stdoutBatcher;
+    if (!tray && has_console && stdoutSink.open_stdout()) {
+        stdoutBatcher.start(stdoutSink);
+    }
+
+    // Multiplexed output goes to --log and to the console (the tray console while it is shown)
+    headless_tty::Supervisor supervisor;
+    bool started = supervisor.start(entries, args.log_options, [&log, &stdoutBatcher, tray](const uint8_t* data, size_t length) {
+        log.write(data, length);
+        if (!tray) {
+            stdoutBatcher.push(data, length);
+        } else if (g_console_visible.load()) {
+            DWORD written;
+            WriteFile(g_hConsoleOut, data, static_cast<DWORD>(length), &written, NULL);
+        }
+    });
+    if (!started) {
+        if (has_console) {
+            std::cerr << "Manifest: " << supervisor.get_last_error() << std::endl;
+        }
+        if (tray) {
+            remove_tray();
+        }
+        return 1;
+    }
+
+    // One loop for every child: exits, restart timers, shutdown and (in tray mode) window messages
+    HANDLE waitHandles[2] = { supervisor.wake_event(), g_hShutdownEvent };
+    while (!g_shutdown_requested.load()) {
+        DWORD timeout = supervisor.dispatch();
+        if (supervisor.finished()) {
+            break;
+        }
+
+        if (!tray) {
+            WaitForMultipleObjects(2, waitHandles, FALSE, timeout);
+            continue;
+        }
+        if (MsgWaitForMultipleObjects(2, waitHandles, FALSE, timeout, QS_ALLINPUT) == WAIT_OBJECT_0 + 2) {
+            MSG msg;
+            while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+                if (msg.message == WM_QUIT) {
+                    request_shutdown();
+                    break;
+                }
+                TranslateMessage(&msg);
+                DispatchMessage(&msg);
+            }
+        }
+    }
+
+    supervisor.stop();
+    stdoutBatcher.stop();
+    if (tray) {
+        if (g_console_visible.load()) {
+            hide_console();
+        }
+        remove_tray();
+    }
+    return supervisor.exit_code();
+}
+
+// --measure-latency: time markers from write() to their echo, idle and next to a session flooding output
+int run_latency_mode(const Args& args) {
+    // Report to stdout when it is redirected, otherwise to the console we were started from
+    HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
+    if ((hOut == NULL || hOut == INVALID_HANDLE_VALUE) && AttachConsole(ATTACH_PARENT_PROCESS)) {
+        hOut = CreateFileW(L"CONOUT$", GENERIC_WRITE, FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0, NULL);
+    }
+    auto report = [hOut](const std::string& text) {
+        if (hOut != NULL && hOut != INVALID_HANDLE_VALUE) {
+            DWORD written;
+            WriteFile(hOut, text.data(), static_cast<DWORD>(text.size()), &written, NULL);
+        }
+    };
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+
+    headless_tty::Config config;
+    config.size.cols = args.width;
+    config.size.rows = args.height;
+    config.io_mode = args.io_mode;
+
+    // The built-in echo child is cmd.exe: each probe is typed as a "rem" command, so conhost
+    // echoes it on a fresh line and cmd ignores it
+    headless_tty::LatencyOptions options;
+    options.samples = args.latency_samples;
+    if (args.has_command) {
+        config.command = args.command;
+        config.args = args.args;
+    } else {
+        config.command = L"cmd.exe";
+        config.args = L"/d /q /k prompt $g";
+        options.prefix = "rem ";
+    }
+
+    headless_tty::LatencyProbe probe;
+    headless_tty::HeadlessTTY tty;
+    tty.set_output_callback([&probe](const uint8_t* data, size_t length) {
+        probe.feed(data, length);
+    });
+    if (!tty.start(config)) {
+        report("Failed to start headless TTY: " + tty.get_last_error() + "\n");
+        return 1;
+    }
+
+    headless_tty::LatencyStats idle;
+    bool ok = probe.run(tty, options, g_hShutdownEvent, idle);
+    if (ok) {
+        report(headless_tty::format_latency("Idle", idle));
+    }
+
+    if (ok) {
+        std::atomic<uint64_t> loadBytes{ 0 };
+        headless_tty::HeadlessTTY load;
+        headless_tty::Config loadConfig = config;
+        loadConfig.command = L"cmd.exe";
+        loadConfig.args = L"/d /q /c for /l %i in (0,0,1) do @echo " + std::wstring(100, L'x');
+        load.set_output_callback([&loadBytes](const uint8_t*, size_t length) {
+            loadBytes.fetch_add(length, std::memory_order_relaxed);
+        });
+
+        if (load.start(loadConfig)) {
+            ULONGLONG started = GetTickCount64();
+            headless_tty::LatencyStats busy;
+            ok = probe.run(tty, options, g_hShutdownEvent, busy);
+            double seconds = (GetTickCount64() - started) / 1000.0;
+            load.stop();
+            if (ok) {
+                char line[96];
+                snprintf(line, sizeof(line), "  load    %9.1f MB/s\n", loadBytes.load() / 1e6 / (seconds > 0 ? seconds : 1));
+                report("\n" + headless_tty::format_latency("Under bulk output load", busy) + line);
+            }
+        } else {
+            report("\nLoad session failed to start: " + load.get_last_error() + "\n");
+        }
+    }
+
+    tty.stop();
+    if (!ok) {
+        report("Latency probe: " + probe.get_last_error() + "\n");
+        return 1;
+    }
+    if (args.latency_gate_ms > 0 && idle.p99_us > args.latency_gate_ms * 1000.0) {
+        report("\nIdle p99 is above the --latency-gate\n");
+        return 1;
+    }
+    return 0;
+}
+
 
 int main(int argc, char* argv[]) {
     Args args = parse_args(argc, argv);
@@ -541,9 +1271,70 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    if (!args.unpack_log.empty()) {
+        std::wstring output = args.unpack_log;
+        if (output.size() > 4 && output.compare(output.size() - 4, 4, L".xph") == 0) {
+            output.resize(output.size() - 4);
+        } else {
+            output += L".log";
+        }
+
+        std::string error;
+        if (!headless_tty::decompress_log_segment(args.unpack_log, output, &error)) {
+            if (has_console) {
+                std::cerr << "Failed to unpack log: " << error << std::endl;
+            }
+            return 1;
+        }
+        return 0;
+    }
+
+    if (!args.convert_input.empty()) {
+        std::wstring output = args.convert_output;
+        if (output.empty()) {
+            static const wchar_t* extensions[] = { L".txt", L".cast", L".screens" };
+            output = args.convert_input + extensions[static_cast<int>(args.convert_options.format)];
+        }
+
+        std::string error;
+        headless_tty::ConvertStats stats;
+        ULONGLONG started = GetTickCount64();
+        if (!headless_tty::convert_capture_file(args.convert_input, output, args.convert_options, &stats, &error)) {
+            if (has_console) {
+                std::cerr << "Failed to convert capture: " << error << std::endl;
+            }
+            return 1;
+        }
+        if (has_console) {
+            std::cerr << "Converted " << stats.input_bytes << " bytes into " << stats.output_bytes << " in "
+                      << GetTickCount64() - started << " ms (" << stats.segments << " segments on "
+                      << stats.threads << " threads, " << stats.redone << " redone in order)" << std::endl;
+        }
+        return 0;
+    }
+
+    // Log sink is opened before the child starts so no early output is missed
+    headless_tty::LogSink log;
+    if (!args.log_path.empty() && !log.open(args.log_path, args.log_options)) {
+        if (has_console) {
+            std::cerr << "Failed to open log: " << log.get_last_error() << std::endl;
+        }
+        return 1;
+    }
+
+    g_hShutdownEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+
+    if (args.latency_samples > 0) {
+        return run_latency_mode(args);
+    }
+
+    if (!args.manifest.empty()) {
+        return run_manifest(args, log, has_console);
+    }
+
     // System tray mode - separate execution path
     if (args.sys_tray) {
-        return run_tray_mode(args);
+        return run_tray_mode(args, log);
     }
 
     signal(SIGINT, signal_handler);
@@ -555,6 +1346,15 @@ int main(int argc, char* argv[]) {
         _setmode(_fileno(stderr), _O_BINARY);
     }
 
+    // Parse the script up front so syntax errors are reported before anything is spawned
+    headless_tty::ExpectScript script;
+    if (!args.expect_script.empty() && !script.load(args.expect_script)) {
+        if (has_console) {
+            std::cerr << "Expect script: " << script.get_last_error() << std::endl;
+        }
+        return 1;
+    }
+
     // Creation Happens here XD
     headless_tty::HeadlessTTY tty;
 
@@ -564,42 +1364,147 @@ int main(int argc, char* argv[]) {
     config.size.rows = args.height;
     config.command = args.command;
     config.args = args.args;
+    config.io_mode = args.io_mode;
+    config.track_screen = !args.snapshot_path.empty() || script.needs_screen();
 
-    // Only set output callback if we have somewhere to write
-    if (has_console) {
-        tty.set_output_callback([](const uint8_t* data, size_t length) {
-            // Write directly to stdout
+    if (!args.snapshot_path.empty()) {
+        restore_snapshot(tty, args.snapshot_path, has_console ? GetStdHandle(STD_OUTPUT_HANDLE) : INVALID_HANDLE_VALUE);
+    }
+
+    // --frame-rate: repaint the latest screen at a fixed rate, skipping intermediate redraws
+    headless_tty::FrameViewer viewer;
+    bool frames = has_console && args.frame_rate > 0;
+    if (frames) {
+        HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
+        DWORD outMode = 0;
+        if (GetConsoleMode(hOut, &outMode)) {
+            SetConsoleMode(hOut, outMode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+        }
+        viewer.start(config.size, args.frame_rate, [hOut, rendered = std::string()](const headless_tty::ScreenFrame& frame) mutable {
+            headless_tty::render_frame(frame, rendered);
             DWORD bytesWritten;
-            WriteFile(GetStdHandle(STD_OUTPUT_HANDLE), data, static_cast<DWORD>(length), &bytesWritten, NULL);
+            WriteFile(hOut, rendered.data(), static_cast<DWORD>(rendered.size()), &bytesWritten, NULL);
+        });
+    }
+
+    headless_tty::SharedScreenWriter shared;
+    headless_tty::FrameViewer publisher;
+    bool publishing = !args.shared_screen.empty();
+    if (publishing && !start_shared_screen(args, config, shared, publisher)) {
+        if (has_console) {
+            std::cerr << "Shared screen: " << shared.get_last_error() << std::endl;
+        }
+        return 1;
+    }
+
+    // Stdout is written by a writer thread: it takes whatever has piled up since its last
+    // write, so a burst costs one WriteFile per batch instead of one per read.
+    // --framed needs stdout even when stdin is a file rather than a console or pipe.
+    headless_tty::HandleSink stdoutSink;
+    headless_tty::OutputBatcher stdoutBatcher;
+    bool batching = (has_console || args.framed) && !frames && stdoutSink.open_stdout();
+    if (batching) {
+        stdoutBatcher.start(stdoutSink);
+    }
+
+    // --framed: output and events go out as frames through the same batcher
+    headless_tty::FrameWriter framer(stdoutBatcher);
+    bool framed = args.framed;
+    if (framed && !batching) {
+        std::cerr << "--framed needs a standard output: " << stdoutSink.get_last_error() << std::endl;
+        return 1;
+    }
+    if (framed) {
+        framer.hello(config.size);
+    }
+
+    // A resize is acknowledged, and the shared screen follows it, once it reaches the console
+    if (framed || publishing) {
+        tty.set_resized_callback([&tty, &publisher, &framer, framed, publishing](const headless_tty::TerminalSize& size, bool applied) {
+            if (applied && publishing) {
+                publisher.resize(size);
+            }
+            if (framed) {
+                if (applied) {
+                    framer.resized(size);
+                } else {
+                    framer.error("Resize failed: " + tty.get_last_error());
+                }
+            }
+        });
+    }
+
+    // Only set output callback if we have somewhere to write
+    if (has_console || framed || log.is_open() || publishing) {
+        tty.set_output_callback([&log, &viewer, &publisher, &stdoutBatcher, &framer, batching, framed, frames, publishing](const uint8_t* data, size_t length) {
+            log.write(data, length);
+            if (publishing) {
+                publisher.feed(data, length);
+            }
+            if (frames) {
+                viewer.feed(data, length);
+            } else if (framed) {
+                framer.output(data, length);
+            } else if (batching) {
+                stdoutBatcher.push(data, length);
+            }
         });
     }
 
 
     if (!tty.start(config)) {
-        if (has_console) {
+        if (framed) {
+            framer.error("Failed to start headless TTY: " + tty.get_last_error());
+            stdoutBatcher.stop();
+        } else if (has_console) {
             std::cerr << "Failed to start headless TTY: " << tty.get_last_error() << std::endl;
         }
         return 1;
     }
 
-    // Only start stdin forwarding if we have a console
-    std::thread stdin_thread;
-    if (has_console) {
-        stdin_thread = std::thread(stdin_forwarder, std::ref(tty));
+    // Input comes from --input-file if given, otherwise from stdin when we have a console
+    IoThread stdin_thread;
+    if (!args.input_file.empty()) {
+        stdin_thread.start(input_file_forwarder, std::ref(tty), std::cref(args));
+    } else if (framed) {
+        stdin_thread.start(framed_stdin_forwarder, std::ref(tty), std::ref(framer));
+    } else if (has_console) {
+        stdin_thread.start(stdin_forwarder, std::ref(tty));
     }
 
-
-    while (tty.is_running() && !g_shutdown_requested.load()) {
-        Sleep(100);
+    IoThread script_thread;
+    if (!args.expect_script.empty()) {
+        script_thread.start(script_runner, std::ref(tty), std::ref(script));
     }
 
-    g_shutdown_requested.store(true);
-    tty.stop();
+    // Block until the child exits (and its output is drained) or we are asked to stop
+    HANDLE waitHandles[2] = { tty.exit_event(), g_hShutdownEvent };
+    WaitForMultipleObjects(2, waitHandles, FALSE, INFINITE);
 
-    if (stdin_thread.joinable()) {
-        stdin_thread.join();
+    request_shutdown();
+    tty.stop();
+    if (framed) {
+        // tty.stop() has joined the read thread, so this is the last frame after the output
+        framer.exited(tty.wait(0));
+    }
+    stdoutBatcher.stop();
+    viewer.stop();
+    publisher.stop();
+    shared.mark_exited();
+    if (!args.snapshot_path.empty()) {
+        save_snapshot(tty, args.snapshot_path, has_console);
     }
 
+    // Wake the forwarder if it is blocked inside ReadFile/ReadConsoleA or a full PTY write
+    stdin_thread.cancel_and_join();
+
+    // End a waiting expect(); a blocked write needs cancelling
+    tty.cancel_expect();
+    script_thread.cancel_and_join();
+
+    if (g_script_failed.load()) {
+        return 1;
+    }
 
     int exitCode = tty.wait(0);
 
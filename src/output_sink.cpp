@@ -0,0 +1,223 @@
+#include "headless_tty/output_sink.hpp"
+#include "win_error.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace headless_tty {
+
+// HandleSink
+
+HandleSink::~HandleSink() {
+    close();
+}
+
+bool HandleSink::open_stdout() {
+    close();
+    HANDLE handle = GetStdHandle(STD_OUTPUT_HANDLE);
+    if (handle == INVALID_HANDLE_VALUE || handle == nullptr) {
+        m_last_error = "No standard output";
+        return false;
+    }
+    m_handle = handle;
+    m_owned = false;
+    return true;
+}
+
+bool HandleSink::open_file(const std::wstring& path, bool append) {
+    close();
+    HANDLE handle = CreateFileW(path.c_str(), append ? FILE_APPEND_DATA : GENERIC_WRITE, FILE_SHARE_READ, NULL,
+                                append ? OPEN_ALWAYS : CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE) {
+        m_last_error = format_win_error("Failed to open output file");
+        return false;
+    }
+    m_handle = handle;
+    m_owned = true;
+    return true;
+}
+
+bool HandleSink::open_pipe(const std::wstring& name, DWORD timeout_ms) {
+    close();
+    ULONGLONG deadline = GetTickCount64() + timeout_ms;
+    while (true) {
+        HANDLE handle = CreateFileW(name.c_str(), GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+        if (handle != INVALID_HANDLE_VALUE) {
+            m_handle = handle;
+            m_owned = true;
+            return true;
+        }
+        // Every instance busy: wait for one to free up, within the overall timeout
+        DWORD error = GetLastError();
+        ULONGLONG now = GetTickCount64();
+        if (error != ERROR_PIPE_BUSY || now >= deadline ||
+            !WaitNamedPipeW(name.c_str(), static_cast<DWORD>(deadline - now))) {
+            m_last_error = format_win_error("Failed to connect to output pipe");
+            return false;
+        }
+    }
+}
+
+void HandleSink::attach(HANDLE handle) {
+    close();
+    m_handle = handle;
+    m_owned = false;
+}
+
+void HandleSink::close() {
+    if (m_owned && m_handle != INVALID_HANDLE_VALUE) {
+        CloseHandle(m_handle);
+    }
+    m_handle = INVALID_HANDLE_VALUE;
+    m_owned = false;
+}
+
+bool HandleSink::write_all(const uint8_t* data, size_t length) {
+    while (length > 0) {
+        DWORD chunk = static_cast<DWORD>(std::min<size_t>(length, 0x40000000));
+        DWORD written = 0;
+        m_writes.fetch_add(1, std::memory_order_relaxed);
+        if (!WriteFile(m_handle, data, chunk, &written, NULL) || written == 0) {
+            m_last_error = format_win_error("Failed to write output");
+            return false;
+        }
+        data += written;
+        length -= written;
+    }
+    return true;
+}
+
+bool HandleSink::write(const OutputSpan* spans, size_t count) {
+    if (m_handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    size_t total = 0;
+    bool contiguous = true;
+    for (size_t i = 0; i < count; ++i) {
+        if (i > 0 && spans[i].data != spans[i - 1].data + spans[i - 1].length) {
+            contiguous = false;
+        }
+        total += spans[i].length;
+    }
+    m_batches.fetch_add(1, std::memory_order_relaxed);
+    m_spans.fetch_add(count, std::memory_order_relaxed);
+    m_bytes.fetch_add(total, std::memory_order_relaxed);
+    if (total == 0) {
+        return true;
+    }
+    if (contiguous) {
+        return write_all(spans[0].data, total);
+    }
+
+    m_staging.resize(total);
+    size_t offset = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (spans[i].length > 0) {
+            memcpy(m_staging.data() + offset, spans[i].data, spans[i].length);
+            offset += spans[i].length;
+        }
+    }
+    return write_all(m_staging.data(), total);
+}
+
+OutputSinkStats HandleSink::get_stats() const {
+    OutputSinkStats stats;
+    stats.batches = m_batches.load(std::memory_order_relaxed);
+    stats.spans = m_spans.load(std::memory_order_relaxed);
+    stats.bytes = m_bytes.load(std::memory_order_relaxed);
+    stats.writes = m_writes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+
+// OutputBatcher
+
+OutputBatcher::~OutputBatcher() {
+    stop();
+}
+
+void OutputBatcher::start(OutputSink& sink) {
+    stop();
+    m_sink = &sink;
+    m_stopping = false;
+    m_failed.store(false);
+    m_writer_thread = std::thread(&OutputBatcher::writer_loop, this);
+}
+
+void OutputBatcher::push(const uint8_t* data, size_t length) {
+    OutputSpan span = { data, length };
+    push(&span, 1);
+}
+
+void OutputBatcher::push(const OutputSpan* spans, size_t count) {
+    size_t length = 0;
+    for (size_t i = 0; i < count; ++i) {
+        length += spans[i].length;
+    }
+    if (length == 0) return;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        // A single chunk larger than the limit still goes through once the batch is empty
+        m_space.wait(lock, [&] {
+            return m_stopping || m_filling.empty() || m_filling.size() + length <= OUTPUT_BATCH_MAX_BYTES;
+        });
+        if (m_stopping) {
+            return;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            m_filling.insert(m_filling.end(), spans[i].data, spans[i].data + spans[i].length);
+        }
+        m_filling_ends.push_back(m_filling.size());
+    }
+    m_cv.notify_one();
+}
+
+void OutputBatcher::stop() {
+    if (!m_writer_thread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_cv.notify_one();
+    m_space.notify_all();
+    m_writer_thread.join();
+}
+
+void OutputBatcher::writer_loop() {
+    std::vector<uint8_t> draining;
+    std::vector<size_t> ends;
+    std::vector<OutputSpan> spans;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_cv.wait(lock, [this] { return m_stopping || !m_filling.empty(); });
+        if (m_filling.empty()) {
+            return;     // Stopping and everything is written
+        }
+
+        // Take the whole backlog; the swapped-in buffers keep their capacity
+        draining.clear();
+        ends.clear();
+        draining.swap(m_filling);
+        ends.swap(m_filling_ends);
+        lock.unlock();
+        m_space.notify_all();
+
+        spans.clear();
+        size_t start = 0;
+        for (size_t end : ends) {
+            spans.push_back({ draining.data() + start, end - start });
+            start = end;
+        }
+        if (!m_sink->write(spans.data(), spans.size())) {
+            m_failed.store(true);
+        }
+
+        lock.lock();
+    }
+}
+
+} // namespace headless_tty
@@ -1,5 +1,14 @@
 #include "headless_tty/pty.hpp"
+#include "headless_tty/snapshot.hpp"
+#include "win_error.hpp"
 #include <sstream>
+#include <algorithm>
+#include <vector>
+
+// Older SDK and MinGW headers predate high-resolution waitable timers (Windows 10 1803)
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
 
 namespace headless_tty {
 
@@ -23,14 +32,22 @@ ConPTY::ConPTY(ConPTY&& other) noexcept {
     m_hProcess = other.m_hProcess;
     m_hThread = other.m_hThread;
     m_hJob = other.m_hJob;
+    m_hExitEvent = other.m_hExitEvent;
     m_processInfo = other.m_processInfo;
     m_startupInfo = other.m_startupInfo;
     m_attributeList = std::move(other.m_attributeList);
     m_running.store(other.m_running.load());
     m_stop_requested.store(other.m_stop_requested.load());
+    m_last_output_tick.store(other.m_last_output_tick.load());
+    m_io_mode.store(other.m_io_mode.load());
     m_read_thread = std::move(other.m_read_thread);
-    m_monitor_thread = std::move(other.m_monitor_thread);
+    m_hExitWait = other.m_hExitWait;
+    m_resize_timer = other.m_resize_timer;
+    m_size = other.m_size;
     m_output_callback = std::move(other.m_output_callback);
+    m_exit_callback = std::move(other.m_exit_callback);
+    m_resize_callback = std::move(other.m_resize_callback);
+    m_resized_callback = std::move(other.m_resized_callback);
     m_last_error = std::move(other.m_last_error);
 
     other.m_hPC = nullptr;
@@ -41,6 +58,9 @@ ConPTY::ConPTY(ConPTY&& other) noexcept {
     other.m_hProcess = nullptr;
     other.m_hThread = nullptr;
     other.m_hJob = nullptr;
+    other.m_hExitEvent = nullptr;
+    other.m_hExitWait = nullptr;
+    other.m_resize_timer = nullptr;
     other.m_running.store(false);
 }
 
@@ -58,14 +78,22 @@ ConPTY& ConPTY::operator=(ConPTY&& other) noexcept {
         m_hProcess = other.m_hProcess;
         m_hThread = other.m_hThread;
         m_hJob = other.m_hJob;
+        m_hExitEvent = other.m_hExitEvent;
         m_processInfo = other.m_processInfo;
         m_startupInfo = other.m_startupInfo;
         m_attributeList = std::move(other.m_attributeList);
         m_running.store(other.m_running.load());
         m_stop_requested.store(other.m_stop_requested.load());
+        m_last_output_tick.store(other.m_last_output_tick.load());
+        m_io_mode.store(other.m_io_mode.load());
         m_read_thread = std::move(other.m_read_thread);
-        m_monitor_thread = std::move(other.m_monitor_thread);
+        m_hExitWait = other.m_hExitWait;
+        m_resize_timer = other.m_resize_timer;
+        m_size = other.m_size;
         m_output_callback = std::move(other.m_output_callback);
+        m_exit_callback = std::move(other.m_exit_callback);
+        m_resize_callback = std::move(other.m_resize_callback);
+        m_resized_callback = std::move(other.m_resized_callback);
         m_last_error = std::move(other.m_last_error);
 
         other.m_hPC = nullptr;
@@ -76,6 +104,9 @@ ConPTY& ConPTY::operator=(ConPTY&& other) noexcept {
         other.m_hProcess = nullptr;
         other.m_hThread = nullptr;
         other.m_hJob = nullptr;
+        other.m_hExitEvent = nullptr;
+        other.m_hExitWait = nullptr;
+        other.m_resize_timer = nullptr;
         other.m_running.store(false);
     }
     return *this;
@@ -87,18 +118,7 @@ void ConPTY::set_error(const std::string& msg) {
 }
 
 void ConPTY::set_win_error(const std::string& prefix) {
-    DWORD error = GetLastError();
-    LPSTR messageBuffer = nullptr;
-    size_t size = FormatMessageA(
-        FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS,
-        NULL, error, MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT),
-        (LPSTR)&messageBuffer, 0, NULL);
-
-    std::stringstream ss;
-    ss << prefix << ": " << std::string(messageBuffer, size) << " (error " << error << ")";
-    LocalFree(messageBuffer);
-
-    set_error(ss.str());
+    set_error(format_win_error(prefix));
 }
 
 std::string ConPTY::get_last_error() const {
@@ -186,7 +206,14 @@ bool ConPTY::initialize_startup_info() {
 bool ConPTY::initialize(const TerminalSize& size) {
     std::lock_guard<std::mutex> lock(m_mutex);
 
+    m_hExitEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+    if (!m_hExitEvent) {
+        set_win_error("Failed to create exit event");
+        return false;
+    }
+
     if (!create_pipes()) {
+        cleanup();
         return false;
     }
 
@@ -200,6 +227,7 @@ bool ConPTY::initialize(const TerminalSize& size) {
         return false;
     }
 
+    m_size = size;
     return true;
 }
 
@@ -264,8 +292,43 @@ void ConPTY::set_output_callback(OutputCallback callback) {
     m_output_callback = std::move(callback);
 }
 
+void ConPTY::set_exit_callback(ExitCallback callback) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_exit_callback = std::move(callback);
+}
+
+void ConPTY::set_resize_callback(ResizeCallback callback) {
+    std::lock_guard<std::mutex> lock(m_resize_mutex);
+    m_resize_callback = std::move(callback);
+}
+
+void ConPTY::set_resized_callback(ResizedCallback callback) {
+    std::lock_guard<std::mutex> lock(m_resize_mutex);
+    m_resized_callback = std::move(callback);
+}
+
+void ConPTY::set_io_mode(IoMode mode) {
+    m_io_mode.store(mode);
+}
+
+IoStats ConPTY::get_io_stats() const {
+    IoStats stats;
+    stats.bytes = m_stat_bytes.load(std::memory_order_relaxed);
+    stats.reads = m_stat_reads.load(std::memory_order_relaxed);
+    stats.callbacks = m_stat_callbacks.load(std::memory_order_relaxed);
+    return stats;
+}
+
 void ConPTY::read_loop() {
-    uint8_t buffer[PTY_BUFFER_SIZE];
+    std::vector<uint8_t> buffer(PTY_BUFFER_SIZE);
+    size_t averageRead = 0;     // EWMA of read sizes, for IoMode::Auto
+
+    // Throughput mode sleeps out the coalescing window on this timer. Without high-resolution
+    // timers (before Windows 10 1803) a wait would round up to the 15.6 ms tick, so reads are
+    // then only coalesced with output that is already waiting in the pipe.
+    HANDLE coalesceTimer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    LARGE_INTEGER coalesceDue;
+    coalesceDue.QuadPart = -static_cast<LONGLONG>(PTY_COALESCE_WINDOW_US) * 10;     // Relative, 100 ns units
 
     while (!m_stop_requested.load()) {
         DWORD bytesRead = 0;
@@ -280,17 +343,73 @@ void ConPTY::read_loop() {
             }
         }
 
-        BOOL success = ReadFile(m_hPipeOut, buffer, sizeof(buffer), &bytesRead, NULL);
+        BOOL success = ReadFile(m_hPipeOut, buffer.data(), static_cast<DWORD>(buffer.size()), &bytesRead, NULL);
 
-        if (!success || bytesRead == 0) {
+        if (!success) {
             DWORD error = GetLastError();
-            if (error == ERROR_BROKEN_PIPE || error == ERROR_NO_DATA) {
-                break;
+            if (error != ERROR_BROKEN_PIPE && error != ERROR_NO_DATA) {
+                // Retrying a failed pipe would only spin. Nothing more can be read, so wait
+                // for the child to go (stop() terminates it) and report the exit as usual.
+                set_win_error("Reading PTY output failed");
+                if (m_hProcess) {
+                    WaitForSingleObject(m_hProcess, INFINITE);
+                }
             }
-            Sleep(10);
-            continue;
+            break;
+        }
+        if (bytesRead == 0) {
+            continue;   // A zero-length write on the other end; the next read blocks again
+        }
+
+        size_t filled = bytesRead;
+        uint64_t reads = 1;
+        averageRead = averageRead - averageRead / 8 + filled / 8;
+
+        IoMode mode = m_io_mode.load(std::memory_order_relaxed);
+        if (mode == IoMode::Auto) {
+            mode = averageRead >= PTY_AUTO_THROUGHPUT_BYTES ? IoMode::Throughput : IoMode::Latency;
         }
 
+        if (mode == IoMode::Throughput) {
+            // A full read means the child is producing faster than we drain; give the
+            // next read more room
+            if (filled == buffer.size() && buffer.size() < PTY_MAX_BUFFER_SIZE) {
+                buffer.resize(std::min(buffer.size() * 2, PTY_MAX_BUFFER_SIZE));
+            }
+
+            // Pick up output that arrives within the window so one callback covers the burst.
+            // The thread waits at most once per callback, so delivery is never more than one
+            // window late, and it sleeps rather than spins while it waits.
+            bool waited = false;
+            while (filled < buffer.size() && !m_stop_requested.load(std::memory_order_relaxed)) {
+                DWORD available = 0;
+                if (!PeekNamedPipe(m_hPipeOut, NULL, 0, NULL, &available, NULL)) {
+                    break;
+                }
+                if (available > 0) {
+                    DWORD want = static_cast<DWORD>(std::min<size_t>(available, buffer.size() - filled));
+                    DWORD got = 0;
+                    if (!ReadFile(m_hPipeOut, buffer.data() + filled, want, &got, NULL) || got == 0) {
+                        break;
+                    }
+                    filled += got;
+                    ++reads;
+                    continue;
+                }
+
+                if (waited || !coalesceTimer ||
+                    !SetWaitableTimer(coalesceTimer, &coalesceDue, 0, NULL, NULL, FALSE)) {
+                    break;
+                }
+                WaitForSingleObject(coalesceTimer, INFINITE);
+                waited = true;
+            }
+        }
+
+        m_last_output_tick.store(GetTickCount64());
+        m_stat_bytes.fetch_add(filled, std::memory_order_relaxed);
+        m_stat_reads.fetch_add(reads, std::memory_order_relaxed);
+
         OutputCallback callback;
         {
             std::lock_guard<std::mutex> lock(m_mutex);
@@ -298,22 +417,59 @@ void ConPTY::read_loop() {
         }
 
         if (callback) {
-            callback(buffer, bytesRead);
+            m_stat_callbacks.fetch_add(1, std::memory_order_relaxed);
+            callback(buffer.data(), filled);
         }
     }
 
+    if (coalesceTimer) {
+        CloseHandle(coalesceTimer);
+    }
     m_running.store(false);
-}
 
-void ConPTY::monitor_loop() {
-    if (!m_hProcess) return;
+    ExitCallback exitCallback;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        exitCallback = m_exit_callback;
+    }
+    if (exitCallback) {
+        exitCallback();
+    }
 
-    // Wait for the child process to exit
-    WaitForSingleObject(m_hProcess, INFINITE);
+    SetEvent(m_hExitEvent);
+}
+
+VOID CALLBACK ConPTY::process_exit_callback(PVOID context, BOOLEAN timedOut) {
+    (void)timedOut;
+    static_cast<ConPTY*>(context)->on_process_exit();
+}
 
+void ConPTY::on_process_exit() {
     // Child exited - close the pseudo console to break pipes
     // This will cause read_loop's ReadFile to return, allowing clean exit
-    if (m_hPC && !m_stop_requested.load()) {
+    if (m_stop_requested.load()) {
+        return;
+    }
+
+    // A coalesced resize has nothing left to resize; drop it and let a running one finish.
+    // The timer itself is only closed by stop(), after this callback has returned.
+    PTP_TIMER timer;
+    {
+        std::lock_guard<std::mutex> lock(m_resize_mutex);
+        timer = m_resize_timer;
+        m_resize_pending = false;
+        m_resize_armed = false;
+        if (timer) {
+            SetThreadpoolTimer(timer, NULL, 0, 0);
+        }
+    }
+    if (timer) {
+        WaitForThreadpoolTimerCallbacks(timer, TRUE);
+    }
+
+    // resize() and the timer only touch m_hPC under m_resize_mutex
+    std::lock_guard<std::mutex> lock(m_resize_mutex);
+    if (m_hPC) {
         ClosePseudoConsole(m_hPC);
         m_hPC = nullptr;
     }
@@ -325,9 +481,10 @@ void ConPTY::start_reading() {
     }
     m_read_thread = std::thread(&ConPTY::read_loop, this);
 
-    // Start monitor thread to detect child process exit
-    if (!m_monitor_thread.joinable()) {
-        m_monitor_thread = std::thread(&ConPTY::monitor_loop, this);
+    // Detect child process exit; one pool thread waits on many processes
+    if (!m_hExitWait && m_hProcess) {
+        RegisterWaitForSingleObject(&m_hExitWait, m_hProcess, &ConPTY::process_exit_callback, this,
+                                    INFINITE, WT_EXECUTEONLYONCE);
     }
 }
 
@@ -366,11 +523,22 @@ void ConPTY::stop() {
         m_read_thread.join();
     }
 
-    if (m_monitor_thread.joinable()) {
-        m_monitor_thread.join();
+    if (m_hExitWait) {
+        UnregisterWaitEx(m_hExitWait, INVALID_HANDLE_VALUE);    // Waits for a running callback
+        m_hExitWait = nullptr;
+    }
+
+    if (m_resize_timer) {
+        SetThreadpoolTimer(m_resize_timer, NULL, 0, 0);         // A pending resize is dropped
+        WaitForThreadpoolTimerCallbacks(m_resize_timer, TRUE);
+        CloseThreadpoolTimer(m_resize_timer);
+        m_resize_timer = nullptr;
     }
 
     m_running.store(false);
+    if (m_hExitEvent) {
+        SetEvent(m_hExitEvent);
+    }
 }
 
 bool ConPTY::is_running() const {
@@ -395,11 +563,80 @@ int ConPTY::wait(DWORD timeout_ms) {
 }
 
 bool ConPTY::resize(const TerminalSize& size) {
+    std::lock_guard<std::mutex> lock(m_resize_mutex);
     if (!m_hPC) {
         set_error("PTY not initialized");
+        if (m_resized_callback) {
+            m_resized_callback(size, false);
+        }
+        return false;
+    }
+
+    m_pending_size = size;
+    m_resize_pending = true;
+    if (m_resize_armed) {
+        return true;    // The timer picks up the latest size
+    }
+
+    ULONGLONG since = GetTickCount64() - m_last_resize_tick;
+    if (since >= PTY_RESIZE_COALESCE_MS) {
+        return apply_resize();
+    }
+
+    if (!m_resize_timer) {
+        m_resize_timer = CreateThreadpoolTimer(&ConPTY::resize_timer_callback, this, NULL);
+        if (!m_resize_timer) {
+            return apply_resize();
+        }
+    }
+    // Negative due time: relative, in 100 ns units
+    LONGLONG due = -static_cast<LONGLONG>(PTY_RESIZE_COALESCE_MS - since) * 10000;
+    FILETIME dueTime;
+    dueTime.dwLowDateTime = static_cast<DWORD>(due);
+    dueTime.dwHighDateTime = static_cast<DWORD>(due >> 32);
+    SetThreadpoolTimer(m_resize_timer, &dueTime, 0, 0);
+    m_resize_armed = true;
+    return true;
+}
+
+VOID CALLBACK ConPTY::resize_timer_callback(PTP_CALLBACK_INSTANCE instance, PVOID context, PTP_TIMER timer) {
+    (void)instance;
+    (void)timer;
+    ConPTY* self = static_cast<ConPTY*>(context);
+    std::lock_guard<std::mutex> lock(self->m_resize_mutex);
+    self->m_resize_armed = false;
+    if (self->m_resize_pending) {
+        self->apply_resize();
+    }
+}
+
+// Caller holds m_resize_mutex
+bool ConPTY::apply_resize() {
+    m_resize_pending = false;
+    m_last_resize_tick = GetTickCount64();
+    const TerminalSize size = m_pending_size;
+    bool applied = resize_console(size);
+    if (m_resized_callback) {
+        m_resized_callback(size, applied);
+    }
+    return applied;
+}
+
+// Caller holds m_resize_mutex
+bool ConPTY::resize_console(const TerminalSize& size) {
+    if (size.cols == m_size.cols && size.rows == m_size.rows) {
+        return true;    // A burst that ended where it started
+    }
+    if (!m_hPC) {
+        set_error("PTY closed");    // Closed after the child exited
         return false;
     }
 
+    // Before the console: its redraw at the new size must land on a screen of that size
+    if (m_resize_callback) {
+        m_resize_callback(size);
+    }
+
     COORD newSize;
     newSize.X = static_cast<SHORT>(size.cols);
     newSize.Y = static_cast<SHORT>(size.rows);
@@ -413,6 +650,7 @@ bool ConPTY::resize(const TerminalSize& size) {
         return false;
     }
 
+    m_size = size;
     return true;
 }
 
@@ -435,6 +673,10 @@ void ConPTY::cleanup() {
         CloseHandle(m_hJob);
         m_hJob = nullptr;
     }
+    if (m_hExitEvent) {
+        CloseHandle(m_hExitEvent);
+        m_hExitEvent = nullptr;
+    }
 
     if (m_hPC) {
         ClosePseudoConsole(m_hPC);
@@ -478,23 +720,141 @@ bool HeadlessTTY::start(const Config& config) {
         return false;
     }
 
+    m_expecter.reset();
+    m_ready.reset();
+    {
+        std::lock_guard<std::mutex> lock(m_screen_mutex);
+        m_index_commands = config.index_commands;
+        m_commands.reset();
+        m_track_screen = config.track_screen || m_screen_restored;
+        if (m_screen_restored) {
+            m_screen.set_scrollback_limit(config.scrollback_lines);
+            m_screen.resize(config.size);
+        } else if (m_track_screen) {
+            m_screen = Screen(config.size, config.scrollback_lines);
+        }
+        m_screen_restored = false;
+    }
+    m_utf8.set_mode(config.utf8_mode);
+    m_utf8.reset();
+    m_pty->set_io_mode(config.io_mode);
+    m_pty->set_output_callback([this](const uint8_t* data, size_t length) {
+        on_output(data, length);
+    });
+    m_pty->set_exit_callback([this]() {
+        m_expecter.close();
+        m_ready.close();
+        m_commands.close();
+
+        OutputCallback output;
+        ExitCallback callback;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            output = m_output_callback;
+            callback = m_exit_callback;
+        }
+        m_utf8.flush(output);   // A partial codepoint left at the very end
+        if (callback) {
+            callback();
+        }
+    });
+    m_pty->set_resize_callback([this](const TerminalSize& size) {
+        std::lock_guard<std::mutex> lock(m_screen_mutex);
+        if (m_track_screen) {
+            m_screen.resize(size);
+        }
+    });
+    m_pty->set_resized_callback([this](const TerminalSize& size, bool applied) {
+        ResizedCallback callback;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            callback = m_resized_callback;
+        }
+        if (callback) {
+            callback(size, applied);
+        }
+    });
     m_pty->start_reading();
     return true;
 }
 
 bool HeadlessTTY::write(const std::string& input) {
     if (!m_pty) return false;
+    m_ready.mark_input();
     return m_pty->write(input);
 }
 
 bool HeadlessTTY::write(const uint8_t* data, size_t length) {
     if (!m_pty) return false;
+    m_ready.mark_input();
     return m_pty->write(data, length);
 }
 
+bool HeadlessTTY::resize(const TerminalSize& size) {
+    if (!m_pty) return false;
+    return m_pty->resize(size);
+}
+
 void HeadlessTTY::set_output_callback(OutputCallback callback) {
-    if (m_pty) {
-        m_pty->set_output_callback(std::move(callback));
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_output_callback = std::move(callback);
+}
+
+void HeadlessTTY::set_exit_callback(ExitCallback callback) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_exit_callback = std::move(callback);
+}
+
+void HeadlessTTY::set_resized_callback(ResizedCallback callback) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_resized_callback = std::move(callback);
+}
+
+void HeadlessTTY::on_output(const uint8_t* data, size_t length) {
+    m_expecter.feed(data, length);
+
+    bool tracked;
+    uint16_t cursor_x = 0;
+    uint16_t cursor_y = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_screen_mutex);
+        tracked = m_track_screen;
+        if (m_index_commands) {
+            // Feed the screen up to each mark so the mark is tied to the line it was drawn on
+            size_t done = 0;
+            while (done < length) {
+                size_t n = m_commands.feed(data + done, length - done);
+                if (tracked) {
+                    m_screen.feed(data + done, n);
+                    if (m_commands.at_mark()) {
+                        // Not cursor_line(): after a width change that would re-wrap all of history
+                        m_commands.set_mark_line(m_screen.mark_output_row());
+                    }
+                }
+                done += n;
+            }
+        } else if (tracked) {
+            m_screen.feed(data, length);
+        }
+        if (tracked) {
+            cursor_x = m_screen.cursor_x();
+            cursor_y = m_screen.cursor_y();
+        }
+    }
+    // Cursor first, so a waiter woken by this chunk never sees the previous position as stable
+    if (tracked) {
+        m_ready.note_cursor(cursor_x, cursor_y);
+    }
+    m_ready.feed(data, length);
+
+    OutputCallback callback;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        callback = m_output_callback;
+    }
+
+    if (callback) {
+        m_utf8.feed(data, length, callback);
     }
 }
 
@@ -508,11 +868,98 @@ bool HeadlessTTY::is_running() const {
     return m_pty && m_pty->is_running();
 }
 
+HANDLE HeadlessTTY::exit_event() const {
+    return m_pty ? m_pty->exit_event() : nullptr;
+}
+
+ULONGLONG HeadlessTTY::last_output_tick() const {
+    return m_pty ? m_pty->last_output_tick() : 0;
+}
+
+void HeadlessTTY::set_io_mode(IoMode mode) {
+    if (m_pty) m_pty->set_io_mode(mode);
+}
+
+IoStats HeadlessTTY::get_io_stats() const {
+    return m_pty ? m_pty->get_io_stats() : IoStats();
+}
+
 int HeadlessTTY::wait(DWORD timeout_ms) {
     if (!m_pty) return -1;
     return m_pty->wait(timeout_ms);
 }
 
+ExpectResult HeadlessTTY::expect(const std::vector<std::string>& patterns, DWORD timeout_ms,
+                                 const ExpectOptions& options) {
+    return m_expecter.expect(patterns, timeout_ms, options);
+}
+
+void HeadlessTTY::cancel_expect() {
+    m_expecter.cancel();
+}
+
+ReadyEvent HeadlessTTY::wait_ready(const ReadyOptions& options, DWORD timeout_ms) {
+    return m_ready.wait(options, timeout_ms);
+}
+
+void HeadlessTTY::read_screen(const std::function<void(const Screen&)>& reader) const {
+    std::lock_guard<std::mutex> lock(m_screen_mutex);
+    reader(m_screen);
+}
+
+bool HeadlessTTY::save_snapshot(const std::wstring& path, std::string* error) const {
+    std::lock_guard<std::mutex> lock(m_screen_mutex);
+    if (!m_track_screen) {
+        if (error) *error = "Screen tracking is not enabled";
+        return false;
+    }
+    return headless_tty::save_snapshot(m_screen, path, error);
+}
+
+bool HeadlessTTY::load_snapshot(const std::wstring& path, std::string* error) {
+    // Load everything; start() applies the configured scrollback limit
+    Screen restored(TerminalSize(), SIZE_MAX);
+    if (!headless_tty::load_snapshot(restored, path, error)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_screen_mutex);
+    m_screen = std::move(restored);
+    m_track_screen = true;
+    m_screen_restored = true;
+    return true;
+}
+
+std::string HeadlessTTY::last_command_output() const {
+    std::string output;
+    m_commands.read_last_command([&output](const CommandRecord& record) { output = record.output; });
+    return output;
+}
+
+bool HeadlessTTY::last_command(CommandRecord& record) const {
+    return m_commands.last_command(record);
+}
+
+bool HeadlessTTY::command(uint64_t id, CommandRecord& record) const {
+    return m_commands.command(id, record);
+}
+
+bool HeadlessTTY::read_last_command(const CommandIndex::RecordReader& reader) const {
+    return m_commands.read_last_command(reader);
+}
+
+bool HeadlessTTY::read_command(uint64_t id, const CommandIndex::RecordReader& reader) const {
+    return m_commands.read_command(id, reader);
+}
+
+uint64_t HeadlessTTY::last_command_id() const {
+    return m_commands.last_id();
+}
+
+std::string HeadlessTTY::shell_cwd() const {
+    return m_commands.cwd();
+}
+
 std::string HeadlessTTY::get_last_error() const {
     if (!m_pty) return "PTY not initialized";
     return m_pty->get_last_error();
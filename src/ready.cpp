@@ -0,0 +1,244 @@
+#include "headless_tty/ready.hpp"
+
+#include <algorithm>
+
+namespace headless_tty {
+
+namespace {
+
+enum ScanState : uint8_t {
+    SCAN_GROUND,
+    SCAN_ESCAPE,
+    SCAN_CSI,           // Just after ESC [
+    SCAN_PRIVATE,       // ESC [ ? parameters
+    SCAN_SKIP           // Any other control sequence, up to its final byte
+};
+
+uint8_t mode_bit(uint32_t param) {
+    switch (param) {
+        case 1:    return READY_APP_CURSOR_KEYS;
+        case 47:
+        case 1047:
+        case 1049: return READY_ALT_SCREEN;
+        case 2004: return READY_BRACKETED_PASTE;
+        default:   return 0;
+    }
+}
+
+bool is_final(uint8_t c) {
+    return c >= 0x40 && c <= 0x7E;
+}
+
+std::string trim_right(const std::string& text) {
+    size_t end = text.find_last_not_of(' ');
+    return end == std::string::npos ? std::string() : text.substr(0, end + 1);
+}
+
+} // namespace
+
+ReadyWaiter::ReadyWaiter() {
+    reset();
+}
+
+void ReadyWaiter::scan_mode(uint8_t c) {
+    switch (m_scan) {
+        case SCAN_GROUND:
+            if (c == 0x1B) m_scan = SCAN_ESCAPE;
+            break;
+
+        case SCAN_ESCAPE:
+            m_scan = c == '[' ? SCAN_CSI : c == 0x1B ? SCAN_ESCAPE : SCAN_GROUND;
+            break;
+
+        case SCAN_CSI:
+            if (c == '?') {
+                m_scan = SCAN_PRIVATE;
+                m_param = 0;
+                m_pending = 0;
+            } else {
+                m_scan = is_final(c) ? SCAN_GROUND : c == 0x1B ? SCAN_ESCAPE : SCAN_SKIP;
+            }
+            break;
+
+        case SCAN_PRIVATE:
+            if (c >= '0' && c <= '9') {
+                m_param = std::min<uint32_t>(m_param * 10 + (c - '0'), 100000);
+            } else if (c == ';') {
+                m_pending |= mode_bit(m_param);
+                m_param = 0;
+            } else if (c == 'h' || c == 'l') {
+                m_pending |= mode_bit(m_param);
+                m_modes = c == 'h' ? (m_modes | m_pending) : (m_modes & ~m_pending);
+                m_scan = SCAN_GROUND;
+            } else {
+                m_scan = is_final(c) ? SCAN_GROUND : c == 0x1B ? SCAN_ESCAPE : SCAN_SKIP;
+            }
+            break;
+
+        default:
+            if (is_final(c)) {
+                m_scan = SCAN_GROUND;
+            } else if (c == 0x1B) {
+                m_scan = SCAN_ESCAPE;
+            }
+            break;
+    }
+}
+
+void ReadyWaiter::feed(const uint8_t* data, size_t length) {
+    bool notify;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (size_t i = 0; i < length; ++i) {
+            uint8_t c = data[i];
+            scan_mode(c);
+            if (!m_stripper.accept(c)) {
+                continue;
+            }
+            if (c == '\r' || c == '\n') {
+                m_tail.clear();
+                continue;
+            }
+            m_tail += static_cast<char>(c);
+            if (m_tail.size() > 2 * READY_TAIL_BYTES) {
+                m_tail.erase(0, m_tail.size() - READY_TAIL_BYTES);     // Amortized
+            }
+        }
+        m_last_output = Clock::now();
+        m_output_since_input = true;
+        notify = m_waiting > 0;
+    }
+
+    if (notify) {
+        m_cv.notify_all();
+    }
+}
+
+void ReadyWaiter::note_cursor(uint16_t x, uint16_t y) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_cursor_known || x != m_cursor_x || y != m_cursor_y) {
+        m_cursor_x = x;
+        m_cursor_y = y;
+        m_last_cursor_move = Clock::now();
+    }
+    m_cursor_known = true;
+}
+
+void ReadyWaiter::mark_input() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_output_since_input = false;
+}
+
+void ReadyWaiter::close() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+    }
+    m_cv.notify_all();
+}
+
+void ReadyWaiter::reset() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_closed = false;
+    m_last_output = m_last_cursor_move = Clock::now();
+    m_output_since_input = false;
+    m_cursor_known = false;
+    m_stripper.reset();
+    m_tail.clear();
+    m_scan = SCAN_GROUND;
+    m_modes = 0;
+}
+
+bool ReadyWaiter::check(const ReadyOptions& options, const std::vector<std::string>& prompts,
+                        Clock::time_point now, ReadyEvent& event) const {
+    if (options.after_input && !m_output_since_input) {
+        return false;
+    }
+
+    if (!prompts.empty()) {
+        std::string text = trim_right(m_tail);
+        for (const std::string& prompt : prompts) {
+            if (text.size() >= prompt.size() && text.compare(text.size() - prompt.size(), prompt.size(), prompt) == 0) {
+                event = ReadyEvent::Prompt;
+                return true;
+            }
+        }
+    }
+    if (options.modes & m_modes) {
+        event = ReadyEvent::Mode;
+        return true;
+    }
+    if (options.cursor_stable_ms > 0 && now - m_last_cursor_move >= std::chrono::milliseconds(options.cursor_stable_ms)) {
+        event = ReadyEvent::CursorStable;
+        return true;
+    }
+    if (options.quiet_ms > 0 && now - m_last_output >= std::chrono::milliseconds(options.quiet_ms)) {
+        event = ReadyEvent::Quiet;
+        return true;
+    }
+    return false;
+}
+
+ReadyEvent ReadyWaiter::wait(const ReadyOptions& options, uint32_t timeout_ms) {
+    std::vector<std::string> prompts;
+    for (const std::string& prompt : options.prompts) {
+        prompts.push_back(trim_right(prompt));
+        if (prompts.back().empty()) {
+            return ReadyEvent::Invalid;
+        }
+    }
+    if (options.quiet_ms == 0 && options.cursor_stable_ms == 0 && prompts.empty() && options.modes == 0) {
+        return ReadyEvent::Invalid;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (options.cursor_stable_ms > 0 && !m_cursor_known) {
+        return ReadyEvent::Invalid;
+    }
+
+    const Clock::time_point start = Clock::now();
+    const bool forever = timeout_ms == 0xFFFFFFFF;
+    const Clock::time_point deadline = start + std::chrono::milliseconds(forever ? 0 : timeout_ms);
+
+    ReadyEvent event = ReadyEvent::Timeout;
+    ++m_waiting;
+    while (true) {
+        Clock::time_point now = Clock::now();
+        if (check(options, prompts, now, event)) {
+            break;
+        }
+        if (m_closed) {
+            event = ReadyEvent::Exited;
+            break;
+        }
+        if (!forever && now >= deadline) {
+            event = ReadyEvent::Timeout;
+            break;
+        }
+
+        // Sleep until a timed condition could next hold; output wakes us earlier
+        bool timed = !forever;
+        Clock::time_point wake = deadline;
+        auto earliest = [&](Clock::time_point when) {
+            wake = timed ? std::min(wake, when) : when;
+            timed = true;
+        };
+        if (!options.after_input || m_output_since_input) {
+            if (options.quiet_ms > 0) {
+                earliest(m_last_output + std::chrono::milliseconds(options.quiet_ms));
+            }
+            if (options.cursor_stable_ms > 0) {
+                earliest(m_last_cursor_move + std::chrono::milliseconds(options.cursor_stable_ms));
+            }
+        }
+        if (timed) {
+            m_cv.wait_until(lock, wake);
+        } else {
+            m_cv.wait(lock);
+        }
+    }
+    --m_waiting;
+    return event;
+}
+
+} // namespace headless_tty
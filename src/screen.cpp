@@ -0,0 +1,1583 @@
+#include "headless_tty/screen.hpp"
+#include "headless_tty/unicode.hpp"
+#include "utf8_encode.hpp"
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+namespace headless_tty {
+
+namespace {
+
+constexpr size_t MAX_CSI_PARAMS = 32;
+constexpr char32_t REPLACEMENT_CHAR = 0xFFFD;
+
+// Snapshot format: StateHeader, title and cluster pool (each padded to 8 bytes), then one
+// LineHeader plus cells per line for scrollback, visible lines and the saved main screen.
+// Cells are stored verbatim, so loading is a memcpy per line.
+constexpr char STATE_MAGIC[8] = { 'H', 'T', 'T', 'Y', 'S', 'C', 'R', 'N' };
+constexpr uint32_t STATE_VERSION = 2;
+
+static_assert(sizeof(Cell) == 16 && std::is_trivially_copyable<Cell>::value,
+              "snapshot format depends on the Cell layout");
+
+enum StateFlags : uint16_t {
+    STATE_CURSOR_VISIBLE  = 1 << 0,
+    STATE_AUTO_WRAP       = 1 << 1,
+    STATE_ALT_SCREEN      = 1 << 2,
+    STATE_BRACKETED_PASTE = 1 << 3,
+    STATE_APP_CURSOR_KEYS = 1 << 4,
+    STATE_WRAP_PENDING    = 1 << 5
+};
+
+struct StateHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t cell_size;
+    uint16_t cols;
+    uint16_t rows;
+    uint16_t cursor_x;
+    uint16_t cursor_y;
+    uint16_t scroll_top;
+    uint16_t scroll_bottom;
+    uint16_t flags;
+    uint16_t attrs;
+    uint32_t fg;
+    uint32_t bg;
+    uint16_t saved_x;
+    uint16_t saved_y;
+    uint16_t saved_attrs;
+    uint16_t reserved;
+    uint32_t saved_fg;
+    uint32_t saved_bg;
+    uint32_t title_length;
+    uint32_t scrollback_count;
+    uint32_t saved_line_count;
+    uint32_t cluster_length;    // Codepoints in the cluster pool
+    uint64_t seq;
+};
+
+struct LineHeader {
+    uint16_t width;
+    uint16_t stored;    // Cells that follow; the rest of the line is blank
+    uint32_t wrapped;
+};
+
+static_assert(sizeof(StateHeader) % 8 == 0 && sizeof(LineHeader) == 8, "snapshot records stay 8-byte aligned");
+
+size_t align8(size_t n) {
+    return (n + 7) & ~static_cast<size_t>(7);
+}
+
+bool is_blank(const Cell& cell) {
+    return cell.ch == U' ' && cell.fg == COLOR_DEFAULT && cell.bg == COLOR_DEFAULT &&
+           cell.attrs == 0 && cell.width == 1;
+}
+
+// Trailing blank cells are not written
+size_t stored_cells(const Line& line) {
+    size_t n = line.cells.size();
+    while (n > 0 && is_blank(line.cells[n - 1])) {
+        --n;
+    }
+    return n;
+}
+
+// Cells of a row laid out at cols; a soft-wrapped row counts as full so its trailing blanks stay
+// Returns the offset in text where the line's cells start
+size_t append_text(std::vector<Cell>& text, const Line& line, uint16_t cols, bool continues) {
+    // A wide character that didn't fit left a blank at the end of the previous row
+    if (!text.empty() && !line.cells.empty() && line.cells[0].width == 2 && is_blank(text.back())) {
+        text.pop_back();
+    }
+    size_t start = text.size();
+    size_t n = continues ? std::min<size_t>(line.cells.size(), cols) : stored_cells(line);
+    text.insert(text.end(), line.cells.begin(), line.cells.begin() + n);
+    if (continues && n < cols) {
+        text.resize(text.size() + (cols - n), Cell());
+    }
+    return start;
+}
+
+// Break the text of one logical line into rows of at most cols cells, appended to rows.
+// A wide character never straddles a break.
+template <typename Rows>
+void rewrap(const std::vector<Cell>& text, uint16_t cols, Rows& rows) {
+    size_t pos = 0;
+    do {
+        Line row(rows.get_allocator());
+        size_t end = std::min(text.size(), pos + cols);
+        if (cols == 1 && text[pos].width == 2) {
+            row.cells.push_back(text[pos]);     // No room for both halves
+            row.cells.back().width = 1;
+            end = std::min(text.size(), pos + 2);
+        } else {
+            if (end < text.size() && end > pos + 1 && text[end - 1].width == 2) {
+                --end;
+            }
+            row.cells.assign(text.begin() + pos, text.begin() + end);
+        }
+        pos = end;
+        row.wrapped = pos < text.size();
+        rows.push_back(std::move(row));
+    } while (pos < text.size());
+}
+
+// Row of rows[first...] (as rewrap() left them) that holds the cell at offset in the text,
+// and the cell's column in it; past the end of the text, the last row
+template <typename Rows>
+size_t row_at(const Rows& rows, size_t first, size_t offset, size_t& column) {
+    size_t start = 0;
+    for (size_t r = first; r < rows.size(); ++r) {
+        size_t length = rows[r].cells.size();
+        if (offset < start + length || r + 1 == rows.size()) {
+            column = offset - start;
+            return r;
+        }
+        start += length;
+    }
+    column = 0;
+    return rows.size() - 1;
+}
+
+} // namespace
+
+std::u32string_view cell_codepoints(const Cell& cell, const std::u32string& pool) {
+    if (!(cell.ch & CELL_CLUSTER)) {
+        return std::u32string_view(&cell.ch, 1);
+    }
+    size_t offset = cell.ch & ~CELL_CLUSTER;
+    if (offset >= pool.size() || pool[offset] >= pool.size() - offset) {
+        return U"\uFFFD";
+    }
+    return std::u32string_view(pool.data() + offset + 1, pool[offset]);
+}
+
+detail::ScreenData::ScreenData(TerminalSize size, size_t scrollback_lines, bool use_arena)
+    : m_arena(use_arena ? std::make_shared<SessionArena>() : nullptr),
+      m_size(size),
+      m_scrollback_limit(scrollback_lines),
+      m_lines(line_allocator()),
+      m_saved_lines(line_allocator()),
+      m_scrollback(line_allocator()),
+      m_arena_keep(m_arena.arena) {
+}
+
+Screen::Screen(TerminalSize size, size_t scrollback_lines, bool use_arena)
+    : ScreenData(size, scrollback_lines, use_arena) {
+    if (m_size.cols == 0) m_size.cols = 1;
+    if (m_size.rows == 0) m_size.rows = 1;
+    reset();
+}
+
+Screen::Screen(const Screen& other)
+    : Screen(other.m_size, other.m_scrollback_limit, other.m_arena.arena != nullptr) {
+    *this = other;
+}
+
+Screen::Screen(Screen&& other) noexcept
+    : ScreenData(std::move(other)) {
+    other.detach_arena();
+}
+
+Screen& Screen::operator=(Screen&& other) noexcept {
+    if (this != &other) {
+        ScreenData::operator=(std::move(other));
+        other.detach_arena();
+    }
+    return *this;
+}
+
+// A moved-from container can still hold memory from the arena that went with the move
+// (a moved-from deque allocates a fresh map from it). Hand that back while the arena is
+// alive, so destroying this screen later never touches the other screen's arena.
+void Screen::detach_arena() {
+    m_lines = LineVector();
+    m_saved_lines = LineVector();
+    m_scrollback = LineDeque();
+    m_layout.clear();
+}
+
+void Screen::reset() {
+    m_fg = COLOR_DEFAULT;
+    m_bg = COLOR_DEFAULT;
+    m_attrs = 0;
+    m_lines.assign(m_size.rows, blank_line());
+    m_saved_lines.clear();
+    m_scrollback.clear();
+    m_layout.clear();
+    m_scrollback_base = 0;
+    m_rows_scrolled = 0;
+    m_cursor_x = 0;
+    m_cursor_y = 0;
+    m_wrap_pending = false;
+    m_saved_cursor = Cursor();
+    m_scroll_top = 0;
+    m_scroll_bottom = m_size.rows - 1;
+    m_modes = ScreenModes();
+    m_title.clear();
+    m_state = State::Ground;
+    m_utf8_remaining = 0;
+    m_cluster_open = false;
+    m_cluster_fresh = false;
+    m_clusters.clear();
+    m_cluster_index.clear();
+    m_cluster_retry_row = 0;
+    m_row_marks.clear();
+    ++m_seq;
+}
+
+void Screen::set_scrollback_limit(size_t lines) {
+    m_scrollback_limit = lines;
+    while (m_scrollback.size() > m_scrollback_limit) {
+        pop_scrollback();
+    }
+}
+
+const LineDeque& Screen::scrollback() const {
+    reflow_scrollback();
+    return m_scrollback;
+}
+
+uint64_t Screen::scrollback_base() const {
+    reflow_scrollback();
+    return m_scrollback_base;
+}
+
+uint64_t Screen::cursor_line() const {
+    reflow_scrollback();
+    return m_scrollback_base + m_scrollback.size() + m_cursor_y;
+}
+
+uint64_t Screen::mark_output_row() {
+    // The line's number as laid out right now; a re-wrap still owed to history renumbers it later
+    RowMark mark = { cursor_output_row(), m_scrollback_base + m_scrollback.size() + m_cursor_y };
+    if (!m_row_marks.empty() && m_row_marks.back().row == mark.row) {
+        m_row_marks.back() = mark;
+    } else {
+        m_row_marks.push_back(mark);
+        if (m_row_marks.size() > SCREEN_ROW_MARKS) {
+            m_row_marks.pop_front();
+        }
+    }
+    return mark.row;
+}
+
+uint64_t Screen::output_row_line(uint64_t row) const {
+    reflow_scrollback();
+    // Newest first: a row marked again after the screen was cleared means its latest line
+    for (auto it = m_row_marks.rbegin(); it != m_row_marks.rend(); ++it) {
+        if (it->row == row) {
+            bool gone = it->line == SCREEN_NO_LINE || it->line < m_scrollback_base ||
+                        it->line >= m_scrollback_base + m_scrollback.size() + m_size.rows;
+            return gone ? SCREEN_NO_LINE : it->line;
+        }
+    }
+    return SCREEN_NO_LINE;
+}
+
+void Screen::clear_line(Line& line) const {
+    Cell blank;
+    blank.bg = m_bg;
+    std::fill(line.cells.begin(), line.cells.end(), blank);
+    line.wrapped = false;
+}
+
+void Screen::push_scrollback(const Line& line) {
+    if (m_modes.alt_screen || m_scrollback_limit == 0) {
+        return;
+    }
+
+    if (m_scrollback.size() >= m_scrollback_limit) {
+        pop_scrollback();
+    }
+    ++m_rows_scrolled;
+    Line kept(line_allocator());
+    kept.cells.assign(line.cells.begin(), line.cells.begin() + stored_cells(line));
+    kept.wrapped = line.wrapped;
+    m_scrollback.push_back(std::move(kept));
+
+    if (!m_layout.empty() && m_layout.back().cols == m_size.cols) {
+        ++m_layout.back().lines;
+    } else {
+        m_layout.push_back({ m_size.cols, 1 });
+    }
+}
+
+void Screen::pop_scrollback() {
+    m_scrollback.pop_front();
+    ++m_scrollback_base;
+    if (--m_layout.front().lines == 0) {
+        m_layout.erase(m_layout.begin());
+    }
+}
+
+void Screen::reflow_scrollback() const {
+    bool stale = false;
+    for (const LayoutRun& run : m_layout) {
+        stale = stale || run.cols != m_size.cols;
+    }
+    if (!stale) {
+        return;
+    }
+
+    // Marked lines in history, in order, so the pass below can carry them to their new rows
+    uint64_t end = m_scrollback_base + m_scrollback.size();
+    std::vector<RowMark*> marked;
+    std::vector<RowMark*> below;            // On the grid
+    for (RowMark& mark : m_row_marks) {
+        if (mark.line >= m_scrollback_base && mark.line < end) {
+            marked.push_back(&mark);
+        } else if (mark.line >= end && mark.line != SCREEN_NO_LINE) {
+            below.push_back(&mark);
+        }
+    }
+    std::sort(marked.begin(), marked.end(), [](const RowMark* a, const RowMark* b) { return a->line < b->line; });
+    size_t pending = 0;
+    uint64_t number = m_scrollback_base;    // Number of m_scrollback.front() before the re-wrap
+    std::vector<std::pair<RowMark*, size_t>> starts;    // Marked lines of a logical line and their text offsets
+
+    // One pass, oldest first. A logical line is only joined within a run; one that was
+    // still open when the width changed keeps its soft wrap into the next run.
+    LineDeque out(line_allocator());
+    std::vector<Cell> text;
+    auto follow = [&](uint64_t row) {
+        for (; pending < marked.size() && marked[pending]->line == number; ++pending) {
+            marked[pending]->line = m_scrollback_base + row;
+        }
+        ++number;
+    };
+    for (const LayoutRun& run : m_layout) {
+        if (run.cols == m_size.cols) {
+            for (size_t i = 0; i < run.lines; ++i) {
+                follow(out.size());
+                out.push_back(std::move(m_scrollback.front()));
+                m_scrollback.pop_front();
+            }
+            continue;
+        }
+        size_t left = run.lines;
+        while (left > 0) {
+            Line& next = m_scrollback.front();
+            if (!next.wrapped && next.cells.size() <= m_size.cols) {
+                follow(out.size());
+                out.push_back(std::move(next));     // Fits as it is
+                m_scrollback.pop_front();
+                --left;
+                continue;
+            }
+            text.clear();
+            starts.clear();
+            bool wrapped;
+            do {
+                Line& line = m_scrollback.front();
+                wrapped = line.wrapped;
+                size_t start = append_text(text, line, run.cols, wrapped && left > 1);
+                for (; pending < marked.size() && marked[pending]->line == number; ++pending) {
+                    starts.push_back({ marked[pending], start });
+                }
+                ++number;
+                m_scrollback.pop_front();
+                --left;
+            } while (wrapped && left > 0);
+
+            size_t first = out.size();
+            rewrap(text, m_size.cols, out);
+            for (auto& [mark, offset] : starts) {
+                size_t column;
+                mark->line = m_scrollback_base + row_at(out, first, offset, column);
+            }
+            for (size_t i = first; i < out.size(); ++i) {
+                out[i].cells.resize(stored_cells(out[i]));
+            }
+            out.back().wrapped = wrapped;
+        }
+    }
+
+    // Lines on the grid keep their place below history, which now has out.size() lines
+    for (RowMark* mark : below) {
+        mark->line = mark->line - end + m_scrollback_base + out.size();
+    }
+
+    while (out.size() > m_scrollback_limit) {
+        out.pop_front();
+        ++m_scrollback_base;
+    }
+    m_scrollback = std::move(out);
+    m_layout.clear();
+    if (!m_scrollback.empty()) {
+        m_layout.push_back({ m_size.cols, m_scrollback.size() });
+    }
+}
+
+Line Screen::blank_line() const {
+    Line line(line_allocator());
+    Cell blank;
+    blank.bg = m_bg;
+    line.cells.assign(m_size.cols, blank);
+    return line;
+}
+
+int Screen::param(size_t index, int fallback) const {
+    if (index >= m_params.size() || m_params[index] == 0) {
+        return fallback;
+    }
+    return m_params[index];
+}
+
+void Screen::feed(const uint8_t* data, size_t length) {
+    if (length == 0) {
+        return;
+    }
+
+    for (size_t i = 0; i < length; ++i) {
+        advance(data[i]);
+    }
+    ++m_seq;
+}
+
+void Screen::advance(uint8_t c) {
+    switch (m_state) {
+        case State::Ground:
+            if (m_utf8_remaining > 0) {
+                if ((c & 0xC0) == 0x80) {
+                    m_codepoint = (m_codepoint << 6) | (c & 0x3F);
+                    if (--m_utf8_remaining == 0) {
+                        put_char(m_codepoint);
+                    }
+                    return;
+                }
+                // Truncated sequence; the current byte starts something new
+                m_utf8_remaining = 0;
+                put_char(REPLACEMENT_CHAR);
+            }
+
+            if (c == 0x1B) {
+                m_state = State::Escape;
+                m_cluster_open = false;
+            } else if (c < 0x20) {
+                execute(c);
+                m_cluster_open = false;
+            } else if (c < 0x7F) {
+                put_char(c);
+            } else if (c == 0x7F) {
+                // DEL is ignored
+            } else if ((c & 0xE0) == 0xC0) {
+                m_codepoint = c & 0x1F;
+                m_utf8_remaining = 1;
+            } else if ((c & 0xF0) == 0xE0) {
+                m_codepoint = c & 0x0F;
+                m_utf8_remaining = 2;
+            } else if ((c & 0xF8) == 0xF0) {
+                m_codepoint = c & 0x07;
+                m_utf8_remaining = 3;
+            } else {
+                put_char(REPLACEMENT_CHAR);
+            }
+            return;
+
+        case State::Escape:
+            if (c == '[') {
+                m_params.clear();
+                m_param_started = false;
+                m_private = 0;
+                m_intermediate = 0;
+                m_state = State::Csi;
+            } else if (c == ']') {
+                m_osc.clear();
+                m_state = State::Osc;
+            } else if (c == 'P' || c == 'X' || c == '^' || c == '_') {
+                m_state = State::String;
+            } else if (c >= 0x20 && c <= 0x2F) {
+                m_state = State::EscapeIntermediate;
+            } else if (c == 0x1B) {
+                // ESC ESC restarts the sequence
+            } else if (c < 0x20) {
+                execute(c);
+            } else {
+                m_state = State::Ground;
+                esc_dispatch(c);
+            }
+            return;
+
+        case State::EscapeIntermediate:
+            // Charset designations and the like; nothing here affects the grid
+            if (c == 0x1B) {
+                m_state = State::Escape;
+            } else if (c < 0x20) {
+                execute(c);
+            } else if (c > 0x2F) {
+                m_state = State::Ground;
+            }
+            return;
+
+        case State::Csi:
+            if (c >= '0' && c <= '9') {
+                if (!m_param_started) {
+                    m_params.push_back(0);
+                    m_param_started = true;
+                }
+                m_params.back() = std::min(m_params.back() * 10 + (c - '0'), 65535);
+            } else if (c == ';' || c == ':') {
+                if (!m_param_started) {
+                    m_params.push_back(0);
+                }
+                m_param_started = false;
+                if (m_params.size() > MAX_CSI_PARAMS) {
+                    m_params.pop_back();
+                }
+            } else if (c >= 0x3C && c <= 0x3F) {
+                if (m_params.empty()) {
+                    m_private = c;
+                }
+            } else if (c >= 0x20 && c <= 0x2F) {
+                m_intermediate = c;
+            } else if (c >= 0x40 && c <= 0x7E) {
+                m_state = State::Ground;
+                csi_dispatch(c);
+            } else if (c == 0x1B) {
+                m_state = State::Escape;
+            } else if (c < 0x20) {
+                execute(c);
+            }
+            return;
+
+        case State::Osc:
+            if (c == 0x07) {
+                m_state = State::Ground;
+                osc_dispatch();
+            } else if (c == 0x1B) {
+                m_state = State::OscEscape;
+            } else if (m_osc.size() < SCREEN_OSC_MAX) {
+                m_osc += static_cast<char>(c);
+            }
+            return;
+
+        case State::OscEscape:
+            if (c == '\\') {
+                m_state = State::Ground;
+                osc_dispatch();
+                return;
+            }
+            m_state = State::Escape;
+            advance(c);
+            return;
+
+        case State::String:
+            if (c == 0x07) {
+                m_state = State::Ground;
+            } else if (c == 0x1B) {
+                m_state = State::StringEscape;
+            }
+            return;
+
+        case State::StringEscape:
+            if (c == '\\') {
+                m_state = State::Ground;
+                return;
+            }
+            m_state = State::Escape;
+            advance(c);
+            return;
+    }
+}
+
+void Screen::put_char(char32_t ch) {
+    // The rest of a grapheme cluster (combining marks, emoji ZWJ sequences, the second
+    // half of a flag) goes into the cell of its first codepoint
+    if (!m_cluster_open) {
+        m_segmenter.reset();
+    }
+    if (!m_segmenter.next(ch) && m_cluster_open) {
+        extend_cluster(ch);
+        return;
+    }
+
+    int width = char_width(ch);
+    if (width == 0) {
+        m_cluster_open = false;
+        return;     // Combining marks with nothing to attach to are not stored
+    }
+    m_cluster_open = true;
+    m_cluster.assign(1, ch);
+    m_cluster_fresh = false;
+    m_cluster_pictograph = width == 1 && is_extended_pictographic(ch);
+    place_char(ch, width);
+}
+
+void Screen::place_char(char32_t ch, int width) {
+    if (width == 2 && m_size.cols < 2) {
+        width = 1;
+    }
+
+    if (m_wrap_pending) {
+        m_wrap_pending = false;
+        if (m_modes.auto_wrap) {
+            m_lines[m_cursor_y].wrapped = true;
+            m_cursor_x = 0;
+            line_feed();
+        }
+    }
+
+    // A wide character that doesn't fit on this line moves to the next
+    if (width == 2 && m_cursor_x + 1 >= m_size.cols) {
+        if (m_modes.auto_wrap) {
+            erase_cells(m_lines[m_cursor_y], m_cursor_x, m_size.cols);
+            m_lines[m_cursor_y].wrapped = true;
+            m_cursor_x = 0;
+            line_feed();
+        } else {
+            m_cursor_x = m_size.cols - 2;
+        }
+    }
+
+    Line& line = m_lines[m_cursor_y];
+    erase_cells(line, m_cursor_x, m_cursor_x + width);
+    m_cluster_x = m_cursor_x;
+    m_cluster_y = m_cursor_y;
+
+    Cell& cell = line.cells[m_cursor_x];
+    cell.ch = ch;
+    cell.fg = m_fg;
+    cell.bg = m_bg;
+    cell.attrs = m_attrs;
+    cell.width = static_cast<uint8_t>(width);
+    if (width == 2) {
+        Cell& tail = line.cells[m_cursor_x + 1];
+        tail = cell;
+        tail.ch = U' ';
+        tail.width = 0;
+    }
+
+    if (m_cursor_x + width >= m_size.cols) {
+        m_cursor_x = m_size.cols - 1;
+        m_wrap_pending = true;
+    } else {
+        m_cursor_x += static_cast<uint16_t>(width);
+    }
+}
+
+void Screen::extend_cluster(char32_t cp) {
+    if (m_cluster.size() >= SCREEN_CLUSTER_MAX) {
+        return;
+    }
+    m_cluster.push_back(cp);
+
+    // Nothing has moved the cell since the cluster started: any control or escape sequence,
+    // or a resize, closes the cluster first
+    Cell& cell = m_lines[m_cluster_y].cells[m_cluster_x];
+    char32_t previous = cell.ch;
+    if (m_cluster_fresh) {
+        // The entry of the shorter cluster is only this cell's; give its space to the longer one
+        size_t offset = cell.ch & ~CELL_CLUSTER;
+        m_cluster_index.erase(std::u32string(cell_codepoints(cell, m_clusters)));
+        m_clusters.resize(offset);
+        previous = m_cluster[0];
+        cell.ch = previous;
+    }
+    char32_t interned = intern_cluster(m_cluster);
+    cell.ch = interned ? interned : previous;
+
+    // VS16 asks for emoji presentation, which takes two columns; text_width() counts it the same
+    if (cp == VARIATION_SELECTOR_16 && m_cluster_pictograph) {
+        m_cluster_pictograph = false;
+        if (cell.width == 1 && m_size.cols >= 2) {
+            Cell placed = cell;
+            erase_cells(m_lines[m_cluster_y], m_cluster_x, m_cluster_x + 1);
+            m_cursor_x = m_cluster_x;
+            m_cursor_y = m_cluster_y;
+            m_wrap_pending = false;
+            place_char(placed.ch, 2);   // Wraps to the next line like any wide character that doesn't fit
+        }
+    }
+}
+
+// Pool entry for cluster, added if it isn't there yet; 0 if the pool is full
+char32_t Screen::intern_cluster(const std::u32string& cluster) {
+    m_cluster_fresh = false;
+    auto found = m_cluster_index.find(cluster);
+    if (found != m_cluster_index.end()) {
+        return CELL_CLUSTER | found->second;
+    }
+    if (m_clusters.size() + 1 + cluster.size() > SCREEN_CLUSTER_POOL) {
+        reclaim_clusters();
+        if (m_clusters.size() + 1 + cluster.size() > SCREEN_CLUSTER_POOL) {
+            return 0;
+        }
+    }
+    uint32_t offset = static_cast<uint32_t>(m_clusters.size());
+    m_clusters += static_cast<char32_t>(cluster.size());
+    m_clusters += cluster;
+    m_cluster_index.emplace(cluster, offset);
+    m_cluster_fresh = true;
+    return CELL_CLUSTER | offset;
+}
+
+// Rebuild the pool from the clusters that cells still show. When they fill most of it,
+// further reclaiming waits until a screenful of output has scrolled by.
+void Screen::reclaim_clusters() {
+    if (m_rows_scrolled + m_cursor_y < m_cluster_retry_row) {
+        return;
+    }
+
+    std::u32string pool;
+    std::unordered_map<std::u32string, uint32_t> index;
+    auto keep = [&](Line& line) {
+        for (Cell& cell : line.cells) {
+            if (cell.ch & CELL_CLUSTER) {
+                std::u32string cluster(cell_codepoints(cell, m_clusters));
+                auto added = index.emplace(cluster, static_cast<uint32_t>(pool.size()));
+                if (added.second) {
+                    pool += static_cast<char32_t>(cluster.size());
+                    pool += cluster;
+                }
+                cell.ch = CELL_CLUSTER | added.first->second;
+            }
+        }
+    };
+    for (Line& line : m_scrollback) keep(line);
+    for (Line& line : m_lines) keep(line);
+    for (Line& line : m_saved_lines) keep(line);
+
+    m_clusters = std::move(pool);
+    m_cluster_index = std::move(index);
+    m_cluster_fresh = false;
+    if (m_clusters.size() > SCREEN_CLUSTER_POOL / 2) {
+        m_cluster_retry_row = m_rows_scrolled + m_cursor_y + m_size.rows;
+    }
+}
+
+void Screen::execute(uint8_t c) {
+    switch (c) {
+        case 0x08:  // BS
+            if (m_cursor_x > 0) --m_cursor_x;
+            m_wrap_pending = false;
+            break;
+        case 0x09:  // HT, fixed stops every 8 columns
+            m_cursor_x = static_cast<uint16_t>(std::min<int>(m_size.cols - 1, (m_cursor_x / 8 + 1) * 8));
+            break;
+        case 0x0A:  // LF, VT, FF
+        case 0x0B:
+        case 0x0C:
+            line_feed();
+            break;
+        case 0x0D:  // CR
+            m_cursor_x = 0;
+            m_wrap_pending = false;
+            break;
+        default:
+            break;
+    }
+}
+
+void Screen::line_feed() {
+    m_wrap_pending = false;
+    if (m_cursor_y == m_scroll_bottom) {
+        scroll_up(m_scroll_top, m_scroll_bottom, 1, true);
+    } else if (m_cursor_y + 1 < m_size.rows) {
+        ++m_cursor_y;
+    }
+}
+
+void Screen::scroll_up(uint16_t top, uint16_t bottom, uint16_t count, bool to_scrollback) {
+    count = std::min<uint16_t>(count, bottom - top + 1);
+    if (count == 0) {
+        return;
+    }
+
+    if (to_scrollback && top == 0) {
+        for (uint16_t i = 0; i < count; ++i) {
+            push_scrollback(m_lines[i]);
+        }
+    }
+
+    std::rotate(m_lines.begin() + top, m_lines.begin() + top + count, m_lines.begin() + bottom + 1);
+    for (int y = bottom + 1 - count; y <= bottom; ++y) {
+        clear_line(m_lines[y]);
+    }
+}
+
+void Screen::scroll_down(uint16_t top, uint16_t bottom, uint16_t count) {
+    count = std::min<uint16_t>(count, bottom - top + 1);
+    if (count == 0) {
+        return;
+    }
+
+    std::rotate(m_lines.begin() + top, m_lines.begin() + bottom + 1 - count, m_lines.begin() + bottom + 1);
+    for (int y = top; y < top + count; ++y) {
+        clear_line(m_lines[y]);
+    }
+}
+
+void Screen::erase_cells(Line& line, uint16_t from, uint16_t to) {
+    to = std::min(to, m_size.cols);
+    if (from >= to) {
+        return;
+    }
+
+    // Never leave half of a wide character behind
+    if (line.cells[from].width == 0 && from > 0) {
+        --from;
+    }
+    if (to < m_size.cols && line.cells[to].width == 0) {
+        ++to;
+    }
+
+    Cell blank;
+    blank.bg = m_bg;
+    std::fill(line.cells.begin() + from, line.cells.begin() + to, blank);
+}
+
+void Screen::esc_dispatch(uint8_t final) {
+    switch (final) {
+        case '7':   // DECSC
+            m_saved_cursor = { m_cursor_x, m_cursor_y, m_fg, m_bg, m_attrs };
+            break;
+        case '8':   // DECRC
+            m_cursor_x = std::min<uint16_t>(m_saved_cursor.x, m_size.cols - 1);
+            m_cursor_y = std::min<uint16_t>(m_saved_cursor.y, m_size.rows - 1);
+            m_fg = m_saved_cursor.fg;
+            m_bg = m_saved_cursor.bg;
+            m_attrs = m_saved_cursor.attrs;
+            m_wrap_pending = false;
+            break;
+        case 'D':   // IND
+            line_feed();
+            break;
+        case 'E':   // NEL
+            m_cursor_x = 0;
+            line_feed();
+            break;
+        case 'M':   // RI
+            m_wrap_pending = false;
+            if (m_cursor_y == m_scroll_top) {
+                scroll_down(m_scroll_top, m_scroll_bottom, 1);
+            } else if (m_cursor_y > 0) {
+                --m_cursor_y;
+            }
+            break;
+        case 'c':   // RIS
+            reset();
+            break;
+        default:
+            break;
+    }
+}
+
+void Screen::csi_dispatch(uint8_t final) {
+    if (m_intermediate) {
+        if (m_intermediate == '!' && final == 'p') {   // DECSTR soft reset
+            m_fg = COLOR_DEFAULT;
+            m_bg = COLOR_DEFAULT;
+            m_attrs = 0;
+            m_scroll_top = 0;
+            m_scroll_bottom = m_size.rows - 1;
+            m_modes.cursor_visible = true;
+            m_modes.auto_wrap = true;
+            m_modes.app_cursor_keys = false;
+        }
+        return;
+    }
+
+    if (m_private == '?') {
+        if (final == 'h' || final == 'l') {
+            for (size_t i = 0; i < m_params.size(); ++i) {
+                set_mode(m_params[i], final == 'h');
+            }
+        }
+        return;
+    }
+    if (m_private) {
+        return;
+    }
+
+    if (final == 'm') {
+        select_graphic_rendition();
+        return;
+    }
+
+    m_wrap_pending = false;
+
+    const int cols = m_size.cols;
+    const int rows = m_size.rows;
+    const int n = param(0, 1);
+    auto clamp_x = [cols](int x) { return static_cast<uint16_t>(std::max(0, std::min(x, cols - 1))); };
+    auto clamp_y = [rows](int y) { return static_cast<uint16_t>(std::max(0, std::min(y, rows - 1))); };
+
+    switch (final) {
+        case 'A':   // CUU
+        case 'F': { // CPL
+            int top = m_cursor_y >= m_scroll_top ? m_scroll_top : 0;
+            m_cursor_y = static_cast<uint16_t>(std::max(top, m_cursor_y - n));
+            if (final == 'F') m_cursor_x = 0;
+            break;
+        }
+        case 'B':   // CUD
+        case 'E': { // CNL
+            int bottom = m_cursor_y <= m_scroll_bottom ? m_scroll_bottom : rows - 1;
+            m_cursor_y = static_cast<uint16_t>(std::min(bottom, m_cursor_y + n));
+            if (final == 'E') m_cursor_x = 0;
+            break;
+        }
+        case 'C':   // CUF
+            m_cursor_x = clamp_x(m_cursor_x + n);
+            break;
+        case 'D':   // CUB
+            m_cursor_x = clamp_x(m_cursor_x - n);
+            break;
+        case 'G':   // CHA
+        case '`':   // HPA
+            m_cursor_x = clamp_x(n - 1);
+            break;
+        case 'd':   // VPA
+            m_cursor_y = clamp_y(n - 1);
+            break;
+        case 'H':   // CUP
+        case 'f':   // HVP
+            m_cursor_y = clamp_y(param(0, 1) - 1);
+            m_cursor_x = clamp_x(param(1, 1) - 1);
+            break;
+
+        case 'J': { // ED
+            int mode = param(0, 0);
+            if (mode == 0) {
+                erase_cells(m_lines[m_cursor_y], m_cursor_x, m_size.cols);
+                for (int y = m_cursor_y + 1; y < rows; ++y) clear_line(m_lines[y]);
+            } else if (mode == 1) {
+                for (int y = 0; y < m_cursor_y; ++y) clear_line(m_lines[y]);
+                erase_cells(m_lines[m_cursor_y], 0, m_cursor_x + 1);
+            } else if (mode == 2) {
+                for (Line& line : m_lines) clear_line(line);
+            } else if (mode == 3) {
+                reflow_scrollback();
+                m_scrollback_base += m_scrollback.size();
+                m_scrollback.clear();
+                m_layout.clear();
+            }
+            break;
+        }
+        case 'K': { // EL
+            int mode = param(0, 0);
+            Line& line = m_lines[m_cursor_y];
+            if (mode == 0) {
+                erase_cells(line, m_cursor_x, m_size.cols);
+            } else if (mode == 1) {
+                erase_cells(line, 0, m_cursor_x + 1);
+            } else if (mode == 2) {
+                erase_cells(line, 0, m_size.cols);
+            }
+            line.wrapped = false;
+            break;
+        }
+        case 'X':   // ECH
+            erase_cells(m_lines[m_cursor_y], m_cursor_x, static_cast<uint16_t>(std::min(cols, m_cursor_x + n)));
+            break;
+
+        case '@': { // ICH
+            Line& line = m_lines[m_cursor_y];
+            int count = std::min(n, cols - m_cursor_x);
+            std::rotate(line.cells.begin() + m_cursor_x, line.cells.end() - count, line.cells.end());
+            erase_cells(line, m_cursor_x, static_cast<uint16_t>(m_cursor_x + count));
+            break;
+        }
+        case 'P': { // DCH
+            Line& line = m_lines[m_cursor_y];
+            int count = std::min(n, cols - m_cursor_x);
+            std::rotate(line.cells.begin() + m_cursor_x, line.cells.begin() + m_cursor_x + count, line.cells.end());
+            erase_cells(line, static_cast<uint16_t>(cols - count), m_size.cols);
+            break;
+        }
+        case 'L':   // IL
+            if (m_cursor_y >= m_scroll_top && m_cursor_y <= m_scroll_bottom) {
+                scroll_down(m_cursor_y, m_scroll_bottom, static_cast<uint16_t>(n));
+                m_cursor_x = 0;
+            }
+            break;
+        case 'M':   // DL
+            if (m_cursor_y >= m_scroll_top && m_cursor_y <= m_scroll_bottom) {
+                scroll_up(m_cursor_y, m_scroll_bottom, static_cast<uint16_t>(n), false);
+                m_cursor_x = 0;
+            }
+            break;
+        case 'S':   // SU
+            scroll_up(m_scroll_top, m_scroll_bottom, static_cast<uint16_t>(n), true);
+            break;
+        case 'T':   // SD
+            scroll_down(m_scroll_top, m_scroll_bottom, static_cast<uint16_t>(n));
+            break;
+
+        case 'r': { // DECSTBM
+            int top = param(0, 1) - 1;
+            int bottom = param(1, rows) - 1;
+            if (top < bottom && bottom < rows) {
+                m_scroll_top = static_cast<uint16_t>(top);
+                m_scroll_bottom = static_cast<uint16_t>(bottom);
+                m_cursor_x = 0;
+                m_cursor_y = 0;
+            }
+            break;
+        }
+        case 's':   // SCOSC
+            esc_dispatch('7');
+            break;
+        case 'u':   // SCORC
+            esc_dispatch('8');
+            break;
+        default:
+            break;
+    }
+}
+
+void Screen::set_mode(int mode, bool enable) {
+    switch (mode) {
+        case 1:
+            m_modes.app_cursor_keys = enable;
+            break;
+        case 7:
+            m_modes.auto_wrap = enable;
+            break;
+        case 25:
+            m_modes.cursor_visible = enable;
+            break;
+        case 47:
+        case 1047:
+            set_alt_screen(enable);
+            break;
+        case 1049:
+            if (enable) {
+                esc_dispatch('7');
+                set_alt_screen(true);
+            } else {
+                set_alt_screen(false);
+                esc_dispatch('8');
+            }
+            break;
+        case 2004:
+            m_modes.bracketed_paste = enable;
+            break;
+        default:
+            break;
+    }
+}
+
+void Screen::set_alt_screen(bool enable) {
+    if (enable == m_modes.alt_screen) {
+        return;
+    }
+
+    if (enable) {
+        m_saved_lines = std::move(m_lines);
+        m_lines.assign(m_size.rows, blank_line());
+    } else {
+        m_lines = std::move(m_saved_lines);
+        m_saved_lines.clear();
+    }
+    m_modes.alt_screen = enable;
+}
+
+void Screen::select_graphic_rendition() {
+    if (m_params.empty()) {
+        m_fg = COLOR_DEFAULT;
+        m_bg = COLOR_DEFAULT;
+        m_attrs = 0;
+        return;
+    }
+
+    // 38/48 ; 5 ; index  or  38/48 ; 2 ; r ; g ; b
+    auto extended = [this](size_t& i, uint32_t& color) {
+        if (i + 2 < m_params.size() && m_params[i + 1] == 5) {
+            color = COLOR_INDEXED | (m_params[i + 2] & 0xFF);
+            i += 2;
+        } else if (i + 4 < m_params.size() && m_params[i + 1] == 2) {
+            color = COLOR_RGB | ((m_params[i + 2] & 0xFF) << 16) |
+                    ((m_params[i + 3] & 0xFF) << 8) | (m_params[i + 4] & 0xFF);
+            i += 4;
+        } else {
+            i = m_params.size();
+        }
+    };
+
+    for (size_t i = 0; i < m_params.size(); ++i) {
+        int p = m_params[i];
+        switch (p) {
+            case 0:  m_fg = COLOR_DEFAULT; m_bg = COLOR_DEFAULT; m_attrs = 0; break;
+            case 1:  m_attrs |= ATTR_BOLD; break;
+            case 2:  m_attrs |= ATTR_DIM; break;
+            case 3:  m_attrs |= ATTR_ITALIC; break;
+            case 4:  m_attrs |= ATTR_UNDERLINE; break;
+            case 5:
+            case 6:  m_attrs |= ATTR_BLINK; break;
+            case 7:  m_attrs |= ATTR_INVERSE; break;
+            case 8:  m_attrs |= ATTR_HIDDEN; break;
+            case 9:  m_attrs |= ATTR_STRIKE; break;
+            case 21: m_attrs |= ATTR_UNDERLINE; break;
+            case 22: m_attrs &= ~(ATTR_BOLD | ATTR_DIM); break;
+            case 23: m_attrs &= ~ATTR_ITALIC; break;
+            case 24: m_attrs &= ~ATTR_UNDERLINE; break;
+            case 25: m_attrs &= ~ATTR_BLINK; break;
+            case 27: m_attrs &= ~ATTR_INVERSE; break;
+            case 28: m_attrs &= ~ATTR_HIDDEN; break;
+            case 29: m_attrs &= ~ATTR_STRIKE; break;
+            case 38: extended(i, m_fg); break;
+            case 39: m_fg = COLOR_DEFAULT; break;
+            case 48: extended(i, m_bg); break;
+            case 49: m_bg = COLOR_DEFAULT; break;
+            default:
+                if (p >= 30 && p <= 37) m_fg = COLOR_INDEXED | (p - 30);
+                else if (p >= 40 && p <= 47) m_bg = COLOR_INDEXED | (p - 40);
+                else if (p >= 90 && p <= 97) m_fg = COLOR_INDEXED | (p - 90 + 8);
+                else if (p >= 100 && p <= 107) m_bg = COLOR_INDEXED | (p - 100 + 8);
+                break;
+        }
+    }
+}
+
+void Screen::osc_dispatch() {
+    // OSC 0 / OSC 2: window title
+    size_t sep = m_osc.find(';');
+    if (sep == std::string::npos) {
+        return;
+    }
+    std::string code = m_osc.substr(0, sep);
+    if (code == "0" || code == "2") {
+        m_title = m_osc.substr(sep + 1);
+    }
+}
+
+void Screen::resize(TerminalSize size) {
+    if (size.cols == 0 || size.rows == 0 || (size.cols == m_size.cols && size.rows == m_size.rows)) {
+        return;
+    }
+    m_cluster_open = false;     // Its cell may move
+    if (size.cols != m_size.cols && !m_modes.alt_screen) {
+        reflow_lines(size);
+        return;
+    }
+
+    Cell blank;
+    auto fit_columns = [&](LineVector& lines) {
+        for (Line& line : lines) {
+            line.cells.resize(size.cols, blank);
+            if (line.cells.back().width == 2) {
+                line.cells.back() = blank;
+            }
+        }
+    };
+
+    // Shrinking keeps the cursor row visible by pushing lines off the top first
+    if (size.rows < m_size.rows) {
+        int excess = m_size.rows - size.rows;
+        int fromTop = std::min(excess, std::max(0, m_cursor_y - (size.rows - 1)));
+        for (int i = 0; i < fromTop; ++i) {
+            push_scrollback(m_lines[i]);
+        }
+        m_lines.erase(m_lines.begin(), m_lines.begin() + fromTop);
+        m_lines.resize(size.rows);
+        m_cursor_y = static_cast<uint16_t>(m_cursor_y - fromTop);
+        if (!m_saved_lines.empty()) {
+            m_saved_lines.resize(size.rows);
+        }
+    }
+
+    m_size = size;
+    fit_columns(m_lines);
+    fit_columns(m_saved_lines);
+    while (m_lines.size() < size.rows) {
+        m_lines.push_back(blank_line());
+    }
+    while (!m_saved_lines.empty() && m_saved_lines.size() < size.rows) {
+        m_saved_lines.push_back(blank_line());
+    }
+
+    m_cursor_x = std::min<uint16_t>(m_cursor_x, size.cols - 1);
+    m_cursor_y = std::min<uint16_t>(m_cursor_y, size.rows - 1);
+    m_wrap_pending = false;
+    m_scroll_top = 0;
+    m_scroll_bottom = size.rows - 1;
+    ++m_seq;
+}
+
+// Main screen column change: re-wrap the visible lines. The cursor keeps its place in
+// the text; rows that no longer fit go to scrollback the same way a row shrink does.
+void Screen::reflow_lines(TerminalSize size) {
+    LineVector rows(line_allocator());
+    std::vector<Cell> text;
+    size_t cursor_row = 0;
+    uint16_t cursor_col = 0;
+    std::vector<size_t> new_row(m_lines.size());    // Row of rows each old row's text starts in
+    std::vector<size_t> starts;
+
+    size_t y = 0;
+    while (y < m_lines.size()) {
+        text.clear();
+        starts.clear();
+        size_t cursor_offset = SIZE_MAX;
+        bool wrapped;
+        do {
+            const Line& line = m_lines[y];
+            wrapped = line.wrapped && y + 1 < m_lines.size();
+            starts.push_back(append_text(text, line, m_size.cols, wrapped));
+            if (y == m_cursor_y) {
+                cursor_offset = starts.back() + m_cursor_x;
+            }
+            ++y;
+        } while (wrapped);
+
+        if (cursor_offset != SIZE_MAX && text.size() < cursor_offset) {
+            text.resize(cursor_offset, Cell());     // Keep the blanks the cursor sits after
+        }
+        size_t first = rows.size();
+        rewrap(text, size.cols, rows);
+
+        size_t column;
+        for (size_t i = 0; i < starts.size(); ++i) {
+            new_row[y - starts.size() + i] = row_at(rows, first, starts[i], column);
+        }
+        if (cursor_offset != SIZE_MAX) {
+            cursor_row = row_at(rows, first, cursor_offset, column);
+            cursor_col = static_cast<uint16_t>(std::min<size_t>(column, size.cols - 1));
+        }
+    }
+    m_size.cols = size.cols;
+    for (Line& row : rows) {
+        row.cells.resize(size.cols, Cell());
+    }
+
+    // Keep the cursor row visible by pushing lines off the top; drop the excess below it
+    size_t fromTop = 0;
+    if (rows.size() > size.rows && cursor_row >= size.rows) {
+        fromTop = std::min(rows.size() - size.rows, cursor_row - (size.rows - 1));
+    }
+    uint64_t top = m_scrollback_base + m_scrollback.size();     // Number of the first grid line
+    for (size_t i = 0; i < fromTop; ++i) {
+        push_scrollback(rows[i]);
+    }
+
+    // Marked grid lines move with their text: into history (unless there is none), to
+    // another grid row, or off the bottom
+    uint64_t pushed = m_scrollback_base + m_scrollback.size() - top;
+    for (RowMark& mark : m_row_marks) {
+        if (mark.line < top || mark.line - top >= new_row.size()) {
+            continue;
+        }
+        size_t row = new_row[static_cast<size_t>(mark.line - top)];
+        if (row < fromTop) {
+            mark.line = row < pushed ? top + row : SCREEN_NO_LINE;
+        } else {
+            mark.line = row - fromTop < size.rows ? top + pushed + (row - fromTop) : SCREEN_NO_LINE;
+        }
+    }
+    rows.erase(rows.begin(), rows.begin() + fromTop);
+    rows.resize(size.rows);
+    for (Line& row : rows) {
+        if (row.cells.empty()) {
+            row = blank_line();
+        }
+    }
+
+    m_lines = std::move(rows);
+    m_size = size;
+    m_cursor_x = cursor_col;
+    m_cursor_y = static_cast<uint16_t>(std::min<size_t>(cursor_row - fromTop, size.rows - 1));
+    m_saved_cursor.x = std::min<uint16_t>(m_saved_cursor.x, size.cols - 1);
+    m_saved_cursor.y = std::min<uint16_t>(m_saved_cursor.y, size.rows - 1);
+    m_wrap_pending = false;
+    m_scroll_top = 0;
+    m_scroll_bottom = size.rows - 1;
+    ++m_seq;
+}
+
+bool Screen::same_live_state(const Screen& other) const {
+    // Cluster offsets depend on each screen's history, so clusters are compared by content
+    auto same_cell = [this, &other](const Cell& a, const Cell& b) {
+        return a.fg == b.fg && a.bg == b.bg && a.attrs == b.attrs && a.width == b.width &&
+               (a.ch == b.ch || ((a.ch & b.ch & CELL_CLUSTER) && codepoints(a) == other.codepoints(b)));
+    };
+    auto same_lines = [&same_cell](const LineVector& a, const LineVector& b) {
+        if (a.size() != b.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); ++i) {
+            if (a[i].wrapped != b[i].wrapped ||
+                !std::equal(a[i].cells.begin(), a[i].cells.end(), b[i].cells.begin(), b[i].cells.end(), same_cell)) {
+                return false;
+            }
+        }
+        return true;
+    };
+    auto same_cursor = [](const Cursor& a, const Cursor& b) {
+        return a.x == b.x && a.y == b.y && a.fg == b.fg && a.bg == b.bg && a.attrs == b.attrs;
+    };
+    auto same_modes = [](const ScreenModes& a, const ScreenModes& b) {
+        return a.cursor_visible == b.cursor_visible && a.auto_wrap == b.auto_wrap && a.alt_screen == b.alt_screen &&
+               a.bracketed_paste == b.bracketed_paste && a.app_cursor_keys == b.app_cursor_keys;
+    };
+
+    // An open grapheme cluster carries segmenter state that isn't compared
+    return m_size.cols == other.m_size.cols && m_size.rows == other.m_size.rows &&
+           m_cursor_x == other.m_cursor_x && m_cursor_y == other.m_cursor_y &&
+           m_wrap_pending == other.m_wrap_pending && m_fg == other.m_fg && m_bg == other.m_bg &&
+           m_attrs == other.m_attrs && same_cursor(m_saved_cursor, other.m_saved_cursor) &&
+           m_scroll_top == other.m_scroll_top && m_scroll_bottom == other.m_scroll_bottom &&
+           same_modes(m_modes, other.m_modes) && !m_cluster_open && !other.m_cluster_open &&
+           m_state == other.m_state &&
+           (m_state == State::Ground ||     // Leftovers of the last sequence don't matter in Ground
+            (m_params == other.m_params && m_param_started == other.m_param_started && m_private == other.m_private &&
+             m_intermediate == other.m_intermediate && m_osc == other.m_osc)) &&
+           m_utf8_remaining == other.m_utf8_remaining && (m_utf8_remaining == 0 || m_codepoint == other.m_codepoint) &&
+           same_lines(m_lines, other.m_lines) && same_lines(m_saved_lines, other.m_saved_lines);
+}
+
+ArenaStats Screen::arena_stats() const {
+    return m_arena.arena ? m_arena.arena->get_stats() : ArenaStats();
+}
+
+void Screen::snapshot(ScreenFrame& frame) const {
+    frame.seq = m_seq;
+    frame.size = m_size;
+    frame.cells.resize(static_cast<size_t>(m_size.cols) * m_size.rows);
+    frame.clusters.clear();
+    for (size_t y = 0; y < m_lines.size(); ++y) {
+        Cell* row = frame.cells.data() + y * m_size.cols;
+        std::copy(m_lines[y].cells.begin(), m_lines[y].cells.end(), row);
+        // The frame gets its own pool with just the clusters on screen
+        for (uint16_t x = 0; x < m_size.cols; ++x) {
+            if (row[x].ch & CELL_CLUSTER) {
+                std::u32string_view cluster = codepoints(row[x]);
+                row[x].ch = CELL_CLUSTER | static_cast<char32_t>(frame.clusters.size());
+                frame.clusters += static_cast<char32_t>(cluster.size());
+                frame.clusters += cluster;
+            }
+        }
+    }
+    frame.cursor_x = m_cursor_x;
+    frame.cursor_y = m_cursor_y;
+    frame.modes = m_modes;
+}
+
+std::string Screen::line_text(uint16_t y) const {
+    std::string text;
+    if (y >= m_size.rows) {
+        return text;
+    }
+
+    const CellVector& cells = m_lines[y].cells;
+    size_t end = cells.size();
+    while (end > 0 && cells[end - 1].ch == U' ') {
+        --end;
+    }
+    for (size_t x = 0; x < end; ++x) {
+        if (cells[x].width != 0) {
+            for (char32_t cp : codepoints(cells[x])) {
+                append_utf8(text, cp);
+            }
+        }
+    }
+    return text;
+}
+
+size_t Screen::state_size() const {
+    reflow_scrollback();
+    size_t size = sizeof(StateHeader) + align8(m_title.size()) + align8(m_clusters.size() * sizeof(char32_t));
+    auto add = [&size](const Line& line) {
+        size += sizeof(LineHeader) + stored_cells(line) * sizeof(Cell);
+    };
+    for (const Line& line : m_scrollback) add(line);
+    for (const Line& line : m_lines) add(line);
+    for (const Line& line : m_saved_lines) add(line);
+    return size;
+}
+
+void Screen::save_state(uint8_t* out) const {
+    reflow_scrollback();
+    StateHeader header = {};
+    std::memcpy(header.magic, STATE_MAGIC, sizeof(header.magic));
+    header.version = STATE_VERSION;
+    header.cell_size = sizeof(Cell);
+    header.cols = m_size.cols;
+    header.rows = m_size.rows;
+    header.cursor_x = m_cursor_x;
+    header.cursor_y = m_cursor_y;
+    header.scroll_top = m_scroll_top;
+    header.scroll_bottom = m_scroll_bottom;
+    header.flags = (m_modes.cursor_visible ? STATE_CURSOR_VISIBLE : 0) |
+                   (m_modes.auto_wrap ? STATE_AUTO_WRAP : 0) |
+                   (m_modes.alt_screen ? STATE_ALT_SCREEN : 0) |
+                   (m_modes.bracketed_paste ? STATE_BRACKETED_PASTE : 0) |
+                   (m_modes.app_cursor_keys ? STATE_APP_CURSOR_KEYS : 0) |
+                   (m_wrap_pending ? STATE_WRAP_PENDING : 0);
+    header.attrs = m_attrs;
+    header.fg = m_fg;
+    header.bg = m_bg;
+    header.saved_x = m_saved_cursor.x;
+    header.saved_y = m_saved_cursor.y;
+    header.saved_attrs = m_saved_cursor.attrs;
+    header.saved_fg = m_saved_cursor.fg;
+    header.saved_bg = m_saved_cursor.bg;
+    header.title_length = static_cast<uint32_t>(m_title.size());
+    header.scrollback_count = static_cast<uint32_t>(m_scrollback.size());
+    header.saved_line_count = static_cast<uint32_t>(m_saved_lines.size());
+    header.cluster_length = static_cast<uint32_t>(m_clusters.size());
+    header.seq = m_seq;
+
+    std::memcpy(out, &header, sizeof(header));
+    out += sizeof(header);
+    std::memset(out, 0, align8(m_title.size()));
+    std::memcpy(out, m_title.data(), m_title.size());
+    out += align8(m_title.size());
+    size_t pool_bytes = m_clusters.size() * sizeof(char32_t);
+    std::memset(out, 0, align8(pool_bytes));
+    if (pool_bytes > 0) {
+        std::memcpy(out, m_clusters.data(), pool_bytes);
+    }
+    out += align8(pool_bytes);
+
+    auto write_line = [&out](const Line& line) {
+        LineHeader lh = {};
+        lh.width = static_cast<uint16_t>(line.cells.size());
+        lh.stored = static_cast<uint16_t>(stored_cells(line));
+        lh.wrapped = line.wrapped ? 1 : 0;
+        std::memcpy(out, &lh, sizeof(lh));
+        out += sizeof(lh);
+        if (lh.stored > 0) {    // A trimmed blank line has no cells, and data() may be null
+            std::memcpy(out, line.cells.data(), lh.stored * sizeof(Cell));
+            out += lh.stored * sizeof(Cell);
+        }
+    };
+    for (const Line& line : m_scrollback) write_line(line);
+    for (const Line& line : m_lines) write_line(line);
+    for (const Line& line : m_saved_lines) write_line(line);
+}
+
+bool Screen::load_state(const uint8_t* data, size_t length) {
+    StateHeader header;
+    if (length < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+
+    if (std::memcmp(header.magic, STATE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != STATE_VERSION || header.cell_size != sizeof(Cell) ||
+        header.cols == 0 || header.rows == 0 ||
+        header.cursor_x >= header.cols || header.cursor_y >= header.rows ||
+        header.scroll_top > header.scroll_bottom || header.scroll_bottom >= header.rows ||
+        header.saved_line_count != ((header.flags & STATE_ALT_SCREEN) ? header.rows : 0u)) {
+        return false;
+    }
+
+    const uint8_t* p = data + sizeof(header);
+    const uint8_t* end = data + length;
+    if (static_cast<size_t>(end - p) < align8(header.title_length)) {
+        return false;
+    }
+    std::string title(reinterpret_cast<const char*>(p), header.title_length);
+    p += align8(header.title_length);
+
+    // Parse into temporaries so a bad file leaves the screen untouched
+    size_t pool_bytes = static_cast<size_t>(header.cluster_length) * sizeof(char32_t);
+    if (static_cast<size_t>(end - p) < align8(pool_bytes)) {
+        return false;
+    }
+    std::u32string clusters(header.cluster_length, U'\0');
+    if (pool_bytes > 0) {
+        std::memcpy(&clusters[0], p, pool_bytes);
+    }
+    p += align8(pool_bytes);
+    std::unordered_map<std::u32string, uint32_t> cluster_index;
+    std::vector<bool> cluster_starts(clusters.size());
+    for (size_t i = 0; i < clusters.size(); i += 1 + clusters[i]) {
+        if (clusters[i] < 2 || clusters[i] > SCREEN_CLUSTER_MAX || clusters[i] >= clusters.size() - i) {
+            return false;
+        }
+        cluster_starts[i] = true;
+        cluster_index.emplace(clusters.substr(i + 1, clusters[i]), static_cast<uint32_t>(i));
+    }
+
+    auto read_line = [&p, end, &cluster_starts](Line& line, uint16_t expected_width) {
+        LineHeader lh;
+        if (static_cast<size_t>(end - p) < sizeof(lh)) {
+            return false;
+        }
+        std::memcpy(&lh, p, sizeof(lh));
+        p += sizeof(lh);
+        if (lh.stored > lh.width || (expected_width && lh.width != expected_width) ||
+            static_cast<size_t>(end - p) < lh.stored * sizeof(Cell)) {
+            return false;
+        }
+        line.cells.resize(lh.width);
+        if (lh.stored > 0) {
+            std::memcpy(line.cells.data(), p, lh.stored * sizeof(Cell));
+            p += lh.stored * sizeof(Cell);
+        }
+        for (uint16_t x = 0; x < lh.stored; ++x) {
+            char32_t ch = line.cells[x].ch;
+            if ((ch & CELL_CLUSTER) && ((ch & ~CELL_CLUSTER) >= cluster_starts.size() || !cluster_starts[ch & ~CELL_CLUSTER])) {
+                return false;
+            }
+        }
+        std::fill(line.cells.begin() + lh.stored, line.cells.end(), Cell());
+        line.wrapped = lh.wrapped != 0;
+        return true;
+    };
+
+    LineDeque scrollback(line_allocator());
+    LineVector lines(header.rows, line_allocator());
+    LineVector saved(header.saved_line_count, line_allocator());
+
+    size_t skip = header.scrollback_count > m_scrollback_limit ? header.scrollback_count - m_scrollback_limit : 0;
+    Line line(line_allocator());
+    for (uint32_t i = 0; i < header.scrollback_count; ++i) {
+        if (!read_line(line, 0)) {
+            return false;
+        }
+        if (i >= skip) {
+            scrollback.push_back(std::move(line));
+            line = Line(line_allocator());
+        }
+    }
+    for (Line& l : lines) {
+        if (!read_line(l, header.cols)) return false;
+    }
+    for (Line& l : saved) {
+        if (!read_line(l, header.cols)) return false;
+    }
+
+    m_size = { header.cols, header.rows };
+    m_lines = std::move(lines);
+    m_saved_lines = std::move(saved);
+    m_scrollback = std::move(scrollback);
+    m_scrollback_base = skip;
+    m_rows_scrolled = skip + m_scrollback.size();
+    m_row_marks.clear();
+    m_layout.clear();
+    if (!m_scrollback.empty()) {
+        m_layout.push_back({ header.cols, m_scrollback.size() });
+    }
+    m_cursor_x = header.cursor_x;
+    m_cursor_y = header.cursor_y;
+    m_scroll_top = header.scroll_top;
+    m_scroll_bottom = header.scroll_bottom;
+    m_wrap_pending = (header.flags & STATE_WRAP_PENDING) != 0;
+    m_modes.cursor_visible = (header.flags & STATE_CURSOR_VISIBLE) != 0;
+    m_modes.auto_wrap = (header.flags & STATE_AUTO_WRAP) != 0;
+    m_modes.alt_screen = (header.flags & STATE_ALT_SCREEN) != 0;
+    m_modes.bracketed_paste = (header.flags & STATE_BRACKETED_PASTE) != 0;
+    m_modes.app_cursor_keys = (header.flags & STATE_APP_CURSOR_KEYS) != 0;
+    m_attrs = header.attrs;
+    m_fg = header.fg;
+    m_bg = header.bg;
+    m_saved_cursor = { header.saved_x, header.saved_y, header.saved_fg, header.saved_bg, header.saved_attrs };
+    m_title = std::move(title);
+    m_clusters = std::move(clusters);
+    m_cluster_index = std::move(cluster_index);
+    m_cluster_retry_row = 0;
+    m_seq = header.seq + 1;
+
+    m_state = State::Ground;
+    m_utf8_remaining = 0;
+    m_cluster_open = false;
+    m_cluster_fresh = false;
+    return true;
+}
+
+} // namespace headless_tty
@@ -0,0 +1,153 @@
+#include "headless_tty/session_pool.hpp"
+
+#include <chrono>
+
+namespace headless_tty {
+
+SessionPool::~SessionPool() {
+    stop();
+}
+
+bool SessionPool::start(const Config& config, const PoolOptions& options) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_filler.joinable()) {
+        m_last_error = "Pool is already running";
+        return false;
+    }
+
+    m_config = config;
+    m_options = options;
+    m_stopping = false;
+    m_start_failed = false;
+    m_stats = PoolStats();
+    m_filler = std::thread([this] { filler_loop(); });
+    return true;
+}
+
+void SessionPool::filler_loop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_refill.wait(lock, [this] { return m_stopping || m_ready.size() < m_options.warm; });
+        if (m_stopping) {
+            return;
+        }
+
+        // Start and warm up outside the lock; acquire() keeps handing out what is ready
+        auto tty = std::make_unique<HeadlessTTY>();
+        lock.unlock();
+        bool started = tty->start(m_config);
+        lock.lock();
+
+        ReadyEvent event = ReadyEvent::Exited;
+        if (started && !m_stopping) {
+            m_warming = tty.get();
+            lock.unlock();
+            event = tty->wait_ready(m_options.ready, m_options.warm_timeout_ms);
+            lock.lock();
+            m_warming = nullptr;
+        }
+
+        if (!started) {
+            m_last_error = tty->get_last_error();
+            m_start_failed = true;
+            m_available.notify_all();
+            // Don't spin on a command that can't start; stop() cuts the pause short
+            m_refill.wait_for(lock, std::chrono::milliseconds(POOL_RETRY_DELAY_MS), [this] { return m_stopping; });
+            continue;
+        }
+
+        ++m_stats.started;
+        m_start_failed = false;
+        if (m_stopping || event == ReadyEvent::Timeout || event == ReadyEvent::Exited || event == ReadyEvent::Invalid) {
+            ++m_stats.discarded;
+            if (event == ReadyEvent::Invalid) {
+                m_last_error = "Pool readiness options are invalid";
+            }
+            lock.unlock();
+            tty.reset();        // Stops the child without holding up acquire()
+            lock.lock();
+            continue;
+        }
+
+        m_ready.push_back(std::move(tty));
+        m_available.notify_one();
+    }
+}
+
+std::unique_ptr<HeadlessTTY> SessionPool::acquire(OutputCallback output, DWORD timeout_ms) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    std::unique_ptr<HeadlessTTY> tty;
+    std::unique_ptr<HeadlessTTY> stale;
+
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        bool counted = false;
+        while (!tty) {
+            auto ready = [this] { return m_stopping || m_start_failed || !m_ready.empty(); };
+            if (!ready() && !counted) {
+                ++m_stats.waited;
+                counted = true;
+            }
+            if (timeout_ms == INFINITE) {
+                m_available.wait(lock, ready);
+            } else if (!m_available.wait_until(lock, deadline, ready)) {
+                return nullptr;
+            }
+            if (m_ready.empty()) {
+                return nullptr;     // Stopping, or the command doesn't start
+            }
+
+            tty = std::move(m_ready.front());
+            m_ready.pop_front();
+            m_refill.notify_one();
+            if (!tty->is_running()) {
+                ++m_stats.discarded;
+                stale = std::move(tty);
+                lock.unlock();
+                stale.reset();
+                lock.lock();
+            }
+        }
+        ++m_stats.handed_out;
+    }
+
+    if (output) {
+        tty->set_output_callback(std::move(output));
+    }
+    if (!m_options.entry.empty()) {
+        tty->write(m_options.entry);
+    }
+    return tty;
+}
+
+void SessionPool::stop() {
+    std::deque<std::unique_ptr<HeadlessTTY>> ready;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+        if (m_warming) {
+            m_warming->stop();      // Ends its wait_ready() with Exited
+        }
+        ready.swap(m_ready);
+    }
+    m_refill.notify_all();
+    m_available.notify_all();
+    if (m_filler.joinable()) {
+        m_filler.join();
+    }
+    ready.clear();
+}
+
+PoolStats SessionPool::get_stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    PoolStats stats = m_stats;
+    stats.warm = m_ready.size();
+    return stats;
+}
+
+std::string SessionPool::get_last_error() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_last_error;
+}
+
+} // namespace headless_tty
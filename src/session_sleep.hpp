@@ -0,0 +1,22 @@
+#pragma once
+
+#include "headless_tty/pty.hpp"
+
+namespace headless_tty {
+
+// Sleep for ms on the optional cancel event and the session's exit; false if either fired first.
+// Shared by the input file streamer and expect scripts, which both pause a running session.
+inline bool session_sleep(HeadlessTTY& tty, HANDLE cancel, DWORD ms) {
+    HANDLE handles[2];
+    DWORD count = 0;
+    if (cancel) handles[count++] = cancel;
+    if (tty.exit_event()) handles[count++] = tty.exit_event();
+
+    if (count == 0) {
+        Sleep(ms);
+        return true;
+    }
+    return WaitForMultipleObjects(count, handles, FALSE, ms) == WAIT_TIMEOUT;
+}
+
+} // namespace headless_tty
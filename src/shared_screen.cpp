@@ -0,0 +1,253 @@
+#include "headless_tty/shared_screen.hpp"
+#include "win_error.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace headless_tty {
+
+namespace {
+
+constexpr char SHARED_MAGIC[8] = { 'H', 'T', 'T', 'Y', 'S', 'H', 'M', '1' };
+
+uint32_t mode_flags(const ScreenModes& modes) {
+    return (modes.cursor_visible ? SHARED_CURSOR_VISIBLE : 0) |
+           (modes.auto_wrap ? SHARED_AUTO_WRAP : 0) |
+           (modes.alt_screen ? SHARED_ALT_SCREEN : 0) |
+           (modes.bracketed_paste ? SHARED_BRACKETED_PASTE : 0) |
+           (modes.app_cursor_keys ? SHARED_APP_CURSOR_KEYS : 0);
+}
+
+ScreenModes modes_from_flags(uint32_t flags) {
+    ScreenModes modes;
+    modes.cursor_visible = (flags & SHARED_CURSOR_VISIBLE) != 0;
+    modes.auto_wrap = (flags & SHARED_AUTO_WRAP) != 0;
+    modes.alt_screen = (flags & SHARED_ALT_SCREEN) != 0;
+    modes.bracketed_paste = (flags & SHARED_BRACKETED_PASTE) != 0;
+    modes.app_cursor_keys = (flags & SHARED_APP_CURSOR_KEYS) != 0;
+    return modes;
+}
+
+} // namespace
+
+SharedScreenWriter::~SharedScreenWriter() {
+    close();
+}
+
+bool SharedScreenWriter::create(const std::wstring& name, TerminalSize max_size) {
+    close();
+
+    uint64_t max_cells = static_cast<uint64_t>(max_size.cols) * max_size.rows;
+    uint64_t size = sizeof(SharedScreenHeader) + max_cells * (sizeof(Cell) + sizeof(char32_t));
+    m_hMapping = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                                    static_cast<DWORD>(size >> 32), static_cast<DWORD>(size & 0xFFFFFFFF),
+                                    name.c_str());
+    if (!m_hMapping) {
+        m_last_error = format_win_error("Failed to create shared screen");
+        return false;
+    }
+    if (GetLastError() == ERROR_ALREADY_EXISTS) {
+        CloseHandle(m_hMapping);
+        m_hMapping = nullptr;
+        m_last_error = "Shared screen name is already in use";
+        return false;
+    }
+
+    void* view = MapViewOfFile(m_hMapping, FILE_MAP_WRITE, 0, 0, static_cast<SIZE_T>(size));
+    if (!view) {
+        m_last_error = format_win_error("Failed to map shared screen");
+        CloseHandle(m_hMapping);
+        m_hMapping = nullptr;
+        return false;
+    }
+
+    // Fresh pagefile-backed mappings are zeroed, so sequence starts at 0 (even, empty screen)
+    m_header = static_cast<SharedScreenHeader*>(view);
+    m_cells = reinterpret_cast<Cell*>(static_cast<uint8_t*>(view) + sizeof(SharedScreenHeader));
+    m_clusters = reinterpret_cast<char32_t*>(m_cells + max_cells);
+    m_header->version = SHARED_SCREEN_VERSION;
+    m_header->header_size = sizeof(SharedScreenHeader);
+    m_header->cell_size = sizeof(Cell);
+    m_header->max_cols = max_size.cols;
+    m_header->max_rows = max_size.rows;
+    m_header->cluster_capacity = static_cast<uint32_t>(max_cells);
+    m_header->writer_pid = GetCurrentProcessId();
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(m_header->magic, SHARED_MAGIC, sizeof(SHARED_MAGIC));   // Readers check the magic last
+    return true;
+}
+
+void SharedScreenWriter::publish(const ScreenFrame& frame) {
+    if (!m_header) {
+        return;
+    }
+
+    uint16_t cols = std::min(frame.size.cols, m_header->max_cols);
+    uint16_t rows = std::min(frame.size.rows, m_header->max_rows);
+
+    uint32_t seq = m_header->sequence.load(std::memory_order_relaxed);
+    m_header->sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    m_header->flags = mode_flags(frame.modes);
+    m_header->cols = cols;
+    m_header->rows = rows;
+    m_header->cursor_x = std::min<uint16_t>(frame.cursor_x, cols - 1);
+    m_header->cursor_y = std::min<uint16_t>(frame.cursor_y, rows - 1);
+    m_header->frame = frame.seq;
+    if (cols == frame.size.cols) {
+        std::memcpy(m_cells, frame.cells.data(), static_cast<size_t>(cols) * rows * sizeof(Cell));
+    } else {
+        for (uint16_t y = 0; y < rows; ++y) {
+            std::memcpy(m_cells + static_cast<size_t>(y) * cols,
+                        frame.cells.data() + static_cast<size_t>(y) * frame.size.cols, cols * sizeof(Cell));
+        }
+    }
+
+    // Clusters past the end of a full pool are published as their first codepoint
+    uint32_t length = static_cast<uint32_t>(std::min<size_t>(frame.clusters.size(), m_header->cluster_capacity));
+    std::memcpy(m_clusters, frame.clusters.data(), length * sizeof(char32_t));
+    m_header->cluster_length = length;
+    if (length < frame.clusters.size()) {
+        for (size_t i = 0; i < static_cast<size_t>(cols) * rows; ++i) {
+            Cell& cell = m_cells[i];
+            size_t offset = cell.ch & ~CELL_CLUSTER;
+            if ((cell.ch & CELL_CLUSTER) && offset + 1 + frame.clusters[offset] > length) {
+                cell.ch = frame.clusters[offset + 1];
+            }
+        }
+    }
+
+    m_header->sequence.store(seq + 2, std::memory_order_release);
+}
+
+void SharedScreenWriter::mark_exited() {
+    if (!m_header) {
+        return;
+    }
+
+    uint32_t seq = m_header->sequence.load(std::memory_order_relaxed);
+    m_header->sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_header->exited = 1;
+    m_header->sequence.store(seq + 2, std::memory_order_release);
+}
+
+void SharedScreenWriter::close() {
+    if (m_header) {
+        UnmapViewOfFile(m_header);
+        m_header = nullptr;
+        m_cells = nullptr;
+        m_clusters = nullptr;
+    }
+    if (m_hMapping) {
+        CloseHandle(m_hMapping);
+        m_hMapping = nullptr;
+    }
+}
+
+SharedScreenReader::~SharedScreenReader() {
+    close();
+}
+
+bool SharedScreenReader::open(const std::wstring& name) {
+    close();
+
+    m_hMapping = OpenFileMappingW(FILE_MAP_READ, FALSE, name.c_str());
+    if (!m_hMapping) {
+        m_last_error = format_win_error("Failed to open shared screen");
+        return false;
+    }
+
+    // Map everything; the size comes from the section itself
+    const void* view = MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        m_last_error = format_win_error("Failed to map shared screen");
+        close();
+        return false;
+    }
+
+    const SharedScreenHeader* header = static_cast<const SharedScreenHeader*>(view);
+    if (std::memcmp(header->magic, SHARED_MAGIC, sizeof(SHARED_MAGIC)) != 0 ||
+        header->version != SHARED_SCREEN_VERSION || header->cell_size != sizeof(Cell)) {
+        UnmapViewOfFile(view);
+        m_last_error = "Not a compatible shared screen";
+        close();
+        return false;
+    }
+
+    m_header = header;
+    m_cells = reinterpret_cast<const Cell*>(static_cast<const uint8_t*>(view) + header->header_size);
+    m_clusters = reinterpret_cast<const char32_t*>(m_cells + static_cast<size_t>(header->max_cols) * header->max_rows);
+    return true;
+}
+
+void SharedScreenReader::close() {
+    if (m_header) {
+        UnmapViewOfFile(m_header);
+        m_header = nullptr;
+        m_cells = nullptr;
+        m_clusters = nullptr;
+    }
+    if (m_hMapping) {
+        CloseHandle(m_hMapping);
+        m_hMapping = nullptr;
+    }
+}
+
+bool SharedScreenReader::read(ScreenFrame& frame, uint32_t max_retries) const {
+    if (!m_header) {
+        return false;
+    }
+
+    for (uint32_t attempt = 0; attempt <= max_retries; ++attempt) {
+        uint32_t before = m_header->sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            YieldProcessor();
+            continue;
+        }
+
+        uint16_t cols = m_header->cols;
+        uint16_t rows = m_header->rows;
+        if (cols > m_header->max_cols || rows > m_header->max_rows) {
+            continue;   // Torn header; the sequence check below would reject it anyway
+        }
+
+        frame.size = { cols, rows };
+        frame.seq = m_header->frame;
+        frame.cursor_x = m_header->cursor_x;
+        frame.cursor_y = m_header->cursor_y;
+        frame.modes = modes_from_flags(m_header->flags);
+        frame.cells.resize(static_cast<size_t>(cols) * rows);
+        std::memcpy(frame.cells.data(), m_cells, frame.cells.size() * sizeof(Cell));
+        uint32_t length = std::min(m_header->cluster_length, static_cast<uint32_t>(m_header->max_cols) * m_header->max_rows);
+        frame.clusters.assign(m_clusters, length);     // A torn copy is rejected below; cell_codepoints() bounds-checks anyway
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_header->sequence.load(std::memory_order_relaxed) == before) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t SharedScreenReader::frame_seq() const {
+    if (!m_header) {
+        return 0;
+    }
+
+    while (true) {
+        uint32_t before = m_header->sequence.load(std::memory_order_acquire);
+        uint64_t frame = m_header->frame;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (!(before & 1) && m_header->sequence.load(std::memory_order_relaxed) == before) {
+            return frame;
+        }
+        YieldProcessor();
+    }
+}
+
+bool SharedScreenReader::writer_exited() const {
+    return m_header && m_header->exited != 0;
+}
+
+} // namespace headless_tty
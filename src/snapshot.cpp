@@ -0,0 +1,92 @@
+#include "headless_tty/snapshot.hpp"
+#include "win_error.hpp"
+
+namespace headless_tty {
+
+namespace {
+
+bool fail(std::string* error, const std::string& msg) {
+    if (error) *error = msg;
+    return false;
+}
+
+} // namespace
+
+bool save_snapshot(const Screen& screen, const std::wstring& path, std::string* error) {
+    std::wstring tempPath = path + L".tmp";
+    size_t size = screen.state_size();
+
+    HANDLE hFile = CreateFileW(tempPath.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL,
+                               CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return fail(error, format_win_error("Failed to create snapshot"));
+    }
+
+    uint64_t mapSize = size;
+    HANDLE hMapping = CreateFileMappingW(hFile, NULL, PAGE_READWRITE, static_cast<DWORD>(mapSize >> 32),
+                                         static_cast<DWORD>(mapSize & 0xFFFFFFFF), NULL);
+    if (!hMapping) {
+        std::string msg = format_win_error("Failed to map snapshot");
+        CloseHandle(hFile);
+        DeleteFileW(tempPath.c_str());
+        return fail(error, msg);
+    }
+
+    void* view = MapViewOfFile(hMapping, FILE_MAP_WRITE, 0, 0, size);
+    if (!view) {
+        std::string msg = format_win_error("Failed to map snapshot");
+        CloseHandle(hMapping);
+        CloseHandle(hFile);
+        DeleteFileW(tempPath.c_str());
+        return fail(error, msg);
+    }
+
+    screen.save_state(static_cast<uint8_t*>(view));
+
+    UnmapViewOfFile(view);
+    CloseHandle(hMapping);
+    CloseHandle(hFile);
+
+    if (!MoveFileExW(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+        std::string msg = format_win_error("Failed to replace snapshot");
+        DeleteFileW(tempPath.c_str());
+        return fail(error, msg);
+    }
+    return true;
+}
+
+bool load_snapshot(Screen& screen, const std::wstring& path, std::string* error) {
+    HANDLE hFile = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                               OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return fail(error, format_win_error("Failed to open snapshot"));
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(hFile, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(hFile);
+        return fail(error, "Snapshot is empty");
+    }
+
+    HANDLE hMapping = CreateFileMappingW(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(hFile);
+    if (!hMapping) {
+        return fail(error, format_win_error("Failed to map snapshot"));
+    }
+
+    const void* view = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(hMapping);
+    if (!view) {
+        return fail(error, format_win_error("Failed to map snapshot"));
+    }
+
+    bool loaded = screen.load_state(static_cast<const uint8_t*>(view), static_cast<size_t>(fileSize.QuadPart));
+    UnmapViewOfFile(view);
+
+    if (!loaded) {
+        return fail(error, "Snapshot is corrupt or from an incompatible version");
+    }
+    return true;
+}
+
+} // namespace headless_tty
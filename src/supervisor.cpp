@@ -0,0 +1,450 @@
+#include "headless_tty/supervisor.hpp"
+#include "headless_tty/utf8.hpp"
+#include "win_error.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+namespace headless_tty {
+
+namespace {
+
+std::string trim(const std::string& text) {
+    size_t start = text.find_first_not_of(" \t\r");
+    if (start == std::string::npos) {
+        return std::string();
+    }
+    size_t end = text.find_last_not_of(" \t\r");
+    return text.substr(start, end - start + 1);
+}
+
+bool parse_number(const std::string& text, uint32_t& value) {
+    if (text.empty()) return false;
+    uint64_t v = 0;
+    for (char c : text) {
+        if (c < '0' || c > '9') return false;
+        v = v * 10 + static_cast<uint64_t>(c - '0');
+        if (v > 0xFFFFFFFFull) return false;
+    }
+    value = static_cast<uint32_t>(v);
+    return true;
+}
+
+bool parse_size(const std::string& text, TerminalSize& size) {
+    size_t x = text.find('x');
+    uint32_t cols = 0;
+    uint32_t rows = 0;
+    if (x == std::string::npos || !parse_number(text.substr(0, x), cols) || !parse_number(text.substr(x + 1), rows) ||
+        cols == 0 || rows == 0 || cols > 0x7FFF || rows > 0x7FFF) {
+        return false;
+    }
+    size.cols = static_cast<uint16_t>(cols);
+    size.rows = static_cast<uint16_t>(rows);
+    return true;
+}
+
+bool manifest_error(std::string* error, int line, const std::string& msg) {
+    if (error) {
+        std::stringstream ss;
+        ss << "line " << line << ": " << msg;
+        *error = ss.str();
+    }
+    return false;
+}
+
+} // namespace
+
+bool parse_manifest(const std::string& text, const SupervisorEntry& defaults,
+                    std::vector<SupervisorEntry>& entries, std::string* error) {
+    entries.clear();
+
+    std::istringstream in(text);
+    std::string raw;
+    int lineNo = 0;
+    std::vector<int> entryLines;
+
+    while (std::getline(in, raw)) {
+        ++lineNo;
+        std::string line = trim(raw);
+        if (line.empty() || line[0] == '#' || line[0] == ';') {
+            continue;
+        }
+
+        if (line[0] == '[') {
+            if (line.back() != ']' || line.size() < 3) {
+                return manifest_error(error, lineNo, "expected [name]");
+            }
+            SupervisorEntry entry = defaults;
+            entry.name = trim(line.substr(1, line.size() - 2));
+            for (const SupervisorEntry& other : entries) {
+                if (other.name == entry.name) {
+                    return manifest_error(error, lineNo, "duplicate entry '" + entry.name + "'");
+                }
+            }
+            entry.prefix = "[" + entry.name + "] ";
+            entry.config.command.clear();
+            entry.config.args.clear();
+            entries.push_back(std::move(entry));
+            entryLines.push_back(lineNo);
+            continue;
+        }
+
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) {
+            return manifest_error(error, lineNo, "expected key = value");
+        }
+        if (entries.empty()) {
+            return manifest_error(error, lineNo, "key outside an [entry]");
+        }
+        std::string key = trim(line.substr(0, eq));
+        std::string value = trim(line.substr(eq + 1));
+        SupervisorEntry& entry = entries.back();
+
+        if (key == "command") {
+            // The whole command line; spawn() passes command and args through as one string
+            entry.config.command = utf8_to_wstring(value);
+        } else if (key == "cwd") {
+            entry.config.working_dir = utf8_to_wstring(value);
+        } else if (key == "size") {
+            if (!parse_size(value, entry.config.size)) {
+                return manifest_error(error, lineNo, "size expects <cols>x<rows>");
+            }
+        } else if (key == "io-mode") {
+            if (value == "latency") {
+                entry.config.io_mode = IoMode::Latency;
+            } else if (value == "throughput") {
+                entry.config.io_mode = IoMode::Throughput;
+            } else if (value == "auto") {
+                entry.config.io_mode = IoMode::Auto;
+            } else {
+                return manifest_error(error, lineNo, "io-mode must be latency, throughput or auto");
+            }
+        } else if (key == "log") {
+            entry.log_path = utf8_to_wstring(value);
+        } else if (key == "prefix") {
+            entry.prefix = value;
+        } else if (key == "plain") {
+            if (value != "yes" && value != "no") {
+                return manifest_error(error, lineNo, "plain expects yes or no");
+            }
+            entry.plain = value == "yes";
+        } else if (key == "restart") {
+            if (value == "never") {
+                entry.restart = RestartPolicy::Never;
+            } else if (value == "always") {
+                entry.restart = RestartPolicy::Always;
+            } else if (value == "on-failure") {
+                entry.restart = RestartPolicy::OnFailure;
+            } else if (value == "backoff") {
+                entry.restart = RestartPolicy::Backoff;
+            } else {
+                return manifest_error(error, lineNo, "restart must be never, always, on-failure or backoff");
+            }
+        } else if (key == "restart-delay" || key == "max-restart-delay") {
+            uint32_t& target = key == "restart-delay" ? entry.restart_delay_ms : entry.max_restart_delay_ms;
+            if (!parse_number(value, target)) {
+                return manifest_error(error, lineNo, key + " expects a number of milliseconds");
+            }
+        } else if (key == "max-failed-starts") {
+            if (!parse_number(value, entry.max_failed_starts)) {
+                return manifest_error(error, lineNo, "max-failed-starts expects a number");
+            }
+        } else {
+            return manifest_error(error, lineNo, "unknown key '" + key + "'");
+        }
+    }
+
+    if (entries.empty()) {
+        return manifest_error(error, lineNo, "no entries");
+    }
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (entries[i].config.command.empty()) {
+            return manifest_error(error, entryLines[i], "entry '" + entries[i].name + "' has no command");
+        }
+        entries[i].max_restart_delay_ms = std::max(entries[i].max_restart_delay_ms, entries[i].restart_delay_ms);
+    }
+    return true;
+}
+
+bool load_manifest(const std::wstring& path, const SupervisorEntry& defaults,
+                   std::vector<SupervisorEntry>& entries, std::string* error) {
+    HANDLE hFile = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                               OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        if (error) {
+            *error = format_win_error("Failed to open manifest");
+        }
+        return false;
+    }
+
+    std::string text;
+    char buffer[4096];
+    DWORD bytesRead = 0;
+    while (ReadFile(hFile, buffer, sizeof(buffer), &bytesRead, NULL) && bytesRead > 0) {
+        text.append(buffer, bytesRead);
+    }
+    CloseHandle(hFile);
+
+    if (text.compare(0, 3, "\xEF\xBB\xBF") == 0) {
+        text.erase(0, 3);       // Notepad's UTF-8 signature
+    }
+    return parse_manifest(text, defaults, entries, error);
+}
+
+
+// Supervisor
+
+struct Supervisor::Session {
+    SupervisorEntry entry;
+    size_t index = 0;
+    HeadlessTTY tty;
+    LogSink log;
+
+    // Read thread only while running; the loop touches them after stop() joined it
+    EscapeStripper stripper;
+    std::vector<uint8_t> stripped;
+    std::string line;                   // Partial line waiting for its newline
+    std::string out;                    // Whole lines of one read, with prefixes
+
+    bool running = false;
+    ULONGLONG started = 0;
+    ULONGLONG restart_at = 0;           // 0 = no restart scheduled
+    uint32_t next_delay = 0;            // Backoff delay of the next restart
+    uint32_t failed_starts = 0;         // Failed starts in a row
+    int exit_code = 0;
+};
+
+Supervisor::Supervisor() {
+}
+
+Supervisor::~Supervisor() {
+    stop();
+    if (m_hWake) {
+        CloseHandle(m_hWake);
+    }
+}
+
+bool Supervisor::start(const std::vector<SupervisorEntry>& entries, const LogOptions& log_options, OutputCallback output) {
+    m_output = std::move(output);
+    if (!m_hWake) {
+        m_hWake = CreateEventW(NULL, FALSE, FALSE, NULL);
+    }
+
+    for (const SupervisorEntry& entry : entries) {
+        auto session = std::make_unique<Session>();
+        session->entry = entry;
+        session->index = m_sessions.size();
+        session->next_delay = entry.restart_delay_ms;
+
+        if (!entry.log_path.empty()) {
+            LogOptions options = log_options;
+            options.plain_text = entry.plain;
+            if (!session->log.open(entry.log_path, options)) {
+                m_last_error = entry.name + ": " + session->log.get_last_error();
+                m_sessions.clear();
+                return false;
+            }
+        }
+
+        Session* s = session.get();
+        s->tty.set_output_callback([this, s](const uint8_t* data, size_t length) {
+            on_output(*s, data, length);
+        });
+        s->tty.set_exit_callback([this, s]() {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_exited.push_back(s->index);
+            }
+            SetEvent(m_hWake);
+        });
+        m_sessions.push_back(std::move(session));
+    }
+
+    ULONGLONG now = GetTickCount64();
+    for (auto& session : m_sessions) {
+        launch(*session, now);
+    }
+    return true;
+}
+
+void Supervisor::launch(Session& session, ULONGLONG now) {
+    session.line.clear();
+    session.stripper.reset();
+    if (!session.tty.start(session.entry.config)) {
+        message(session, "failed to start: " + session.tty.get_last_error());
+        session.tty.stop();
+        ++session.failed_starts;
+        finish(session, -1, now, 0);
+        return;
+    }
+    session.failed_starts = 0;
+    session.running = true;
+    session.started = now;
+}
+
+DWORD Supervisor::dispatch() {
+    std::vector<size_t> exited;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stopping) {
+            return INFINITE;
+        }
+        exited.swap(m_exited);
+    }
+
+    ULONGLONG now = GetTickCount64();
+    for (size_t index : exited) {
+        Session& session = *m_sessions[index];
+        session.tty.stop();         // Joins the read thread, which has delivered its last output
+        flush_line(session);
+        session.running = false;
+        finish(session, session.tty.wait(0), now, now - session.started);
+    }
+
+    for (auto& session : m_sessions) {
+        if (session->restart_at != 0 && session->restart_at <= now) {
+            session->restart_at = 0;
+            launch(*session, now);
+        }
+    }
+
+    // A failed launch may have scheduled the next attempt already
+    DWORD timeout = INFINITE;
+    for (auto& session : m_sessions) {
+        if (session->restart_at != 0) {
+            timeout = std::min<DWORD>(timeout, static_cast<DWORD>(session->restart_at > now ? session->restart_at - now : 0));
+        }
+    }
+    return timeout;
+}
+
+void Supervisor::finish(Session& session, int code, ULONGLONG now, ULONGLONG uptime) {
+    session.exit_code = code;
+    const SupervisorEntry& entry = session.entry;
+
+    bool restart = entry.restart == RestartPolicy::Always || entry.restart == RestartPolicy::Backoff ||
+                   (entry.restart == RestartPolicy::OnFailure && code != 0);
+    if (!restart) {
+        message(session, "exited with code " + std::to_string(code));
+        return;
+    }
+
+    uint32_t delay = entry.restart_delay_ms;
+    if (entry.restart == RestartPolicy::Backoff) {
+        // A run that lasted longer than the ceiling counts as healthy and resets the delay
+        if (uptime >= entry.max_restart_delay_ms) {
+            session.next_delay = entry.restart_delay_ms;
+        }
+        delay = session.next_delay;
+        session.next_delay = static_cast<uint32_t>(std::min<uint64_t>(uint64_t(delay) * 2, entry.max_restart_delay_ms));
+    }
+
+    // A command that can't start fails again at once; with a short restart-delay that
+    // would be a tight loop, so failed starts back off on their own and eventually give up
+    if (session.failed_starts > 0) {
+        if (entry.max_failed_starts > 0 && session.failed_starts >= entry.max_failed_starts) {
+            message(session, "failed to start " + std::to_string(session.failed_starts) + " times in a row, giving up");
+            return;
+        }
+        uint64_t ceiling = std::max(entry.max_restart_delay_ms, SUPERVISOR_FAILED_START_DELAY_MS);
+        uint64_t backoff = uint64_t(SUPERVISOR_FAILED_START_DELAY_MS) << std::min<uint32_t>(session.failed_starts - 1, 20);
+        delay = std::max<uint32_t>(delay, static_cast<uint32_t>(std::min(backoff, ceiling)));
+    }
+    session.restart_at = std::max<ULONGLONG>(now + delay, 1);
+    message(session, "exited with code " + std::to_string(code) + ", restarting in " + std::to_string(delay) + " ms");
+}
+
+bool Supervisor::finished() const {
+    for (const auto& session : m_sessions) {
+        if (session->running || session->restart_at != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Supervisor::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+        m_exited.clear();
+    }
+    for (auto& session : m_sessions) {
+        session->tty.stop();
+        if (session->running) {
+            flush_line(*session);
+            session->running = false;
+        }
+        session->restart_at = 0;
+        session->log.close();
+    }
+}
+
+int Supervisor::exit_code() const {
+    for (const auto& session : m_sessions) {
+        if (session->exit_code != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void Supervisor::on_output(Session& session, const uint8_t* data, size_t length) {
+    if (session.log.is_open()) {
+        session.log.write(data, length);    // The sink strips escapes itself when plain
+        return;
+    }
+
+    if (session.entry.plain) {
+        session.stripped.resize(length);
+        length = session.stripper.filter(data, length, session.stripped.data());
+        data = session.stripped.data();
+    }
+
+    // Collect every completed line of this read and pass them on in one call
+    const std::string& prefix = session.entry.prefix;
+    session.out.clear();
+    size_t start = 0;
+    while (start < length) {
+        const void* newline = std::memchr(data + start, '\n', length - start);
+        size_t end = newline ? static_cast<size_t>(static_cast<const uint8_t*>(newline) - data) + 1 : length;
+        session.line.append(reinterpret_cast<const char*>(data + start), end - start);
+        start = end;
+
+        if (newline) {
+            session.out += prefix;
+            session.out += session.line;
+            session.line.clear();
+        } else if (session.line.size() >= SUPERVISOR_LINE_LIMIT) {
+            session.out += prefix;
+            session.out += session.line;
+            session.out += "\r\n";
+            session.line.clear();
+        }
+    }
+    if (!session.out.empty()) {
+        emit(session.out);
+    }
+}
+
+void Supervisor::flush_line(Session& session) {
+    if (!session.line.empty()) {
+        emit(session.entry.prefix + session.line + "\r\n");
+        session.line.clear();
+    }
+}
+
+void Supervisor::emit(const std::string& text) {
+    if (!m_output) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_output_mutex);
+    m_output(reinterpret_cast<const uint8_t*>(text.data()), text.size());
+}
+
+void Supervisor::message(const Session& session, const std::string& text) {
+    emit("headless-tty: " + session.entry.name + " " + text + "\r\n");
+}
+
+} // namespace headless_tty
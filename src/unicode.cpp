@@ -0,0 +1,230 @@
+#include "headless_tty/unicode.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HEADLESS_TTY_SSE2 1
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+namespace headless_tty {
+
+namespace {
+
+#include "unicode_tables.inc"
+
+constexpr uint8_t PROP_WIDTH_MASK = 0x03;
+constexpr uint8_t PROP_BREAK_SHIFT = 2;
+constexpr uint8_t PROP_BREAK_MASK = 0x0F;
+constexpr uint8_t PROP_PICTOGRAPHIC = 0x40;
+constexpr char32_t REPLACEMENT_CHAR = 0xFFFD;
+
+inline uint8_t properties(char32_t cp) {
+    if (cp >= 0x110000) {
+        cp = REPLACEMENT_CHAR;
+    }
+    return UNICODE_STAGE2[UNICODE_STAGE1[cp >> UNICODE_BLOCK_SHIFT]][cp & 0xFF];
+}
+
+inline GraphemeBreak break_of(uint8_t props) {
+    return static_cast<GraphemeBreak>((props >> PROP_BREAK_SHIFT) & PROP_BREAK_MASK);
+}
+
+inline bool is_control(GraphemeBreak gb) {
+    return gb == GraphemeBreak::Control || gb == GraphemeBreak::CR || gb == GraphemeBreak::LF;
+}
+
+inline unsigned count_trailing_zeros(uint32_t value) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward(&index, value);
+    return index;
+#else
+    return static_cast<unsigned>(__builtin_ctz(value));
+#endif
+}
+
+// Decode one codepoint; malformed input yields U+FFFD and consumes one byte
+inline char32_t decode_utf8(const uint8_t* data, size_t length, size_t& i) {
+    uint8_t lead = data[i];
+    size_t need;
+    char32_t cp;
+    char32_t min;
+    if (lead < 0x80) {
+        ++i;
+        return lead;
+    } else if ((lead & 0xE0) == 0xC0) {
+        need = 1; cp = lead & 0x1F; min = 0x80;
+    } else if ((lead & 0xF0) == 0xE0) {
+        need = 2; cp = lead & 0x0F; min = 0x800;
+    } else if ((lead & 0xF8) == 0xF0) {
+        need = 3; cp = lead & 0x07; min = 0x10000;
+    } else {
+        ++i;
+        return REPLACEMENT_CHAR;
+    }
+
+    if (length - i <= need) {
+        ++i;
+        return REPLACEMENT_CHAR;
+    }
+    for (size_t k = 1; k <= need; ++k) {
+        uint8_t c = data[i + k];
+        if ((c & 0xC0) != 0x80) {
+            ++i;
+            return REPLACEMENT_CHAR;
+        }
+        cp = (cp << 6) | (c & 0x3F);
+    }
+    if (cp < min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) {
+        ++i;
+        return REPLACEMENT_CHAR;
+    }
+    i += need + 1;
+    return cp;
+}
+
+} // namespace
+
+int char_width(char32_t cp) {
+    if (cp >= 0x20 && cp < 0x7F) {
+        return 1;
+    }
+    return properties(cp) & PROP_WIDTH_MASK;
+}
+
+GraphemeBreak grapheme_break(char32_t cp) {
+    return break_of(properties(cp));
+}
+
+bool is_extended_pictographic(char32_t cp) {
+    return (properties(cp) & PROP_PICTOGRAPHIC) != 0;
+}
+
+void GraphemeSegmenter::reset() {
+    m_prev = GraphemeBreak::Other;
+    m_started = false;
+    m_ri_odd = false;
+    m_emoji = 0;
+}
+
+bool GraphemeSegmenter::next(char32_t cp) {
+    return advance(properties(cp));
+}
+
+bool GraphemeSegmenter::advance(uint8_t props) {
+    GraphemeBreak gb = break_of(props);
+    bool pictographic = (props & PROP_PICTOGRAPHIC) != 0;
+    GraphemeBreak prev = m_prev;
+
+    bool boundary;
+    if (!m_started) {
+        boundary = true;                                                        // GB1
+    } else if (prev == GraphemeBreak::CR && gb == GraphemeBreak::LF) {
+        boundary = false;                                                       // GB3
+    } else if (is_control(prev) || is_control(gb)) {
+        boundary = true;                                                        // GB4, GB5
+    } else if (prev == GraphemeBreak::L &&
+               (gb == GraphemeBreak::L || gb == GraphemeBreak::V || gb == GraphemeBreak::LV || gb == GraphemeBreak::LVT)) {
+        boundary = false;                                                       // GB6
+    } else if ((prev == GraphemeBreak::LV || prev == GraphemeBreak::V) &&
+               (gb == GraphemeBreak::V || gb == GraphemeBreak::T)) {
+        boundary = false;                                                       // GB7
+    } else if ((prev == GraphemeBreak::LVT || prev == GraphemeBreak::T) && gb == GraphemeBreak::T) {
+        boundary = false;                                                       // GB8
+    } else if (gb == GraphemeBreak::Extend || gb == GraphemeBreak::ZWJ || gb == GraphemeBreak::SpacingMark) {
+        boundary = false;                                                       // GB9, GB9a
+    } else if (prev == GraphemeBreak::Prepend) {
+        boundary = false;                                                       // GB9b
+    } else if (m_emoji == 2 && pictographic) {
+        boundary = false;                                                       // GB11
+    } else if (prev == GraphemeBreak::RegionalIndicator && gb == GraphemeBreak::RegionalIndicator) {
+        boundary = !m_ri_odd;                                                   // GB12, GB13
+    } else {
+        boundary = true;                                                        // GB999
+    }
+
+    if (pictographic) {
+        m_emoji = 1;
+    } else if (m_emoji == 1 && gb == GraphemeBreak::Extend) {
+        m_emoji = 1;
+    } else if (m_emoji == 1 && gb == GraphemeBreak::ZWJ) {
+        m_emoji = 2;
+    } else {
+        m_emoji = 0;
+    }
+    m_ri_odd = gb == GraphemeBreak::RegionalIndicator && !(prev == GraphemeBreak::RegionalIndicator && m_ri_odd);
+    m_prev = gb;
+    m_started = true;
+    return boundary;
+}
+
+size_t ascii_span(const uint8_t* data, size_t length) {
+    size_t i = 0;
+#ifdef HEADLESS_TTY_SSE2
+    // Printable ASCII is 0x20..0x7E; as signed bytes everything >= 0x80 is negative
+    const __m128i low = _mm_set1_epi8(0x1F);
+    const __m128i high = _mm_set1_epi8(0x7F);
+    for (; i + 32 <= length; i += 32) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 16));
+        __m128i okA = _mm_and_si128(_mm_cmpgt_epi8(a, low), _mm_cmplt_epi8(a, high));
+        __m128i okB = _mm_and_si128(_mm_cmpgt_epi8(b, low), _mm_cmplt_epi8(b, high));
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(okA)) |
+                        (static_cast<uint32_t>(_mm_movemask_epi8(okB)) << 16);
+        if (mask != 0xFFFFFFFFu) {
+            return i + count_trailing_zeros(~mask);
+        }
+    }
+    for (; i + 16 <= length; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i ok = _mm_and_si128(_mm_cmpgt_epi8(a, low), _mm_cmplt_epi8(a, high));
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(ok));
+        if (mask != 0xFFFFu) {
+            return i + count_trailing_zeros(~mask);
+        }
+    }
+#endif
+    while (i < length && data[i] >= 0x20 && data[i] < 0x7F) {
+        ++i;
+    }
+    return i;
+}
+
+size_t text_width(const uint8_t* data, size_t length) {
+    GraphemeSegmenter segmenter;
+    size_t width = 0;
+    bool narrowPictograph = false;      // Current cluster starts with a one-column ExtPict
+    size_t i = 0;
+
+    while (i < length) {
+        size_t span = data[i] >= 0x20 && data[i] < 0x7F ? ascii_span(data + i, length - i) : 0;
+        if (span > 0) {
+            // Every printable ASCII byte is its own cluster (property Other)
+            width += span;
+            i += span;
+            segmenter.reset();
+            segmenter.next(U'a');
+            narrowPictograph = false;
+            if (i == length) {
+                break;
+            }
+        }
+
+        char32_t cp = decode_utf8(data, length, i);
+        uint8_t props = properties(cp);
+        if (segmenter.advance(props)) {
+            int w = props & PROP_WIDTH_MASK;
+            width += static_cast<size_t>(w);
+            narrowPictograph = w == 1 && (props & PROP_PICTOGRAPHIC) != 0;
+        } else if (cp == VARIATION_SELECTOR_16 && narrowPictograph) {
+            ++width;
+            narrowPictograph = false;
+        }
+    }
+    return width;
+}
+
+} // namespace headless_tty
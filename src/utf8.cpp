@@ -0,0 +1,278 @@
+#include "headless_tty/utf8.hpp"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HEADLESS_TTY_SSE2 1
+#endif
+
+namespace headless_tty {
+
+namespace {
+
+constexpr char32_t REPLACEMENT_CHAR = 0xFFFD;
+constexpr uint8_t REPLACEMENT_UTF8[3] = { 0xEF, 0xBF, 0xBD };
+
+enum class SeqStatus : uint8_t {
+    Valid,
+    Invalid,        // length is the maximal ill-formed subpart (replaced by one U+FFFD)
+    Truncated       // Well-formed so far, but the input ends before the codepoint does
+};
+
+struct Seq {
+    SeqStatus status;
+    uint8_t length;
+    char32_t cp;
+};
+
+// Decode the sequence at data[0] following Table 3-7 of the Unicode standard
+inline Seq decode(const uint8_t* data, size_t available) {
+    uint8_t lead = data[0];
+    if (lead < 0x80) {
+        return { SeqStatus::Valid, 1, lead };
+    }
+
+    uint8_t need;
+    uint8_t low = 0x80;     // Allowed range of the second byte
+    uint8_t high = 0xBF;
+    char32_t cp;
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        need = 1;
+        cp = lead & 0x1F;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+        need = 2;
+        cp = lead & 0x0F;
+        if (lead == 0xE0) low = 0xA0;           // Overlong
+        if (lead == 0xED) high = 0x9F;          // Surrogates
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        need = 3;
+        cp = lead & 0x07;
+        if (lead == 0xF0) low = 0x90;           // Overlong
+        if (lead == 0xF4) high = 0x8F;          // Above U+10FFFF
+    } else {
+        return { SeqStatus::Invalid, 1, 0 };
+    }
+
+    for (uint8_t k = 1; k <= need; ++k) {
+        if (k >= available) {
+            return { SeqStatus::Truncated, k, 0 };
+        }
+        uint8_t c = data[k];
+        if (c < low || c > high) {
+            return { SeqStatus::Invalid, k, 0 };
+        }
+        low = 0x80;
+        high = 0xBF;
+        cp = (cp << 6) | (c & 0x3F);
+    }
+    return { SeqStatus::Valid, static_cast<uint8_t>(need + 1), cp };
+}
+
+#ifdef HEADLESS_TTY_SSE2
+inline bool ascii16(const uint8_t* data) {
+    return _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data))) == 0;
+}
+#endif
+
+} // namespace
+
+size_t utf8_valid_prefix(const uint8_t* data, size_t length) {
+    size_t i = 0;
+    while (i < length) {
+#ifdef HEADLESS_TTY_SSE2
+        while (i + 16 <= length && ascii16(data + i)) {
+            i += 16;
+        }
+        if (i == length) {
+            break;
+        }
+#endif
+        if (data[i] < 0x80) {
+            ++i;
+            continue;
+        }
+        Seq seq = decode(data + i, length - i);
+        if (seq.status != SeqStatus::Valid) {
+            return i;
+        }
+        i += seq.length;
+    }
+    return length;
+}
+
+size_t utf8_incomplete_tail(const uint8_t* data, size_t length) {
+    for (size_t k = 1; k <= 3 && k <= length; ++k) {
+        const uint8_t* start = data + length - k;
+        if ((*start & 0xC0) != 0x80) {
+            return decode(start, k).status == SeqStatus::Truncated ? k : 0;
+        }
+    }
+    return 0;
+}
+
+size_t utf8_to_utf16(const uint8_t* data, size_t length, char16_t* out) {
+    char16_t* start = out;
+    size_t i = 0;
+    while (i < length) {
+#ifdef HEADLESS_TTY_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        while (i + 16 <= length) {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            if (_mm_movemask_epi8(bytes) != 0) {
+                break;
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_unpacklo_epi8(bytes, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 8), _mm_unpackhi_epi8(bytes, zero));
+            out += 16;
+            i += 16;
+        }
+        if (i == length) {
+            break;
+        }
+#endif
+        if (data[i] < 0x80) {
+            *out++ = data[i++];
+            continue;
+        }
+
+        Seq seq = decode(data + i, length - i);
+        i += seq.length;
+        if (seq.status != SeqStatus::Valid) {
+            *out++ = static_cast<char16_t>(REPLACEMENT_CHAR);
+        } else if (seq.cp < 0x10000) {
+            *out++ = static_cast<char16_t>(seq.cp);
+        } else {
+            char32_t v = seq.cp - 0x10000;
+            *out++ = static_cast<char16_t>(0xD800 + (v >> 10));
+            *out++ = static_cast<char16_t>(0xDC00 + (v & 0x3FF));
+        }
+    }
+    return static_cast<size_t>(out - start);
+}
+
+size_t utf8_to_utf32(const uint8_t* data, size_t length, char32_t* out) {
+    char32_t* start = out;
+    size_t i = 0;
+    while (i < length) {
+#ifdef HEADLESS_TTY_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        while (i + 16 <= length) {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            if (_mm_movemask_epi8(bytes) != 0) {
+                break;
+            }
+            __m128i low = _mm_unpacklo_epi8(bytes, zero);
+            __m128i high = _mm_unpackhi_epi8(bytes, zero);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_unpacklo_epi16(low, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4), _mm_unpackhi_epi16(low, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 8), _mm_unpacklo_epi16(high, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 12), _mm_unpackhi_epi16(high, zero));
+            out += 16;
+            i += 16;
+        }
+        if (i == length) {
+            break;
+        }
+#endif
+        if (data[i] < 0x80) {
+            *out++ = data[i++];
+            continue;
+        }
+
+        Seq seq = decode(data + i, length - i);
+        i += seq.length;
+        *out++ = seq.status == SeqStatus::Valid ? seq.cp : REPLACEMENT_CHAR;
+    }
+    return static_cast<size_t>(out - start);
+}
+
+std::wstring utf8_to_wstring(const char* data, size_t length) {
+    // One pass into a buffer of the worst-case size, then trim
+    std::wstring result(length, L'\0');
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+    size_t units;
+    if constexpr (sizeof(wchar_t) == sizeof(char16_t)) {
+        units = utf8_to_utf16(bytes, length, reinterpret_cast<char16_t*>(&result[0]));
+    } else {
+        units = utf8_to_utf32(bytes, length, reinterpret_cast<char32_t*>(&result[0]));
+    }
+    result.resize(units);
+    return result;
+}
+
+void Utf8Stream::emit(const uint8_t* data, size_t length, const OutputCallback& sink) const {
+    if (length > 0 && sink) {
+        sink(data, length);
+    }
+}
+
+void Utf8Stream::feed(const uint8_t* data, size_t length, const OutputCallback& sink) {
+    if (m_mode == Utf8Mode::Raw) {
+        emit(data, length, sink);
+        return;
+    }
+
+    size_t i = 0;
+    if (m_pending_length > 0) {
+        // Finish the codepoint held back from the previous read
+        uint8_t joined[4];
+        std::memcpy(joined, m_pending, m_pending_length);
+        size_t take = std::min<size_t>(4 - m_pending_length, length);
+        std::memcpy(joined + m_pending_length, data, take);
+        size_t available = m_pending_length + take;
+
+        Seq seq = decode(joined, available);
+        if (seq.status == SeqStatus::Truncated) {
+            std::memcpy(m_pending, joined, available);      // Still incomplete; all of data was used
+            m_pending_length = static_cast<uint8_t>(available);
+            return;
+        }
+
+        if (seq.status == SeqStatus::Valid || m_mode == Utf8Mode::Whole) {
+            emit(joined, seq.length, sink);
+        } else {
+            emit(REPLACEMENT_UTF8, sizeof(REPLACEMENT_UTF8), sink);
+        }
+        // The pending bytes were a well-formed prefix, so the sequence ends inside data
+        i = seq.length - m_pending_length;
+        m_pending_length = 0;
+    }
+
+    const uint8_t* rest = data + i;
+    size_t restLength = length - i;
+    size_t tail = utf8_incomplete_tail(rest, restLength);
+    size_t body = restLength - tail;
+
+    if (m_mode == Utf8Mode::Whole) {
+        emit(rest, body, sink);
+    } else {
+        size_t j = 0;
+        while (j < body) {
+            size_t valid = utf8_valid_prefix(rest + j, body - j);
+            emit(rest + j, valid, sink);
+            j += valid;
+            if (j < body) {
+                emit(REPLACEMENT_UTF8, sizeof(REPLACEMENT_UTF8), sink);
+                j += decode(rest + j, body - j).length;
+            }
+        }
+    }
+
+    std::memcpy(m_pending, rest + body, tail);
+    m_pending_length = static_cast<uint8_t>(tail);
+}
+
+void Utf8Stream::flush(const OutputCallback& sink) {
+    if (m_pending_length == 0) {
+        return;
+    }
+    if (m_mode == Utf8Mode::Repair) {
+        emit(REPLACEMENT_UTF8, sizeof(REPLACEMENT_UTF8), sink);
+    } else {
+        emit(m_pending, m_pending_length, sink);
+    }
+    m_pending_length = 0;
+}
+
+} // namespace headless_tty
@@ -0,0 +1,18 @@
+#include "headless_tty/vt_strip.hpp"
+
+namespace headless_tty {
+
+size_t EscapeStripper::filter(const uint8_t* in, size_t length, uint8_t* out) {
+    size_t written = 0;
+
+    for (size_t i = 0; i < length; ++i) {
+        uint8_t c = in[i];
+        if (accept(c)) {
+            out[written++] = c;
+        }
+    }
+
+    return written;
+}
+
+} // namespace headless_tty
@@ -0,0 +1,29 @@
+#pragma once
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <windows.h>
+#include <string>
+#include <sstream>
+
+namespace headless_tty {
+
+// Format GetLastError() as "<prefix>: <system message> (error N)"
+inline std::string format_win_error(const std::string& prefix) {
+    DWORD error = GetLastError();
+    LPSTR messageBuffer = nullptr;
+    size_t size = FormatMessageA(
+        FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS,
+        NULL, error, MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT),
+        (LPSTR)&messageBuffer, 0, NULL);
+
+    std::stringstream ss;
+    ss << prefix << ": " << std::string(messageBuffer, size) << " (error " << error << ")";
+    LocalFree(messageBuffer);
+
+    return ss.str();
+}
+
+} // namespace headless_tty
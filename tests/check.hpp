@@ -0,0 +1,45 @@
+#pragma once
+
+// Checks shared by the tests in tests/. CHECK records a failure and carries on, so one
+// run reports every broken expectation; main() returns check_result().
+
+#include <cstdio>
+#include <string>
+
+namespace headless_tty_test {
+
+inline int& failures() {
+    static int count = 0;
+    return count;
+}
+
+inline void check(bool ok, const char* expr, const char* file, int line) {
+    if (!ok) {
+        std::printf("%s:%d: CHECK(%s) failed\n", file, line, expr);
+        ++failures();
+    }
+}
+
+inline void check_equal(const std::string& actual, const std::string& expected, const char* expr,
+                        const char* file, int line) {
+    if (actual != expected) {
+        std::printf("%s:%d: %s\n  got      \"%s\"\n  expected \"%s\"\n", file, line, expr, actual.c_str(),
+                    expected.c_str());
+        ++failures();
+    }
+}
+
+inline int check_result(const char* name) {
+    if (failures() == 0) {
+        std::printf("%s: all checks passed\n", name);
+        return 0;
+    }
+    std::printf("%s: %d check(s) failed\n", name, failures());
+    return 1;
+}
+
+} // namespace headless_tty_test
+
+#define CHECK(expr) headless_tty_test::check(static_cast<bool>(expr), #expr, __FILE__, __LINE__)
+#define CHECK_EQ(actual, expected) \
+    headless_tty_test::check_equal((actual), (expected), #actual " == " #expected, __FILE__, __LINE__)
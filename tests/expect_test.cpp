@@ -0,0 +1,198 @@
+/*
+expect_test - Expecter and ExpectScript against canned transcripts, no child process
+
+    cmake -S . -B build -DHEADLESS_TTY_TESTS=ON
+    cmake --build build && ctest --test-dir build -C Debug
+
+Transcripts are fed the way the read thread would: in arbitrary chunks, before or while
+expect() waits. Also covers the ways a wait ends other than a match (timeout, end of
+output, cancel) and the script checks that keep a rules step from running forever.
+ */
+
+#include "headless_tty/expect_script.hpp"
+#include "check.hpp"
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace headless_tty;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+const std::string LOGIN_TRANSCRIPT =
+    "Welcome to host01\r\n"
+    "\x1b[1mlogin:\x1b[0m admin\r\n"
+    "Password: \r\n"
+    "Last login: Tue from 10.0.0.7\r\n"
+    "\x1b]0;admin@host01\x07" "admin@host01:~$ ";
+
+void feed(Expecter& expecter, const std::string& text) {
+    expecter.feed(reinterpret_cast<const uint8_t*>(text.data()), text.size());
+}
+
+// Every split of the transcript into two reads finds the same match
+void split_reads() {
+    for (size_t split = 0; split <= LOGIN_TRANSCRIPT.size(); ++split) {
+        Expecter expecter;
+        feed(expecter, LOGIN_TRANSCRIPT.substr(0, split));
+        feed(expecter, LOGIN_TRANSCRIPT.substr(split));
+        ExpectResult result = expecter.expect({ "Password: " }, 0);
+        CHECK(result.index == 0);
+        CHECK_EQ(result.output, "Welcome to host01\r\n\x1b[1mlogin:\x1b[0m admin\r\nPassword: ");
+    }
+}
+
+// The earliest match wins; of patterns ending at the same byte, the lowest index
+void earliest_match() {
+    Expecter expecter;
+    feed(expecter, "ushers");
+    ExpectResult result = expecter.expect({ "hers", "she", "he" }, 0);
+    CHECK(result.index == 1);
+    CHECK_EQ(result.output, "ushe");
+
+    feed(expecter, "ushers");
+    result = expecter.expect({ "he", "she" }, 0);
+    CHECK(result.index == 0);
+}
+
+// Consecutive expect() calls walk through the transcript without losing output
+void retained_between_calls() {
+    Expecter expecter;
+    feed(expecter, LOGIN_TRANSCRIPT);
+    CHECK(expecter.expect({ "login:" }, 0).index == 0);
+    CHECK(expecter.expect({ "Password: " }, 0).index == 0);
+    ExpectResult result = expecter.expect({ "$ ", "# " }, 0);
+    CHECK(result.index == 0);
+    CHECK_EQ(result.output, "\r\nLast login: Tue from 10.0.0.7\r\n\x1b]0;admin@host01\x07" "admin@host01:~$ ");
+    CHECK(expecter.expect({ "login:" }, 0).index == EXPECT_TIMEOUT);
+}
+
+void ignore_escapes() {
+    Expecter expecter;
+    feed(expecter, LOGIN_TRANSCRIPT);
+    CHECK(expecter.expect({ "login: admin" }, 0).index == EXPECT_TIMEOUT);
+
+    ExpectOptions options;
+    options.ignore_escapes = true;
+    CHECK(expecter.expect({ "login: admin" }, 0, options).index == 0);
+
+    // The window title is an escape sequence, so only the prompt itself matches
+    ExpectResult result = expecter.expect({ "admin@host01:~$ " }, 0, options);
+    CHECK(result.index == 0);
+    CHECK(result.output.find("Last login") != std::string::npos);
+}
+
+// Output that arrives while expect() waits is matched as it comes in
+void live_transcript() {
+    Expecter expecter;
+    std::thread reader([&expecter] {
+        for (size_t i = 0; i < LOGIN_TRANSCRIPT.size(); i += 7) {
+            feed(expecter, LOGIN_TRANSCRIPT.substr(i, 7));
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        expecter.close();
+    });
+
+    CHECK(expecter.expect({ "login:" }, 5000).index == 0);
+    CHECK(expecter.expect({ "Password: " }, 5000).index == 0);
+    CHECK(expecter.expect({ "$ " }, 5000).index == 0);
+    CHECK(expecter.expect({ "$ " }, 5000).index == EXPECT_EOF);
+    reader.join();
+}
+
+void timeout_and_errors() {
+    Expecter expecter;
+    feed(expecter, "no prompt here");
+    Clock::time_point start = Clock::now();
+    CHECK(expecter.expect({ "$ " }, 50).index == EXPECT_TIMEOUT);
+    CHECK(Clock::now() - start >= std::chrono::milliseconds(50));
+
+    CHECK(expecter.expect({}, 0).index == EXPECT_ERROR);
+    CHECK(expecter.expect({ "ok", "" }, 0).index == EXPECT_ERROR);
+}
+
+// The output returned with a match is bounded by the window, however much came before it
+void bounded_output() {
+    Expecter expecter;
+    std::string noise(3 * EXPECT_WINDOW_SIZE + 123, 'x');
+    feed(expecter, noise);
+    feed(expecter, "$ ");
+    ExpectResult result = expecter.expect({ "$ " }, 0);
+    CHECK(result.index == 0);
+    CHECK(result.output.size() <= EXPECT_WINDOW_SIZE);
+    CHECK(result.output.size() > 2 && result.output.substr(result.output.size() - 2) == "$ ");
+}
+
+// cancel() ends a wait that no output would ever end, and later calls until reset()
+void cancel() {
+    Expecter expecter;
+    std::thread canceller([&expecter] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        expecter.cancel();
+    });
+    Clock::time_point start = Clock::now();
+    CHECK(expecter.expect({ "never" }, 0xFFFFFFFF).index == EXPECT_CANCELLED);
+    CHECK(Clock::now() - start < std::chrono::seconds(5));
+    canceller.join();
+
+    feed(expecter, "never");
+    CHECK(expecter.expect({ "never" }, 0).index == EXPECT_CANCELLED);
+
+    expecter.reset();
+    feed(expecter, "now");
+    CHECK(expecter.expect({ "now" }, 0).index == 0);
+}
+
+void close_wakes_waiter() {
+    Expecter expecter;
+    std::thread closer([&expecter] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        expecter.close();
+    });
+    CHECK(expecter.expect({ "never" }, 0xFFFFFFFF).index == EXPECT_EOF);
+    closer.join();
+}
+
+std::string parse_error(const std::string& text) {
+    ExpectScript script;
+    return script.parse(text) ? std::string() : script.get_last_error();
+}
+
+void script_parse() {
+    CHECK_EQ(parse_error("timeout 5000\n"
+                         "expect \"login:\"\n"
+                         "sendline \"admin\"\n"
+                         "rule \"Password:\" \"hunter2\\r\"\n"
+                         "rule \"$ \" final\n"
+                         "rules 30000\n"
+                         "wait-exit 2000\n"),
+             "");
+
+    // Without a final rule the rules step could only end in a failure, or never
+    CHECK_EQ(parse_error("rule \"y/n\" \"y\\r\"\nrules\n"), "line 2: rules needs a final rule to finish");
+    CHECK_EQ(parse_error("rules\n"), "line 1: rules needs a final rule to finish");
+    CHECK_EQ(parse_error("rule \"$ \" final\nrules\nrule \"y/n\" \"y\\r\"\nrules\n"),
+             "line 4: rules needs a final rule to finish");
+    CHECK_EQ(parse_error("rule \"$ \" final\nrules soon\n"), "line 2: rules expects an optional number of milliseconds");
+    CHECK_EQ(parse_error("expect \"unterminated\n"), "line 1: unterminated string");
+    CHECK_EQ(parse_error("send \"\\xZZ\"\n"), "line 1: bad \\x escape");
+}
+
+} // namespace
+
+int main() {
+    split_reads();
+    earliest_match();
+    retained_between_calls();
+    ignore_escapes();
+    live_transcript();
+    timeout_and_errors();
+    bounded_output();
+    cancel();
+    close_wakes_waiter();
+    script_parse();
+    return headless_tty_test::check_result("expect_test");
+}
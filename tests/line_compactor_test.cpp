@@ -0,0 +1,81 @@
+/*
+line_compactor_test - LineCompactor output for in-place rewrites
+
+    cmake -S . -B build -DHEADLESS_TTY_TESTS=ON
+    cmake --build build && ctest --test-dir build -C Debug
+
+Each case feeds a chunk of output (whole and one byte at a time) and compares the
+emitted text, flush included.
+ */
+
+#include "headless_tty/line_compactor.hpp"
+#include "check.hpp"
+
+#include <string>
+
+using namespace headless_tty;
+
+namespace {
+
+std::string compact(const std::string& text, bool bytewise = false) {
+    LineCompactor compactor;
+    std::string out;
+    OutputCallback sink = [&out](const uint8_t* data, size_t length) {
+        out.append(reinterpret_cast<const char*>(data), length);
+    };
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(text.data());
+    if (bytewise) {
+        for (size_t i = 0; i < text.size(); ++i) {
+            compactor.feed(data + i, 1, sink);
+        }
+    } else {
+        compactor.feed(data, text.size(), sink);
+    }
+    compactor.flush(sink);
+    return out;
+}
+
+void check_compact(const std::string& text, const std::string& expected) {
+    CHECK_EQ(compact(text), expected);
+    CHECK_EQ(compact(text, true), expected);
+}
+
+void plain_and_carriage_return() {
+    check_compact("one\r\ntwo\r\n", "one\r\ntwo\r\n");
+    check_compact("  0%\r 50%\r100%\r\ndone", "100%\r\ndone\r\n");
+    check_compact("abc\b\bX\r\n", "aXc\r\n");
+    check_compact("tail   \r\n", "tail\r\n");
+}
+
+// A block redrawn with cursor up keeps only its last frame
+void block_redraw() {
+    check_compact("a\r\nb\r\n"
+                  "\x1b[2AA 10%\r\nB 10%\r\n"
+                  "\x1b[2AA 90%\r\nB 90%\r\n"
+                  "\x1b[2A\x1b[KA done\r\n\x1b[KB done\r\nend\r\n",
+                  "a\r\nb\r\nA done\r\nB done\r\nend\r\n");
+}
+
+// Moves above lines that were already emitted must not overwrite the open line
+void up_past_emitted_lines() {
+    check_compact("\x1b[1;1Hfirst\x1b[2;1Hsecond\x1b[1;1HFIRST\r\n", "first\r\nsecond\r\nFIRST\r\n");
+    check_compact("line1\r\nline2\r\nline3\x1b[2;1H\x1b[KLINE2\x1b[3;6H\r\n",
+                  "line1\r\nline2\r\nline3\r\nLINE2\r\n");
+    check_compact("one\r\ntwo\x1bMup\r\n", "one\r\ntwo\r\n   up\r\n");
+    check_compact("one\r\ntwo\r\n\x1b[Fback\r\n", "one\r\ntwo\r\nback\r\n");
+}
+
+void escapes_dropped() {
+    check_compact("\x1b[31mred\x1b[0m \x1b]0;title\x07text\r\n", "red text\r\n");
+    check_compact("\xe4\xb8\xad\xe6\x96\x87\r\n", "\xe4\xb8\xad\xe6\x96\x87\r\n");
+}
+
+} // namespace
+
+int main() {
+    plain_and_carriage_return();
+    block_redraw();
+    up_past_emitted_lines();
+    escapes_dropped();
+    return headless_tty_test::check_result("line_compactor_test");
+}
@@ -0,0 +1,115 @@
+/*
+line_editor_test - LineEditor echo and committed lines for ASCII, wide and combining text
+ */
+
+#include "headless_tty/line_editor.hpp"
+#include "check.hpp"
+
+#include <string>
+#include <vector>
+
+using namespace headless_tty;
+
+namespace {
+
+struct Result {
+    std::string echo;
+    std::string committed;
+};
+
+std::vector<EditEvent> chars(const std::u32string& text) {
+    std::vector<EditEvent> events;
+    for (char32_t cp : text) {
+        events.push_back(EditEvent{ EditKey::Char, cp });
+    }
+    return events;
+}
+
+EditEvent key(EditKey k) {
+    return EditEvent{ k, 0 };
+}
+
+Result run(LineEditor& editor, const std::vector<EditEvent>& events) {
+    Result result;
+    editor.process(events.data(), events.size(), result.echo, result.committed);
+    return result;
+}
+
+void ascii_editing() {
+    LineEditor editor;
+    Result r = run(editor, chars(U"helo"));
+    CHECK_EQ(r.echo, "helo");
+    CHECK(editor.cursor() == 4);
+
+    r = run(editor, { key(EditKey::Left), EditEvent{ EditKey::Char, U'l' } });
+    CHECK_EQ(r.echo, "\x1b[1Dlo\x1b[1D");
+    CHECK_EQ(editor.line(), "hello");
+
+    r = run(editor, { key(EditKey::Home), key(EditKey::Delete), key(EditKey::End), key(EditKey::Backspace) });
+    CHECK_EQ(r.echo, "\x1b[4Dello \x1b[5D\x1b[4C\x1b[1D \x1b[1D");
+    CHECK_EQ(editor.line(), "ell");
+
+    r = run(editor, { key(EditKey::Enter) });
+    CHECK_EQ(r.echo, "\r\n");
+    CHECK_EQ(r.committed, "ell\r\n");
+    CHECK(editor.line().empty() && editor.cursor() == 0);
+}
+
+// U+4E2D and U+6587 take two columns each
+void wide_characters() {
+    LineEditor editor;
+    run(editor, chars(U"a\u4E2D\u6587b"));
+
+    Result r = run(editor, { key(EditKey::Left), key(EditKey::Left) });
+    CHECK_EQ(r.echo, "\x1b[1D\x1b[2D");
+    CHECK(editor.cursor() == 4);
+
+    r = run(editor, { key(EditKey::Right) });
+    CHECK_EQ(r.echo, "\x1b[2C");
+
+    r = run(editor, { key(EditKey::Backspace) });
+    CHECK_EQ(r.echo, "\x1b[2Db  \x1b[3D");
+    CHECK_EQ(editor.line(), "a\xe4\xb8\xad" "b");
+
+    r = run(editor, { key(EditKey::Home) });
+    CHECK_EQ(r.echo, "\x1b[3D");
+    r = run(editor, { key(EditKey::End) });
+    CHECK_EQ(r.echo, "\x1b[4C");
+}
+
+// e + U+0301 is one cluster, one column
+void combining_marks() {
+    LineEditor editor;
+    run(editor, chars(U"ce\u0301x"));
+
+    Result r = run(editor, { key(EditKey::Left), key(EditKey::Left) });
+    CHECK_EQ(r.echo, "\x1b[1D\x1b[1D");
+    CHECK(editor.cursor() == 1);
+
+    r = run(editor, { key(EditKey::Delete) });
+    CHECK_EQ(r.echo, "x \x1b[2D");
+    CHECK_EQ(editor.line(), "cx");
+
+    r = run(editor, { key(EditKey::End), key(EditKey::Enter) });
+    CHECK_EQ(r.committed, "cx\r\n");
+}
+
+// Characters typed in one batch are echoed as one run, with one redraw of the tail
+void batched_insert() {
+    LineEditor editor;
+    run(editor, chars(U"ad"));
+    run(editor, { key(EditKey::Left) });
+    Result r = run(editor, chars(U"bc"));
+    CHECK_EQ(r.echo, "bcd\x1b[1D");
+    CHECK_EQ(editor.line(), "abcd");
+}
+
+} // namespace
+
+int main() {
+    ascii_editing();
+    wide_characters();
+    combining_marks();
+    batched_insert();
+    return headless_tty_test::check_result("line_editor_test");
+}
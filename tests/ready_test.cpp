@@ -0,0 +1,207 @@
+/*
+ready_test - ReadyWaiter's quiet, prompt, cursor-stable and mode detectors, no child process
+
+    cmake -S . -B build -DHEADLESS_TTY_TESTS=ON
+    cmake --build build && ctest --test-dir build -C Debug
+
+Output and cursor moves are fed from a second thread the way the read thread would.
+Lower time bounds are checked exactly; upper bounds only loosely, so a loaded machine
+doesn't fail the run.
+ */
+
+#include "headless_tty/ready.hpp"
+#include "check.hpp"
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+using namespace headless_tty;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+const uint32_t FOREVER = 0xFFFFFFFF;
+
+void feed(ReadyWaiter& waiter, const std::string& text) {
+    waiter.feed(reinterpret_cast<const uint8_t*>(text.data()), text.size());
+}
+
+double elapsed_ms(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+ReadyOptions prompt_options(const std::string& prompt) {
+    ReadyOptions options;
+    options.prompts = { prompt };
+    return options;
+}
+
+// Quiet holds only once output has stopped for quiet_ms
+void quiet() {
+    ReadyWaiter waiter;
+    ReadyOptions options;
+    options.quiet_ms = 30;
+
+    std::thread reader([&waiter] {
+        for (int i = 0; i < 20; ++i) {
+            feed(waiter, "building module " + std::to_string(i) + "\r\n");
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    });
+    Clock::time_point start = Clock::now();
+    CHECK(waiter.wait(options, FOREVER) == ReadyEvent::Quiet);
+    double waited = elapsed_ms(start);
+    reader.join();
+    CHECK(waited >= 90 + 30);
+    CHECK(waited < 5000);
+}
+
+// With after_input, output from before the last write() doesn't count
+void after_input() {
+    ReadyWaiter waiter;
+    ReadyOptions options;
+    options.quiet_ms = 10;
+    feed(waiter, "C:\\> ");
+    waiter.mark_input();
+
+    Clock::time_point start = Clock::now();
+    CHECK(waiter.wait(options, 50) == ReadyEvent::Timeout);
+    CHECK(elapsed_ms(start) >= 50);
+
+    options.after_input = false;
+    CHECK(waiter.wait(options, 1000) == ReadyEvent::Quiet);
+
+    options = prompt_options(">");
+    CHECK(waiter.wait(options, 0) == ReadyEvent::Timeout);
+    feed(waiter, "dir\r\n volume in drive C\r\nC:\\> ");
+    CHECK(waiter.wait(options, 0) == ReadyEvent::Prompt);
+}
+
+void prompt() {
+    ReadyWaiter waiter;
+    ReadyOptions options = prompt_options("$");
+
+    // Trailing spaces and escape sequences around the prompt are ignored
+    feed(waiter, "\x1b]0;user@host\x07\x1b[32muser@host\x1b[0m:~");
+    CHECK(waiter.wait(options, 0) == ReadyEvent::Timeout);
+    feed(waiter, "\x1b[1m$\x1b[0m   ");
+    CHECK(waiter.wait(options, 0) == ReadyEvent::Prompt);
+
+    // Only the current line counts
+    feed(waiter, "pwd\r\n/home/user\r\n");
+    CHECK(waiter.wait(options, 0) == ReadyEvent::Timeout);
+
+    // Any of several prompts, split across reads
+    options.prompts = { ">>>", "(Pdb)" };
+    feed(waiter, "Python 3.12\r\n>");
+    CHECK(waiter.wait(options, 0) == ReadyEvent::Timeout);
+    feed(waiter, ">> ");
+    CHECK(waiter.wait(options, 0) == ReadyEvent::Prompt);
+    feed(waiter, "breakpoint()\r\n(Pd");
+    CHECK(waiter.wait(options, 0) == ReadyEvent::Timeout);
+    feed(waiter, "b) ");
+    CHECK(waiter.wait(options, 0) == ReadyEvent::Prompt);
+
+    // A prompt that arrives later wakes the waiter before its timeout
+    feed(waiter, "\r\n");
+    std::thread reader([&waiter] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        feed(waiter, "(Pdb) ");
+    });
+    Clock::time_point start = Clock::now();
+    CHECK(waiter.wait(options, 10000) == ReadyEvent::Prompt);
+    CHECK(elapsed_ms(start) < 5000);
+    reader.join();
+}
+
+// The cursor has to stay put for cursor_stable_ms; output that leaves it alone doesn't matter
+void cursor_stable() {
+    ReadyWaiter waiter;
+    ReadyOptions options;
+    options.cursor_stable_ms = 30;
+    CHECK(waiter.wait(options, 0) == ReadyEvent::Invalid);
+
+    feed(waiter, "loading");
+    waiter.note_cursor(7, 0);
+    std::thread reader([&waiter] {
+        for (uint16_t x = 8; x < 28; ++x) {
+            feed(waiter, ".");
+            waiter.note_cursor(x, 0);
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        // A clock redrawn in place keeps the output going, not the cursor
+        for (int i = 0; i < 20; ++i) {
+            feed(waiter, "\x1b[s\x1b[1;70H12:00:0" + std::to_string(i % 10) + "\x1b[u");
+            waiter.note_cursor(27, 0);
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    });
+    Clock::time_point start = Clock::now();
+    CHECK(waiter.wait(options, FOREVER) == ReadyEvent::CursorStable);
+    double waited = elapsed_ms(start);
+    reader.join();
+    CHECK(waited >= 90 + 30);
+    CHECK(waited < 5000);
+
+    // Quiet would not have held yet: the clock was still ticking
+    options.cursor_stable_ms = 0;
+    options.quiet_ms = 1000;
+    CHECK(waiter.wait(options, 0) == ReadyEvent::Timeout);
+}
+
+void modes() {
+    ReadyWaiter waiter;
+    ReadyOptions paste;
+    paste.modes = READY_BRACKETED_PASTE;
+    ReadyOptions keys;
+    keys.modes = READY_APP_CURSOR_KEYS;
+    ReadyOptions fullscreen;
+    fullscreen.modes = READY_ALT_SCREEN;
+
+    feed(waiter, "\x1b[?25l\x1b[?1;20");
+    CHECK(waiter.wait(paste, 0) == ReadyEvent::Timeout);
+    feed(waiter, "04h");
+    CHECK(waiter.wait(paste, 0) == ReadyEvent::Mode);
+    CHECK(waiter.wait(keys, 0) == ReadyEvent::Mode);
+    CHECK(waiter.wait(fullscreen, 0) == ReadyEvent::Timeout);
+
+    feed(waiter, "\x1b[?2004l\x1b[?1049h");
+    CHECK(waiter.wait(paste, 0) == ReadyEvent::Timeout);
+    CHECK(waiter.wait(keys, 0) == ReadyEvent::Mode);
+    CHECK(waiter.wait(fullscreen, 0) == ReadyEvent::Mode);
+
+    // Other sequences with the same numbers are not mode switches
+    waiter.reset();
+    feed(waiter, "\x1b[2004h\x1b[1h\x1b[?1049");
+    CHECK(waiter.wait(paste, 0) == ReadyEvent::Timeout);
+    CHECK(waiter.wait(keys, 0) == ReadyEvent::Timeout);
+    CHECK(waiter.wait(fullscreen, 0) == ReadyEvent::Timeout);
+}
+
+void exited_and_invalid() {
+    ReadyWaiter waiter;
+    ReadyOptions options = prompt_options("$");
+    std::thread closer([&waiter] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        feed(waiter, "bye\r\n");
+        waiter.close();
+    });
+    CHECK(waiter.wait(options, FOREVER) == ReadyEvent::Exited);
+    closer.join();
+
+    CHECK(waiter.wait(ReadyOptions(), 0) == ReadyEvent::Invalid);
+    CHECK(waiter.wait(prompt_options("  "), 0) == ReadyEvent::Invalid);
+}
+
+} // namespace
+
+int main() {
+    quiet();
+    after_input();
+    prompt();
+    cursor_stable();
+    modes();
+    exited_and_invalid();
+    return headless_tty_test::check_result("ready_test");
+}
@@ -0,0 +1,173 @@
+/*
+screen_arena_test - Screen copies and moves with per-screen arenas
+
+    cmake -S . -B build -DHEADLESS_TTY_TESTS=ON -DHEADLESS_TTY_SANITIZE=ON
+    cmake --build build && ctest --test-dir build -C Debug
+
+Meant to run under AddressSanitizer: a screen that keeps memory from an arena it no
+longer owns shows up as a use-after-free when the screens are destroyed. Arena screens
+are also checked against heap screens fed the same output.
+ */
+
+#include "headless_tty/screen.hpp"
+#include "check.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace headless_tty;
+
+namespace {
+
+void feed(Screen& screen, const std::string& text) {
+    screen.feed(reinterpret_cast<const uint8_t*>(text.data()), text.size());
+}
+
+// Scrollback and visible rows as text
+std::string dump(const Screen& screen) {
+    std::string out;
+    for (const Line& line : screen.scrollback()) {
+        for (const Cell& cell : line.cells) {
+            out += cell.ch < 128 ? static_cast<char>(cell.ch) : '?';
+        }
+        out += line.wrapped ? "\\\n" : "\n";
+    }
+    out += "--\n";
+    for (uint16_t y = 0; y < screen.size().rows; ++y) {
+        out += screen.line_text(y) + "\n";
+    }
+    return out;
+}
+
+std::string numbered_lines(int count) {
+    std::string out;
+    for (int i = 0; i < count; ++i) {
+        out += "line " + std::to_string(i) + " \x1b[31mred\x1b[0m\r\n";
+    }
+    return out;
+}
+
+void copy_and_move_sequence() {
+    Screen s(TerminalSize{ 40, 10 }, 200);
+    feed(s, numbered_lines(300));
+    std::string expected = dump(s);
+
+    Screen c(s);
+    Screen d;
+    d = c;
+    Screen e(std::move(c));
+    e = std::move(d);
+    CHECK_EQ(dump(e), expected);
+    CHECK(c.arena_stats().reserved_bytes == 0);
+    CHECK(d.arena_stats().reserved_bytes == 0);
+
+    // Moved-from screens can be assigned to and used again
+    c = s;
+    CHECK_EQ(dump(c), expected);
+    d = std::move(c);
+    feed(d, "more\r\n");
+    CHECK(d.line_text(d.cursor_y() - 1) == "more");
+}
+
+void destination_dies_first() {
+    Screen source(TerminalSize{ 40, 10 }, 200);
+    feed(source, numbered_lines(100));
+    std::string expected = dump(source);
+
+    auto moved = std::make_unique<Screen>(std::move(source));
+    CHECK_EQ(dump(*moved), expected);
+    auto assigned = std::make_unique<Screen>(TerminalSize{ 20, 5 }, 50);
+    *assigned = std::move(*moved);
+    moved.reset();
+    CHECK_EQ(dump(*assigned), expected);
+    assigned.reset();
+
+    // The moved-from screen is back in use once something is assigned to it
+    source = Screen(TerminalSize{ 40, 10 }, 200);
+    feed(source, numbered_lines(20));
+    CHECK(source.scrollback().size() > 0);
+}
+
+void self_move() {
+    Screen s(TerminalSize{ 40, 10 }, 200);
+    feed(s, numbered_lines(50));
+    std::string expected = dump(s);
+    Screen& alias = s;
+    s = std::move(alias);
+    CHECK_EQ(dump(s), expected);
+}
+
+// Random output, resizes, copies, moves and state round trips against a heap screen
+void matches_heap_screen() {
+    const char* pieces[] = { "hello world ", "\r\n", "\x1b[31mred\x1b[0m", "\x1b[2K", "\x1b[A",
+                             "\x1b[?1049h", "\x1b[?1049l", "\x1b[5;3H", "a long line that wraps more than once ",
+                             "\t", "\x1b[3J", "\x1b[2J", "\xe4\xb8\xad\xe6\x96\x87", "\x1b[L", "\x1b[M" };
+    std::srand(1);
+    Screen arena(TerminalSize{ 80, 24 }, 500, true);
+    Screen heap(TerminalSize{ 80, 24 }, 500, false);
+
+    for (int step = 1; step <= 400; ++step) {
+        std::string chunk;
+        for (int i = std::rand() % 200; i >= 0; --i) {
+            chunk += pieces[std::rand() % (sizeof(pieces) / sizeof(pieces[0]))];
+        }
+        feed(arena, chunk);
+        feed(heap, chunk);
+
+        if (step % 7 == 0) {
+            TerminalSize size{ static_cast<uint16_t>(20 + std::rand() % 120), static_cast<uint16_t>(5 + std::rand() % 40) };
+            arena.resize(size);
+            heap.resize(size);
+        }
+        if (step % 11 == 0) {
+            Screen copy(arena);
+            CHECK_EQ(dump(copy), dump(arena));
+            arena = std::move(copy);
+        }
+        if (step % 13 == 0) {
+            std::vector<uint8_t> state(arena.state_size());
+            arena.save_state(state.data());
+            Screen loaded(TerminalSize{ 3, 3 }, 500);
+            CHECK(loaded.load_state(state.data(), state.size()));
+            arena = std::move(loaded);
+        }
+        CHECK_EQ(dump(arena), dump(heap));
+    }
+    CHECK(arena.arena_stats().used_bytes > 0);
+    CHECK(heap.arena_stats().reserved_bytes == 0);
+}
+
+void every_size_class() {
+    SessionArena arena;
+    std::vector<std::pair<void*, size_t>> chunks;
+    for (size_t size = 1; size <= ARENA_MAX_POOLED + 64; size += (size < 512 ? 1 : 61)) {
+        void* p = arena.allocate(size);
+        std::memset(p, 0xAB, size);
+        chunks.emplace_back(p, size);
+    }
+    for (const auto& chunk : chunks) {
+        arena.deallocate(chunk.first, chunk.second);
+    }
+    CHECK(arena.get_stats().used_bytes == 0);
+
+    // Freed chunks are reused before another block is cut
+    size_t blocks = arena.get_stats().blocks;
+    for (const auto& chunk : chunks) {
+        arena.deallocate(arena.allocate(chunk.second), chunk.second);
+    }
+    CHECK(arena.get_stats().blocks == blocks);
+}
+
+} // namespace
+
+int main() {
+    copy_and_move_sequence();
+    destination_dies_first();
+    self_move();
+    matches_heap_screen();
+    every_size_class();
+    return headless_tty_test::check_result("screen_arena_test");
+}
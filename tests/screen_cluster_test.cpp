@@ -0,0 +1,168 @@
+/*
+screen_cluster_test - grapheme clusters of more than one codepoint in Screen, no child process
+
+    cmake -S . -B build -DHEADLESS_TTY_TESTS=ON
+    cmake --build build && ctest --test-dir build -C Debug
+
+Every codepoint of a cluster has to come back out of line_text(), snapshots, render_frame()
+and a save/load round trip, and VS16 has to widen a cell the way text_width() counts it.
+ */
+
+#include "headless_tty/screen.hpp"
+#include "headless_tty/frame_viewer.hpp"
+#include "headless_tty/unicode.hpp"
+#include "check.hpp"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace headless_tty;
+
+namespace {
+
+const std::string E_ACUTE = "e\xCC\x81";                                        // e U+0301
+const std::string FAMILY = "\xF0\x9F\x91\xA9\xE2\x80\x8D\xF0\x9F\x91\xA9\xE2\x80\x8D\xF0\x9F\x91\xA7";  // ZWJ sequence
+const std::string FLAG = "\xF0\x9F\x87\xAF\xF0\x9F\x87\xB5";                    // Regional indicators J P
+const std::string HEART = "\xE2\x9D\xA4";                                       // U+2764, one column on its own
+const std::string VS16 = "\xEF\xB8\x8F";
+
+void feed(Screen& screen, const std::string& text) {
+    screen.feed(reinterpret_cast<const uint8_t*>(text.data()), text.size());
+}
+
+size_t width(const std::string& text) {
+    return text_width(reinterpret_cast<const uint8_t*>(text.data()), text.size());
+}
+
+void all_codepoints_kept() {
+    Screen screen(TerminalSize{ 20, 3 }, 10);
+    std::string text = E_ACUTE + "x" + FAMILY + FLAG + "!";
+    feed(screen, text);
+    CHECK_EQ(screen.line_text(0), text);
+    CHECK(screen.cursor_x() == width(text));
+    CHECK(screen.codepoints(screen.cell(0, 0)).size() == 2);
+    CHECK(screen.codepoints(screen.cell(2, 0)).size() == 5);
+    CHECK(screen.cell(2, 0).width == 2 && screen.cell(3, 0).width == 0);
+    CHECK(screen.codepoints(screen.cell(4, 0)).size() == 2);
+
+    // Overwriting a cluster replaces all of it
+    feed(screen, "\x1b[1;1Hab");
+    CHECK_EQ(screen.line_text(0), "ab" + FAMILY + FLAG + "!");
+
+    // A control character ends the cluster; a mark after it has nothing to attach to
+    feed(screen, "\r\ne\r\xCC\x81");
+    CHECK_EQ(screen.line_text(1), "e");
+}
+
+void variation_selector_widens() {
+    Screen screen(TerminalSize{ 10, 3 }, 10);
+    feed(screen, HEART + "a");
+    CHECK(screen.cell(0, 0).width == 1);
+    CHECK(screen.cursor_x() == width(HEART + "a"));
+
+    feed(screen, "\r\n" + HEART + VS16 + "a");
+    CHECK(screen.cell(0, 1).width == 2 && screen.cell(1, 1).width == 0);
+    CHECK(screen.cursor_x() == width(HEART + VS16 + "a"));
+    CHECK_EQ(screen.line_text(1), HEART + VS16 + "a");
+
+    // Already wide: VS16 changes nothing
+    std::string grin = "\xF0\x9F\x98\x80";
+    feed(screen, "\r\n" + grin + VS16 + "a");
+    CHECK(screen.cursor_x() == 3 && screen.cursor_x() == width(grin + VS16 + "a"));
+
+    // In the last column the widened character moves to the next line like any wide one
+    Screen narrow(TerminalSize{ 4, 3 }, 10);
+    feed(narrow, "abc" + HEART + VS16 + "d");
+    CHECK_EQ(narrow.line_text(0), "abc");
+    CHECK(narrow.line(0).wrapped);
+    CHECK_EQ(narrow.line_text(1), HEART + VS16 + "d");
+    CHECK(narrow.cursor_x() == 3 && narrow.cursor_y() == 1);
+}
+
+void frames_and_rendering() {
+    Screen screen(TerminalSize{ 12, 2 }, 10);
+    feed(screen, FAMILY + " " + E_ACUTE + E_ACUTE);
+
+    ScreenFrame frame;
+    screen.snapshot(frame);
+    CHECK(cell_codepoints(frame.cells[0], frame.clusters) == screen.codepoints(screen.cell(0, 0)));
+    CHECK(cell_codepoints(frame.cells[3], frame.clusters) == screen.codepoints(screen.cell(3, 0)));
+
+    std::string out;
+    render_frame(frame, out);
+    CHECK(out.find(FAMILY + " " + E_ACUTE + E_ACUTE) != std::string::npos);
+
+    // Cells copied without their pool can't read past it
+    ScreenFrame bare = frame;
+    bare.clusters.clear();
+    CHECK(cell_codepoints(bare.cells[0], bare.clusters) == U"\uFFFD");
+}
+
+void state_round_trip() {
+    Screen screen(TerminalSize{ 10, 2 }, 10);
+    feed(screen, FLAG + "\r\n" + E_ACUTE + "\r\n" + FAMILY + "\r\n" + HEART + VS16 + "\x1b[m");
+    std::vector<uint8_t> state(screen.state_size());
+    screen.save_state(state.data());
+
+    Screen loaded;
+    CHECK(loaded.load_state(state.data(), state.size()));
+    CHECK(loaded.same_live_state(screen));
+    CHECK_EQ(loaded.line_text(0), FAMILY);
+    CHECK_EQ(loaded.line_text(1), HEART + VS16);
+    CHECK(loaded.codepoints(loaded.scrollback()[0].cells[0]).size() == 2);
+
+    // Same picture reached another way: different pool offsets, still the same state
+    Screen other(TerminalSize{ 10, 2 }, 10);
+    feed(other, "a\xCC\x80\x1b[1;1H" + E_ACUTE + "\x1b[m");
+    Screen direct(TerminalSize{ 10, 2 }, 10);
+    feed(direct, E_ACUTE + "\x1b[m");
+    CHECK(other.same_live_state(direct));
+
+    // A cell pointing into the middle of a pool entry is rejected
+    bool corrupted = false;
+    for (size_t i = 0; i + 4 <= state.size(); i += 4) {
+        uint32_t value;
+        std::memcpy(&value, &state[i], 4);
+        if (value & CELL_CLUSTER) {
+            value += 1;
+            std::memcpy(&state[i], &value, 4);
+            corrupted = true;
+            break;
+        }
+    }
+    CHECK(corrupted);
+    Screen rejected;
+    CHECK(!rejected.load_state(state.data(), state.size()));
+}
+
+// Far more distinct clusters than the pool holds: the ones that scrolled away are reclaimed
+void pool_is_reclaimed() {
+    Screen screen(TerminalSize{ 8, 2 }, 0);
+    std::string last;
+    for (char32_t i = 0; i < 3 * SCREEN_CLUSTER_POOL / 4; ++i) {
+        std::string cluster(1, static_cast<char>('a' + i % 26));
+        for (char32_t mark : { 0x300 + (i / 26) % 112, 0x300 + (i / 26 / 112) % 112 }) {
+            cluster += static_cast<char>(0xC0 | (mark >> 6));
+            cluster += static_cast<char>(0x80 | (mark & 0x3F));
+        }
+        feed(screen, cluster);
+        last += cluster;
+        if (i % 8 == 7) {
+            feed(screen, "\r\n");
+            CHECK_EQ(screen.line_text(0), last);
+            last.clear();
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    all_codepoints_kept();
+    variation_selector_widens();
+    frames_and_rendering();
+    state_round_trip();
+    pool_is_reclaimed();
+    return headless_tty_test::check_result("screen_cluster_test");
+}
@@ -0,0 +1,171 @@
+/*
+screen_state_test - Screen::save_state() / load_state() round trips, and line numbering
+
+Blank scrollback lines are stored without cells, which is the case that used to hand
+memcpy a null pointer; run under -DHEADLESS_TTY_SANITIZE=ON to catch it again.
+ */
+
+#include "headless_tty/screen.hpp"
+#include "check.hpp"
+
+#include <string>
+#include <vector>
+
+using namespace headless_tty;
+
+namespace {
+
+void feed(Screen& screen, const std::string& text) {
+    screen.feed(reinterpret_cast<const uint8_t*>(text.data()), text.size());
+}
+
+std::vector<uint8_t> save(const Screen& screen) {
+    std::vector<uint8_t> state(screen.state_size());
+    screen.save_state(state.data());
+    return state;
+}
+
+void blank_lines_round_trip() {
+    Screen screen(TerminalSize{ 20, 4 }, 100);
+    feed(screen, "first\r\n\r\n\r\n\r\n\r\nlast\r\n\x1b]0;title\x07");
+    CHECK(screen.scrollback().size() > 0);
+    CHECK(screen.scrollback().back().cells.empty());
+
+    std::vector<uint8_t> state = save(screen);
+    Screen loaded(TerminalSize{ 5, 5 }, 100);
+    CHECK(loaded.load_state(state.data(), state.size()));
+    CHECK(loaded.size().cols == 20 && loaded.size().rows == 4);
+    CHECK(loaded.scrollback().size() == screen.scrollback().size());
+    CHECK_EQ(loaded.title(), "title");
+    CHECK(loaded.same_live_state(screen));
+    CHECK(loaded.state_size() == state.size());
+}
+
+void alt_screen_round_trip() {
+    Screen screen(TerminalSize{ 20, 4 }, 100);
+    feed(screen, "main\r\n\x1b[?1049h\x1b[2;3Halt");
+    std::vector<uint8_t> state = save(screen);
+    Screen loaded;
+    CHECK(loaded.load_state(state.data(), state.size()));
+    CHECK(loaded.modes().alt_screen);
+    CHECK_EQ(loaded.line_text(1), "  alt");
+
+    feed(screen, "\x1b[?1049l");
+    feed(loaded, "\x1b[?1049l");
+    CHECK_EQ(loaded.line_text(0), "main");
+    CHECK(loaded.same_live_state(screen));
+}
+
+void truncated_state_is_rejected() {
+    Screen screen(TerminalSize{ 20, 4 }, 100);
+    feed(screen, "some text\r\nmore text");
+    std::vector<uint8_t> state = save(screen);
+
+    Screen target(TerminalSize{ 10, 3 }, 100);
+    feed(target, "keep");
+    for (size_t length = 0; length < state.size(); length += 7) {
+        CHECK(!target.load_state(state.data(), length));
+    }
+    CHECK_EQ(target.line_text(0), "keep");
+}
+
+// cursor_output_row() matches cursor_line() until a width change, then keeps counting
+// rows as written while cursor_line() follows the re-wrapped history
+void output_rows() {
+    Screen screen(TerminalSize{ 20, 5 }, 10);
+    for (int i = 0; i < 30; ++i) {
+        feed(screen, "line " + std::to_string(i) + " ==========\r\n");
+    }
+    feed(screen, "x\r\nx\r\nx\r\nx\r\nx\r\n");
+    uint64_t row = screen.cursor_output_row();
+    CHECK(row == 35);
+    CHECK(screen.cursor_line() == row);
+
+    screen.resize(TerminalSize{ 10, 5 });
+    feed(screen, "more\r\n");
+    CHECK(screen.cursor_output_row() == row + 1);
+    CHECK(screen.cursor_line() > row + 1);
+
+    std::vector<uint8_t> state = save(screen);
+    Screen loaded(TerminalSize{ 20, 5 }, 10);
+    CHECK(loaded.load_state(state.data(), state.size()));
+    CHECK(loaded.cursor_output_row() == loaded.cursor_line());
+
+    feed(loaded, "\x1b[3J");
+    CHECK(loaded.cursor_output_row() == loaded.cursor_line());
+}
+
+// Text of line n in Screen::cursor_line() numbering: history, then the grid
+std::string line_at(const Screen& screen, uint64_t n) {
+    const LineDeque& history = screen.scrollback();
+    uint64_t base = screen.scrollback_base();
+    if (n >= base + history.size()) {
+        return screen.line_text(static_cast<uint16_t>(n - base - history.size()));
+    }
+    std::string text;
+    for (const Cell& cell : history[static_cast<size_t>(n - base)].cells) {
+        text += static_cast<char>(cell.ch);
+    }
+    return text;
+}
+
+bool starts_with(const std::string& text, const std::string& prefix) {
+    return text.compare(0, prefix.size(), prefix) == 0;
+}
+
+// Marked rows follow their lines through the re-wraps of width changes, in history and on the grid
+void marked_rows() {
+    Screen screen(TerminalSize{ 20, 5 }, 100);
+    std::vector<uint64_t> rows;
+    for (int i = 0; i < 8; ++i) {
+        rows.push_back(screen.mark_output_row());
+        feed(screen, "p" + std::to_string(i) + "> long enough to wrap once\r\n");
+    }
+    // One mark on the second row of a wrapped line: it stays with the text that row started with
+    rows.push_back(screen.mark_output_row());
+    feed(screen, "p8>abcdefghijklmnopqr");
+    uint64_t middle = screen.mark_output_row();
+    feed(screen, "stuvwxyz\r\n");
+
+    auto check_all = [&](const std::string& middle_text) {
+        for (size_t i = 0; i < rows.size(); ++i) {
+            CHECK(starts_with(line_at(screen, screen.output_row_line(rows[i])), "p" + std::to_string(i) + ">"));
+        }
+        CHECK(starts_with(line_at(screen, screen.output_row_line(middle)), middle_text));
+    };
+    check_all("rstu");
+
+    screen.resize(TerminalSize{ 10, 5 });
+    check_all("rstu");
+    screen.resize(TerminalSize{ 40, 5 });
+    check_all("p8>");
+
+    // Marked after a width change, before history has been re-wrapped for it
+    screen.resize(TerminalSize{ 15, 5 });
+    rows.push_back(screen.mark_output_row());
+    feed(screen, "p9> after the resize\r\n");
+    check_all("p8>");
+
+    CHECK(screen.output_row_line(screen.cursor_output_row() + 1) == SCREEN_NO_LINE);
+
+    // Lines dropped from history take their marks with them
+    Screen small(TerminalSize{ 20, 2 }, 2);
+    uint64_t first = small.mark_output_row();
+    feed(small, "gone\r\n1\r\n2\r\n3\r\n");
+    CHECK(small.output_row_line(first) == SCREEN_NO_LINE);
+    uint64_t kept = small.mark_output_row();
+    feed(small, "kept");
+    small.resize(TerminalSize{ 2, 2 });
+    CHECK(starts_with(line_at(small, small.output_row_line(kept)), "ke"));
+}
+
+} // namespace
+
+int main() {
+    blank_lines_round_trip();
+    alt_screen_round_trip();
+    truncated_state_is_rejected();
+    output_rows();
+    marked_rows();
+    return headless_tty_test::check_result("screen_state_test");
+}
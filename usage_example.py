@@ -92,6 +92,75 @@ def get_all_descendants(parent_pid):
     finally:
         _kernel32.CloseHandle(snapshot)
 
+# Job object notifications, so new processes can be waited for instead of polled
+JobObjectAssociateCompletionPortInformation = 7
+PROCESS_SET_QUOTA = 0x0100
+PROCESS_TERMINATE = 0x0001
+
+class JOBOBJECT_ASSOCIATE_COMPLETION_PORT(ctypes.Structure):
+    _fields_ = [
+        ("CompletionKey", ctypes.c_void_p),
+        ("CompletionPort", wintypes.HANDLE),
+    ]
+
+def watch_process_tree(pid):
+    """
+    Put a process in a job whose completion port reports every process started
+    or ended in its tree from now on. Processes it started earlier aren't covered.
+
+    Args:
+        pid: Process ID
+
+    Returns:
+        HANDLE of the completion port, or None if the process couldn't be watched
+    """
+    _kernel32.CreateIoCompletionPort.restype = wintypes.HANDLE
+    _kernel32.CreateIoCompletionPort.argtypes = [wintypes.HANDLE, wintypes.HANDLE, ctypes.c_void_p, wintypes.DWORD]
+    _kernel32.CreateJobObjectW.restype = wintypes.HANDLE
+    _kernel32.CreateJobObjectW.argtypes = [ctypes.c_void_p, wintypes.LPCWSTR]
+    _kernel32.SetInformationJobObject.argtypes = [wintypes.HANDLE, ctypes.c_int, ctypes.c_void_p, wintypes.DWORD]
+    _kernel32.OpenProcess.restype = wintypes.HANDLE
+    _kernel32.OpenProcess.argtypes = [wintypes.DWORD, wintypes.BOOL, wintypes.DWORD]
+    _kernel32.AssignProcessToJobObject.argtypes = [wintypes.HANDLE, wintypes.HANDLE]
+
+    port = _kernel32.CreateIoCompletionPort(wintypes.HANDLE(-1), None, None, 1)
+    job = _kernel32.CreateJobObjectW(None, None)
+    process = _kernel32.OpenProcess(PROCESS_SET_QUOTA | PROCESS_TERMINATE, False, pid)
+    info = JOBOBJECT_ASSOCIATE_COMPLETION_PORT(None, port)
+    ok = (port and job and process and
+          _kernel32.SetInformationJobObject(job, JobObjectAssociateCompletionPortInformation,
+                                            ctypes.byref(info), ctypes.sizeof(info)) and
+          _kernel32.AssignProcessToJobObject(job, process))
+    # The job lives as long as a process in it; without a kill limit closing it ends nothing
+    for handle in (job, process):
+        if handle:
+            _kernel32.CloseHandle(handle)
+    if not ok:
+        if port:
+            _kernel32.CloseHandle(port)
+        return None
+    return port
+
+def wait_for_process_event(port, timeout):
+    """
+    Block until the watched tree starts or ends a process, or timeout seconds pass
+
+    Returns:
+        bool: True if something happened, False on timeout
+    """
+    if port is None:
+        # Not watched: the caller takes a snapshot after each pause instead
+        time.sleep(min(timeout, 0.1))
+        return False
+    _kernel32.GetQueuedCompletionStatus.argtypes = [wintypes.HANDLE, ctypes.POINTER(wintypes.DWORD),
+                                                    ctypes.POINTER(ctypes.c_void_p), ctypes.POINTER(ctypes.c_void_p),
+                                                    wintypes.DWORD]
+    message = wintypes.DWORD()
+    key = ctypes.c_void_p()
+    overlapped = ctypes.c_void_p()
+    return bool(_kernel32.GetQueuedCompletionStatus(port, ctypes.byref(message), ctypes.byref(key),
+                                                    ctypes.byref(overlapped), max(0, int(timeout * 1000))))
+
 
 
 headless_tty_exe = "headless-tty.exe" # Use path r"path to headless-tty.exe" such as r"C:\my folder\headless-tty.exe", or if running from the same folder use "headless-tty.exe
@@ -111,13 +180,26 @@ headless_process = subprocess.Popen(
     cmd
 )
 
-# Wait a moment for child process to spawn
-time.sleep(0.5)
+# Wait for the children instead of sleeping a fixed time. conhost appears before the
+# app (and a UWP app spawns several), so wait until no process has started or ended
+# for 100 ms; a slow machine still gets up to 5 s. The job's completion port wakes
+# this loop only when the process tree changes.
+port = watch_process_tree(headless_process.pid)
+children = get_all_descendants(headless_process.pid)
+deadline = time.monotonic() + 5.0
+while headless_process.poll() is None:
+    remaining = deadline - time.monotonic()
+    if remaining <= 0:
+        break
+    changed = wait_for_process_event(port, min(remaining, 0.1) if children else remaining)
+    # Get all descendant processes (children, grandchildren, etc.)
+    children = get_all_descendants(headless_process.pid)
+    if not changed and children:
+        break
+if port is not None:
+    _kernel32.CloseHandle(port)
 
 msg = f"headless-tty PID: {headless_process.pid}\n"
-
-# Get all descendant processes (children, grandchildren, etc.)
-children = get_all_descendants(headless_process.pid)
 if children:
     for child in children:
         msg += f"Child process PID: {child['pid']} ({child['name']})\n"